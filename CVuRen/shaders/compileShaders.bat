@@ -1,3 +1,17 @@
 %VULKAN_SDK%\Bin\glslc.exe shader.vert -o vert.spv
 %VULKAN_SDK%\Bin\glslc.exe shader.frag -o frag.spv
+%VULKAN_SDK%\Bin\glslc.exe hiz.comp -o hiz.spv
+%VULKAN_SDK%\Bin\glslc.exe cull.comp -o cull.spv
+%VULKAN_SDK%\Bin\glslc.exe overdraw.frag -o overdraw.spv
+%VULKAN_SDK%\Bin\glslc.exe fullscreen.vert -o fullscreen.spv
+%VULKAN_SDK%\Bin\glslc.exe heatmap.frag -o heatmap.spv
+%VULKAN_SDK%\Bin\glslc.exe light.comp -o light.spv
+%VULKAN_SDK%\Bin\glslc.exe shadow.vert -o shadow.spv
+%VULKAN_SDK%\Bin\glslc.exe upscale.comp -o upscale.spv
+%VULKAN_SDK%\Bin\glslc.exe bloom_down.comp -o bloom_down.spv
+%VULKAN_SDK%\Bin\glslc.exe bloom_up.comp -o bloom_up.spv
+%VULKAN_SDK%\Bin\glslc.exe overlay.vert -o overlay_vert.spv
+%VULKAN_SDK%\Bin\glslc.exe overlay.frag -o overlay_frag.spv
+%VULKAN_SDK%\Bin\glslc.exe sprite.vert -o sprite_vert.spv
+%VULKAN_SDK%\Bin\glslc.exe sprite.frag -o sprite_frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450
+
+layout(constant_id = 0) const float saturation = 8.0;
+
+layout(binding = 0) uniform sampler2D counts;
+
+layout(location = 0) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+// black, blue, green, yellow, red, white as the count goes from 0 to saturation
+const vec3 ramp[6] = vec3[](
+    vec3(0.0, 0.0, 0.0),
+    vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(1.0, 1.0, 0.0),
+    vec3(1.0, 0.0, 0.0),
+    vec3(1.0, 1.0, 1.0)
+);
+
+void main() {
+    float count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;
+    float t = clamp(count / saturation, 0.0, 1.0) * 5.0;
+    int i = min(int(t), 4);
+    outColor = vec4(mix(ramp[i], ramp[i + 1], t - float(i)), 1.0);
+}
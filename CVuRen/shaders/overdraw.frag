@@ -0,0 +1,8 @@
+#version 450
+
+// one per fragment, the count target adds them up
+layout(location = 0) out vec4 outCount;
+
+void main() {
+    outCount = vec4(1.0);
+}
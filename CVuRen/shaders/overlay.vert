@@ -0,0 +1,27 @@
+#version 450
+
+// one instance per quad, the corner comes from the vertex index of a 4 vertex strip
+layout(location = 0) in ivec4 rect;
+layout(location = 1) in vec4 uvRect;
+layout(location = 2) in vec4 color;
+
+layout(push_constant) uniform Params {
+    // 2 / the output extent, pixels to clip space
+    vec2 scale;
+} params;
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) out vec4 fragColor;
+
+vec3 fromSrgb(vec3 c) {
+    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), step(0.04045, c));
+}
+
+void main() {
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 position = vec2(rect.xy) + vec2(rect.zw) * corner;
+    gl_Position = vec4(position * params.scale - 1.0, 0.0, 1.0);
+    fragUv = mix(uvRect.xy, uvRect.zw, corner);
+    // the output is linear and the blit encodes it
+    fragColor = vec4(fromSrgb(color.rgb), color.a);
+}
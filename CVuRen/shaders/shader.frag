@@ -1,12 +1,125 @@
 #version 450
 
+// matches lighting.h
+const uint GRID_X = 16;
+const uint GRID_Y = 9;
+const uint GRID_Z = 24;
+// matches shadows.h
+const uint CASCADES = 4;
+
+const vec3 AMBIENT = vec3(0.08);
+
+// extra views: no clusters or cascades of their own and no post stack after them, see views.h
+layout(constant_id = 0) const bool SIMPLE_VIEW = false;
+
+struct Light {
+    vec4 positionRange;
+    vec4 colorSpot;
+    vec4 direction;
+};
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    // tile size in pixels, slice scale and bias
+    vec4 cluster;
+    mat4 shadowMatrices[CASCADES];
+    vec4 cascadeSplits;
+    vec4 cascadeTexels;
+    vec4 sunDirection;
+    vec4 sunColor;
+} ubo;
 layout(binding = 1) uniform sampler2D texSampler;
+layout(std430, binding = 2) readonly buffer Lights { Light lights[]; };
+layout(std430, binding = 3) readonly buffer Clusters { uvec2 clusters[]; };
+layout(std430, binding = 4) readonly buffer Indices { uint indices[]; };
+layout(binding = 5) uniform sampler2DArrayShadow shadowMap;
 
 layout(location = 0) in vec4 fragColor;
 layout(location = 1) in vec3 fragTexCoord;
+layout(location = 2) in vec3 fragViewPosition;
 
 layout(location = 0) out vec4 outColor;
 
+uint clusterIndex() {
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.cluster.xy), uvec2(GRID_X - 1, GRID_Y - 1));
+    float slice = log(max(-fragViewPosition.z, 1e-4)) * ubo.cluster.z + ubo.cluster.w;
+    uint z = uint(clamp(slice, 0.0, float(GRID_Z - 1)));
+    return tile.x + tile.y * GRID_X + z * GRID_X * GRID_Y;
+}
+
+// 1 is fully lit, past the last cascade everything is
+float sunShadow(vec3 normal) {
+    float depth = -fragViewPosition.z;
+    if (depth >= ubo.cascadeSplits[CASCADES - 1]) {
+        return 1.0;
+    }
+    uint cascade = 0;
+    while (depth >= ubo.cascadeSplits[cascade]) {
+        ++cascade;
+    }
+
+    // pushed out along the normal by about a texel, so surfaces don't shadow themselves
+    vec3 position = fragViewPosition + normal * ubo.cascadeTexels[cascade] * 1.5;
+    vec4 coord = ubo.shadowMatrices[cascade] * vec4(position, 1.0);
+    vec2 uv = coord.xy * 0.5 + 0.5;
+
+    // 3x3 taps of 2x2 hardware compares
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            lit += texture(shadowMap, vec4(uv + vec2(x, y) * texel, float(cascade), coord.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+// Narkowicz's fit of the ACES filmic curve, as upscale.comp has it
+vec3 tonemap(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
 void main() {
-    outColor = texture(texSampler, vec2(fragTexCoord.x,fragTexCoord.y));
+    vec4 albedo = texture(texSampler, vec2(fragTexCoord.x,fragTexCoord.y));
+
+    // the vertices carry no normals, faces are lit flat
+    vec3 normal = normalize(cross(dFdx(fragViewPosition), dFdy(fragViewPosition)));
+    vec3 toEye = normalize(-fragViewPosition);
+    if (dot(normal, toEye) < 0.0) {
+        normal = -normal;
+    }
+
+    vec3 lit = AMBIENT;
+    float sun = max(dot(normal, ubo.sunDirection.xyz), 0.0);
+    if (SIMPLE_VIEW) {
+        outColor = vec4(tonemap(albedo.rgb * (lit + ubo.sunColor.rgb * sun)), albedo.a);
+        return;
+    }
+    if (sun > 0.0) {
+        lit += ubo.sunColor.rgb * sun * sunShadow(normal);
+    }
+    uvec2 range = clusters[clusterIndex()];
+    for (uint i = range.x; i < range.x + range.y; ++i) {
+        Light light = lights[indices[i]];
+        vec3 toLight = light.positionRange.xyz - fragViewPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float rangeSquared = light.positionRange.w * light.positionRange.w;
+        if (distanceSquared >= rangeSquared) {
+            continue;
+        }
+        toLight *= inversesqrt(distanceSquared);
+
+        // smooth falloff to exactly zero at the range
+        float falloff = 1.0 - distanceSquared / rangeSquared;
+        float attenuation = falloff * falloff / (1.0 + distanceSquared);
+        if (light.colorSpot.w > -1.0) {
+            float cosAngle = dot(-toLight, light.direction.xyz);
+            attenuation *= smoothstep(light.colorSpot.w, mix(light.colorSpot.w, 1.0, 0.2), cosAngle);
+        }
+        lit += light.colorSpot.rgb * max(dot(normal, toLight), 0.0) * attenuation;
+    }
+
+    outColor = vec4(albedo.rgb * lit, albedo.a);
 }
\ No newline at end of file
@@ -4,17 +4,22 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    vec4 cluster;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec4 inColor;
 layout(location = 2) in vec3 inTexCoord;
+layout(location = 3) in mat4 inModel;
 
 layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec3 fragTexCoord;
+layout(location = 2) out vec3 fragViewPosition;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec4 viewPosition = ubo.view * ubo.model * inModel * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * viewPosition;
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+    fragViewPosition = viewPosition.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450
+
+// the cascade being drawn, light view and ortho projection
+layout(push_constant) uniform Cascade {
+    mat4 viewProj;
+} cascade;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 3) in mat4 inModel;
+
+void main() {
+    gl_Position = cascade.viewProj * inModel * vec4(inPosition, 1.0);
+}
\ No newline at end of file
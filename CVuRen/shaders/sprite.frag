@@ -0,0 +1,13 @@
+#version 450
+
+layout(binding = 1) uniform sampler2DArray textures;
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) flat in uint fragLayer;
+layout(location = 2) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures, vec3(fragUv, float(fragLayer))) * fragColor;
+}
@@ -0,0 +1,54 @@
+#version 450
+
+// no vertex input, every 6 vertices are the two triangles of one sprite
+struct Sprite {
+    vec2 position;
+    vec2 size;
+    // 4 unorm16, top left then bottom right
+    uvec2 uv;
+    // rgba8 srgb
+    uint color;
+    // rotation in turns as unorm16 in the low half, the layer in the high one
+    uint rotationLayer;
+};
+
+layout(std430, binding = 0) readonly buffer Sprites {
+    Sprite sprites[];
+};
+
+layout(push_constant) uniform Params {
+    // 2 / the output extent, pixels to clip space
+    vec2 scale;
+} params;
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) flat out uint fragLayer;
+layout(location = 2) out vec4 fragColor;
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+    vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0)
+);
+
+vec3 fromSrgb(vec3 c) {
+    return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), step(0.04045, c));
+}
+
+void main() {
+    Sprite sprite = sprites[gl_VertexIndex / 6];
+    vec2 corner = CORNERS[gl_VertexIndex % 6];
+
+    // y points down on screen, so counter clockwise is a negative angle here
+    float angle = float(sprite.rotationLayer & 0xffffu) / 65535.0 * -6.28318531;
+    float c = cos(angle);
+    float s = sin(angle);
+    vec2 local = (corner - 0.5) * sprite.size;
+    vec2 position = sprite.position + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+    gl_Position = vec4(position * params.scale - 1.0, 0.0, 1.0);
+
+    fragUv = mix(unpackUnorm2x16(sprite.uv.x), unpackUnorm2x16(sprite.uv.y), corner);
+    fragLayer = sprite.rotationLayer >> 16;
+    vec4 color = unpackUnorm4x8(sprite.color);
+    // the render target is linear
+    fragColor = vec4(fromSrgb(color.rgb), color.a);
+}
@@ -0,0 +1,351 @@
+#include "capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stb_image_write.h>
+
+#include "vkcontext.h"
+#include "settings.h"
+
+#include "utils/threading.h"
+#include "utils/trace.h"
+#include "utils/utils.h"
+
+#define SLOT_FREE 0
+/* copy recorded, waiting for the frame's fence */
+#define SLOT_PENDING 1
+/* handed to a worker */
+#define SLOT_CONVERTING 2
+
+typedef struct CaptureSlot {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* mapped;
+    volatile int32_t state;
+    uint32_t frame;
+    uint32_t index;
+} CaptureSlot;
+
+static struct CAPTURE {
+    bool supported;
+    bool swizzle;
+    VkDeviceSize size;
+    uint32_t width, height;
+    CaptureSlot slots[CAPTURE_RING_SIZE];
+    uint32_t cursor;
+
+    bool active;
+    CaptureFormat format;
+    uint32_t remaining;
+    uint32_t nextIndex;
+
+    /* jobs submitted and not finished yet, a slot is freed before its job ends */
+    volatile int32_t inFlight;
+
+    CaptureSinkFn sink;
+    void* sinkUserData;
+
+    c_mutex statsLock;
+    CaptureStats stats;
+} CAPTURE;
+
+void createCaptureResources() {
+    switch (VULKAN.swapchainImageFormat) {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        CAPTURE.swizzle = true;
+        CAPTURE.supported = true;
+        break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        CAPTURE.swizzle = false;
+        CAPTURE.supported = true;
+        break;
+    default:
+        CAPTURE.supported = false;
+        break;
+    }
+    CAPTURE.supported = CAPTURE.supported && VULKAN.swapchainTransferSrc;
+    if (!CAPTURE.supported) {
+        printf("capture: swapchain images can't be copied, capturing is off\n");
+        return;
+    }
+
+    createCaptureBuffers();
+    if (SETTINGS.capture) captureStart(SETTINGS.captureRaw ? CAPTURE_FORMAT_RAW : CAPTURE_FORMAT_PNG, 0);
+}
+
+void destroyCaptureResources() {
+    CAPTURE.active = false;
+    destroyCaptureBuffers();
+}
+
+/* reading back through uncached memory is several times slower, so cached is preferred */
+static uint32_t findReadbackMemoryType(uint32_t typeFilter) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(VULKAN.physicalDevice, &memProperties);
+
+    VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & cached) == cached) {
+            return i;
+        }
+    }
+    return findMemoryType(typeFilter, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+void createCaptureBuffers() {
+    if (!CAPTURE.supported) return;
+
+    CAPTURE.width = VULKAN.swapchainExtent.width;
+    CAPTURE.height = VULKAN.swapchainExtent.height;
+    CAPTURE.size = (VkDeviceSize)CAPTURE.width * CAPTURE.height * 4;
+
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; ++i) {
+        CaptureSlot* slot = CAPTURE.slots + i;
+        VkBufferCreateInfo bufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .size = CAPTURE.size,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = NULL
+        };
+        if (vkCreateBuffer(VULKAN.device, &bufferInfo, NULL, &slot->buffer) != VK_SUCCESS) {
+            c_throw("failed to create capture buffer");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(VULKAN.device, slot->buffer, &memRequirements);
+        uint32_t memoryType = findReadbackMemoryType(memRequirements.memoryTypeBits);
+        if (!allocateDeviceMemory(memRequirements.size, memoryType, MEMORY_CATEGORY_READBACK, &slot->memory)) {
+            c_throw("failed to alloc capture buffer memory");
+        }
+        vkBindBufferMemory(VULKAN.device, slot->buffer, slot->memory, 0);
+        vkMapMemory(VULKAN.device, slot->memory, 0, CAPTURE.size, 0, &slot->mapped);
+        c_atomic_store(&slot->state, SLOT_FREE);
+    }
+    CAPTURE.cursor = 0;
+}
+
+void destroyCaptureBuffers() {
+    if (!CAPTURE.supported || CAPTURE.slots[0].buffer == VK_NULL_HANDLE) return;
+
+    // copies still waiting on a fence are lost, the device is idle by now anyway
+    flushCaptures();
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; ++i) {
+        CaptureSlot* slot = CAPTURE.slots + i;
+        if (c_atomic_load(&slot->state) == SLOT_PENDING) {
+            c_mutex_lock(&CAPTURE.statsLock);
+            ++CAPTURE.stats.dropped;
+            c_mutex_unlock(&CAPTURE.statsLock);
+        }
+        vkDestroyBuffer(VULKAN.device, slot->buffer, NULL);
+        freeDeviceMemory(slot->memory);
+        slot->buffer = VK_NULL_HANDLE;
+    }
+}
+
+void captureStart(CaptureFormat format, uint32_t frameCount) {
+    if (!CAPTURE.supported) return;
+    CAPTURE.format = format;
+    CAPTURE.remaining = frameCount;
+    CAPTURE.active = true;
+}
+
+void captureStop() {
+    CAPTURE.active = false;
+}
+
+bool captureActive() {
+    return CAPTURE.active;
+}
+
+void captureSetSink(CaptureSinkFn fn, void* userData) {
+    // jobs already handed out read the sink, let them finish with the old one
+    flushCaptures();
+    CAPTURE.sink = fn;
+    CAPTURE.sinkUserData = userData;
+}
+
+void recordCapture(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t imageIndex) {
+    if (!CAPTURE.active) return;
+
+    CaptureSlot* slot = CAPTURE.slots + CAPTURE.cursor;
+    if (c_atomic_load(&slot->state) != SLOT_FREE) {
+        // the workers are behind, skipping is what keeps this from stalling
+        c_mutex_lock(&CAPTURE.statsLock);
+        ++CAPTURE.stats.dropped;
+        c_mutex_unlock(&CAPTURE.statsLock);
+        return;
+    }
+    CAPTURE.cursor = (CAPTURE.cursor + 1) % CAPTURE_RING_SIZE;
+
+    VkImage image = VULKAN.swapchainImages.swapchainImages[imageIndex];
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &toTransfer);
+
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { CAPTURE.width, CAPTURE.height, 1 }
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+    VkImageMemoryBarrier toPresent = toTransfer;
+    toPresent.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toPresent.dstAccessMask = 0;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkBufferMemoryBarrier toHost = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot->buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &toHost, 1, &toPresent);
+
+    slot->frame = frame;
+    slot->index = CAPTURE.nextIndex++;
+    c_atomic_store(&slot->state, SLOT_PENDING);
+
+    if (CAPTURE.remaining && --CAPTURE.remaining == 0) CAPTURE.active = false;
+}
+
+static void writeCapture(const CaptureImage* image, CaptureFormat format) {
+    char path[64];
+    uint64_t bytes = 0;
+    if (format == CAPTURE_FORMAT_PNG) {
+        snprintf(path, sizeof(path), "capture_%05u.png", image->index);
+        int stride = (int)image->width * 4;
+        if (stbi_write_png(path, (int)image->width, (int)image->height, 4, image->pixels, stride)) {
+            bytes = (uint64_t)stride * image->height;
+        }
+    } else {
+        snprintf(path, sizeof(path), "capture_%05u_%ux%u.rgba", image->index, image->width, image->height);
+        FILE* file = fopen(path, "wb");
+        if (file) {
+            bytes = fwrite(image->pixels, 1, (size_t)image->width * image->height * 4, file);
+            fclose(file);
+        }
+    }
+
+    c_mutex_lock(&CAPTURE.statsLock);
+    if (bytes) {
+        ++CAPTURE.stats.written;
+        CAPTURE.stats.bytesWritten += bytes;
+    } else {
+        fprintf(stderr, "capture: failed to write %s\n", path);
+    }
+    c_mutex_unlock(&CAPTURE.statsLock);
+}
+
+static void captureJob(void* arg) {
+    CaptureSlot* slot = arg;
+    TRACE_BEGIN("captureEncode");
+    uint64_t start = getTimeInNanoseconds();
+
+    // converting into a private copy frees the slot before the slow part
+    size_t pixelCount = (size_t)CAPTURE.width * CAPTURE.height;
+    uint8_t* pixels = malloc(pixelCount * 4);
+    const uint8_t* source = slot->mapped;
+    if (CAPTURE.swizzle) {
+        for (size_t i = 0; i < pixelCount; ++i) {
+            pixels[i * 4 + 0] = source[i * 4 + 2];
+            pixels[i * 4 + 1] = source[i * 4 + 1];
+            pixels[i * 4 + 2] = source[i * 4 + 0];
+            pixels[i * 4 + 3] = source[i * 4 + 3];
+        }
+    } else {
+        memcpy(pixels, source, pixelCount * 4);
+    }
+    CaptureImage image = { slot->index, CAPTURE.width, CAPTURE.height, pixels };
+    CaptureFormat format = CAPTURE.format;
+    c_atomic_store(&slot->state, SLOT_FREE);
+
+    if (CAPTURE.sink) {
+        CAPTURE.sink(&image, CAPTURE.sinkUserData);
+    } else {
+        writeCapture(&image, format);
+    }
+    free(pixels);
+
+    c_mutex_lock(&CAPTURE.statsLock);
+    CAPTURE.stats.encodeTimeTotalNs += getTimeInNanoseconds() - start;
+    c_mutex_unlock(&CAPTURE.statsLock);
+    c_atomic_add(&CAPTURE.inFlight, -1);
+    TRACE_END();
+}
+
+void collectCaptures(uint32_t frame) {
+    if (!CAPTURE.supported) return;
+
+    for (uint32_t i = 0; i < CAPTURE_RING_SIZE; ++i) {
+        CaptureSlot* slot = CAPTURE.slots + i;
+        if (slot->frame != frame || c_atomic_load(&slot->state) != SLOT_PENDING) continue;
+
+        c_atomic_store(&slot->state, SLOT_CONVERTING);
+        c_mutex_lock(&CAPTURE.statsLock);
+        ++CAPTURE.stats.captured;
+        c_mutex_unlock(&CAPTURE.statsLock);
+        c_atomic_add(&CAPTURE.inFlight, 1);
+        tp_submit(captureJob, slot);
+    }
+}
+
+void flushCaptures() {
+    if (c_atomic_load(&CAPTURE.inFlight) > 0) tp_wait_idle();
+}
+
+CaptureStats getCaptureStats() {
+    c_mutex_lock(&CAPTURE.statsLock);
+    CaptureStats stats = CAPTURE.stats;
+    c_mutex_unlock(&CAPTURE.statsLock);
+    return stats;
+}
+
+void printCaptureStats() {
+    CaptureStats stats = getCaptureStats();
+    if (stats.captured == 0 && stats.dropped == 0) return;
+
+    printf("capture: %u frames captured, %u dropped, %u written (%.1f MB), %.2f ms per frame on the workers\n",
+        stats.captured, stats.dropped, stats.written, (double)stats.bytesWritten / (1024.0 * 1024.0),
+        stats.captured ? (double)stats.encodeTimeTotalNs / (double)stats.captured / 1e6 : 0.0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* readback buffers, enough to keep every frame in flight plus the workers busy */
+#define CAPTURE_RING_SIZE 8
+
+typedef enum CaptureFormat {
+    CAPTURE_FORMAT_PNG,
+    /* tightly packed rgba8, the size is in the file name */
+    CAPTURE_FORMAT_RAW
+} CaptureFormat;
+
+/* tightly packed rgba8, top row first, whatever the swapchain format was */
+typedef struct CaptureImage {
+    uint32_t index;
+    uint32_t width, height;
+    const uint8_t* pixels;
+} CaptureImage;
+
+/* runs on a worker thread, pixels are only valid during the call */
+typedef void (*CaptureSinkFn)(const CaptureImage* image, void* userData);
+
+typedef struct CaptureStats {
+    uint32_t captured, dropped, written;
+    uint64_t bytesWritten;
+    uint64_t encodeTimeTotalNs;
+} CaptureStats;
+
+/*
+ * Copies the presented image into a ring of host visible buffers at the end
+ * of the frame. A buffer is only touched on the cpu after its frame's fence
+ * has signalled, then a worker converts and encodes it, so capturing never
+ * waits on the gpu. When every buffer is busy the frame is dropped and counted.
+ */
+void createCaptureResources();
+void destroyCaptureResources();
+
+/* readback buffers are sized after the swapchain, the resources call these too */
+void createCaptureBuffers();
+void destroyCaptureBuffers();
+
+/* frameCount 0 keeps capturing until captureStop() */
+void captureStart(CaptureFormat format, uint32_t frameCount);
+void captureStop();
+bool captureActive();
+/* replaces writing files, NULL restores it */
+void captureSetSink(CaptureSinkFn fn, void* userData);
+
+/* records the copy of the swapchain image, which has to be in PRESENT_SRC_KHR */
+void recordCapture(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t imageIndex);
+/* call after the frame's fence wait, hands finished copies to the workers */
+void collectCaptures(uint32_t frame);
+/* waits until every handed out frame is encoded */
+void flushCaptures();
+
+CaptureStats getCaptureStats();
+void printCaptureStats();
@@ -0,0 +1,215 @@
+#include "compute.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkcontext.h"
+
+#include "utils/utils.h"
+
+typedef struct ComputeRecorder {
+    ComputeRecordFn fn;
+    void* userData;
+    VkPipelineStageFlags waitStage;
+} ComputeRecorder;
+
+static struct COMPUTE {
+    VkCommandPool commandPool;
+    VkCommandBuffer* commandBuffers;
+    VkSemaphore* finished;
+
+    ComputeRecorder recorders[MAX_COMPUTE_RECORDERS];
+    uint32_t recorderCount;
+} COMPUTE;
+
+void createComputeResources() {
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = VULKAN.queueFamilies.computeFamily
+    };
+    if (vkCreateCommandPool(VULKAN.device, &poolInfo, NULL, &COMPUTE.commandPool) != VK_SUCCESS) {
+        c_throw("failed to create compute command pool");
+    }
+
+    COMPUTE.commandBuffers = malloc(sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = COMPUTE.commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = (uint32_t)MAX_FRAMES_IN_FLIGHT
+    };
+    if (vkAllocateCommandBuffers(VULKAN.device, &allocInfo, COMPUTE.commandBuffers) != VK_SUCCESS) {
+        c_throw("failed to allocate compute command buffers");
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0
+    };
+    COMPUTE.finished = malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (vkCreateSemaphore(VULKAN.device, &semaphoreInfo, NULL, COMPUTE.finished + i) != VK_SUCCESS) {
+            c_throw("failed to create compute semaphores");
+        }
+    }
+}
+
+void destroyComputeResources() {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroySemaphore(VULKAN.device, COMPUTE.finished[i], NULL);
+    }
+    vkDestroyCommandPool(VULKAN.device, COMPUTE.commandPool, NULL);
+    free(COMPUTE.finished);
+    free(COMPUTE.commandBuffers);
+    COMPUTE.recorderCount = 0;
+}
+
+void addAsyncComputeRecorder(ComputeRecordFn fn, void* userData, VkPipelineStageFlags graphicsWaitStage) {
+    if (COMPUTE.recorderCount == MAX_COMPUTE_RECORDERS) {
+        c_throw("too many async compute recorders");
+    }
+    COMPUTE.recorders[COMPUTE.recorderCount++] = (ComputeRecorder){ fn, userData, graphicsWaitStage };
+}
+
+bool submitAsyncCompute(uint32_t frame, VkSemaphore* signaled, VkPipelineStageFlags* waitStage) {
+    if (!COMPUTE.recorderCount) return false;
+
+    /* the frame fence covers this buffer too: the graphics submit of the
+       same frame waited on its semaphore before it could signal */
+    VkCommandBuffer commandBuffer = COMPUTE.commandBuffers[frame];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL
+    };
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        c_throw("failed to begin a compute command buffer");
+    }
+
+    VkPipelineStageFlags stages = 0;
+    for (uint32_t i = 0; i < COMPUTE.recorderCount; ++i) {
+        COMPUTE.recorders[i].fn(commandBuffer, frame, COMPUTE.recorders[i].userData);
+        stages |= COMPUTE.recorders[i].waitStage;
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        c_throw("failed to record compute command buffer");
+    }
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = NULL,
+        .pWaitDstStageMask = NULL,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = COMPUTE.finished + frame
+    };
+    if (vkQueueSubmit(VULKAN.computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        c_throw("failed to submit compute command buffer");
+    }
+
+    *signaled = COMPUTE.finished[frame];
+    *waitStage = stages ? stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    return true;
+}
+
+bool asyncComputeIsDedicated() {
+    return VULKAN.queueFamilies.dedicatedCompute;
+}
+
+static void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    bool transfer = srcFamily != dstFamily;
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .srcQueueFamilyIndex = transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
+
+void releaseBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkPipelineStageFlags srcStage) {
+    if (srcFamily == dstFamily) {
+        // same queue, the acquire side does the whole barrier
+        return;
+    }
+    // dst access/stage are ignored on release
+    bufferBarrier(commandBuffer, buffer, srcFamily, dstFamily, srcAccess, 0,
+        srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void acquireBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+    if (srcFamily == dstFamily) {
+        bufferBarrier(commandBuffer, buffer, srcFamily, dstFamily, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            dstAccess, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage);
+        return;
+    }
+    // the semaphore already made the writes available, src access is ignored on acquire
+    bufferBarrier(commandBuffer, buffer, srcFamily, dstFamily, 0, dstAccess,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage);
+}
+
+static void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    bool transfer = srcFamily != dstFamily;
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = aspect,
+            .baseMipLevel = 0,
+            .levelCount = VK_REMAINING_MIP_LEVELS,
+            .baseArrayLayer = 0,
+            .layerCount = VK_REMAINING_ARRAY_LAYERS
+            }
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void releaseImageOwnership(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkPipelineStageFlags srcStage) {
+    if (srcFamily == dstFamily) return;
+    // layouts have to match on both halves, the transition happens once
+    imageBarrier(commandBuffer, image, aspect, oldLayout, newLayout, srcFamily, dstFamily,
+        srcAccess, 0, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void acquireImageOwnership(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+    if (srcFamily == dstFamily) {
+        imageBarrier(commandBuffer, image, aspect, oldLayout, newLayout, srcFamily, dstFamily,
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, dstAccess,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage);
+        return;
+    }
+    imageBarrier(commandBuffer, image, aspect, oldLayout, newLayout, srcFamily, dstFamily,
+        0, dstAccess, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+
+#define MAX_COMPUTE_RECORDERS 8
+
+/* records async compute work for the frame, called once per frame before the graphics submit */
+typedef void (*ComputeRecordFn)(VkCommandBuffer commandBuffer, uint32_t frame, void* userData);
+
+void createComputeResources();
+void destroyComputeResources();
+
+/*
+ * graphicsWaitStage is the first graphics stage that consumes the results,
+ * the frame's graphics submit waits on the compute semaphore there.
+ */
+void addAsyncComputeRecorder(ComputeRecordFn fn, void* userData, VkPipelineStageFlags graphicsWaitStage);
+
+/* records and submits all recorders, returns false when there was nothing to do */
+bool submitAsyncCompute(uint32_t frame, VkSemaphore* signaled, VkPipelineStageFlags* waitStage);
+
+bool asyncComputeIsDedicated();
+
+/*
+ * Queue family ownership transfer. The release half goes into the source queue's
+ * command buffer, the acquire half into the destination's, with a semaphore between
+ * the two submits. With a shared family both become a plain barrier.
+ */
+void releaseBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkPipelineStageFlags srcStage);
+void acquireBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+void releaseImageOwnership(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkPipelineStageFlags srcStage);
+void acquireImageOwnership(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
@@ -0,0 +1,119 @@
+#include "devices.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TIER_NAMES[DEVICE_TIER_COUNT] = { "low", "mid", "high" };
+
+static bool hasExtension(const VkExtensionProperties* extensions, uint32_t count, const char* name) {
+    for (uint32_t i = 0; i < count; ++i) {
+        if (strcmp(extensions[i].extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+static uint32_t typeScore(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 1000;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 400;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 200;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return 10;
+    default: return 100;
+    }
+}
+
+static const char* typeName(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+    default: return "other";
+    }
+}
+
+void queryDeviceCaps(VkPhysicalDevice device, bool dedicatedCompute, bool dedicatedTransfer, DeviceCaps* caps) {
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceMemoryProperties memory;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    vkGetPhysicalDeviceFeatures(device, &features);
+    vkGetPhysicalDeviceMemoryProperties(device, &memory);
+
+    memset(caps, 0, sizeof(DeviceCaps));
+    strncpy(caps->name, properties.deviceName, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+    caps->type = properties.deviceType;
+    caps->apiVersion = properties.apiVersion;
+    // integrated gpus report system memory as device local, the type score keeps them behind discrete ones
+    for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+        if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            caps->deviceLocalBytes += memory.memoryHeaps[i].size;
+        }
+    }
+    caps->maxImageDimension2D = properties.limits.maxImageDimension2D;
+    caps->maxComputeWorkGroupInvocations = properties.limits.maxComputeWorkGroupInvocations;
+
+    caps->dedicatedCompute = dedicatedCompute;
+    caps->dedicatedTransfer = dedicatedTransfer;
+    caps->multiDrawIndirect = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+    caps->pipelineStatistics = features.pipelineStatisticsQuery;
+
+    // the instance is 1.1, so the 1.2 promotions only count through their extensions
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+    VkExtensionProperties* extensions = malloc(sizeof(VkExtensionProperties) * extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, extensions);
+    caps->timelineSemaphore = hasExtension(extensions, extensionCount, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    caps->descriptorIndexing = hasExtension(extensions, extensionCount, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    caps->drawIndirectCount = hasExtension(extensions, extensionCount, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    caps->memoryBudget = properties.apiVersion >= VK_API_VERSION_1_1 &&
+        hasExtension(extensions, extensionCount, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    free(extensions);
+
+    // the type dominates, memory counts up to 16 GiB, the rest breaks ties between similar devices
+    VkDeviceSize gib = caps->deviceLocalBytes >> 30;
+    caps->score = typeScore(caps->type) + 40 * (uint32_t)(gib < 16 ? gib : 16);
+    caps->score += caps->maxImageDimension2D / 1024 + caps->maxComputeWorkGroupInvocations / 256;
+    caps->score += caps->dedicatedCompute ? 100 : 0;
+    caps->score += caps->dedicatedTransfer ? 50 : 0;
+    caps->score += caps->multiDrawIndirect ? 150 : 0;
+    caps->score += caps->pipelineStatistics ? 10 : 0;
+    caps->score += caps->timelineSemaphore ? 30 : 0;
+    caps->score += caps->descriptorIndexing ? 30 : 0;
+    caps->score += caps->drawIndirectCount ? 30 : 0;
+    caps->score += caps->memoryBudget ? 20 : 0;
+
+    if (caps->type == VK_PHYSICAL_DEVICE_TYPE_CPU || !caps->multiDrawIndirect) {
+        caps->tier = DEVICE_TIER_LOW;
+    } else if (caps->type == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && caps->dedicatedCompute &&
+        caps->deviceLocalBytes >= DEVICE_HIGH_TIER_MEMORY) {
+        caps->tier = DEVICE_TIER_HIGH;
+    } else {
+        caps->tier = DEVICE_TIER_MID;
+    }
+}
+
+const char* deviceTierName(DeviceTier tier) {
+    return tier < DEVICE_TIER_COUNT ? TIER_NAMES[tier] : "unknown";
+}
+
+DeviceTier parseDeviceTier(const char* name) {
+    for (uint32_t tier = 0; tier < DEVICE_TIER_COUNT; ++tier) {
+        if (strcmp(name, TIER_NAMES[tier]) == 0) return (DeviceTier)tier;
+    }
+    return DEVICE_TIER_COUNT;
+}
+
+void printDeviceCaps(uint32_t index, const DeviceCaps* caps, bool chosen) {
+    printf("device %u: %s, %s, %llu MiB device local, score %u, tier %s%s\n", index, caps->name,
+        typeName(caps->type), (unsigned long long)(caps->deviceLocalBytes >> 20), caps->score,
+        deviceTierName(caps->tier), chosen ? " <- chosen" : "");
+    if (!chosen) return;
+    printf("  async compute %s, transfer queue %s, multi draw indirect %s, timeline semaphores %s, "
+        "descriptor indexing %s, draw indirect count %s, memory budget %s\n",
+        caps->dedicatedCompute ? "yes" : "no", caps->dedicatedTransfer ? "yes" : "no",
+        caps->multiDrawIndirect ? "yes" : "no", caps->timelineSemaphore ? "yes" : "no",
+        caps->descriptorIndexing ? "yes" : "no", caps->drawIndirectCount ? "yes" : "no",
+        caps->memoryBudget ? "yes" : "no");
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* below this much device local memory a discrete gpu is treated like an integrated one */
+#define DEVICE_HIGH_TIER_MEMORY (2ull << 30)
+
+typedef enum DeviceTier {
+    /* software rasterizers and devices without multi draw indirect: plain draws, no gpu culling or statistics */
+    DEVICE_TIER_LOW,
+    /* integrated gpus: everything but async compute, which only competes with graphics for the same units */
+    DEVICE_TIER_MID,
+    DEVICE_TIER_HIGH,
+    DEVICE_TIER_COUNT
+} DeviceTier;
+
+typedef struct DeviceCaps {
+    char name[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+    VkPhysicalDeviceType type;
+    uint32_t apiVersion;
+    VkDeviceSize deviceLocalBytes;
+    uint32_t maxImageDimension2D, maxComputeWorkGroupInvocations;
+
+    bool dedicatedCompute, dedicatedTransfer;
+    bool multiDrawIndirect, pipelineStatistics;
+    /* extensions the renderer could build faster paths on, they only add to the score so far */
+    bool timelineSemaphore, descriptorIndexing, drawIndirectCount, memoryBudget;
+
+    uint32_t score;
+    DeviceTier tier;
+} DeviceCaps;
+
+/*
+ * What a physical device can do and how it ranks against the others.
+ * The score adds up the device type, device local memory, a couple of
+ * limits, the queue family layout and the optional features, so among
+ * several devices of a kind the bigger, better equipped one wins. The tier
+ * follows from the same capabilities and decides which optional paths the
+ * renderer takes on the chosen device, see DeviceTier.
+ * pickPhysicalDevice chooses the best scoring suitable device unless
+ * SETTINGS.device names one, by index or by part of its name, and
+ * SETTINGS.deviceTier overrides the tier.
+ */
+void queryDeviceCaps(VkPhysicalDevice device, bool dedicatedCompute, bool dedicatedTransfer, DeviceCaps* caps);
+
+const char* deviceTierName(DeviceTier tier);
+/* DEVICE_TIER_COUNT when the name is none of them */
+DeviceTier parseDeviceTier(const char* name);
+
+void printDeviceCaps(uint32_t index, const DeviceCaps* caps, bool chosen);
@@ -0,0 +1,235 @@
+#include "geometry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vkcontext.h"
+
+#include "utils/threading.h"
+#include "utils/utils.h"
+
+typedef struct GeometryArena {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint32_t capacity, used;
+    /* sorted by offset, neighbours are always merged */
+    GeometryRange freeBlocks[GEOMETRY_MAX_FREE_BLOCKS];
+    uint32_t freeCount;
+} GeometryArena;
+
+typedef struct PendingFree {
+    GeometryRange vertices, indices;
+    uint64_t retireFrame;
+} PendingFree;
+
+static struct GEOMETRY {
+    GeometryArena vertices, indices;
+    PendingFree pending[GEOMETRY_MAX_PENDING_FREES];
+    uint32_t pendingCount;
+    uint64_t frame;
+    uint32_t meshes;
+    c_mutex lock;
+} GEOMETRY;
+
+static void createArena(GeometryArena* arena, uint32_t capacity, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+    MemoryCategory category) {
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->freeBlocks[0] = (GeometryRange){ 0, capacity };
+    arena->freeCount = 1;
+    createBuffer(elementSize * capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, category, &arena->buffer, &arena->memory);
+}
+
+static void destroyArena(GeometryArena* arena) {
+    vkDestroyBuffer(VULKAN.device, arena->buffer, NULL);
+    freeDeviceMemory(arena->memory);
+}
+
+static bool arenaAlloc(GeometryArena* arena, uint32_t count, uint32_t* offset) {
+    for (uint32_t i = 0; i < arena->freeCount; ++i) {
+        GeometryRange* block = arena->freeBlocks + i;
+        if (block->count < count) continue;
+
+        *offset = block->offset;
+        block->offset += count;
+        block->count -= count;
+        if (block->count == 0) {
+            memmove(block, block + 1, sizeof(GeometryRange) * (arena->freeCount - i - 1));
+            --arena->freeCount;
+        }
+        arena->used += count;
+        return true;
+    }
+    return false;
+}
+
+static void arenaFree(GeometryArena* arena, GeometryRange range) {
+    if (range.count == 0) return;
+
+    uint32_t i = 0;
+    while (i < arena->freeCount && arena->freeBlocks[i].offset < range.offset) ++i;
+
+    bool mergePrev = i > 0 && arena->freeBlocks[i - 1].offset + arena->freeBlocks[i - 1].count == range.offset;
+    bool mergeNext = i < arena->freeCount && range.offset + range.count == arena->freeBlocks[i].offset;
+
+    if (mergePrev && mergeNext) {
+        arena->freeBlocks[i - 1].count += range.count + arena->freeBlocks[i].count;
+        memmove(arena->freeBlocks + i, arena->freeBlocks + i + 1, sizeof(GeometryRange) * (arena->freeCount - i - 1));
+        --arena->freeCount;
+    } else if (mergePrev) {
+        arena->freeBlocks[i - 1].count += range.count;
+    } else if (mergeNext) {
+        arena->freeBlocks[i].offset = range.offset;
+        arena->freeBlocks[i].count += range.count;
+    } else {
+        if (arena->freeCount == GEOMETRY_MAX_FREE_BLOCKS) {
+            c_throw("geometry free list is full");
+        }
+        memmove(arena->freeBlocks + i + 1, arena->freeBlocks + i, sizeof(GeometryRange) * (arena->freeCount - i));
+        arena->freeBlocks[i] = range;
+        ++arena->freeCount;
+    }
+    arena->used -= range.count;
+}
+
+void createGeometryBuffers() {
+    createArena(&GEOMETRY.vertices, GEOMETRY_VERTEX_CAPACITY, sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        MEMORY_CATEGORY_VERTEX);
+    createArena(&GEOMETRY.indices, GEOMETRY_INDEX_CAPACITY, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        MEMORY_CATEGORY_INDEX);
+}
+
+void destroyGeometryBuffers() {
+    destroyArena(&GEOMETRY.vertices);
+    destroyArena(&GEOMETRY.indices);
+}
+
+bool uploadMesh(Mesh* mesh, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+    uint32_t vertexOffset, firstIndex;
+
+    c_mutex_lock(&GEOMETRY.lock);
+    if (!arenaAlloc(&GEOMETRY.vertices, vertexCount, &vertexOffset)) {
+        c_mutex_unlock(&GEOMETRY.lock);
+        return false;
+    }
+    if (!arenaAlloc(&GEOMETRY.indices, indexCount, &firstIndex)) {
+        arenaFree(&GEOMETRY.vertices, (GeometryRange){ vertexOffset, vertexCount });
+        c_mutex_unlock(&GEOMETRY.lock);
+        return false;
+    }
+    ++GEOMETRY.meshes;
+    c_mutex_unlock(&GEOMETRY.lock);
+
+    VkDeviceSize vertexSize = sizeof(Vertex) * vertexCount;
+    VkDeviceSize indexSize = sizeof(uint32_t) * indexCount;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(vertexSize + indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING,
+        &stagingBuffer, &stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(VULKAN.device, stagingBufferMemory, 0, vertexSize + indexSize, 0, &data);
+    memcpy(data, vertices, vertexSize);
+    memcpy((char*)data + vertexSize, indices, indexSize);
+    vkUnmapMemory(VULKAN.device, stagingBufferMemory);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkBufferCopy vertexRegion = {
+        .srcOffset = 0,
+        .dstOffset = sizeof(Vertex) * (VkDeviceSize)vertexOffset,
+        .size = vertexSize
+    };
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, GEOMETRY.vertices.buffer, 1, &vertexRegion);
+    VkBufferCopy indexRegion = {
+        .srcOffset = vertexSize,
+        .dstOffset = sizeof(uint32_t) * (VkDeviceSize)firstIndex,
+        .size = indexSize
+    };
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, GEOMETRY.indices.buffer, 1, &indexRegion);
+    endSingleTimeCommands(commandBuffer);
+
+    vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
+    freeDeviceMemory(stagingBufferMemory);
+
+    mesh->vertexOffset = (int32_t)vertexOffset;
+    mesh->vertexCount = vertexCount;
+    mesh->firstIndex = firstIndex;
+    mesh->indexCount = indexCount;
+    for (uint32_t i = 0; i < mesh->lodCount; ++i) {
+        mesh->lods[i].firstIndex += firstIndex;
+    }
+    return true;
+}
+
+void releaseMesh(Mesh* mesh) {
+    c_mutex_lock(&GEOMETRY.lock);
+    if (GEOMETRY.pendingCount == GEOMETRY_MAX_PENDING_FREES) {
+        c_mutex_unlock(&GEOMETRY.lock);
+        c_throw("too many meshes released at once");
+    }
+    GEOMETRY.pending[GEOMETRY.pendingCount++] = (PendingFree){
+        { (uint32_t)mesh->vertexOffset, mesh->vertexCount },
+        { mesh->firstIndex, mesh->indexCount },
+        GEOMETRY.frame + MAX_FRAMES_IN_FLIGHT
+    };
+    --GEOMETRY.meshes;
+    c_mutex_unlock(&GEOMETRY.lock);
+
+    memset(mesh, 0, sizeof(Mesh));
+}
+
+void retireGeometry() {
+    c_mutex_lock(&GEOMETRY.lock);
+    ++GEOMETRY.frame;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < GEOMETRY.pendingCount; ++i) {
+        PendingFree* pending = GEOMETRY.pending + i;
+        if (pending->retireFrame <= GEOMETRY.frame) {
+            arenaFree(&GEOMETRY.vertices, pending->vertices);
+            arenaFree(&GEOMETRY.indices, pending->indices);
+        } else {
+            GEOMETRY.pending[kept++] = *pending;
+        }
+    }
+    GEOMETRY.pendingCount = kept;
+    c_mutex_unlock(&GEOMETRY.lock);
+}
+
+void bindGeometry(VkCommandBuffer commandBuffer) {
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &GEOMETRY.vertices.buffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, GEOMETRY.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+static uint32_t largestFree(const GeometryArena* arena) {
+    uint32_t largest = 0;
+    for (uint32_t i = 0; i < arena->freeCount; ++i) {
+        if (arena->freeBlocks[i].count > largest) largest = arena->freeBlocks[i].count;
+    }
+    return largest;
+}
+
+GeometryStats getGeometryStats() {
+    c_mutex_lock(&GEOMETRY.lock);
+    GeometryStats stats = {
+        .vertexUsed = GEOMETRY.vertices.used,
+        .indexUsed = GEOMETRY.indices.used,
+        .vertexFreeBlocks = GEOMETRY.vertices.freeCount,
+        .indexFreeBlocks = GEOMETRY.indices.freeCount,
+        .vertexLargestFree = largestFree(&GEOMETRY.vertices),
+        .indexLargestFree = largestFree(&GEOMETRY.indices),
+        .meshes = GEOMETRY.meshes
+    };
+    c_mutex_unlock(&GEOMETRY.lock);
+    return stats;
+}
+
+void printGeometryStats() {
+    GeometryStats stats = getGeometryStats();
+    printf("geometry: %u meshes, vertices %u/%u (%u free blocks, largest %u), indices %u/%u (%u free blocks, largest %u)\n",
+        stats.meshes, stats.vertexUsed, GEOMETRY_VERTEX_CAPACITY, stats.vertexFreeBlocks, stats.vertexLargestFree,
+        stats.indexUsed, GEOMETRY_INDEX_CAPACITY, stats.indexFreeBlocks, stats.indexLargestFree);
+}
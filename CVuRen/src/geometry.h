@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vertexes.h"
+#include "mesh.h"
+
+/* sizes of the shared arenas, in vertices and indices */
+#define GEOMETRY_VERTEX_CAPACITY (1u << 19)
+#define GEOMETRY_INDEX_CAPACITY (1u << 21)
+#define GEOMETRY_MAX_FREE_BLOCKS 1024
+#define GEOMETRY_MAX_PENDING_FREES 256
+
+typedef struct GeometryRange {
+	uint32_t offset, count;
+} GeometryRange;
+
+typedef struct GeometryStats {
+	uint32_t vertexUsed, indexUsed;
+	uint32_t vertexFreeBlocks, indexFreeBlocks;
+	uint32_t vertexLargestFree, indexLargestFree;
+	uint32_t meshes;
+} GeometryStats;
+
+/*
+ * All static geometry lives in one device local vertex buffer and one index
+ * buffer. Meshes get ranges out of them from a first fit free list and are
+ * drawn with vertexOffset/firstIndex, so nothing is rebound between meshes.
+ */
+void createGeometryBuffers();
+void destroyGeometryBuffers();
+
+/*
+ * Copies the mesh into the arenas and rebases its vertexOffset and lod
+ * firstIndex values. Lod firstIndex values must be relative to indices.
+ * Returns false when either arena has no block large enough.
+ */
+bool uploadMesh(Mesh* mesh, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+/* the ranges go back to the free list once frames that may still draw the mesh are done */
+void releaseMesh(Mesh* mesh);
+
+/* once per frame, after the frame's fence wait */
+void retireGeometry();
+
+void bindGeometry(VkCommandBuffer commandBuffer);
+
+GeometryStats getGeometryStats();
+void printGeometryStats();
@@ -0,0 +1,302 @@
+#include "gpumemory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkcontext.h"
+#include "settings.h"
+
+#include "utils/threading.h"
+#include "utils/utils.h"
+
+typedef struct Allocation {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t heap;
+    MemoryCategory category;
+} Allocation;
+
+typedef struct BudgetCallback {
+    MemoryBudgetFn fn;
+    void* userData;
+} BudgetCallback;
+
+static const char* categoryNames[MEMORY_CATEGORY_COUNT] = {
+    "vertex", "index", "texture", "uniform", "staging", "attachment", "storage", "readback"
+};
+
+static struct MEMORY {
+    c_mutex lock;
+    bool budgetExtension;
+    VkPhysicalDeviceMemoryProperties properties;
+
+    Allocation* allocations;
+    uint32_t allocationCount, allocationCapacity;
+
+    /* what went through allocateDeviceMemory, the usage when the driver can't tell */
+    VkDeviceSize heapAllocated[VK_MAX_MEMORY_HEAPS];
+    /* the usage the driver last reported, and allocated minus freed since then */
+    VkDeviceSize heapReported[VK_MAX_MEMORY_HEAPS];
+    int64_t heapSinceQuery[VK_MAX_MEMORY_HEAPS];
+    MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+    MemoryCategoryStats categories[MEMORY_CATEGORY_COUNT];
+
+    BudgetCallback callbacks[MAX_BUDGET_CALLBACKS];
+    uint32_t callbackCount;
+
+    uint64_t frame;
+    uint32_t overBudget, retries, failures;
+} MEMORY;
+
+static double mib(VkDeviceSize bytes) {
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+// lock held; asks the driver, so it's for once a frame and the rare paths, not every allocation
+static void queryBudget() {
+    uint32_t heapCount = MEMORY.properties.memoryHeapCount;
+    memset(MEMORY.heapSinceQuery, 0, sizeof(MEMORY.heapSinceQuery));
+
+    if (MEMORY.budgetExtension) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+            .pNext = NULL
+        };
+        VkPhysicalDeviceMemoryProperties2 properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budget
+        };
+        vkGetPhysicalDeviceMemoryProperties2(VULKAN.physicalDevice, &properties);
+        for (uint32_t i = 0; i < heapCount; ++i) {
+            MEMORY.heaps[i].budget = budget.heapBudget[i];
+            MEMORY.heapReported[i] = budget.heapUsage[i];
+            MEMORY.heaps[i].usage = budget.heapUsage[i];
+        }
+    } else {
+        for (uint32_t i = 0; i < heapCount; ++i) {
+            MEMORY.heaps[i].usage = MEMORY.heapAllocated[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < heapCount; ++i) {
+        if (MEMORY.heaps[i].usage > MEMORY.heaps[i].peak) MEMORY.heaps[i].peak = MEMORY.heaps[i].usage;
+    }
+}
+
+// lock held; between queries the last reported usage plus what changed here since
+static VkDeviceSize heapUsage(uint32_t heap) {
+    if (!MEMORY.budgetExtension) return MEMORY.heapAllocated[heap];
+    int64_t usage = (int64_t)MEMORY.heapReported[heap] + MEMORY.heapSinceQuery[heap];
+    return usage > 0 ? (VkDeviceSize)usage : 0;
+}
+
+static void runBudgetCallbacks(uint32_t heap, VkDeviceSize usage, VkDeviceSize budget) {
+    // copied out so the callbacks can allocate, free and unregister
+    BudgetCallback callbacks[MAX_BUDGET_CALLBACKS];
+    c_mutex_lock(&MEMORY.lock);
+    uint32_t count = MEMORY.callbackCount;
+    for (uint32_t i = 0; i < count; ++i) callbacks[i] = MEMORY.callbacks[i];
+    c_mutex_unlock(&MEMORY.lock);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        callbacks[i].fn(heap, usage, budget, callbacks[i].userData);
+    }
+}
+
+void createMemoryTracking(bool budgetExtension) {
+    MEMORY.budgetExtension = budgetExtension;
+    vkGetPhysicalDeviceMemoryProperties(VULKAN.physicalDevice, &MEMORY.properties);
+
+    for (uint32_t i = 0; i < MEMORY.properties.memoryHeapCount; ++i) {
+        VkMemoryHeap heap = MEMORY.properties.memoryHeaps[i];
+        MEMORY.heaps[i].size = heap.size;
+        MEMORY.heaps[i].budget = (VkDeviceSize)((double)heap.size * MEMORY_FALLBACK_BUDGET);
+        MEMORY.heaps[i].deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    MEMORY.allocationCapacity = 64;
+    MEMORY.allocations = malloc(sizeof(Allocation) * MEMORY.allocationCapacity);
+    if (!MEMORY.allocations) c_throw("failed to alloc the memory tracking table");
+
+    c_mutex_lock(&MEMORY.lock);
+    queryBudget();
+    c_mutex_unlock(&MEMORY.lock);
+}
+
+void destroyMemoryTracking() {
+    if (MEMORY.allocationCount) {
+        fprintf(stderr, "gpu memory: %u allocations were never freed\n", MEMORY.allocationCount);
+    }
+    free(MEMORY.allocations);
+    MEMORY.allocations = NULL;
+    MEMORY.allocationCount = MEMORY.allocationCapacity = 0;
+}
+
+bool allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, MemoryCategory category, VkDeviceMemory* memory) {
+    uint32_t heap = MEMORY.properties.memoryTypes[memoryType].heapIndex;
+
+    c_mutex_lock(&MEMORY.lock);
+    VkDeviceSize usage = heapUsage(heap) + size;
+    VkDeviceSize budget = MEMORY.heaps[heap].budget;
+    bool over = usage > budget;
+    if (over) ++MEMORY.overBudget;
+    c_mutex_unlock(&MEMORY.lock);
+
+    if (over) runBudgetCallbacks(heap, usage, budget);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType
+    };
+    VkResult result = vkAllocateMemory(VULKAN.device, &allocInfo, NULL, memory);
+
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+        // whatever the budget said, the heap is full, evicting is the last chance
+        c_mutex_lock(&MEMORY.lock);
+        ++MEMORY.retries;
+        queryBudget();
+        usage = MEMORY.heaps[heap].usage + size;
+        budget = MEMORY.heaps[heap].budget;
+        c_mutex_unlock(&MEMORY.lock);
+
+        runBudgetCallbacks(heap, usage, budget);
+        result = vkAllocateMemory(VULKAN.device, &allocInfo, NULL, memory);
+    }
+
+    c_mutex_lock(&MEMORY.lock);
+    if (result != VK_SUCCESS) {
+        ++MEMORY.failures;
+        c_mutex_unlock(&MEMORY.lock);
+        return false;
+    }
+
+    if (MEMORY.allocationCount == MEMORY.allocationCapacity) {
+        MEMORY.allocationCapacity *= 2;
+        Allocation* grown = realloc(MEMORY.allocations, sizeof(Allocation) * MEMORY.allocationCapacity);
+        if (!grown) {
+            c_mutex_unlock(&MEMORY.lock);
+            c_throw("failed to grow the memory tracking table");
+        }
+        MEMORY.allocations = grown;
+    }
+    MEMORY.allocations[MEMORY.allocationCount++] = (Allocation){ *memory, size, heap, category };
+
+    MEMORY.heapAllocated[heap] += size;
+    MEMORY.heapSinceQuery[heap] += (int64_t)size;
+    MemoryCategoryStats* stats = MEMORY.categories + category;
+    stats->bytes += size;
+    ++stats->allocations;
+    if (stats->bytes > stats->peak) stats->peak = stats->bytes;
+    MemoryHeapStats* heapStats = MEMORY.heaps + heap;
+    heapStats->usage = heapUsage(heap);
+    if (heapStats->usage > heapStats->peak) heapStats->peak = heapStats->usage;
+    c_mutex_unlock(&MEMORY.lock);
+    return true;
+}
+
+void freeDeviceMemory(VkDeviceMemory memory) {
+    if (memory == VK_NULL_HANDLE) return;
+
+    c_mutex_lock(&MEMORY.lock);
+    for (uint32_t i = 0; i < MEMORY.allocationCount; ++i) {
+        Allocation* allocation = MEMORY.allocations + i;
+        if (allocation->memory != memory) continue;
+
+        MEMORY.heapAllocated[allocation->heap] -= allocation->size;
+        MEMORY.heapSinceQuery[allocation->heap] -= (int64_t)allocation->size;
+        MEMORY.heaps[allocation->heap].usage = heapUsage(allocation->heap);
+        MemoryCategoryStats* stats = MEMORY.categories + allocation->category;
+        stats->bytes -= allocation->size;
+        --stats->allocations;
+        *allocation = MEMORY.allocations[--MEMORY.allocationCount];
+        break;
+    }
+    c_mutex_unlock(&MEMORY.lock);
+
+    vkFreeMemory(VULKAN.device, memory, NULL);
+}
+
+void memoryAddBudgetCallback(MemoryBudgetFn fn, void* userData) {
+    c_mutex_lock(&MEMORY.lock);
+    if (MEMORY.callbackCount == MAX_BUDGET_CALLBACKS) {
+        c_mutex_unlock(&MEMORY.lock);
+        c_throw("too many memory budget callbacks");
+    }
+    MEMORY.callbacks[MEMORY.callbackCount++] = (BudgetCallback){ fn, userData };
+    c_mutex_unlock(&MEMORY.lock);
+}
+
+void memoryRemoveBudgetCallback(MemoryBudgetFn fn, void* userData) {
+    c_mutex_lock(&MEMORY.lock);
+    for (uint32_t i = 0; i < MEMORY.callbackCount; ++i) {
+        if (MEMORY.callbacks[i].fn == fn && MEMORY.callbacks[i].userData == userData) {
+            MEMORY.callbacks[i] = MEMORY.callbacks[--MEMORY.callbackCount];
+            break;
+        }
+    }
+    c_mutex_unlock(&MEMORY.lock);
+}
+
+void updateMemoryBudget() {
+    ++MEMORY.frame;
+    if (SETTINGS.memoryReportFrames && MEMORY.frame % SETTINGS.memoryReportFrames == 0) {
+        printMemoryReport();
+    }
+    MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+    c_mutex_lock(&MEMORY.lock);
+    queryBudget();
+    uint32_t heapCount = MEMORY.properties.memoryHeapCount;
+    for (uint32_t i = 0; i < heapCount; ++i) {
+        heaps[i] = MEMORY.heaps[i];
+        if (heaps[i].usage > heaps[i].budget) ++MEMORY.overBudget;
+    }
+    c_mutex_unlock(&MEMORY.lock);
+
+    for (uint32_t i = 0; i < heapCount; ++i) {
+        if (heaps[i].usage > heaps[i].budget) runBudgetCallbacks(i, heaps[i].usage, heaps[i].budget);
+    }
+}
+
+MemoryHeapStats getMemoryHeapStats(uint32_t heap) {
+    c_mutex_lock(&MEMORY.lock);
+    MemoryHeapStats stats = heap < MEMORY.properties.memoryHeapCount ? MEMORY.heaps[heap] : (MemoryHeapStats){ 0 };
+    c_mutex_unlock(&MEMORY.lock);
+    return stats;
+}
+
+MemoryCategoryStats getMemoryCategoryStats(MemoryCategory category) {
+    c_mutex_lock(&MEMORY.lock);
+    MemoryCategoryStats stats = MEMORY.categories[category];
+    c_mutex_unlock(&MEMORY.lock);
+    return stats;
+}
+
+const char* memoryCategoryName(MemoryCategory category) {
+    return category < MEMORY_CATEGORY_COUNT ? categoryNames[category] : "unknown";
+}
+
+void printMemoryReport() {
+    c_mutex_lock(&MEMORY.lock);
+    queryBudget();
+
+    printf("gpu memory, budget %s:\n", MEMORY.budgetExtension ? "from VK_EXT_memory_budget" : "estimated");
+    for (uint32_t i = 0; i < MEMORY.properties.memoryHeapCount; ++i) {
+        MemoryHeapStats* heap = MEMORY.heaps + i;
+        printf("\theap %u%s: %.1f MiB used of %.1f MiB budget, %.1f MiB heap, peak %.1f MiB, ours %.1f MiB\n",
+            i, heap->deviceLocal ? " (device local)" : "", mib(heap->usage), mib(heap->budget), mib(heap->size),
+            mib(heap->peak), mib(MEMORY.heapAllocated[i]));
+    }
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        MemoryCategoryStats* stats = MEMORY.categories + i;
+        if (!stats->peak) continue;
+        printf("\t%-10s %4u allocations, %8.2f MiB, peak %8.2f MiB\n",
+            categoryNames[i], stats->allocations, mib(stats->bytes), mib(stats->peak));
+    }
+    printf("\tover budget %u times, %u retried allocations, %u failed\n",
+        MEMORY.overBudget, MEMORY.retries, MEMORY.failures);
+
+    c_mutex_unlock(&MEMORY.lock);
+}
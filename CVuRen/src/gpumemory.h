@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* share of a heap treated as the budget when the driver can't tell */
+#define MEMORY_FALLBACK_BUDGET 0.8
+#define MAX_BUDGET_CALLBACKS 8
+
+typedef enum MemoryCategory {
+    MEMORY_CATEGORY_VERTEX,
+    MEMORY_CATEGORY_INDEX,
+    MEMORY_CATEGORY_TEXTURE,
+    MEMORY_CATEGORY_UNIFORM,
+    MEMORY_CATEGORY_STAGING,
+    /* depth, the pyramid and everything else sized after the swapchain */
+    MEMORY_CATEGORY_ATTACHMENT,
+    /* gpu written buffers: indirect draws, culling state */
+    MEMORY_CATEGORY_STORAGE,
+    /* host cached copies the cpu reads back */
+    MEMORY_CATEGORY_READBACK,
+    MEMORY_CATEGORY_COUNT
+} MemoryCategory;
+
+/*
+ * Called with a heap over its budget, usage includes the allocation that is
+ * about to happen. Streaming code frees what it can through freeDeviceMemory.
+ * Runs on whatever thread allocated or called updateMemoryBudget, with no
+ * lock held, so it may allocate and free itself.
+ */
+typedef void (*MemoryBudgetFn)(uint32_t heap, VkDeviceSize usage, VkDeviceSize budget, void* userData);
+
+typedef struct MemoryHeapStats {
+    VkDeviceSize size, budget, usage, peak;
+    bool deviceLocal;
+} MemoryHeapStats;
+
+typedef struct MemoryCategoryStats {
+    VkDeviceSize bytes, peak;
+    uint32_t allocations;
+} MemoryCategoryStats;
+
+/*
+ * Every device allocation goes through here and is tagged with a category.
+ * Heap budgets and usage come from VK_EXT_memory_budget when the device has
+ * it, otherwise the budget is MEMORY_FALLBACK_BUDGET of the heap and usage is
+ * what the renderer allocated itself. The driver is asked once a frame,
+ * allocations in between add to what it last reported. Crossing a budget is
+ * soft: the callbacks get a chance to evict first, then the allocation goes
+ * ahead anyway. A failed allocation runs the callbacks and is retried once
+ * before giving up.
+ */
+void createMemoryTracking(bool budgetExtension);
+void destroyMemoryTracking();
+
+/* returns false when the memory really isn't there, callers throw as before */
+bool allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, MemoryCategory category, VkDeviceMemory* memory);
+/* VK_NULL_HANDLE is ignored */
+void freeDeviceMemory(VkDeviceMemory memory);
+
+void memoryAddBudgetCallback(MemoryBudgetFn fn, void* userData);
+void memoryRemoveBudgetCallback(MemoryBudgetFn fn, void* userData);
+
+/* once per frame, queries the budget and runs the callbacks for heaps over it */
+void updateMemoryBudget();
+
+MemoryHeapStats getMemoryHeapStats(uint32_t heap);
+MemoryCategoryStats getMemoryCategoryStats(MemoryCategory category);
+const char* memoryCategoryName(MemoryCategory category);
+void printMemoryReport();
@@ -0,0 +1,126 @@
+#include "gpustats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vkcontext.h"
+
+#include "utils/utils.h"
+
+/* results come back in bit order, which is the order of PassStatistics */
+#define STATISTICS_FLAGS (VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+#define STATISTICS_VALUES 4
+
+static const char* passNames[STATISTICS_PASS_COUNT] = { "scene", "late", "overdraw" };
+
+static struct STATISTICS {
+    VkQueryPool pool;
+    bool* issued;
+
+    PassStatistics last[STATISTICS_PASS_COUNT];
+    PassStatistics total[STATISTICS_PASS_COUNT];
+    uint64_t frames[STATISTICS_PASS_COUNT];
+    /* pixels of the frame each pass was last collected at, for the per pixel numbers */
+    uint64_t pixelsTotal[STATISTICS_PASS_COUNT];
+} STATISTICS;
+
+static uint32_t queryIndex(uint32_t frame, StatisticsPass pass) {
+    return frame * STATISTICS_PASS_COUNT + pass;
+}
+
+void createStatisticsQueries() {
+    if (!VULKAN.pipelineStatisticsQuery) return;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+        .queryCount = MAX_FRAMES_IN_FLIGHT * STATISTICS_PASS_COUNT,
+        .pipelineStatistics = STATISTICS_FLAGS
+    };
+    if (vkCreateQueryPool(VULKAN.device, &poolInfo, NULL, &STATISTICS.pool) != VK_SUCCESS) {
+        c_throw("failed to create pipeline statistics query pool");
+    }
+    STATISTICS.issued = calloc(MAX_FRAMES_IN_FLIGHT * STATISTICS_PASS_COUNT, sizeof(bool));
+}
+
+void destroyStatisticsQueries() {
+    if (STATISTICS.pool == VK_NULL_HANDLE) return;
+
+    vkDestroyQueryPool(VULKAN.device, STATISTICS.pool, NULL);
+    free(STATISTICS.issued);
+    STATISTICS.pool = VK_NULL_HANDLE;
+}
+
+void resetStatistics(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (STATISTICS.pool == VK_NULL_HANDLE) return;
+    vkCmdResetQueryPool(commandBuffer, STATISTICS.pool, queryIndex(frame, 0), STATISTICS_PASS_COUNT);
+}
+
+void beginStatistics(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass) {
+    if (STATISTICS.pool == VK_NULL_HANDLE) return;
+    vkCmdBeginQuery(commandBuffer, STATISTICS.pool, queryIndex(frame, pass), 0);
+}
+
+void endStatistics(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass) {
+    if (STATISTICS.pool == VK_NULL_HANDLE) return;
+    vkCmdEndQuery(commandBuffer, STATISTICS.pool, queryIndex(frame, pass));
+    STATISTICS.issued[queryIndex(frame, pass)] = true;
+}
+
+void collectStatistics(uint32_t frame) {
+    if (STATISTICS.pool == VK_NULL_HANDLE) return;
+
+    uint64_t pixels = (uint64_t)VULKAN.renderExtent.width * VULKAN.renderExtent.height;
+    for (uint32_t pass = 0; pass < STATISTICS_PASS_COUNT; ++pass) {
+        uint32_t query = queryIndex(frame, pass);
+        if (!STATISTICS.issued[query]) continue;
+
+        uint64_t result[STATISTICS_VALUES + 1];
+        VkResult status = vkGetQueryPoolResults(VULKAN.device, STATISTICS.pool, query, 1, sizeof(result), result,
+            sizeof(result), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        STATISTICS.issued[query] = false;
+        if (status != VK_SUCCESS || result[STATISTICS_VALUES] == 0) continue;
+
+        PassStatistics stats = { result[0], result[1], result[2], result[3] };
+        PassStatistics* total = STATISTICS.total + pass;
+        total->vertexInvocations += stats.vertexInvocations;
+        total->clippingInvocations += stats.clippingInvocations;
+        total->clippingPrimitives += stats.clippingPrimitives;
+        total->fragmentInvocations += stats.fragmentInvocations;
+        STATISTICS.last[pass] = stats;
+        STATISTICS.pixelsTotal[pass] += pixels;
+        ++STATISTICS.frames[pass];
+    }
+}
+
+PassStatistics getPassStatistics(StatisticsPass pass) {
+    return STATISTICS.last[pass];
+}
+
+void printStatistics() {
+    if (STATISTICS.pool == VK_NULL_HANDLE) {
+        printf("pipeline statistics: not supported by the device\n");
+        return;
+    }
+    printf("pipeline statistics, per frame:\n");
+    for (uint32_t pass = 0; pass < STATISTICS_PASS_COUNT; ++pass) {
+        uint64_t frames = STATISTICS.frames[pass];
+        if (!frames) continue;
+
+        const PassStatistics* total = STATISTICS.total + pass;
+        printf("\t%-8s %.1f vertex invocations, %.1f primitives clipped to %.1f, %.1f fragment invocations "
+            "(%.2f per pixel) over %llu frames\n", passNames[pass],
+            (double)total->vertexInvocations / (double)frames,
+            (double)total->clippingInvocations / (double)frames,
+            (double)total->clippingPrimitives / (double)frames,
+            (double)total->fragmentInvocations / (double)frames,
+            (double)total->fragmentInvocations / (double)STATISTICS.pixelsTotal[pass],
+            (unsigned long long)frames);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+typedef enum StatisticsPass {
+    /* the only scene pass, or the early one with occlusion culling */
+    STATISTICS_PASS_SCENE,
+    STATISTICS_PASS_LATE,
+    STATISTICS_PASS_OVERDRAW,
+    STATISTICS_PASS_COUNT
+} StatisticsPass;
+
+typedef struct PassStatistics {
+    uint64_t vertexInvocations;
+    /* primitives that reached the clipper and the ones that came out of it */
+    uint64_t clippingInvocations, clippingPrimitives;
+    uint64_t fragmentInvocations;
+} PassStatistics;
+
+/*
+ * Pipeline statistics queries around each pass, one query per pass and
+ * frame in flight. Results are read back without waiting once the frame's
+ * fence has signalled, a pass that didn't run keeps its last numbers out of
+ * the averages. Everything is a no-op when the device lacks the feature.
+ */
+void createStatisticsQueries();
+void destroyStatisticsQueries();
+
+/* must be recorded outside of a render pass, as must begin and end */
+void resetStatistics(VkCommandBuffer commandBuffer, uint32_t frame);
+void beginStatistics(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass);
+void endStatistics(VkCommandBuffer commandBuffer, uint32_t frame, StatisticsPass pass);
+
+/* call after the frame's fence wait */
+void collectStatistics(uint32_t frame);
+/* the latest frame that ran the pass */
+PassStatistics getPassStatistics(StatisticsPass pass);
+void printStatistics();
@@ -0,0 +1,188 @@
+#include "gputrace.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vkcontext.h"
+
+#include "utils/utils.h"
+
+#define GPU_TRACE_FRAME_QUERIES (GPU_TRACE_MAX_ZONES * 2)
+
+typedef struct GpuMarker {
+    /* NULL ends the innermost zone */
+    const char* name;
+    uint32_t query;
+} GpuMarker;
+
+typedef struct GpuTraceFrame {
+    GpuMarker markers[GPU_TRACE_FRAME_QUERIES];
+    uint32_t count;
+} GpuTraceFrame;
+
+static struct GPU_TRACE {
+    bool active;
+    VkQueryPool pool;
+    GpuTraceFrame* frames;
+
+    uint64_t validMask;
+    /* cpu ticks per device tick */
+    double tickScale;
+
+    bool calibratedTimestamps;
+    PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps;
+    uint64_t gpuBase, cpuBase;
+    uint32_t sinceCalibration;
+} GPU_TRACE;
+
+static bool supportsQpcDomain() {
+    PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT getDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+        vkGetInstanceProcAddr(VULKAN.instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+    if (!getDomains) return false;
+
+    uint32_t count = 0;
+    getDomains(VULKAN.physicalDevice, &count, NULL);
+    VkTimeDomainEXT* domains = malloc(sizeof(VkTimeDomainEXT) * count);
+    getDomains(VULKAN.physicalDevice, &count, domains);
+    bool device = false, qpc = false;
+    for (uint32_t i = 0; i < count; ++i) {
+        device |= domains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+        qpc |= domains[i] == VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+    }
+    free(domains);
+    return device && qpc;
+}
+
+static void calibrate() {
+    GPU_TRACE.sinceCalibration = 0;
+
+    if (GPU_TRACE.calibratedTimestamps) {
+        VkCalibratedTimestampInfoEXT infos[2] = {
+            { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, NULL, VK_TIME_DOMAIN_DEVICE_EXT },
+            { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, NULL, VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT }
+        };
+        uint64_t timestamps[2];
+        uint64_t deviation;
+        if (GPU_TRACE.getCalibratedTimestamps(VULKAN.device, 2, infos, timestamps, &deviation) == VK_SUCCESS) {
+            GPU_TRACE.gpuBase = timestamps[0] & GPU_TRACE.validMask;
+            GPU_TRACE.cpuBase = timestamps[1];
+            return;
+        }
+    }
+
+    // the query after the per frame ones is kept for this
+    uint32_t query = MAX_FRAMES_IN_FLIGHT * GPU_TRACE_FRAME_QUERIES;
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    vkCmdResetQueryPool(commandBuffer, GPU_TRACE.pool, query, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GPU_TRACE.pool, query);
+    endSingleTimeCommands(commandBuffer);
+    uint64_t cpu = trace_ticks();
+
+    uint64_t gpu = 0;
+    vkGetQueryPoolResults(VULKAN.device, GPU_TRACE.pool, query, 1, sizeof(gpu), &gpu, sizeof(gpu),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    GPU_TRACE.gpuBase = gpu & GPU_TRACE.validMask;
+    GPU_TRACE.cpuBase = cpu;
+}
+
+void createGpuTrace() {
+#if CVUREN_TRACE
+    VkQueueFamilyProperties* families;
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, NULL);
+    families = malloc(sizeof(VkQueueFamilyProperties) * familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, families);
+    uint32_t validBits = families[VULKAN.queueFamilies.graphicsFamily].timestampValidBits;
+    free(families);
+
+    GPU_TRACE.active = trace_enabled() && validBits > 0;
+    if (!GPU_TRACE.active) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(VULKAN.physicalDevice, &properties);
+    GPU_TRACE.validMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    GPU_TRACE.tickScale = (double)properties.limits.timestampPeriod * (double)trace_ticks_per_second() / 1e9;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MAX_FRAMES_IN_FLIGHT * GPU_TRACE_FRAME_QUERIES + 1,
+        .pipelineStatistics = 0
+    };
+    if (vkCreateQueryPool(VULKAN.device, &poolInfo, NULL, &GPU_TRACE.pool) != VK_SUCCESS) {
+        c_throw("failed to create gpu trace query pool");
+    }
+    GPU_TRACE.frames = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(GpuTraceFrame));
+
+    if (VULKAN.calibratedTimestamps && supportsQpcDomain()) {
+        GPU_TRACE.getCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT)
+            vkGetDeviceProcAddr(VULKAN.device, "vkGetCalibratedTimestampsEXT");
+        GPU_TRACE.calibratedTimestamps = GPU_TRACE.getCalibratedTimestamps != NULL;
+    }
+    calibrate();
+#endif
+}
+
+void destroyGpuTrace() {
+    if (!GPU_TRACE.active) return;
+
+    vkDestroyQueryPool(VULKAN.device, GPU_TRACE.pool, NULL);
+    free(GPU_TRACE.frames);
+    GPU_TRACE.active = false;
+}
+
+void gpuTraceReset(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (!GPU_TRACE.active) return;
+    vkCmdResetQueryPool(commandBuffer, GPU_TRACE.pool, frame * GPU_TRACE_FRAME_QUERIES, GPU_TRACE_FRAME_QUERIES);
+    GPU_TRACE.frames[frame].count = 0;
+}
+
+static void mark(VkCommandBuffer commandBuffer, uint32_t frame, const char* name, VkPipelineStageFlagBits stage) {
+    GpuTraceFrame* traceFrame = GPU_TRACE.frames + frame;
+    if (traceFrame->count == GPU_TRACE_FRAME_QUERIES) return;
+
+    uint32_t query = frame * GPU_TRACE_FRAME_QUERIES + traceFrame->count;
+    vkCmdWriteTimestamp(commandBuffer, stage, GPU_TRACE.pool, query);
+    traceFrame->markers[traceFrame->count++] = (GpuMarker){ name, query };
+}
+
+void gpuTraceBegin(VkCommandBuffer commandBuffer, uint32_t frame, const char* name) {
+    if (!GPU_TRACE.active) return;
+    // an end always has to fit after its begin
+    if (GPU_TRACE.frames[frame].count >= GPU_TRACE_FRAME_QUERIES - 1) return;
+    mark(commandBuffer, frame, name, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+}
+
+void gpuTraceEnd(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (!GPU_TRACE.active) return;
+    mark(commandBuffer, frame, NULL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void collectGpuTrace(uint32_t frame) {
+    if (!GPU_TRACE.active) return;
+    GpuTraceFrame* traceFrame = GPU_TRACE.frames + frame;
+    if (traceFrame->count == 0) return;
+
+    uint64_t results[GPU_TRACE_FRAME_QUERIES];
+    VkResult status = vkGetQueryPoolResults(VULKAN.device, GPU_TRACE.pool, frame * GPU_TRACE_FRAME_QUERIES,
+        traceFrame->count, sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    uint32_t count = traceFrame->count;
+    traceFrame->count = 0;
+    // the fence has signalled, so anything else means the frame never ran
+    if (status != VK_SUCCESS) return;
+
+    if (GPU_TRACE.calibratedTimestamps && ++GPU_TRACE.sinceCalibration >= GPU_TRACE_CALIBRATION_INTERVAL) {
+        calibrate();
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        // masked difference, so a wrap of the device counter doesn't throw the zone across the timeline
+        uint64_t delta = ((results[i] & GPU_TRACE.validMask) - GPU_TRACE.gpuBase) & GPU_TRACE.validMask;
+        int64_t signedDelta = delta > (GPU_TRACE.validMask >> 1) ? (int64_t)delta - (int64_t)GPU_TRACE.validMask - 1
+            : (int64_t)delta;
+        uint64_t ticks = GPU_TRACE.cpuBase + (int64_t)((double)signedDelta * GPU_TRACE.tickScale);
+        trace_gpu_event(traceFrame->markers[i].name, ticks);
+    }
+}
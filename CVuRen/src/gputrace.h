@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+#include "utils/trace.h"
+
+/* timestamp zones a frame can hold, nested ones included */
+#define GPU_TRACE_MAX_ZONES 32
+/* collected frames between clock calibrations, the two clocks drift apart slowly */
+#define GPU_TRACE_CALIBRATION_INTERVAL 600
+
+#if CVUREN_TRACE
+#define TRACE_GPU_BEGIN(commandBuffer, frame, name) gpuTraceBegin(commandBuffer, frame, name)
+#define TRACE_GPU_END(commandBuffer, frame) gpuTraceEnd(commandBuffer, frame)
+#else
+#define TRACE_GPU_BEGIN(commandBuffer, frame, name) ((void)0)
+#define TRACE_GPU_END(commandBuffer, frame) ((void)0)
+#endif
+
+/*
+ * Timestamp queries around command buffer ranges, turned into zones on the
+ * trace's gpu track. Device ticks are mapped to the cpu clock through
+ * VK_EXT_calibrated_timestamps in the QueryPerformanceCounter domain when the
+ * device has it, otherwise through one timestamp read right after a queue
+ * wait at startup, which is off by about the submit latency. Does nothing
+ * while tracing is disabled or the graphics queue has no timestamps.
+ */
+void createGpuTrace();
+void destroyGpuTrace();
+
+/* first thing in the frame's command buffer, outside of a render pass */
+void gpuTraceReset(VkCommandBuffer commandBuffer, uint32_t frame);
+void gpuTraceBegin(VkCommandBuffer commandBuffer, uint32_t frame, const char* name);
+void gpuTraceEnd(VkCommandBuffer commandBuffer, uint32_t frame);
+
+/* call after the frame's fence wait, never blocks */
+void collectGpuTrace(uint32_t frame);
@@ -0,0 +1,107 @@
+#include "hud.h"
+
+#include <stdbool.h>
+
+#include "vkcontext.h"
+#include "gpumemory.h"
+#include "lighting.h"
+#include "occlusion.h"
+#include "overlay.h"
+#include "resolution.h"
+#include "sprites.h"
+
+#include "utils/utils.h"
+
+#define HUD_MARGIN 8.0f
+#define HUD_PADDING 6.0f
+#define HUD_COLUMNS 34
+#define HUD_LINES 8
+/* weight of the newest frame in the smoothed frame time */
+#define HUD_SMOOTHING 0.05f
+
+#define HUD_BACKGROUND OVERLAY_RGBA(16, 16, 20, 180)
+#define HUD_TEXT OVERLAY_RGBA(230, 230, 230, 255)
+#define HUD_LABEL OVERLAY_RGBA(140, 170, 220, 255)
+#define HUD_WARNING OVERLAY_RGBA(240, 120, 80, 255)
+
+static struct HUD {
+    uint64_t lastFrameNs;
+    float frameMs;
+} HUD;
+
+static float line(uint32_t index) {
+    return HUD_MARGIN + HUD_PADDING + (float)(index * OVERLAY_GLYPH_HEIGHT);
+}
+
+void drawHud(uint32_t frame) {
+    uint64_t now = getTimeInNanoseconds();
+    if (HUD.lastFrameNs != 0) {
+        float ms = (float)(now - HUD.lastFrameNs) / 1e6f;
+        HUD.frameMs = HUD.frameMs == 0.0f ? ms : HUD.frameMs + (ms - HUD.frameMs) * HUD_SMOOTHING;
+    }
+    HUD.lastFrameNs = now;
+
+    if (!overlayActive()) return;
+    // last frame's, this one's is only known at overlayEnd
+    OverlayStats overlay = getOverlayStats();
+    overlayBegin(frame);
+
+    uint32_t lines = HUD_LINES + (spritesActive() ? 1 : 0);
+    overlayRect(HUD_MARGIN, HUD_MARGIN, HUD_COLUMNS * OVERLAY_GLYPH_WIDTH + 2.0f * HUD_PADDING,
+        lines * OVERLAY_GLYPH_HEIGHT + 2.0f * HUD_PADDING, HUD_BACKGROUND);
+    float x = HUD_MARGIN + HUD_PADDING;
+    uint32_t row = 0;
+
+    float fps = HUD.frameMs > 0.0f ? 1000.0f / HUD.frameMs : 0.0f;
+    float value = overlayText(x, line(row), HUD_LABEL, "frame ");
+    overlayTextf(value, line(row++), HUD_TEXT, "%6.2f ms %6.0f fps", HUD.frameMs, fps);
+
+    ResolutionStats resolution = getResolutionStats();
+    value = overlayText(x, line(row), HUD_LABEL, "gpu   ");
+    overlayTextf(value, line(row++), HUD_TEXT, "%6.2f ms at %3.0f%% %ux%u", resolution.gpuMs,
+        resolution.scale * 100.0f, VULKAN.renderExtent.width, VULKAN.renderExtent.height);
+
+    const DrawStats* draws = &VULKAN.drawStats;
+    value = overlayText(x, line(row), HUD_LABEL, "draws ");
+    overlayTextf(value, line(row++), HUD_TEXT, "%u batches %u instances", draws->batches, draws->instances);
+    value = overlayText(x, line(row), HUD_LABEL, "tris  ");
+    overlayTextf(value, line(row++), HUD_TEXT, "%.2f M", (double)draws->triangles / 1e6);
+
+    value = overlayText(x, line(row), HUD_LABEL, "cull  ");
+    if (occlusionCullingActive()) {
+        OcclusionStats occlusion = getOcclusionStats();
+        overlayTextf(value, line(row++), HUD_TEXT, "%u drawn %u occluded",
+            occlusion.earlyDrawn + occlusion.lateDrawn, occlusion.occluded);
+    } else {
+        overlayText(value, line(row++), HUD_TEXT, "off");
+    }
+
+    if (spritesActive()) {
+        SpriteStats sprites = getSpriteStats();
+        value = overlayText(x, line(row), HUD_LABEL, "sprite");
+        overlayTextf(value, line(row++), HUD_TEXT, "%u in %.2f ms", sprites.sprites, (double)sprites.writeNs / 1e6);
+    }
+
+    LightingStats lighting = getLightingStats();
+    value = overlayText(x, line(row), HUD_LABEL, "light ");
+    value = overlayTextf(value, line(row), HUD_TEXT, "%u, %u in a cluster", lighting.lights,
+        lighting.maxClusterLights);
+    if (lighting.overflowed) overlayText(value, line(row), HUD_WARNING, " full");
+    ++row;
+
+    VkDeviceSize usage = 0, budget = 0;
+    for (uint32_t heap = 0; heap < VK_MAX_MEMORY_HEAPS; ++heap) {
+        MemoryHeapStats stats = getMemoryHeapStats(heap);
+        if (!stats.deviceLocal) continue;
+        usage += stats.usage;
+        budget += stats.budget;
+    }
+    value = overlayText(x, line(row), HUD_LABEL, "vram  ");
+    overlayTextf(value, line(row++), usage > budget ? HUD_WARNING : HUD_TEXT, "%llu / %llu MiB",
+        (unsigned long long)(usage >> 20), (unsigned long long)(budget >> 20));
+
+    value = overlayText(x, line(row), HUD_LABEL, "hud   ");
+    overlayTextf(value, line(row++), HUD_TEXT, "%.1f us %u quads", (double)overlay.buildNs / 1e3, overlay.quads);
+
+    overlayEnd();
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * The stats panel in the top left corner: frame and gpu times, the render
+ * scale, what was drawn and culled, lights and device memory, all read from
+ * the modules' own stats, most of them a few frames old. Built through the
+ * overlay between updating the frame's uniforms and recording it.
+ */
+void drawHud(uint32_t frame);
@@ -0,0 +1,345 @@
+#include "lighting.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vkcontext.h"
+#include "compute.h"
+#include "pipelines.h"
+
+#include "utils/utils.h"
+
+#define LIGHT_INDEX_CAPACITY (CLUSTER_COUNT * CLUSTER_AVERAGE_LIGHTS)
+
+/* mirrors the structs in light.comp and shader.frag */
+typedef struct GpuLight {
+    vec4 positionRange;
+    /* w is the spot cosine */
+    vec4 colorSpot;
+    vec4 direction;
+} GpuLight;
+
+typedef struct LightCullParams {
+    /* proj[0][0], proj[1][1], near, far */
+    vec4 projection;
+    /* width, height, tile width, tile height */
+    vec4 screen;
+    uint32_t lightCount;
+    uint32_t indexCapacity;
+} LightCullParams;
+
+typedef struct LightCounters {
+    uint32_t indexCount, overflowed, maxClusterLights, pad;
+} LightCounters;
+
+static struct LIGHTING {
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkDescriptorPool pool;
+    VkDescriptorSet* sets;
+
+    VkBuffer* uploads;
+    VkDeviceMemory* uploadsMemory;
+    void** uploadsMapped;
+    VkBuffer* lights;
+    VkDeviceMemory* lightsMemory;
+    VkBuffer* clusters;
+    VkDeviceMemory* clustersMemory;
+    VkBuffer* indices;
+    VkDeviceMemory* indicesMemory;
+    VkBuffer* counters;
+    VkDeviceMemory* countersMemory;
+    void** countersMapped;
+    bool* countersPending;
+
+    LightCullParams* params;
+
+    LightingStats stats;
+} LIGHTING;
+
+static void createLayouts() {
+    VkDescriptorSetLayoutBinding bindings[4];
+    for (uint32_t i = 0; i < 4; ++i) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        };
+    }
+    VkDescriptorSetLayoutCreateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 4,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &setInfo, NULL, &LIGHTING.setLayout) != VK_SUCCESS) {
+        c_throw("failed to create light culling descriptor set layout");
+    }
+
+    VkPushConstantRange push = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(LightCullParams)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &LIGHTING.setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &LIGHTING.layout) != VK_SUCCESS) {
+        c_throw("failed to create light culling pipeline layout");
+    }
+}
+
+static void createSets() {
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 4 * MAX_FRAMES_IN_FLIGHT
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &LIGHTING.pool) != VK_SUCCESS) {
+        c_throw("failed to create light culling descriptor pool");
+    }
+
+    VkDescriptorSetLayout* layouts = malloc(sizeof(VkDescriptorSetLayout) * MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) layouts[i] = LIGHTING.setLayout;
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = LIGHTING.pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = layouts
+    };
+    LIGHTING.sets = malloc(sizeof(VkDescriptorSet) * MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, LIGHTING.sets) != VK_SUCCESS) {
+        c_throw("failed to allocate light culling descriptor sets");
+    }
+    free(layouts);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo buffers[4] = {
+            { LIGHTING.lights[i], 0, VK_WHOLE_SIZE },
+            { LIGHTING.clusters[i], 0, VK_WHOLE_SIZE },
+            { LIGHTING.indices[i], 0, VK_WHOLE_SIZE },
+            { LIGHTING.counters[i], 0, VK_WHOLE_SIZE }
+        };
+        VkWriteDescriptorSet writes[4];
+        for (uint32_t b = 0; b < 4; ++b) {
+            writes[b] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = LIGHTING.sets[i],
+                .dstBinding = b,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = NULL,
+                .pBufferInfo = buffers + b,
+                .pTexelBufferView = NULL
+            };
+        }
+        vkUpdateDescriptorSets(VULKAN.device, 4, writes, 0, NULL);
+    }
+}
+
+static void recordLightCulling(VkCommandBuffer commandBuffer, uint32_t frame, void* userData) {
+    const LightCullParams* params = LIGHTING.params + frame;
+    uint32_t computeFamily = VULKAN.queueFamilies.computeFamily;
+    uint32_t graphicsFamily = VULKAN.queueFamilies.graphicsFamily;
+
+    // lights go to device local memory first, every cluster reads all of them
+    if (params->lightCount) {
+        VkBufferCopy region = { 0, 0, sizeof(GpuLight) * params->lightCount };
+        vkCmdCopyBuffer(commandBuffer, LIGHTING.uploads[frame], LIGHTING.lights[frame], 1, &region);
+    }
+    VkMemoryBarrier copied = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &copied, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, LIGHTING.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, LIGHTING.layout,
+        0, 1, LIGHTING.sets + frame, 0, NULL);
+    vkCmdPushConstants(commandBuffer, LIGHTING.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LightCullParams), params);
+    vkCmdDispatch(commandBuffer, CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+
+    // the counters stay on the compute queue, collectLightingStats reads them once the fence is signaled
+    VkBufferMemoryBarrier toHost = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = LIGHTING.counters[frame],
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, NULL, 1, &toHost, 0, NULL);
+
+    releaseBufferOwnership(commandBuffer, LIGHTING.lights[frame], computeFamily, graphicsFamily,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    releaseBufferOwnership(commandBuffer, LIGHTING.clusters[frame], computeFamily, graphicsFamily,
+        VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    releaseBufferOwnership(commandBuffer, LIGHTING.indices[frame], computeFamily, graphicsFamily,
+        VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    LIGHTING.countersPending[frame] = true;
+}
+
+void createLightingResources() {
+    createLayouts();
+    LIGHTING.pipeline = createComputePipeline("shaders/light.spv", LIGHTING.layout);
+
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    createFrameBuffers(sizeof(GpuLight) * LIGHTING_MAX_LIGHTS, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostVisible,
+        MEMORY_CATEGORY_STAGING, &LIGHTING.uploads, &LIGHTING.uploadsMemory, &LIGHTING.uploadsMapped);
+    createFrameBuffers(sizeof(GpuLight) * LIGHTING_MAX_LIGHTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_STORAGE, &LIGHTING.lights, &LIGHTING.lightsMemory, NULL);
+    // offset and count per cluster
+    createFrameBuffers(sizeof(uint32_t) * 2 * CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_STORAGE, &LIGHTING.clusters, &LIGHTING.clustersMemory, NULL);
+    createFrameBuffers(sizeof(uint32_t) * LIGHT_INDEX_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_STORAGE, &LIGHTING.indices, &LIGHTING.indicesMemory, NULL);
+    createFrameBuffers(sizeof(LightCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+        MEMORY_CATEGORY_READBACK, &LIGHTING.counters, &LIGHTING.countersMemory, &LIGHTING.countersMapped);
+    LIGHTING.countersPending = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(bool));
+    LIGHTING.params = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(LightCullParams));
+
+    createSets();
+
+    // binning doesn't need the depth buffer, so it overlaps with the previous frame's tail
+    addAsyncComputeRecorder(recordLightCulling, NULL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+void destroyLightingResources() {
+    vkDestroyPipeline(VULKAN.device, LIGHTING.pipeline, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, LIGHTING.layout, NULL);
+    vkDestroyDescriptorPool(VULKAN.device, LIGHTING.pool, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, LIGHTING.setLayout, NULL);
+
+    destroyFrameBuffers(LIGHTING.uploads, LIGHTING.uploadsMemory, LIGHTING.uploadsMapped);
+    destroyFrameBuffers(LIGHTING.lights, LIGHTING.lightsMemory, NULL);
+    destroyFrameBuffers(LIGHTING.clusters, LIGHTING.clustersMemory, NULL);
+    destroyFrameBuffers(LIGHTING.indices, LIGHTING.indicesMemory, NULL);
+    destroyFrameBuffers(LIGHTING.counters, LIGHTING.countersMemory, LIGHTING.countersMapped);
+    free(LIGHTING.sets);
+    free(LIGHTING.countersPending);
+    free(LIGHTING.params);
+}
+
+void writeLightingInputs(uint32_t frame, const Light* lights, uint32_t lightCount, const Camera* camera) {
+    if (lightCount > LIGHTING_MAX_LIGHTS) lightCount = LIGHTING_MAX_LIGHTS;
+
+    // culling and shading both happen in view space, so the transform is done once here
+    GpuLight* gpuLights = LIGHTING.uploadsMapped[frame];
+    for (uint32_t i = 0; i < lightCount; ++i) {
+        const Light* light = lights + i;
+        GpuLight* gpuLight = gpuLights + i;
+        glm_mat4_mulv3((vec4*)camera->view, (float*)light->position, 1.0f, gpuLight->positionRange);
+        gpuLight->positionRange[3] = light->range;
+        glm_vec3_copy((float*)light->color, gpuLight->colorSpot);
+        gpuLight->colorSpot[3] = light->spotCos;
+        glm_mat4_mulv3((vec4*)camera->view, (float*)light->direction, 0.0f, gpuLight->direction);
+        gpuLight->direction[3] = 0.0f;
+    }
+
+    memset(LIGHTING.countersMapped[frame], 0, sizeof(LightCounters));
+
+    vec4 cluster;
+    lightingClusterParams(camera, VULKAN.renderExtent, cluster);
+    LightCullParams* params = LIGHTING.params + frame;
+    params->projection[0] = camera->proj[0][0];
+    params->projection[1] = camera->proj[1][1];
+    params->projection[2] = camera->znear;
+    params->projection[3] = camera->zfar;
+    params->screen[0] = (float)VULKAN.renderExtent.width;
+    params->screen[1] = (float)VULKAN.renderExtent.height;
+    params->screen[2] = cluster[0];
+    params->screen[3] = cluster[1];
+    params->lightCount = lightCount;
+    params->indexCapacity = LIGHT_INDEX_CAPACITY;
+    LIGHTING.stats.lights = lightCount;
+}
+
+void lightingClusterParams(const Camera* camera, VkExtent2D extent, vec4 params) {
+    // whole tiles, the last row and column may stick out of the screen
+    params[0] = (float)((extent.width + CLUSTER_GRID_X - 1) / CLUSTER_GRID_X);
+    params[1] = (float)((extent.height + CLUSTER_GRID_Y - 1) / CLUSTER_GRID_Y);
+    // slice = log(depth) * scale + bias, 0 at the near plane and CLUSTER_GRID_Z at the far one
+    float logRange = logf(camera->zfar / camera->znear);
+    params[2] = (float)CLUSTER_GRID_Z / logRange;
+    params[3] = -(float)CLUSTER_GRID_Z * logf(camera->znear) / logRange;
+}
+
+void acquireLightingBuffers(VkCommandBuffer commandBuffer, uint32_t frame) {
+    uint32_t computeFamily = VULKAN.queueFamilies.computeFamily;
+    uint32_t graphicsFamily = VULKAN.queueFamilies.graphicsFamily;
+    acquireBufferOwnership(commandBuffer, LIGHTING.lights[frame], computeFamily, graphicsFamily,
+        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    acquireBufferOwnership(commandBuffer, LIGHTING.clusters[frame], computeFamily, graphicsFamily,
+        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    acquireBufferOwnership(commandBuffer, LIGHTING.indices[frame], computeFamily, graphicsFamily,
+        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+VkBuffer lightingLights(uint32_t frame) {
+    return LIGHTING.lights[frame];
+}
+
+VkBuffer lightingClusters(uint32_t frame) {
+    return LIGHTING.clusters[frame];
+}
+
+VkBuffer lightingIndices(uint32_t frame) {
+    return LIGHTING.indices[frame];
+}
+
+void collectLightingStats(uint32_t frame) {
+    if (!LIGHTING.countersPending[frame]) return;
+
+    const LightCounters* counters = LIGHTING.countersMapped[frame];
+    uint32_t used = counters->indexCount < LIGHT_INDEX_CAPACITY ? counters->indexCount : LIGHT_INDEX_CAPACITY;
+    LIGHTING.stats.indicesUsed = used;
+    LIGHTING.stats.maxClusterLights = counters->maxClusterLights;
+    LIGHTING.stats.overflowed = counters->overflowed;
+    LIGHTING.stats.indicesTotal += used;
+    ++LIGHTING.stats.frames;
+    LIGHTING.countersPending[frame] = false;
+}
+
+LightingStats getLightingStats() {
+    return LIGHTING.stats;
+}
+
+void printLightingStats() {
+    const LightingStats* stats = &LIGHTING.stats;
+    printf("clustered lighting: %u lights in %u clusters, %.1f light indices per frame over %llu frames, "
+        "last frame %u indices, at most %u lights in a cluster, %u clusters overflowed\n",
+        stats->lights, CLUSTER_COUNT,
+        stats->frames ? (double)stats->indicesTotal / (double)stats->frames : 0.0, (unsigned long long)stats->frames,
+        stats->indicesUsed, stats->maxClusterLights, stats->overflowed);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scene.h"
+
+/* froxel grid, x and y split the screen into tiles, z is logarithmic in view depth */
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+/* a cluster keeps at most this many lights, the rest are dropped and counted */
+#define CLUSTER_MAX_LIGHTS 256
+/* shared index list, per frame, an average of this many lights per cluster */
+#define CLUSTER_AVERAGE_LIGHTS 128
+
+#define LIGHTING_MAX_LIGHTS 16384
+
+typedef struct Light {
+    vec3 position;
+    float range;
+    /* premultiplied by the intensity */
+    vec3 color;
+    /* cosine of the cone's half angle, -1 or less is a point light */
+    float spotCos;
+    vec3 direction;
+} Light;
+
+typedef struct LightingStats {
+    uint32_t lights;
+    uint32_t indicesUsed, maxClusterLights;
+    /* clusters that hit CLUSTER_MAX_LIGHTS or ran out of index space */
+    uint32_t overflowed;
+
+    uint64_t frames, indicesTotal;
+} LightingStats;
+
+/*
+ * Clustered forward lighting. Every frame an async compute pass bins the
+ * lights into the froxel grid: one workgroup per cluster tests all lights
+ * against the cluster's view space bounds and appends the hits to a shared
+ * index list. The scene's fragment shader finds its cluster from the
+ * fragment position and depth and only loops over that cluster's lights.
+ * Lights, cluster ranges and indices are handed to the graphics queue
+ * through ownership transfers when compute has a family of its own.
+ */
+void createLightingResources();
+void destroyLightingResources();
+
+/* view space copies of the lights, the frame's cpu side before the compute submit */
+void writeLightingInputs(uint32_t frame, const Light* lights, uint32_t lightCount, const Camera* camera);
+/* tile size in pixels, then the slice scale and bias, as the scene shaders expect them in the ubo */
+void lightingClusterParams(const Camera* camera, VkExtent2D extent, vec4 params);
+
+/* takes the frame's cluster data over on the graphics queue, outside of a render pass */
+void acquireLightingBuffers(VkCommandBuffer commandBuffer, uint32_t frame);
+
+/* bound to the scene descriptor sets at 2, 3 and 4 */
+VkBuffer lightingLights(uint32_t frame);
+VkBuffer lightingClusters(uint32_t frame);
+VkBuffer lightingIndices(uint32_t frame);
+
+/* call after the frame's fence wait */
+void collectLightingStats(uint32_t frame);
+LightingStats getLightingStats();
+void printLightingStats();
@@ -2,19 +2,78 @@
 
 #include "window.h"
 #include "vkthings.h"
+#include "regress.h"
+#include "settings.h"
+#include "simulation.h"
 
-void mainloop() {
-	while (!glfwWindowShouldClose(WINDOW.window)) {
-		glfwPollEvents();
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "utils/threading.h"
+#include "utils/trace.h"
+#include "utils/utils.h"
+
+static uint64_t runStart;
+static volatile int32_t rendering;
+
+static void renderLoop(void* arg) {
+	TRACE_THREAD_NAME("render");
+	bool firstFrame = true;
+	while (c_atomic_load(&rendering)) {
+		TRACE_BEGIN("frame");
 		drawFrame();
+		TRACE_END();
+		if (firstFrame) {
+			printf("time to first frame: %.3f ms\n", (double)(getTimeInNanoseconds() - runStart) / 1e6);
+			firstFrame = false;
+		}
 	}
 	deviceIdle();
 }
 
-void run() {
+// the main thread only handles events, so they're seen as they come, not once per frame
+void mainloop() {
+	windowSetEventsElsewhere(true);
+	simulationStart();
+	c_atomic_store(&rendering, 1);
+	c_thread render = c_thread_start(renderLoop, NULL);
+
+	while (!windowShouldClose()) {
+		glfwWaitEvents();
+		TRACE_BEGIN("events");
+		windowPublishSize();
+		TRACE_END();
+	}
+
+	c_atomic_store(&rendering, 0);
+	// the render thread may be waiting for a minimized window to come back
+	windowReleaseWaiters();
+	c_thread_join(render);
+	simulationStop();
+	windowSetEventsElsewhere(false);
+	printSimulationStats();
+}
+
+int run() {
+	runStart = getTimeInNanoseconds();
+	// before the pool and the device, so init shows up and the gpu track gets its queries
+	trace_set_enabled(SETTINGS.tracePath != NULL);
+	TRACE_THREAD_NAME("main");
+	tp_init(0);
 	initWindow();
 	initVk();
-	mainloop();
+	int status = 0;
+	if (SETTINGS.regress) {
+		status = regressRun() ? 0 : 1;
+		deviceIdle();
+	} else {
+		mainloop();
+	}
+	if (SETTINGS.tracePath) {
+		trace_export(SETTINGS.tracePath);
+	}
 	cleanVk();
 	cleanWindow();
+	tp_shutdown();
+	return status;
 }
@@ -1,4 +1,5 @@
 #pragma once
 
 void mainloop();
-void run();
+/* returns the process exit code */
+int run();
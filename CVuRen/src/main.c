@@ -1,6 +1,86 @@
 #include "loop.h"
+#include "transforms.h"
+#include "settings.h"
+#include "devices.h"
+#include "vkthings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char** argv) {
-	run();
-	return 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--bench-transforms") == 0) {
+			transformsBenchmark(100000, 200);
+			return 0;
+		} else if (strcmp(argv[i], "--no-meshopt") == 0) {
+			SETTINGS.meshOptimize = false;
+		} else if (strcmp(argv[i], "--no-occlusion") == 0) {
+			SETTINGS.occlusionCulling = false;
+		} else if (strcmp(argv[i], "--capture") == 0) {
+			SETTINGS.capture = true;
+		} else if (strcmp(argv[i], "--capture-raw") == 0) {
+			SETTINGS.capture = true;
+			SETTINGS.captureRaw = true;
+		} else if (strcmp(argv[i], "--overdraw") == 0) {
+			SETTINGS.overdraw = true;
+		} else if (strcmp(argv[i], "--cpu-device") == 0) {
+			SETTINGS.cpuDevice = true;
+		} else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+			SETTINGS.device = argv[++i];
+		} else if (strcmp(argv[i], "--tier") == 0 && i + 1 < argc) {
+			SETTINGS.deviceTier = parseDeviceTier(argv[++i]);
+			if (SETTINGS.deviceTier == DEVICE_TIER_COUNT) {
+				fprintf(stderr, "unknown tier %s, expected low, mid or high\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+			++i;
+			SETTINGS.scene = SCENE_KIND_COUNT;
+			for (uint32_t kind = 0; kind < SCENE_KIND_COUNT; ++kind) {
+				if (strcmp(argv[i], sceneKindName(kind)) == 0) SETTINGS.scene = kind;
+			}
+			if (SETTINGS.scene == SCENE_KIND_COUNT) {
+				fprintf(stderr, "unknown scene %s\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+			SETTINGS.lightCount = (uint32_t)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+			SETTINGS.spriteCount = (uint32_t)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--no-shadow-cache") == 0) {
+			SETTINGS.shadowCache = false;
+		} else if (strcmp(argv[i], "--frame-target") == 0 && i + 1 < argc) {
+			SETTINGS.frameTargetMs = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+			SETTINGS.renderScale = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--sharpen") == 0 && i + 1 < argc) {
+			SETTINGS.upscaleSharpness = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--exposure") == 0 && i + 1 < argc) {
+			SETTINGS.exposure = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--bloom") == 0 && i + 1 < argc) {
+			SETTINGS.bloomStrength = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--lut") == 0 && i + 1 < argc) {
+			SETTINGS.lutPath = argv[++i];
+		} else if (strcmp(argv[i], "--post-naive") == 0) {
+			SETTINGS.postNaive = true;
+		} else if (strcmp(argv[i], "--no-overlay") == 0) {
+			SETTINGS.overlay = false;
+		} else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc) {
+			SETTINGS.viewCount = (uint32_t)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--regress") == 0) {
+			SETTINGS.regress = true;
+		} else if (strcmp(argv[i], "--regress-update") == 0) {
+			SETTINGS.regress = true;
+			SETTINGS.regressUpdate = true;
+		} else if (strcmp(argv[i], "--regress-slack") == 0 && i + 1 < argc) {
+			SETTINGS.regressSlack = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--memory-report") == 0 && i + 1 < argc) {
+			SETTINGS.memoryReportFrames = (uint32_t)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			SETTINGS.tracePath = argv[++i];
+		}
+	}
+
+	return run();
 }
\ No newline at end of file
@@ -0,0 +1,358 @@
+#include "mesh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "scene.h"
+#include "utils/utils.h"
+
+/* symmetric 4x4 plane quadric, upper triangle only */
+typedef struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} Quadric;
+
+typedef struct Collapse {
+	uint32_t from, to;
+	double cost;
+} Collapse;
+
+/* how much more an open edge resists being moved than a regular face */
+#define BOUNDARY_WEIGHT 10.0
+#define MAX_PASSES 64
+
+static void quadricAddPlane(Quadric* q, double a, double b, double c, double d, double w) {
+	q->a2 += w * a * a; q->ab += w * a * b; q->ac += w * a * c; q->ad += w * a * d;
+	q->b2 += w * b * b; q->bc += w * b * c; q->bd += w * b * d;
+	q->c2 += w * c * c; q->cd += w * c * d;
+	q->d2 += w * d * d;
+}
+
+static void quadricAdd(Quadric* q, const Quadric* other) {
+	double* dst = (double*)q;
+	const double* src = (const double*)other;
+	for (int i = 0; i < 10; ++i) dst[i] += src[i];
+}
+
+static double quadricError(const Quadric* q, const float p[3]) {
+	double x = p[0], y = p[1], z = p[2];
+	double e = q->a2 * x * x + 2 * q->ab * x * y + 2 * q->ac * x * z + 2 * q->ad * x
+		+ q->b2 * y * y + 2 * q->bc * y * z + 2 * q->bd * y
+		+ q->c2 * z * z + 2 * q->cd * z
+		+ q->d2;
+	return e > 0.0 ? e : 0.0;
+}
+
+static void triangleNormal(const float* a, const float* b, const float* c, double n[3]) {
+	double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static int compareCollapse(const void* a, const void* b) {
+	double ca = ((const Collapse*)a)->cost, cb = ((const Collapse*)b)->cost;
+	return (ca > cb) - (ca < cb);
+}
+
+/* open addressing set of directed edges, used to find edges only one triangle uses */
+typedef struct EdgeSet {
+	uint64_t* keys;
+	uint32_t mask;
+} EdgeSet;
+
+#define EDGE_EMPTY UINT64_MAX
+
+static void edgeSetInit(EdgeSet* set, uint32_t edgeCount) {
+	uint32_t capacity = 16;
+	while (capacity < edgeCount * 2) capacity <<= 1;
+	set->keys = malloc(sizeof(uint64_t) * capacity);
+	memset(set->keys, 0xff, sizeof(uint64_t) * capacity);
+	set->mask = capacity - 1;
+}
+
+static uint32_t edgeHash(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	return (uint32_t)key;
+}
+
+static void edgeSetInsert(EdgeSet* set, uint32_t a, uint32_t b) {
+	uint64_t key = ((uint64_t)a << 32) | b;
+	uint32_t slot = edgeHash(key) & set->mask;
+	while (set->keys[slot] != EDGE_EMPTY && set->keys[slot] != key) {
+		slot = (slot + 1) & set->mask;
+	}
+	set->keys[slot] = key;
+}
+
+static bool edgeSetContains(const EdgeSet* set, uint32_t a, uint32_t b) {
+	uint64_t key = ((uint64_t)a << 32) | b;
+	uint32_t slot = edgeHash(key) & set->mask;
+	while (set->keys[slot] != EDGE_EMPTY) {
+		if (set->keys[slot] == key) return true;
+		slot = (slot + 1) & set->mask;
+	}
+	return false;
+}
+
+/* would moving "from" onto "to" turn any of the triangles around it over */
+static bool collapseFlips(const uint32_t* indices, const uint32_t* triangles, uint32_t first, uint32_t last,
+	const Vertex* vertices, uint32_t from, uint32_t to) {
+	for (uint32_t t = first; t < last; ++t) {
+		const uint32_t* tri = indices + triangles[t] * 3;
+		if (tri[0] == to || tri[1] == to || tri[2] == to) continue; // this one disappears
+
+		const float* p[3];
+		for (int k = 0; k < 3; ++k) p[k] = vertices[tri[k]].pos;
+
+		double before[3], after[3];
+		triangleNormal(p[0], p[1], p[2], before);
+		for (int k = 0; k < 3; ++k) if (tri[k] == from) p[k] = vertices[to].pos;
+		triangleNormal(p[0], p[1], p[2], after);
+
+		double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+		if (dot <= 0.0) return true;
+	}
+	return false;
+}
+
+uint32_t meshSimplify(uint32_t* dst, const uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount, uint32_t targetIndexCount, float maxError, float* resultError) {
+	if (dst != indices) memcpy(dst, indices, sizeof(uint32_t) * indexCount);
+
+	Quadric* quadrics = calloc(vertexCount, sizeof(Quadric));
+	uint32_t* remap = malloc(sizeof(uint32_t) * vertexCount);
+	uint8_t* locked = malloc(vertexCount);
+	uint8_t* boundary = malloc(vertexCount);
+	uint32_t* triangleOffsets = malloc(sizeof(uint32_t) * (vertexCount + 1));
+	uint32_t* triangles = malloc(sizeof(uint32_t) * indexCount);
+	Collapse* collapses = malloc(sizeof(Collapse) * indexCount);
+
+	// face planes, and perpendicular planes along open edges so borders keep their shape
+	EdgeSet edges;
+	edgeSetInit(&edges, indexCount);
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+		for (int k = 0; k < 3; ++k) edgeSetInsert(&edges, dst[i + k], dst[i + (k + 1) % 3]);
+	}
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+		const float* p0 = vertices[dst[i]].pos;
+		const float* p1 = vertices[dst[i + 1]].pos;
+		const float* p2 = vertices[dst[i + 2]].pos;
+		double n[3];
+		triangleNormal(p0, p1, p2, n);
+		double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (len == 0.0) continue;
+		n[0] /= len; n[1] /= len; n[2] /= len;
+		double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		for (int k = 0; k < 3; ++k) quadricAddPlane(quadrics + dst[i + k], n[0], n[1], n[2], d, 1.0);
+
+		for (int k = 0; k < 3; ++k) {
+			uint32_t a = dst[i + k], b = dst[i + (k + 1) % 3];
+			if (edgeSetContains(&edges, b, a)) continue;
+
+			const float* pa = vertices[a].pos;
+			const float* pb = vertices[b].pos;
+			double e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+			double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+			double mlen = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+			if (mlen == 0.0) continue;
+			m[0] /= mlen; m[1] /= mlen; m[2] /= mlen;
+			double md = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+			quadricAddPlane(quadrics + a, m[0], m[1], m[2], md, BOUNDARY_WEIGHT);
+			quadricAddPlane(quadrics + b, m[0], m[1], m[2], md, BOUNDARY_WEIGHT);
+		}
+	}
+	free(edges.keys);
+
+	double maxCost = (double)maxError * (double)maxError;
+	double worstCost = 0.0;
+
+	for (int pass = 0; pass < MAX_PASSES && indexCount > targetIndexCount; ++pass) {
+		// open edges of the current topology, they change as collapses go on
+		edgeSetInit(&edges, indexCount);
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; ++k) edgeSetInsert(&edges, dst[i + k], dst[i + (k + 1) % 3]);
+		}
+		memset(boundary, 0, vertexCount);
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t a = dst[i + k], b = dst[i + (k + 1) % 3];
+				if (!edgeSetContains(&edges, b, a)) boundary[a] = boundary[b] = 1;
+			}
+		}
+
+		// vertex -> triangle adjacency
+		memset(triangleOffsets, 0, sizeof(uint32_t) * (vertexCount + 1));
+		for (uint32_t i = 0; i < indexCount; ++i) ++triangleOffsets[dst[i] + 1];
+		for (uint32_t v = 0; v < vertexCount; ++v) triangleOffsets[v + 1] += triangleOffsets[v];
+		for (uint32_t i = 0; i < indexCount; ++i) triangles[triangleOffsets[dst[i]]++] = i / 3;
+		for (uint32_t v = vertexCount; v > 0; --v) triangleOffsets[v] = triangleOffsets[v - 1];
+		triangleOffsets[0] = 0;
+
+		// every edge in both directions, a border vertex may only slide along its border
+		uint32_t collapseCount = 0;
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				uint32_t a = dst[i + k], b = dst[i + (k + 1) % 3];
+				bool open = !edgeSetContains(&edges, b, a);
+				if (boundary[a] && !open) continue;
+
+				Quadric q = quadrics[a];
+				quadricAdd(&q, quadrics + b);
+				double cost = quadricError(&q, vertices[b].pos);
+				if (cost > maxCost) continue;
+				collapses[collapseCount++] = (Collapse){ a, b, cost };
+			}
+		}
+		free(edges.keys);
+		if (collapseCount == 0) break;
+
+		qsort(collapses, collapseCount, sizeof(Collapse), compareCollapse);
+
+		for (uint32_t v = 0; v < vertexCount; ++v) remap[v] = v;
+		memset(locked, 0, vertexCount);
+
+		uint32_t triangleCount = indexCount / 3;
+		uint32_t targetTriangles = targetIndexCount / 3;
+		uint32_t collapsed = 0;
+		for (uint32_t c = 0; c < collapseCount && triangleCount > targetTriangles; ++c) {
+			uint32_t from = collapses[c].from, to = collapses[c].to;
+			if (locked[from] || locked[to]) continue;
+
+			uint32_t first = triangleOffsets[from], last = triangleOffsets[from + 1];
+			if (collapseFlips(dst, triangles, first, last, vertices, from, to)) continue;
+
+			// lock the whole neighbourhood, the adjacency above is only valid for untouched vertices
+			uint32_t removed = 0;
+			for (uint32_t t = first; t < last; ++t) {
+				const uint32_t* tri = dst + triangles[t] * 3;
+				for (int k = 0; k < 3; ++k) locked[tri[k]] = 1;
+				if (tri[0] == to || tri[1] == to || tri[2] == to) ++removed;
+			}
+			locked[to] = 1;
+
+			remap[from] = to;
+			quadricAdd(quadrics + to, quadrics + from);
+			triangleCount -= removed;
+			if (collapses[c].cost > worstCost) worstCost = collapses[c].cost;
+			++collapsed;
+		}
+		if (collapsed == 0) break;
+
+		uint32_t write = 0;
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			uint32_t a = remap[dst[i]], b = remap[dst[i + 1]], c = remap[dst[i + 2]];
+			if (a == b || b == c || a == c) continue;
+			dst[write++] = a;
+			dst[write++] = b;
+			dst[write++] = c;
+		}
+		indexCount = write;
+	}
+
+	free(quadrics);
+	free(remap);
+	free(locked);
+	free(boundary);
+	free(triangleOffsets);
+	free(triangles);
+	free(collapses);
+
+	if (resultError) *resultError = (float)sqrt(worstCost);
+	return indexCount;
+}
+
+uint32_t meshBuildLods(Mesh* mesh, uint32_t* dst, uint32_t baseIndex, const uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount) {
+	// bounding sphere around the box centre, good enough for picking lods
+	vec3 minP = { INFINITY, INFINITY, INFINITY }, maxP = { -INFINITY, -INFINITY, -INFINITY };
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		glm_vec3_minv(minP, (float*)vertices[v].pos, minP);
+		glm_vec3_maxv(maxP, (float*)vertices[v].pos, maxP);
+	}
+	glm_vec3_center(minP, maxP, mesh->center);
+	mesh->radius = 0.0f;
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		float d = glm_vec3_distance(mesh->center, (float*)vertices[v].pos);
+		if (d > mesh->radius) mesh->radius = d;
+	}
+
+	mesh->vertexCount = vertexCount;
+	mesh->firstIndex = baseIndex;
+	mesh->lods[0] = (MeshLod){ baseIndex, indexCount, 0.0f };
+	mesh->lodCount = 1;
+	memcpy(dst, indices, sizeof(uint32_t) * indexCount);
+
+	// errors beyond a quarter of the mesh size aren't worth a level
+	float maxError = mesh->radius * 0.25f;
+	uint32_t written = indexCount;
+	// meshSimplify starts from a full copy of its input, so it works apart and only the result is appended
+	uint32_t* scratch = malloc(sizeof(uint32_t) * indexCount);
+	while (mesh->lodCount < MESH_MAX_LODS) {
+		const MeshLod* prev = mesh->lods + mesh->lodCount - 1;
+		const uint32_t* source = dst + (prev->firstIndex - baseIndex);
+		uint32_t target = (prev->indexCount / 2) / 3 * 3;
+
+		float error;
+		uint32_t count = meshSimplify(scratch, source, prev->indexCount,
+			vertices, vertexCount, target, maxError, &error);
+		// a level that barely shrinks only costs memory
+		if (count == 0 || count > prev->indexCount * 3 / 4) break;
+
+		memcpy(dst + written, scratch, sizeof(uint32_t) * count);
+		MeshLod* lod = mesh->lods + mesh->lodCount++;
+		lod->firstIndex = baseIndex + written;
+		lod->indexCount = count;
+		lod->error = error > prev->error ? error : prev->error;
+		written += count;
+	}
+	free(scratch);
+
+	mesh->indexCount = written;
+	return written;
+}
+
+uint32_t meshSelectLod(const Mesh* mesh, uint32_t current, const mat4 world, const Camera* camera, float viewportHeight) {
+	if (mesh->lodCount <= 1) return 0;
+
+	vec3 center;
+	glm_mat4_mulv3((vec4*)world, (float*)mesh->center, 1.0f, center);
+	float scale = glm_vec3_norm((float*)world[0]);
+	float sy = glm_vec3_norm((float*)world[1]), sz = glm_vec3_norm((float*)world[2]);
+	if (sy > scale) scale = sy;
+	if (sz > scale) scale = sz;
+
+	float distance = glm_vec3_distance(center, (float*)camera->eye) - mesh->radius * scale;
+	if (distance < camera->znear) distance = camera->znear;
+	float pixelsPerUnit = viewportHeight / (2.0f * tanf(camera->fovy * 0.5f) * distance) * scale;
+
+	float refine = MESH_LOD_PIXEL_ERROR * (1.0f + MESH_LOD_HYSTERESIS);
+	float coarsen = MESH_LOD_PIXEL_ERROR * (1.0f - MESH_LOD_HYSTERESIS);
+
+	uint32_t lod = current < mesh->lodCount ? current : 0;
+	while (lod > 0 && mesh->lods[lod].error * pixelsPerUnit > refine) --lod;
+	while (lod + 1 < mesh->lodCount && mesh->lods[lod + 1].error * pixelsPerUnit <= coarsen) ++lod;
+	return lod;
+}
+
+void meshPrintLods(const char* name, const Mesh* mesh) {
+	printf("%s: %u lods, radius %.3f\n", name, mesh->lodCount, mesh->radius);
+	for (uint32_t i = 0; i < mesh->lodCount; ++i) {
+		printf("\tlod %u: %u triangles, error %.5f\n", i, mesh->lods[i].indexCount / 3, mesh->lods[i].error);
+	}
+}
+
+void printDrawStats(const DrawStats* stats) {
+	printf("draws: %.0f triangles per frame on average over %llu frames, last frame %u batches, %u instances",
+		stats->frames ? (double)stats->trianglesTotal / (double)stats->frames : 0.0,
+		(unsigned long long)stats->frames, stats->batches, stats->instances);
+	for (uint32_t i = 0; i < MESH_MAX_LODS; ++i) {
+		if (stats->lodInstances[i]) printf(", lod %u x%u", i, stats->lodInstances[i]);
+	}
+	printf("\n");
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "vertexes.h"
+
+typedef struct Camera Camera;
+
+#define MESH_MAX_LODS 6
+
+/* projected error, in pixels, a lod is allowed before a finer one is picked */
+#define MESH_LOD_PIXEL_ERROR 1.0f
+/* relative band around the threshold inside which the current lod is kept */
+#define MESH_LOD_HYSTERESIS 0.25f
+
+typedef struct MeshLod {
+	uint32_t firstIndex, indexCount;
+	/* object space distance the simplified surface may be off by */
+	float error;
+} MeshLod;
+
+/*
+ * All lods of a mesh share its vertices and live back to back in the
+ * index buffer, so a lod switch only changes firstIndex/indexCount.
+ */
+typedef struct Mesh {
+	int32_t vertexOffset;
+	uint32_t vertexCount;
+	/* index range holding every lod */
+	uint32_t firstIndex, indexCount;
+	MeshLod lods[MESH_MAX_LODS];
+	uint32_t lodCount;
+	vec3 center;
+	float radius;
+} Mesh;
+
+/* instances of one mesh at one lod, drawn with a single instanced call */
+typedef struct DrawBatch {
+	uint32_t mesh, lod;
+	uint32_t firstInstance, instanceCount;
+} DrawBatch;
+
+typedef struct DrawStats {
+	uint32_t batches, instances;
+	uint64_t triangles;
+	uint32_t lodInstances[MESH_MAX_LODS];
+
+	uint64_t frames, trianglesTotal;
+} DrawStats;
+
+/*
+ * Quadric error edge collapse. Vertices are only ever collapsed onto other
+ * existing vertices, so the result indexes the same vertex array. Stops at
+ * targetIndexCount or when the next collapse would cost more than maxError.
+ * dst may alias indices. Returns the new index count.
+ */
+uint32_t meshSimplify(uint32_t* dst, const uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount, uint32_t targetIndexCount, float maxError, float* resultError);
+
+/* a level is only kept while it's at most 3/4 of the one before, so all of them add up to under 4x the base */
+#define MESH_LOD_INDEX_CAPACITY(indexCount) ((indexCount) * 4)
+
+/*
+ * Builds up to MESH_MAX_LODS levels, each roughly half of the previous one,
+ * and writes them one after another into dst, which needs room for
+ * MESH_LOD_INDEX_CAPACITY(indexCount) indices. firstIndex of every lod is
+ * offset by baseIndex. Returns the total number of indices written.
+ */
+uint32_t meshBuildLods(Mesh* mesh, uint32_t* dst, uint32_t baseIndex, const uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount);
+
+/* picks a lod from the projected size of the bounding sphere, keeping current while inside the hysteresis band */
+uint32_t meshSelectLod(const Mesh* mesh, uint32_t current, const mat4 world, const Camera* camera, float viewportHeight);
+
+void meshPrintLods(const char* name, const Mesh* mesh);
+void printDrawStats(const DrawStats* stats);
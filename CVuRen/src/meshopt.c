@@ -0,0 +1,287 @@
+#include "meshopt.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY 1.5f
+#define FORSYTH_LAST_TRIANGLE 0.75f
+#define FORSYTH_VALENCE_SCALE 2.0f
+#define FORSYTH_VALENCE_POWER 0.5f
+#define FORSYTH_MAX_VALENCE 32
+
+MeshCacheStats meshAnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+	MeshCacheStats stats = { 0 };
+	if (indexCount == 0) return stats;
+
+	// fifo of the last cacheSize misses, timestamps avoid shifting anything
+	uint32_t* insertedAt = calloc(vertexCount, sizeof(uint32_t));
+	uint8_t* used = calloc(vertexCount, 1);
+	uint32_t clock = cacheSize + 1;
+	uint32_t unique = 0;
+
+	for (uint32_t i = 0; i < indexCount; ++i) {
+		uint32_t v = indices[i];
+		if (!used[v]) {
+			used[v] = 1;
+			++unique;
+		}
+		if (clock - insertedAt[v] > cacheSize) {
+			insertedAt[v] = clock++;
+			++stats.transformed;
+		}
+	}
+
+	free(insertedAt);
+	free(used);
+
+	stats.acmr = (float)stats.transformed / (float)(indexCount / 3);
+	stats.atvr = (float)stats.transformed / (float)unique;
+	return stats;
+}
+
+static float cachePositionScore[FORSYTH_CACHE_SIZE];
+static float valenceScore[FORSYTH_MAX_VALENCE + 1];
+static int scoreTablesReady = 0;
+
+static void buildScoreTables() {
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+		if (i < 3) {
+			cachePositionScore[i] = FORSYTH_LAST_TRIANGLE;
+		} else {
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			cachePositionScore[i] = powf(1.0f - (float)(i - 3) * scaler, FORSYTH_CACHE_DECAY);
+		}
+	}
+	valenceScore[0] = 0.0f;
+	for (int i = 1; i <= FORSYTH_MAX_VALENCE; ++i) {
+		valenceScore[i] = FORSYTH_VALENCE_SCALE * powf((float)i, -FORSYTH_VALENCE_POWER);
+	}
+	scoreTablesReady = 1;
+}
+
+static float vertexScore(int cachePosition, uint32_t liveTriangles) {
+	if (liveTriangles == 0) return -1.0f;
+
+	float score = cachePosition >= 0 ? cachePositionScore[cachePosition] : 0.0f;
+	return score + valenceScore[liveTriangles < FORSYTH_MAX_VALENCE ? liveTriangles : FORSYTH_MAX_VALENCE];
+}
+
+void meshOptimizeVertexCache(uint32_t* dst, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount) {
+	if (!scoreTablesReady) buildScoreTables();
+
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	uint32_t* source = malloc(sizeof(uint32_t) * indexCount);
+	memcpy(source, indices, sizeof(uint32_t) * indexCount);
+
+	// vertex -> live triangles, emitted triangles get swapped past the live count
+	uint32_t* live = calloc(vertexCount, sizeof(uint32_t));
+	uint32_t* offsets = malloc(sizeof(uint32_t) * (vertexCount + 1));
+	uint32_t* adjacency = malloc(sizeof(uint32_t) * indexCount);
+	for (uint32_t i = 0; i < indexCount; ++i) ++live[source[i]];
+	offsets[0] = 0;
+	for (uint32_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + live[v];
+	uint32_t* fill = malloc(sizeof(uint32_t) * vertexCount);
+	memcpy(fill, offsets, sizeof(uint32_t) * vertexCount);
+	for (uint32_t i = 0; i < indexCount; ++i) adjacency[fill[source[i]]++] = i / 3;
+	free(fill);
+
+	int* cachePosition = malloc(sizeof(int) * vertexCount);
+	float* score = malloc(sizeof(float) * vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		cachePosition[v] = -1;
+		score[v] = vertexScore(-1, live[v]);
+	}
+
+	float* triangleScore = malloc(sizeof(float) * triangleCount);
+	uint8_t* emitted = calloc(triangleCount, 1);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = score[source[t * 3]] + score[source[t * 3 + 1]] + score[source[t * 3 + 2]];
+	}
+
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3], newCache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t cacheCount = 0;
+	uint32_t restartCursor = 0;
+	uint32_t best = 0;
+	float bestScore = -1.0f;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (triangleScore[t] > bestScore) {
+			bestScore = triangleScore[t];
+			best = t;
+		}
+	}
+
+	for (uint32_t written = 0; written < triangleCount; ++written) {
+		if (bestScore < 0.0f) {
+			// dead end, nothing in the cache has live triangles left, restart in input order
+			while (emitted[restartCursor]) ++restartCursor;
+			best = restartCursor;
+		}
+
+		const uint32_t* tri = source + best * 3;
+		memcpy(dst + written * 3, tri, sizeof(uint32_t) * 3);
+		emitted[best] = 1;
+
+		uint32_t newCount = 0;
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = tri[k];
+			uint32_t* list = adjacency + offsets[v];
+			for (uint32_t j = 0; j < live[v]; ++j) {
+				if (list[j] == best) {
+					list[j] = list[live[v] - 1];
+					list[live[v] - 1] = best;
+					break;
+				}
+			}
+			--live[v];
+			newCache[newCount++] = v;
+		}
+		for (uint32_t j = 0; j < cacheCount; ++j) {
+			uint32_t v = cache[j];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+		}
+
+		// everything that fell off the end loses its cache bonus
+		for (uint32_t j = 0; j < newCount; ++j) {
+			uint32_t v = newCache[j];
+			cachePosition[v] = j < FORSYTH_CACHE_SIZE ? (int)j : -1;
+			score[v] = vertexScore(cachePosition[v], live[v]);
+		}
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+
+		// only triangles touching the cache changed score, the next pick comes from them
+		bestScore = -1.0f;
+		for (uint32_t j = 0; j < newCount; ++j) {
+			uint32_t v = newCache[j];
+			const uint32_t* list = adjacency + offsets[v];
+			for (uint32_t k = 0; k < live[v]; ++k) {
+				uint32_t t = list[k];
+				const uint32_t* other = source + t * 3;
+				float s = score[other[0]] + score[other[1]] + score[other[2]];
+				triangleScore[t] = s;
+				if (s > bestScore) {
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+	}
+
+	free(source);
+	free(live);
+	free(offsets);
+	free(adjacency);
+	free(cachePosition);
+	free(score);
+	free(triangleScore);
+	free(emitted);
+}
+
+typedef struct Cluster {
+	uint32_t first, count;
+	float sortKey;
+} Cluster;
+
+static int compareCluster(const void* a, const void* b) {
+	float ka = ((const Cluster*)a)->sortKey, kb = ((const Cluster*)b)->sortKey;
+	return (ka < kb) - (ka > kb);
+}
+
+void meshOptimizeOverdraw(uint32_t* dst, const uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount) {
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	uint32_t* source = malloc(sizeof(uint32_t) * indexCount);
+	memcpy(source, indices, sizeof(uint32_t) * indexCount);
+
+	vec3 meshCenter = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < indexCount; ++i) {
+		glm_vec3_add(meshCenter, (float*)vertices[source[i]].pos, meshCenter);
+	}
+	glm_vec3_scale(meshCenter, 1.0f / (float)indexCount, meshCenter);
+
+	// a triangle missing on all three vertices is where the cache optimizer restarted
+	Cluster* clusters = malloc(sizeof(Cluster) * triangleCount);
+	uint32_t clusterCount = 0;
+	uint32_t* insertedAt = calloc(vertexCount, sizeof(uint32_t));
+	uint32_t clock = MESHOPT_CACHE_SIZE + 1;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		uint32_t misses = 0;
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = source[t * 3 + k];
+			if (clock - insertedAt[v] > MESHOPT_CACHE_SIZE) {
+				insertedAt[v] = clock++;
+				++misses;
+			}
+		}
+		if (t == 0 || misses == 3) {
+			clusters[clusterCount++] = (Cluster){ t, 0, 0.0f };
+		}
+		++clusters[clusterCount - 1].count;
+	}
+	free(insertedAt);
+
+	// clusters facing away from the centre occlude the rest, so they go first
+	for (uint32_t c = 0; c < clusterCount; ++c) {
+		vec3 center = { 0.0f, 0.0f, 0.0f }, normal = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (uint32_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; ++t) {
+			float* p0 = (float*)vertices[source[t * 3]].pos;
+			float* p1 = (float*)vertices[source[t * 3 + 1]].pos;
+			float* p2 = (float*)vertices[source[t * 3 + 2]].pos;
+			vec3 e1, e2, n;
+			glm_vec3_sub(p1, p0, e1);
+			glm_vec3_sub(p2, p0, e2);
+			glm_vec3_cross(e1, e2, n);
+			float a = glm_vec3_norm(n);
+
+			vec3 centroid;
+			glm_vec3_add(p0, p1, centroid);
+			glm_vec3_add(centroid, p2, centroid);
+			glm_vec3_muladds(centroid, a / 3.0f, center);
+			glm_vec3_add(normal, n, normal);
+			area += a;
+		}
+		if (area > 0.0f) glm_vec3_scale(center, 1.0f / area, center);
+		glm_vec3_normalize(normal);
+
+		vec3 offset;
+		glm_vec3_sub(center, meshCenter, offset);
+		clusters[c].sortKey = glm_vec3_dot(offset, normal);
+	}
+
+	qsort(clusters, clusterCount, sizeof(Cluster), compareCluster);
+
+	uint32_t written = 0;
+	for (uint32_t c = 0; c < clusterCount; ++c) {
+		memcpy(dst + written, source + clusters[c].first * 3, sizeof(uint32_t) * 3 * clusters[c].count);
+		written += clusters[c].count * 3;
+	}
+
+	free(clusters);
+	free(source);
+}
+
+uint32_t meshOptimizeVertexFetch(Vertex* dstVertices, uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount) {
+	uint32_t* remap = malloc(sizeof(uint32_t) * vertexCount);
+	memset(remap, 0xff, sizeof(uint32_t) * vertexCount);
+
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < indexCount; ++i) {
+		uint32_t v = indices[i];
+		if (remap[v] == UINT32_MAX) {
+			remap[v] = next;
+			dstVertices[next++] = vertices[v];
+		}
+		indices[i] = remap[v];
+	}
+
+	free(remap);
+	return next;
+}
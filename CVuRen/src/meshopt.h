@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "vertexes.h"
+
+/* fifo size used when simulating the post-transform cache, a conservative guess for current gpus */
+#define MESHOPT_CACHE_SIZE 16
+
+typedef struct MeshCacheStats {
+	uint32_t transformed;
+	/* vertices transformed per triangle, 0.5 is the best a regular grid can do and 3 the worst */
+	float acmr;
+	/* vertices transformed per vertex used, 1 is perfect */
+	float atvr;
+} MeshCacheStats;
+
+MeshCacheStats meshAnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+/* reorders triangles for post-transform cache hits (Forsyth's linear speed algorithm), dst may alias indices */
+void meshOptimizeVertexCache(uint32_t* dst, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+/*
+ * Splits cache optimized indices into clusters where the cache was restarted
+ * and sorts the clusters so outward facing ones on the outside of the mesh
+ * draw first, which cuts overdraw while keeping most cache hits. dst may alias indices.
+ */
+void meshOptimizeOverdraw(uint32_t* dst, const uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount);
+
+/*
+ * Reorders vertices into the order indices first reference them and
+ * rewrites indices to match, unused vertices are dropped. Returns the new
+ * vertex count. dstVertices needs room for vertexCount vertices.
+ */
+uint32_t meshOptimizeVertexFetch(Vertex* dstVertices, uint32_t* indices, uint32_t indexCount,
+	const Vertex* vertices, uint32_t vertexCount);
@@ -0,0 +1,698 @@
+#include "occlusion.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+#define OCCLUSION_MAX_LEVELS 16
+#define CULL_GROUP_SIZE 64
+#define REDUCE_GROUP_SIZE 8
+
+/* mirrors the structs in cull.comp */
+typedef struct CullInstance {
+    vec4 sphere;
+    uint32_t node, batch;
+    uint32_t pad0, pad1;
+} CullInstance;
+
+typedef struct CullParams {
+    mat4 viewProj;
+    vec2 pyramidSize;
+    uint32_t instanceCount;
+    uint32_t phase;
+    uint32_t lateDrawOffset;
+} CullParams;
+
+typedef struct CullCounters {
+    uint32_t earlyDrawn, lateDrawn, occluded, frustumCulled;
+} CullCounters;
+
+typedef struct ReduceParams {
+    int32_t sourceWidth, sourceHeight;
+    int32_t destWidth, destHeight;
+} ReduceParams;
+
+static struct OCCLUSION {
+    bool active;
+
+    VkDescriptorSetLayout cullSetLayout, reduceSetLayout;
+    VkPipelineLayout cullLayout, reduceLayout;
+    VkPipeline cullPipeline, reducePipeline;
+    VkDescriptorPool cullPool, pyramidPool;
+    VkDescriptorSet* cullSets;
+    VkSampler sampler;
+
+    VkBuffer* inputs;
+    VkDeviceMemory* inputsMemory;
+    void** inputsMapped;
+    VkBuffer* visible;
+    VkDeviceMemory* visibleMemory;
+    VkBuffer* draws;
+    VkDeviceMemory* drawsMemory;
+    void** drawsMapped;
+    VkBuffer* counters;
+    VkDeviceMemory* countersMemory;
+    void** countersMapped;
+    bool* countersPending;
+    VkBuffer visibility;
+    VkDeviceMemory visibilityMemory;
+
+    CullParams* params;
+
+    VkImage pyramid;
+    VkDeviceMemory pyramidMemory;
+    VkImageView pyramidView;
+    VkImageView levelViews[OCCLUSION_MAX_LEVELS];
+    VkDescriptorSet reduceSets[OCCLUSION_MAX_LEVELS];
+    uint32_t levelCount, width, height;
+
+    OcclusionStats stats;
+} OCCLUSION;
+
+static void createLayouts() {
+    VkDescriptorSetLayoutBinding cullBindings[7];
+    for (uint32_t i = 0; i < 7; ++i) {
+        cullBindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = i == 6 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        };
+    }
+    VkDescriptorSetLayoutCreateInfo cullSetInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 7,
+        .pBindings = cullBindings
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &cullSetInfo, NULL, &OCCLUSION.cullSetLayout) != VK_SUCCESS) {
+        c_throw("failed to create cull descriptor set layout");
+    }
+
+    VkDescriptorSetLayoutBinding reduceBindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        }
+    };
+    VkDescriptorSetLayoutCreateInfo reduceSetInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 2,
+        .pBindings = reduceBindings
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &reduceSetInfo, NULL, &OCCLUSION.reduceSetLayout) != VK_SUCCESS) {
+        c_throw("failed to create depth pyramid descriptor set layout");
+    }
+
+    VkPushConstantRange cullPush = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(CullParams)
+    };
+    VkPipelineLayoutCreateInfo cullLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &OCCLUSION.cullSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &cullPush
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &cullLayoutInfo, NULL, &OCCLUSION.cullLayout) != VK_SUCCESS) {
+        c_throw("failed to create cull pipeline layout");
+    }
+
+    VkPushConstantRange reducePush = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(ReduceParams)
+    };
+    VkPipelineLayoutCreateInfo reduceLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &OCCLUSION.reduceSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &reducePush
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &reduceLayoutInfo, NULL, &OCCLUSION.reduceLayout) != VK_SUCCESS) {
+        c_throw("failed to create depth pyramid pipeline layout");
+    }
+}
+
+static void createCullSets() {
+    VkDescriptorPoolSize poolSizes[] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 6 * MAX_FRAMES_IN_FLIGHT
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = MAX_FRAMES_IN_FLIGHT
+        }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &OCCLUSION.cullPool) != VK_SUCCESS) {
+        c_throw("failed to create cull descriptor pool");
+    }
+
+    VkDescriptorSetLayout* layouts = malloc(sizeof(VkDescriptorSetLayout) * MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) layouts[i] = OCCLUSION.cullSetLayout;
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = OCCLUSION.cullPool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = layouts
+    };
+    OCCLUSION.cullSets = malloc(sizeof(VkDescriptorSet) * MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, OCCLUSION.cullSets) != VK_SUCCESS) {
+        c_throw("failed to allocate cull descriptor sets");
+    }
+    free(layouts);
+
+    // the pyramid at binding 6 is written when it's created
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo buffers[6] = {
+            { OCCLUSION.inputs[i], 0, VK_WHOLE_SIZE },
+            { VULKAN.instanceBuffers[i], 0, VK_WHOLE_SIZE },
+            { OCCLUSION.visible[i], 0, VK_WHOLE_SIZE },
+            { OCCLUSION.draws[i], 0, VK_WHOLE_SIZE },
+            { OCCLUSION.visibility, 0, VK_WHOLE_SIZE },
+            { OCCLUSION.counters[i], 0, VK_WHOLE_SIZE }
+        };
+        VkWriteDescriptorSet writes[6];
+        for (uint32_t b = 0; b < 6; ++b) {
+            writes[b] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = OCCLUSION.cullSets[i],
+                .dstBinding = b,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = NULL,
+                .pBufferInfo = buffers + b,
+                .pTexelBufferView = NULL
+            };
+        }
+        vkUpdateDescriptorSets(VULKAN.device, 6, writes, 0, NULL);
+    }
+}
+
+void createOcclusionResources() {
+    // the draws need a per batch firstInstance coming from a buffer
+    OCCLUSION.active = SETTINGS.occlusionCulling && VULKAN.multiDrawIndirect;
+    if (!OCCLUSION.active) return;
+
+    createLayouts();
+    OCCLUSION.cullPipeline = createComputePipeline("shaders/cull.spv", OCCLUSION.cullLayout);
+    OCCLUSION.reducePipeline = createComputePipeline("shaders/hiz.spv", OCCLUSION.reduceLayout);
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = (float)OCCLUSION_MAX_LEVELS,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &OCCLUSION.sampler) != VK_SUCCESS) {
+        c_throw("failed to create depth pyramid sampler");
+    }
+
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    createFrameBuffers(sizeof(CullInstance) * MAX_INSTANCES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+        MEMORY_CATEGORY_STORAGE, &OCCLUSION.inputs, &OCCLUSION.inputsMemory, &OCCLUSION.inputsMapped);
+    // early and late phases get separate halves
+    createFrameBuffers(sizeof(InstanceData) * MAX_INSTANCES * 2,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_STORAGE, &OCCLUSION.visible, &OCCLUSION.visibleMemory, NULL);
+    createFrameBuffers(sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAW_BATCHES * 2,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, hostVisible,
+        MEMORY_CATEGORY_STORAGE, &OCCLUSION.draws, &OCCLUSION.drawsMemory, &OCCLUSION.drawsMapped);
+    createFrameBuffers(sizeof(CullCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+        MEMORY_CATEGORY_STORAGE, &OCCLUSION.counters, &OCCLUSION.countersMemory, &OCCLUSION.countersMapped);
+    OCCLUSION.countersPending = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(bool));
+    OCCLUSION.params = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(CullParams));
+
+    // starts out all invisible, so the first late pass draws everything that passes
+    VkDeviceSize visibilitySize = sizeof(uint32_t) * MAX_INSTANCES;
+    createBuffer(visibilitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_STORAGE, &OCCLUSION.visibility, &OCCLUSION.visibilityMemory);
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    vkCmdFillBuffer(commandBuffer, OCCLUSION.visibility, 0, visibilitySize, 0);
+    endSingleTimeCommands(commandBuffer);
+
+    createCullSets();
+}
+
+void destroyOcclusionResources() {
+    if (!OCCLUSION.active) return;
+
+    vkDestroyPipeline(VULKAN.device, OCCLUSION.cullPipeline, NULL);
+    vkDestroyPipeline(VULKAN.device, OCCLUSION.reducePipeline, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, OCCLUSION.cullLayout, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, OCCLUSION.reduceLayout, NULL);
+    vkDestroyDescriptorPool(VULKAN.device, OCCLUSION.cullPool, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, OCCLUSION.cullSetLayout, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, OCCLUSION.reduceSetLayout, NULL);
+    vkDestroySampler(VULKAN.device, OCCLUSION.sampler, NULL);
+
+    destroyFrameBuffers(OCCLUSION.inputs, OCCLUSION.inputsMemory, OCCLUSION.inputsMapped);
+    destroyFrameBuffers(OCCLUSION.visible, OCCLUSION.visibleMemory, NULL);
+    destroyFrameBuffers(OCCLUSION.draws, OCCLUSION.drawsMemory, OCCLUSION.drawsMapped);
+    destroyFrameBuffers(OCCLUSION.counters, OCCLUSION.countersMemory, OCCLUSION.countersMapped);
+    vkDestroyBuffer(VULKAN.device, OCCLUSION.visibility, NULL);
+    freeDeviceMemory(OCCLUSION.visibilityMemory);
+
+    free(OCCLUSION.cullSets);
+    free(OCCLUSION.countersPending);
+    free(OCCLUSION.params);
+}
+
+static uint32_t previousPow2(uint32_t v) {
+    uint32_t result = 1;
+    while (result * 2 <= v) result *= 2;
+    return result;
+}
+
+void createDepthPyramid() {
+    if (!OCCLUSION.active) return;
+
+    // power of two so every level above 0 is an exact 2:1 reduction
+    OCCLUSION.width = previousPow2(VULKAN.swapchainExtent.width);
+    OCCLUSION.height = previousPow2(VULKAN.swapchainExtent.height);
+    OCCLUSION.levelCount = 1;
+    while ((OCCLUSION.width >> OCCLUSION.levelCount) || (OCCLUSION.height >> OCCLUSION.levelCount)) {
+        ++OCCLUSION.levelCount;
+    }
+    if (OCCLUSION.levelCount > OCCLUSION_MAX_LEVELS) OCCLUSION.levelCount = OCCLUSION_MAX_LEVELS;
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .extent = { OCCLUSION.width, OCCLUSION.height, 1 },
+        .mipLevels = OCCLUSION.levelCount,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (vkCreateImage(VULKAN.device, &imageInfo, NULL, &OCCLUSION.pyramid) != VK_SUCCESS) {
+        c_throw("failed to create depth pyramid");
+    }
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(VULKAN.device, OCCLUSION.pyramid, &memReq);
+    uint32_t memoryType = findMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!allocateDeviceMemory(memReq.size, memoryType, MEMORY_CATEGORY_ATTACHMENT, &OCCLUSION.pyramidMemory)) {
+        c_throw("failed to alloc depth pyramid memory");
+    }
+    vkBindImageMemory(VULKAN.device, OCCLUSION.pyramid, OCCLUSION.pyramidMemory, 0);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = OCCLUSION.pyramid,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .components = {
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = OCCLUSION.levelCount,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    if (vkCreateImageView(VULKAN.device, &viewInfo, NULL, &OCCLUSION.pyramidView) != VK_SUCCESS) {
+        c_throw("failed to create depth pyramid view");
+    }
+    for (uint32_t i = 0; i < OCCLUSION.levelCount; ++i) {
+        viewInfo.subresourceRange.baseMipLevel = i;
+        viewInfo.subresourceRange.levelCount = 1;
+        if (vkCreateImageView(VULKAN.device, &viewInfo, NULL, OCCLUSION.levelViews + i) != VK_SUCCESS) {
+            c_throw("failed to create depth pyramid level view");
+        }
+    }
+
+    // the pyramid stays in GENERAL, it is written and sampled level by level
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = OCCLUSION.pyramid,
+        .subresourceRange = viewInfo.subresourceRange
+    };
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = OCCLUSION.levelCount;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, NULL, 0, NULL, 1, &barrier);
+    endSingleTimeCommands(commandBuffer);
+
+    VkDescriptorPoolSize poolSizes[] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = OCCLUSION.levelCount
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = OCCLUSION.levelCount
+        }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = OCCLUSION.levelCount,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &OCCLUSION.pyramidPool) != VK_SUCCESS) {
+        c_throw("failed to create depth pyramid descriptor pool");
+    }
+
+    VkDescriptorSetLayout layouts[OCCLUSION_MAX_LEVELS];
+    for (uint32_t i = 0; i < OCCLUSION.levelCount; ++i) layouts[i] = OCCLUSION.reduceSetLayout;
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = OCCLUSION.pyramidPool,
+        .descriptorSetCount = OCCLUSION.levelCount,
+        .pSetLayouts = layouts
+    };
+    if (vkAllocateDescriptorSets(VULKAN.device, &setInfo, OCCLUSION.reduceSets) != VK_SUCCESS) {
+        c_throw("failed to allocate depth pyramid descriptor sets");
+    }
+
+    // level 0 reads the depth attachment, every other level the one below it
+    for (uint32_t i = 0; i < OCCLUSION.levelCount; ++i) {
+        VkDescriptorImageInfo source = {
+            .sampler = OCCLUSION.sampler,
+            .imageView = i == 0 ? VULKAN.depthImageView : OCCLUSION.levelViews[i - 1],
+            .imageLayout = i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL
+        };
+        VkDescriptorImageInfo dest = {
+            .sampler = VK_NULL_HANDLE,
+            .imageView = OCCLUSION.levelViews[i],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        };
+        VkWriteDescriptorSet writes[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = OCCLUSION.reduceSets[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &source,
+                .pBufferInfo = NULL,
+                .pTexelBufferView = NULL
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = OCCLUSION.reduceSets[i],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &dest,
+                .pBufferInfo = NULL,
+                .pTexelBufferView = NULL
+            }
+        };
+        vkUpdateDescriptorSets(VULKAN.device, 2, writes, 0, NULL);
+    }
+
+    VkDescriptorImageInfo pyramidInfo = {
+        .sampler = OCCLUSION.sampler,
+        .imageView = OCCLUSION.pyramidView,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+    };
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = NULL,
+            .dstSet = OCCLUSION.cullSets[i],
+            .dstBinding = 6,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &pyramidInfo,
+            .pBufferInfo = NULL,
+            .pTexelBufferView = NULL
+        };
+        vkUpdateDescriptorSets(VULKAN.device, 1, &write, 0, NULL);
+    }
+}
+
+void destroyDepthPyramid() {
+    if (!OCCLUSION.active) return;
+
+    vkDestroyDescriptorPool(VULKAN.device, OCCLUSION.pyramidPool, NULL);
+    for (uint32_t i = 0; i < OCCLUSION.levelCount; ++i) {
+        vkDestroyImageView(VULKAN.device, OCCLUSION.levelViews[i], NULL);
+    }
+    vkDestroyImageView(VULKAN.device, OCCLUSION.pyramidView, NULL);
+    vkDestroyImage(VULKAN.device, OCCLUSION.pyramid, NULL);
+    freeDeviceMemory(OCCLUSION.pyramidMemory);
+}
+
+bool occlusionCullingActive() {
+    return OCCLUSION.active;
+}
+
+void writeOcclusionInputs(uint32_t frame, const DrawBatch* batches, uint32_t batchCount, const Mesh* meshes,
+    const InstanceData* instances, const uint32_t* instanceNodes, uint32_t instanceCount, const Camera* camera) {
+    if (!OCCLUSION.active) return;
+
+    CullInstance* inputs = OCCLUSION.inputsMapped[frame];
+    VkDrawIndexedIndirectCommand* draws = OCCLUSION.drawsMapped[frame];
+    for (uint32_t b = 0; b < batchCount; ++b) {
+        const DrawBatch* batch = batches + b;
+        const Mesh* mesh = meshes + batch->mesh;
+        const MeshLod* lod = mesh->lods + batch->lod;
+
+        // counts are filled in by the cull shader
+        VkDrawIndexedIndirectCommand draw = {
+            .indexCount = lod->indexCount,
+            .instanceCount = 0,
+            .firstIndex = lod->firstIndex,
+            .vertexOffset = mesh->vertexOffset,
+            .firstInstance = batch->firstInstance
+        };
+        draws[b] = draw;
+        draw.firstInstance += MAX_INSTANCES;
+        draws[MAX_DRAW_BATCHES + b] = draw;
+
+        for (uint32_t i = batch->firstInstance; i < batch->firstInstance + batch->instanceCount; ++i) {
+            vec4* model = (vec4*)instances[i].model;
+            CullInstance* input = inputs + i;
+            glm_mat4_mulv3(model, (float*)mesh->center, 1.0f, input->sphere);
+            float scale = glm_vec3_norm(model[0]);
+            float sy = glm_vec3_norm(model[1]), sz = glm_vec3_norm(model[2]);
+            if (sy > scale) scale = sy;
+            if (sz > scale) scale = sz;
+            input->sphere[3] = mesh->radius * scale;
+            input->node = instanceNodes[i];
+            input->batch = b;
+        }
+    }
+
+    memset(OCCLUSION.countersMapped[frame], 0, sizeof(CullCounters));
+
+    CullParams* params = OCCLUSION.params + frame;
+    glm_mat4_mul((vec4*)camera->proj, (vec4*)camera->view, params->viewProj);
+    params->pyramidSize[0] = (float)OCCLUSION.width;
+    params->pyramidSize[1] = (float)OCCLUSION.height;
+    params->instanceCount = instanceCount;
+    params->lateDrawOffset = MAX_DRAW_BATCHES;
+}
+
+void recordOcclusionCull(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t phase) {
+    // last frame's late pass wrote the visibility bits and read the pyramid
+    VkMemoryBarrier before = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &before, 0, NULL, 0, NULL);
+
+    CullParams* params = OCCLUSION.params + frame;
+    params->phase = phase;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, OCCLUSION.cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, OCCLUSION.cullLayout,
+        0, 1, OCCLUSION.cullSets + frame, 0, NULL);
+    vkCmdPushConstants(commandBuffer, OCCLUSION.cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), params);
+    vkCmdDispatch(commandBuffer, (params->instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier after = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+    };
+    VkPipelineStageFlags afterStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    // the late pass leaves the counters for collectOcclusionStats to read once the fence is signaled
+    if (phase == OCCLUSION_PHASE_LATE) {
+        after.dstAccessMask |= VK_ACCESS_HOST_READ_BIT;
+        afterStages |= VK_PIPELINE_STAGE_HOST_BIT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, afterStages,
+        0, 1, &after, 0, NULL, 0, NULL);
+
+    if (phase == OCCLUSION_PHASE_LATE) OCCLUSION.countersPending[frame] = true;
+}
+
+void recordDepthPyramid(VkCommandBuffer commandBuffer) {
+    VkFormat depthFormat = findDepthFormat();
+    VkImageMemoryBarrier depthBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = VULKAN.depthImage,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStancilComponent(depthFormat) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0),
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, NULL, 0, NULL, 1, &depthBarrier);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, OCCLUSION.reducePipeline);
+
+    VkMemoryBarrier levelBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    };
+    uint32_t sourceWidth = VULKAN.renderExtent.width, sourceHeight = VULKAN.renderExtent.height;
+    for (uint32_t i = 0; i < OCCLUSION.levelCount; ++i) {
+        uint32_t width = OCCLUSION.width >> i, height = OCCLUSION.height >> i;
+        if (width == 0) width = 1;
+        if (height == 0) height = 1;
+
+        ReduceParams params = { (int32_t)sourceWidth, (int32_t)sourceHeight, (int32_t)width, (int32_t)height };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, OCCLUSION.reduceLayout,
+            0, 1, OCCLUSION.reduceSets + i, 0, NULL);
+        vkCmdPushConstants(commandBuffer, OCCLUSION.reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(commandBuffer, (width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &levelBarrier, 0, NULL, 0, NULL);
+        sourceWidth = width;
+        sourceHeight = height;
+    }
+}
+
+VkBuffer occlusionVisibleInstances(uint32_t frame) {
+    return OCCLUSION.visible[frame];
+}
+
+VkBuffer occlusionDraws(uint32_t frame) {
+    return OCCLUSION.draws[frame];
+}
+
+VkDeviceSize occlusionDrawOffset(uint32_t phase) {
+    return phase == OCCLUSION_PHASE_LATE ? sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAW_BATCHES : 0;
+}
+
+void collectOcclusionStats(uint32_t frame) {
+    if (!OCCLUSION.active || !OCCLUSION.countersPending[frame]) return;
+
+    const CullCounters* counters = OCCLUSION.countersMapped[frame];
+    OCCLUSION.stats.earlyDrawn = counters->earlyDrawn;
+    OCCLUSION.stats.lateDrawn = counters->lateDrawn;
+    OCCLUSION.stats.occluded = counters->occluded;
+    OCCLUSION.stats.frustumCulled = counters->frustumCulled;
+    OCCLUSION.stats.occludedTotal += counters->occluded;
+    ++OCCLUSION.stats.frames;
+    OCCLUSION.countersPending[frame] = false;
+}
+
+OcclusionStats getOcclusionStats() {
+    return OCCLUSION.stats;
+}
+
+void printOcclusionStats() {
+    if (!OCCLUSION.active) {
+        printf("occlusion culling: off\n");
+        return;
+    }
+    const OcclusionStats* stats = &OCCLUSION.stats;
+    printf("occlusion culling: %.1f occluded per frame over %llu frames, last frame %u early + %u late drawn, "
+        "%u occluded, %u outside the frustum\n",
+        stats->frames ? (double)stats->occludedTotal / (double)stats->frames : 0.0, (unsigned long long)stats->frames,
+        stats->earlyDrawn, stats->lateDrawn, stats->occluded, stats->frustumCulled);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mesh.h"
+#include "scene.h"
+
+#define OCCLUSION_PHASE_EARLY 0
+#define OCCLUSION_PHASE_LATE 1
+
+typedef struct OcclusionStats {
+    uint32_t earlyDrawn, lateDrawn;
+    uint32_t occluded, frustumCulled;
+
+    uint64_t frames, occludedTotal;
+} OcclusionStats;
+
+/*
+ * GPU occlusion culling against a hierarchical depth pyramid, two phases a frame:
+ * - early: whatever was visible last frame is frustum tested and drawn
+ * - the depth of that pass is reduced into the pyramid
+ * - late: everything is tested against the pyramid, newly visible objects are
+ *   drawn on top and the visibility bits are updated for the next frame
+ * Both phases write instanceCount of indirect draws and compact the visible
+ * matrices into a vertex buffer, nothing comes back to the cpu.
+ */
+void createOcclusionResources();
+void destroyOcclusionResources();
+
+/* sized after the depth image, so it follows the swapchain */
+void createDepthPyramid();
+void destroyDepthPyramid();
+
+bool occlusionCullingActive();
+
+/* cpu side of a frame: bounding spheres, indirect templates and zeroed counters */
+void writeOcclusionInputs(uint32_t frame, const DrawBatch* batches, uint32_t batchCount, const Mesh* meshes,
+    const InstanceData* instances, const uint32_t* instanceNodes, uint32_t instanceCount, const Camera* camera);
+
+void recordOcclusionCull(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t phase);
+/* reads the depth attachment, leaves it in DEPTH_STENCIL_READ_ONLY_OPTIMAL */
+void recordDepthPyramid(VkCommandBuffer commandBuffer);
+
+VkBuffer occlusionVisibleInstances(uint32_t frame);
+VkBuffer occlusionDraws(uint32_t frame);
+VkDeviceSize occlusionDrawOffset(uint32_t phase);
+
+/* call after the frame's fence wait */
+void collectOcclusionStats(uint32_t frame);
+OcclusionStats getOcclusionStats();
+void printOcclusionStats();
@@ -0,0 +1,354 @@
+#include "overdraw.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+static struct OVERDRAW {
+    bool active;
+
+    VkRenderPass countPass;
+    PipelineHandle countPipeline;
+
+    VkDescriptorSetLayout heatmapSetLayout;
+    VkPipelineLayout heatmapLayout;
+    VkDescriptorPool heatmapPool;
+    VkDescriptorSet heatmapSet;
+    VkSampler sampler;
+    PipelineHandle heatmapPipeline;
+
+    VkImage counts;
+    VkDeviceMemory countsMemory;
+    VkImageView countsView;
+    VkFramebuffer framebuffer;
+} OVERDRAW;
+
+static void createCountPass() {
+    VkAttachmentDescription countAttachment = {
+        .flags = 0,
+        .format = OVERDRAW_FORMAT,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkAttachmentReference countRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+    VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &countRef,
+        .pResolveAttachments = NULL,
+        .pDepthStencilAttachment = NULL,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL
+    };
+
+    // the previous frame's heatmap has to be done reading before the clear, the next one waits for the counts
+    VkSubpassDependency dependencies[] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = 0
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .dependencyFlags = 0
+        }
+    };
+
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = 1,
+        .pAttachments = &countAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 2,
+        .pDependencies = dependencies
+    };
+    if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &OVERDRAW.countPass) != VK_SUCCESS) {
+        c_throw("failed to create overdraw render pass");
+    }
+}
+
+static void createHeatmapLayout() {
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = NULL
+    };
+    VkDescriptorSetLayoutCreateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 1,
+        .pBindings = &binding
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &setInfo, NULL, &OVERDRAW.heatmapSetLayout) != VK_SUCCESS) {
+        c_throw("failed to create heatmap descriptor set layout");
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &OVERDRAW.heatmapSetLayout,
+        .pushConstantRangeCount = 0,
+        .pPushConstantRanges = NULL
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &OVERDRAW.heatmapLayout) != VK_SUCCESS) {
+        c_throw("failed to create heatmap pipeline layout");
+    }
+
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &OVERDRAW.heatmapPool) != VK_SUCCESS) {
+        c_throw("failed to create heatmap descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = OVERDRAW.heatmapPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &OVERDRAW.heatmapSetLayout
+    };
+    if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, &OVERDRAW.heatmapSet) != VK_SUCCESS) {
+        c_throw("failed to allocate heatmap descriptor set");
+    }
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &OVERDRAW.sampler) != VK_SUCCESS) {
+        c_throw("failed to create heatmap sampler");
+    }
+}
+
+static void requestPipelines() {
+    // the scene's vertex input and layout, every fragment adds one
+    PipelineDesc count;
+    sceneVertexInput(&count);
+    strncpy(count.fragShader, "shaders/overdraw.spv", PIPELINE_SHADER_PATH - 1);
+    count.cullMode = VK_CULL_MODE_NONE;
+    count.blend = PIPELINE_BLEND_ADDITIVE;
+    count.depthTest = VK_FALSE;
+    count.depthWrite = VK_FALSE;
+    count.renderPass = OVERDRAW.countPass;
+    count.layout = VULKAN.pipelineLayout;
+    OVERDRAW.countPipeline = requestPipeline(&count, PIPELINE_HANDLE_NONE);
+
+    PipelineDesc heatmap;
+    pipelineDescDefault(&heatmap);
+    strncpy(heatmap.vertShader, "shaders/fullscreen.spv", PIPELINE_SHADER_PATH - 1);
+    strncpy(heatmap.fragShader, "shaders/heatmap.spv", PIPELINE_SHADER_PATH - 1);
+    heatmap.cullMode = VK_CULL_MODE_NONE;
+    heatmap.depthTest = VK_FALSE;
+    heatmap.depthWrite = VK_FALSE;
+    heatmap.renderPass = VULKAN.renderPass;
+    heatmap.layout = OVERDRAW.heatmapLayout;
+    float saturation = (float)OVERDRAW_SATURATION;
+    heatmap.specEntries[0] = (VkSpecializationMapEntry){ 0, 0, sizeof(float) };
+    heatmap.specEntryCount = 1;
+    memcpy(heatmap.specData, &saturation, sizeof(float));
+    heatmap.specDataSize = sizeof(float);
+    OVERDRAW.heatmapPipeline = requestPipeline(&heatmap, PIPELINE_HANDLE_NONE);
+}
+
+void createOverdrawResources() {
+    OVERDRAW.active = SETTINGS.overdraw;
+    if (!OVERDRAW.active) return;
+
+    createCountPass();
+    createHeatmapLayout();
+    requestPipelines();
+}
+
+void destroyOverdrawResources() {
+    if (!OVERDRAW.active) return;
+
+    vkDestroySampler(VULKAN.device, OVERDRAW.sampler, NULL);
+    vkDestroyDescriptorPool(VULKAN.device, OVERDRAW.heatmapPool, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, OVERDRAW.heatmapLayout, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, OVERDRAW.heatmapSetLayout, NULL);
+    vkDestroyRenderPass(VULKAN.device, OVERDRAW.countPass, NULL);
+}
+
+void createOverdrawTarget() {
+    if (!OVERDRAW.active) return;
+
+    VkExtent2D extent = VULKAN.swapchainExtent;
+    createImage(extent.width, extent.height, OVERDRAW_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_ATTACHMENT, &OVERDRAW.counts, &OVERDRAW.countsMemory);
+    OVERDRAW.countsView = createImageView(OVERDRAW.counts, OVERDRAW_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = OVERDRAW.countPass,
+        .attachmentCount = 1,
+        .pAttachments = &OVERDRAW.countsView,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1
+    };
+    if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, &OVERDRAW.framebuffer) != VK_SUCCESS) {
+        c_throw("failed to create overdraw framebuffer");
+    }
+
+    VkDescriptorImageInfo imageInfo = {
+        .sampler = OVERDRAW.sampler,
+        .imageView = OVERDRAW.countsView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = OVERDRAW.heatmapSet,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = NULL,
+        .pTexelBufferView = NULL
+    };
+    vkUpdateDescriptorSets(VULKAN.device, 1, &write, 0, NULL);
+}
+
+void destroyOverdrawTarget() {
+    if (!OVERDRAW.active) return;
+
+    vkDestroyFramebuffer(VULKAN.device, OVERDRAW.framebuffer, NULL);
+    vkDestroyImageView(VULKAN.device, OVERDRAW.countsView, NULL);
+    vkDestroyImage(VULKAN.device, OVERDRAW.counts, NULL);
+    freeDeviceMemory(OVERDRAW.countsMemory);
+}
+
+bool overdrawReady() {
+    return OVERDRAW.active && getPipeline(OVERDRAW.countPipeline) != VK_NULL_HANDLE &&
+        getPipeline(OVERDRAW.heatmapPipeline) != VK_NULL_HANDLE;
+}
+
+static void setFullViewport(VkCommandBuffer commandBuffer) {
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)VULKAN.renderExtent.width,
+        .height = (float)VULKAN.renderExtent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {
+        .offset = {0,0},
+        .extent = VULKAN.renderExtent
+    };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void beginOverdrawCount(VkCommandBuffer commandBuffer) {
+    VkClearValue clear = {.color = {0.0f, 0.0f, 0.0f, 0.0f}};
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = OVERDRAW.countPass,
+        .framebuffer = OVERDRAW.framebuffer,
+        .renderArea = {
+            .offset = {0,0},
+            .extent = VULKAN.renderExtent
+        },
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    setFullViewport(commandBuffer);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(OVERDRAW.countPipeline));
+}
+
+void endOverdrawCount(VkCommandBuffer commandBuffer) {
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void recordOverdrawHeatmap(VkCommandBuffer commandBuffer) {
+    VkClearValue clearValues[] = {
+        {.color = {0.0f, 0.0f, 0.0f, 1.0f}},
+        {.depthStencil = {1.0f, 0}}
+    };
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = VULKAN.renderPass,
+        .framebuffer = VULKAN.sceneFramebuffer,
+        .renderArea = {
+            .offset = {0,0},
+            .extent = VULKAN.renderExtent
+        },
+        .clearValueCount = 2,
+        .pClearValues = clearValues,
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    setFullViewport(commandBuffer);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(OVERDRAW.heatmapPipeline));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, OVERDRAW.heatmapLayout,
+        0, 1, &OVERDRAW.heatmapSet, 0, NULL);
+    // one triangle past the screen edges, positions come from gl_VertexIndex
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+}
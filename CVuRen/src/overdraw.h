@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+
+/* layers of overdraw at which the heatmap saturates to white */
+#define OVERDRAW_SATURATION 8
+#define OVERDRAW_FORMAT VK_FORMAT_R16_SFLOAT
+
+/*
+ * Overdraw visualization: the scene goes into a single channel count target
+ * with additive blending and no depth test, so every fragment the rasterizer
+ * produces adds one. A fullscreen pass then colorizes the counts into the
+ * scene target, black through blue, green and red to white at OVERDRAW_SATURATION.
+ * Only created when SETTINGS.overdraw is set.
+ */
+void createOverdrawResources();
+void destroyOverdrawResources();
+
+/* the count target is sized after the swapchain */
+void createOverdrawTarget();
+void destroyOverdrawTarget();
+
+/* false while the mode is off or its pipelines are still compiling */
+bool overdrawReady();
+
+/* begins the count pass with its pipeline bound, the caller records the draws */
+void beginOverdrawCount(VkCommandBuffer commandBuffer);
+void endOverdrawCount(VkCommandBuffer commandBuffer);
+/* draws the heatmap over the rendered part of the scene target, clearing it first */
+void recordOverdrawHeatmap(VkCommandBuffer commandBuffer);
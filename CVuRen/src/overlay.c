@@ -0,0 +1,605 @@
+#include "overlay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "resolution.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+#define OVERLAY_FIRST_CHAR 32
+#define OVERLAY_GLYPH_COUNT 95
+/* the atlas is 16 cells wide, the cell after the last glyph is solid for rectangles */
+#define OVERLAY_ATLAS_COLUMNS 16
+#define OVERLAY_ATLAS_ROWS 6
+#define OVERLAY_ATLAS_WIDTH (OVERLAY_ATLAS_COLUMNS * OVERLAY_GLYPH_WIDTH)
+#define OVERLAY_ATLAS_HEIGHT (OVERLAY_ATLAS_ROWS * OVERLAY_GLYPH_HEIGHT)
+#define OVERLAY_SOLID_CELL OVERLAY_GLYPH_COUNT
+
+/* one instance, overlay.vert makes the 4 corners from it */
+typedef struct OverlayQuad {
+    int16_t rect[4];
+    /* atlas rectangle as unorm, top left then bottom right */
+    uint16_t uv[4];
+    uint32_t color;
+} OverlayQuad;
+
+/* rows top to bottom, the leftmost pixel in the high bit; rasterized from DejaVu Sans Mono */
+static const uint8_t GLYPHS[OVERLAY_GLYPH_COUNT][OVERLAY_GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* space */
+    { 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* ! */
+    { 0x00, 0x00, 0x00, 0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* " */
+    { 0x00, 0x00, 0x00, 0x12, 0x12, 0x16, 0x7f, 0x24, 0x24, 0xfe, 0x68, 0x48, 0x48, 0x00, 0x00, 0x00 }, /* # */
+    { 0x00, 0x00, 0x00, 0x08, 0x3e, 0x68, 0x48, 0x78, 0x1e, 0x0a, 0x0a, 0x4e, 0x3c, 0x08, 0x00, 0x00 }, /* $ */
+    { 0x00, 0x00, 0x00, 0x60, 0x90, 0x90, 0xf0, 0x0c, 0x34, 0x0f, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00 }, /* % */
+    { 0x00, 0x00, 0x00, 0x3c, 0x60, 0x20, 0x20, 0x70, 0xd9, 0xcd, 0xc6, 0x46, 0x3f, 0x00, 0x00, 0x00 }, /* & */
+    { 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* ' */
+    { 0x00, 0x00, 0x04, 0x08, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x08, 0x08, 0x00, 0x00 }, /* ( */
+    { 0x00, 0x00, 0x20, 0x10, 0x10, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x10, 0x10, 0x00, 0x00 }, /* ) */
+    { 0x00, 0x00, 0x00, 0x18, 0x7e, 0x18, 0x3c, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* asterisk */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0xff, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00 }, /* + */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x10, 0x00 }, /* , */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* - */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* . */
+    { 0x00, 0x00, 0x00, 0x06, 0x04, 0x0c, 0x08, 0x08, 0x10, 0x10, 0x30, 0x20, 0x60, 0x40, 0x00, 0x00 }, /* slash */
+    { 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x5a, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 }, /* 0 */
+    { 0x00, 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x3e, 0x3e, 0x00, 0x00, 0x00 }, /* 1 */
+    { 0x00, 0x00, 0x10, 0x7c, 0x06, 0x06, 0x06, 0x04, 0x08, 0x10, 0x20, 0x7e, 0x7e, 0x00, 0x00, 0x00 }, /* 2 */
+    { 0x00, 0x00, 0x10, 0x7c, 0x06, 0x06, 0x06, 0x3c, 0x06, 0x02, 0x02, 0x46, 0x7c, 0x00, 0x00, 0x00 }, /* 3 */
+    { 0x00, 0x00, 0x00, 0x0c, 0x1c, 0x14, 0x24, 0x24, 0x44, 0xfe, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00 }, /* 4 */
+    { 0x00, 0x00, 0x00, 0x7c, 0x60, 0x60, 0x78, 0x0e, 0x06, 0x02, 0x06, 0x46, 0x7c, 0x00, 0x00, 0x00 }, /* 5 */
+    { 0x00, 0x00, 0x08, 0x3e, 0x60, 0x40, 0x5c, 0x66, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 }, /* 6 */
+    { 0x00, 0x00, 0x00, 0x7e, 0x06, 0x04, 0x04, 0x0c, 0x08, 0x18, 0x10, 0x10, 0x30, 0x00, 0x00, 0x00 }, /* 7 */
+    { 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x66, 0x3c, 0x66, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 }, /* 8 */
+    { 0x00, 0x00, 0x10, 0x3c, 0x46, 0x42, 0x42, 0x46, 0x3e, 0x02, 0x06, 0x0c, 0x38, 0x00, 0x00, 0x00 }, /* 9 */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* : */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x10, 0x00 }, /* ; */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x0e, 0x70, 0xe0, 0x38, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* < */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x7e, 0x00, 0x7e, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* = */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x70, 0x0e, 0x07, 0x1c, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* > */
+    { 0x00, 0x00, 0x00, 0x3c, 0x06, 0x06, 0x04, 0x08, 0x18, 0x18, 0x00, 0x18, 0x10, 0x00, 0x00, 0x00 }, /* ? */
+    { 0x00, 0x00, 0x00, 0x0c, 0x36, 0x43, 0xcf, 0x93, 0x91, 0x91, 0x93, 0xcf, 0x40, 0x20, 0x1e, 0x00 }, /* @ */
+    { 0x00, 0x00, 0x00, 0x18, 0x18, 0x3c, 0x24, 0x24, 0x66, 0x7e, 0x42, 0xc3, 0x81, 0x00, 0x00, 0x00 }, /* A */
+    { 0x00, 0x00, 0x00, 0x7c, 0x42, 0x42, 0x46, 0x7c, 0x42, 0x43, 0x43, 0x46, 0x7c, 0x00, 0x00, 0x00 }, /* B */
+    { 0x00, 0x00, 0x08, 0x3e, 0x60, 0x60, 0x40, 0x40, 0x40, 0x40, 0x60, 0x32, 0x1e, 0x00, 0x00, 0x00 }, /* C */
+    { 0x00, 0x00, 0x00, 0x7c, 0x46, 0x42, 0x42, 0x42, 0x42, 0x42, 0x46, 0x4c, 0x78, 0x00, 0x00, 0x00 }, /* D */
+    { 0x00, 0x00, 0x00, 0x7e, 0x60, 0x60, 0x60, 0x7e, 0x60, 0x60, 0x60, 0x7e, 0x7e, 0x00, 0x00, 0x00 }, /* E */
+    { 0x00, 0x00, 0x00, 0x7e, 0x60, 0x60, 0x60, 0x7e, 0x60, 0x60, 0x60, 0x60, 0x20, 0x00, 0x00, 0x00 }, /* F */
+    { 0x00, 0x00, 0x08, 0x3e, 0x60, 0x40, 0x40, 0xc6, 0xc6, 0x42, 0x42, 0x22, 0x1e, 0x00, 0x00, 0x00 }, /* G */
+    { 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 }, /* H */
+    { 0x00, 0x00, 0x00, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3c, 0x7e, 0x00, 0x00, 0x00 }, /* I */
+    { 0x00, 0x00, 0x00, 0x3c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0xcc, 0x78, 0x00, 0x00, 0x00 }, /* J */
+    { 0x00, 0x00, 0x00, 0x42, 0x44, 0x48, 0x50, 0x78, 0x48, 0x4c, 0x46, 0x42, 0x43, 0x00, 0x00, 0x00 }, /* K */
+    { 0x00, 0x00, 0x00, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7e, 0x7e, 0x00, 0x00, 0x00 }, /* L */
+    { 0x00, 0x00, 0x00, 0xe7, 0xe7, 0xe7, 0xdb, 0xdb, 0xdb, 0xc3, 0xc3, 0xc3, 0x42, 0x00, 0x00, 0x00 }, /* M */
+    { 0x00, 0x00, 0x00, 0x62, 0x62, 0x72, 0x52, 0x52, 0x4a, 0x4a, 0x46, 0x46, 0x46, 0x00, 0x00, 0x00 }, /* N */
+    { 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 }, /* O */
+    { 0x00, 0x00, 0x00, 0x7e, 0x62, 0x63, 0x62, 0x7e, 0x7c, 0x60, 0x60, 0x60, 0x40, 0x00, 0x00, 0x00 }, /* P */
+    { 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x04, 0x00, 0x00 }, /* Q */
+    { 0x00, 0x00, 0x00, 0x7c, 0x46, 0x46, 0x46, 0x7c, 0x7c, 0x46, 0x42, 0x43, 0x41, 0x00, 0x00, 0x00 }, /* R */
+    { 0x00, 0x00, 0x08, 0x3e, 0x40, 0x40, 0x60, 0x3c, 0x06, 0x02, 0x02, 0x46, 0x7c, 0x00, 0x00, 0x00 }, /* S */
+    { 0x00, 0x00, 0x00, 0xff, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* T */
+    { 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 }, /* U */
+    { 0x00, 0x00, 0x00, 0xc3, 0x42, 0x42, 0x66, 0x24, 0x24, 0x24, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* V */
+    { 0x00, 0x00, 0x00, 0x81, 0x81, 0xc3, 0xdb, 0x5a, 0x5a, 0x66, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00 }, /* W */
+    { 0x00, 0x00, 0x00, 0x42, 0x66, 0x34, 0x18, 0x18, 0x18, 0x24, 0x66, 0x42, 0xc3, 0x00, 0x00, 0x00 }, /* X */
+    { 0x00, 0x00, 0x00, 0xc2, 0x66, 0x24, 0x3c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* Y */
+    { 0x00, 0x00, 0x00, 0x7f, 0x02, 0x04, 0x0c, 0x08, 0x10, 0x30, 0x20, 0x7e, 0x7f, 0x00, 0x00, 0x00 }, /* Z */
+    { 0x00, 0x00, 0x1c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x18, 0x00 }, /* [ */
+    { 0x00, 0x00, 0x00, 0x40, 0x60, 0x20, 0x30, 0x10, 0x18, 0x08, 0x0c, 0x04, 0x04, 0x02, 0x00, 0x00 }, /* backslash */
+    { 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x18, 0x18, 0x00 }, /* ] */
+    { 0x00, 0x00, 0x00, 0x18, 0x24, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* ^ */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff }, /* _ */
+    { 0x00, 0x00, 0x30, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* ` */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x46, 0x02, 0x3e, 0x42, 0x46, 0x46, 0x3a, 0x00, 0x00, 0x00 }, /* a */
+    { 0x00, 0x00, 0x40, 0x60, 0x60, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x62, 0x66, 0x7c, 0x00, 0x00, 0x00 }, /* b */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x1e, 0x32, 0x60, 0x60, 0x60, 0x60, 0x32, 0x1e, 0x00, 0x00, 0x00 }, /* c */
+    { 0x00, 0x00, 0x02, 0x06, 0x06, 0x3e, 0x66, 0x46, 0x46, 0x46, 0x46, 0x66, 0x3e, 0x00, 0x00, 0x00 }, /* d */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x7e, 0x40, 0x40, 0x62, 0x3e, 0x00, 0x00, 0x00 }, /* e */
+    { 0x00, 0x00, 0x0e, 0x18, 0x18, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00, 0x00 }, /* f */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x66, 0x46, 0x46, 0x46, 0x46, 0x66, 0x3e, 0x06, 0x24, 0x38 }, /* g */
+    { 0x00, 0x00, 0x40, 0x60, 0x60, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x62, 0x62, 0x42, 0x00, 0x00, 0x00 }, /* h */
+    { 0x00, 0x00, 0x08, 0x18, 0x00, 0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7e, 0x00, 0x00, 0x00 }, /* i */
+    { 0x00, 0x00, 0x08, 0x08, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x78, 0x70 }, /* j */
+    { 0x00, 0x00, 0x20, 0x60, 0x60, 0x62, 0x64, 0x68, 0x78, 0x6c, 0x64, 0x66, 0x23, 0x00, 0x00, 0x00 }, /* k */
+    { 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0e, 0x00, 0x00, 0x00 }, /* l */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0xda, 0xdb, 0xdb, 0xdb, 0xdb, 0xdb, 0x42, 0x00, 0x00, 0x00 }, /* m */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x5c, 0x66, 0x62, 0x62, 0x62, 0x62, 0x62, 0x42, 0x00, 0x00, 0x00 }, /* n */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 }, /* o */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x62, 0x66, 0x7c, 0x60, 0x60, 0x00 }, /* p */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3a, 0x66, 0x46, 0x42, 0x42, 0x46, 0x66, 0x3a, 0x02, 0x02, 0x02 }, /* q */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x2e, 0x38, 0x30, 0x30, 0x30, 0x30, 0x30, 0x20, 0x00, 0x00, 0x00 }, /* r */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x60, 0x60, 0x38, 0x0e, 0x06, 0x46, 0x3c, 0x00, 0x00, 0x00 }, /* s */
+    { 0x00, 0x00, 0x00, 0x10, 0x10, 0x7e, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0e, 0x00, 0x00, 0x00 }, /* t */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x62, 0x62, 0x62, 0x62, 0x62, 0x66, 0x3a, 0x00, 0x00, 0x00 }, /* u */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x66, 0x24, 0x24, 0x3c, 0x18, 0x18, 0x00, 0x00, 0x00 }, /* v */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x81, 0xc3, 0x5a, 0x5a, 0x66, 0x66, 0x24, 0x00, 0x00, 0x00 }, /* w */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x24, 0x3c, 0x18, 0x18, 0x24, 0x66, 0x42, 0x00, 0x00, 0x00 }, /* x */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x66, 0x24, 0x34, 0x1c, 0x18, 0x18, 0x10, 0x70, 0x60 }, /* y */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x06, 0x0c, 0x08, 0x10, 0x30, 0x60, 0x7e, 0x00, 0x00, 0x00 }, /* z */
+    { 0x00, 0x00, 0x06, 0x08, 0x18, 0x18, 0x18, 0x18, 0x70, 0x10, 0x18, 0x18, 0x18, 0x18, 0x0e, 0x00 }, /* { */
+    { 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 }, /* | */
+    { 0x00, 0x00, 0x60, 0x10, 0x18, 0x18, 0x18, 0x18, 0x0e, 0x08, 0x18, 0x18, 0x18, 0x18, 0x70, 0x00 }, /* } */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x7e, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* ~ */
+};
+
+static struct OVERLAY {
+    bool active;
+
+    VkImage atlas;
+    VkDeviceMemory atlasMemory;
+    VkImageView atlasView;
+    VkSampler sampler;
+    uint16_t cellUv[OVERLAY_GLYPH_COUNT + 1][4];
+
+    VkRenderPass renderPass;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    PipelineHandle pipeline;
+    VkFramebuffer* framebuffers;
+
+    VkBuffer* quadBuffers;
+    VkDeviceMemory* quadBuffersMemory;
+    OverlayQuad** quadsMapped;
+    uint32_t* quadCounts;
+
+    /* the frame being built */
+    OverlayQuad* quads;
+    uint32_t quadCount, dropped;
+    uint32_t frame;
+    uint64_t buildStart;
+
+    OverlayStats stats;
+} OVERLAY;
+
+static void createAtlas() {
+    uint8_t* pixels = calloc(OVERLAY_ATLAS_WIDTH * OVERLAY_ATLAS_HEIGHT, 1);
+    for (uint32_t cell = 0; cell <= OVERLAY_SOLID_CELL; ++cell) {
+        uint32_t left = (cell % OVERLAY_ATLAS_COLUMNS) * OVERLAY_GLYPH_WIDTH;
+        uint32_t top = (cell / OVERLAY_ATLAS_COLUMNS) * OVERLAY_GLYPH_HEIGHT;
+        for (uint32_t y = 0; y < OVERLAY_GLYPH_HEIGHT; ++y) {
+            uint8_t bits = cell == OVERLAY_SOLID_CELL ? 0xff : GLYPHS[cell][y];
+            for (uint32_t x = 0; x < OVERLAY_GLYPH_WIDTH; ++x) {
+                if (bits & (0x80 >> x)) pixels[(top + y) * OVERLAY_ATLAS_WIDTH + left + x] = 255;
+            }
+        }
+        OVERLAY.cellUv[cell][0] = (uint16_t)(65535u * left / OVERLAY_ATLAS_WIDTH);
+        OVERLAY.cellUv[cell][1] = (uint16_t)(65535u * top / OVERLAY_ATLAS_HEIGHT);
+        OVERLAY.cellUv[cell][2] = (uint16_t)(65535u * (left + OVERLAY_GLYPH_WIDTH) / OVERLAY_ATLAS_WIDTH);
+        OVERLAY.cellUv[cell][3] = (uint16_t)(65535u * (top + OVERLAY_GLYPH_HEIGHT) / OVERLAY_ATLAS_HEIGHT);
+    }
+    // rectangles stretch the solid cell, sampling its middle keeps the edges from bleeding in
+    uint16_t* solid = OVERLAY.cellUv[OVERLAY_SOLID_CELL];
+    uint16_t middleU = (uint16_t)((solid[0] + solid[2]) / 2), middleV = (uint16_t)((solid[1] + solid[3]) / 2);
+    solid[0] = solid[2] = middleU;
+    solid[1] = solid[3] = middleV;
+
+    VkDeviceSize bytes = OVERLAY_ATLAS_WIDTH * OVERLAY_ATLAS_HEIGHT;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, &stagingBuffer, &stagingBufferMemory);
+    void* data;
+    vkMapMemory(VULKAN.device, stagingBufferMemory, 0, bytes, 0, &data);
+    memcpy(data, pixels, (size_t)bytes);
+    vkUnmapMemory(VULKAN.device, stagingBufferMemory);
+    free(pixels);
+
+    createImage(OVERLAY_ATLAS_WIDTH, OVERLAY_ATLAS_HEIGHT, VK_FORMAT_R8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_TEXTURE, &OVERLAY.atlas, &OVERLAY.atlasMemory);
+    transitionImageLayout(OVERLAY.atlas, VK_FORMAT_R8_UNORM,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copyBufferToImage(stagingBuffer, OVERLAY.atlas, OVERLAY_ATLAS_WIDTH, OVERLAY_ATLAS_HEIGHT);
+    transitionImageLayout(OVERLAY.atlas, VK_FORMAT_R8_UNORM,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
+    freeDeviceMemory(stagingBufferMemory);
+
+    OVERLAY.atlasView = createImageView(OVERLAY.atlas, VK_FORMAT_R8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &OVERLAY.sampler) != VK_SUCCESS) {
+        c_throw("failed to create overlay sampler");
+    }
+}
+
+static void createRenderPass() {
+    // draws over what the upscale wrote, the output stays in GENERAL for both
+    VkAttachmentDescription colorAttachment = {
+        .flags = 0,
+        .format = RESOLUTION_OUTPUT_FORMAT,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .finalLayout = VK_IMAGE_LAYOUT_GENERAL
+    };
+    VkAttachmentReference colorRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_GENERAL
+    };
+    VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRef,
+        .pResolveAttachments = NULL,
+        .pDepthStencilAttachment = NULL,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL
+    };
+    VkSubpassDependency dependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dependencyFlags = 0
+    };
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = 1,
+        .pAttachments = &colorAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 1,
+        .pDependencies = &dependency
+    };
+    if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &OVERLAY.renderPass) != VK_SUCCESS) {
+        c_throw("failed to create overlay render pass");
+    }
+}
+
+static void createLayout() {
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = NULL
+    };
+    VkDescriptorSetLayoutCreateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 1,
+        .pBindings = &binding
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &setInfo, NULL, &OVERLAY.setLayout) != VK_SUCCESS) {
+        c_throw("failed to create overlay descriptor set layout");
+    }
+
+    VkPushConstantRange push = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(float) * 2
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &OVERLAY.setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &OVERLAY.layout) != VK_SUCCESS) {
+        c_throw("failed to create overlay pipeline layout");
+    }
+
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &OVERLAY.pool) != VK_SUCCESS) {
+        c_throw("failed to create overlay descriptor pool");
+    }
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = OVERLAY.pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &OVERLAY.setLayout
+    };
+    if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, &OVERLAY.set) != VK_SUCCESS) {
+        c_throw("failed to allocate overlay descriptor set");
+    }
+
+    VkDescriptorImageInfo imageInfo = {
+        .sampler = OVERLAY.sampler,
+        .imageView = OVERLAY.atlasView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = OVERLAY.set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = NULL,
+        .pTexelBufferView = NULL
+    };
+    vkUpdateDescriptorSets(VULKAN.device, 1, &write, 0, NULL);
+}
+
+static void requestOverlayPipeline() {
+    PipelineDesc desc;
+    pipelineDescDefault(&desc);
+    strncpy(desc.vertShader, "shaders/overlay_vert.spv", PIPELINE_SHADER_PATH - 1);
+    strncpy(desc.fragShader, "shaders/overlay_frag.spv", PIPELINE_SHADER_PATH - 1);
+    desc.bindings[0] = (VkVertexInputBindingDescription){ 0, sizeof(OverlayQuad), VK_VERTEX_INPUT_RATE_INSTANCE };
+    desc.bindingCount = 1;
+    desc.attributes[0] = (VkVertexInputAttributeDescription){
+        0, 0, VK_FORMAT_R16G16B16A16_SINT, offsetof(OverlayQuad, rect) };
+    desc.attributes[1] = (VkVertexInputAttributeDescription){
+        1, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(OverlayQuad, uv) };
+    desc.attributes[2] = (VkVertexInputAttributeDescription){
+        2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(OverlayQuad, color) };
+    desc.attributeCount = 3;
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    desc.cullMode = VK_CULL_MODE_NONE;
+    desc.blend = PIPELINE_BLEND_ALPHA;
+    desc.depthTest = VK_FALSE;
+    desc.depthWrite = VK_FALSE;
+    desc.renderPass = OVERLAY.renderPass;
+    desc.layout = OVERLAY.layout;
+    OVERLAY.pipeline = requestPipeline(&desc, PIPELINE_HANDLE_NONE);
+}
+
+void createOverlayResources() {
+    OVERLAY.active = SETTINGS.overlay && !SETTINGS.regress;
+    if (!OVERLAY.active) return;
+
+    createAtlas();
+    createRenderPass();
+    createLayout();
+    requestOverlayPipeline();
+
+    OVERLAY.quadBuffers = malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
+    OVERLAY.quadBuffersMemory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    OVERLAY.quadsMapped = malloc(sizeof(OverlayQuad*) * MAX_FRAMES_IN_FLIGHT);
+    OVERLAY.quadCounts = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(uint32_t));
+    VkDeviceSize bytes = sizeof(OverlayQuad) * OVERLAY_MAX_QUADS;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_VERTEX, OVERLAY.quadBuffers + i,
+            OVERLAY.quadBuffersMemory + i);
+        vkMapMemory(VULKAN.device, OVERLAY.quadBuffersMemory[i], 0, bytes, 0, (void**)(OVERLAY.quadsMapped + i));
+    }
+}
+
+void destroyOverlayResources() {
+    if (!OVERLAY.active) return;
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyBuffer(VULKAN.device, OVERLAY.quadBuffers[i], NULL);
+        freeDeviceMemory(OVERLAY.quadBuffersMemory[i]);
+    }
+    free(OVERLAY.quadBuffers);
+    free(OVERLAY.quadBuffersMemory);
+    free(OVERLAY.quadsMapped);
+    free(OVERLAY.quadCounts);
+
+    vkDestroyDescriptorPool(VULKAN.device, OVERLAY.pool, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, OVERLAY.layout, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, OVERLAY.setLayout, NULL);
+    vkDestroyRenderPass(VULKAN.device, OVERLAY.renderPass, NULL);
+    vkDestroySampler(VULKAN.device, OVERLAY.sampler, NULL);
+    vkDestroyImageView(VULKAN.device, OVERLAY.atlasView, NULL);
+    vkDestroyImage(VULKAN.device, OVERLAY.atlas, NULL);
+    freeDeviceMemory(OVERLAY.atlasMemory);
+}
+
+void createOverlayTargets() {
+    if (!OVERLAY.active) return;
+
+    OVERLAY.framebuffers = malloc(sizeof(VkFramebuffer) * MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkImageView attachment = resolutionOutputView(i);
+        VkFramebufferCreateInfo framebufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .renderPass = OVERLAY.renderPass,
+            .attachmentCount = 1,
+            .pAttachments = &attachment,
+            .width = VULKAN.swapchainExtent.width,
+            .height = VULKAN.swapchainExtent.height,
+            .layers = 1
+        };
+        if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, OVERLAY.framebuffers + i) != VK_SUCCESS) {
+            c_throw("failed to create overlay framebuffer");
+        }
+    }
+}
+
+void destroyOverlayTargets() {
+    if (!OVERLAY.active) return;
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyFramebuffer(VULKAN.device, OVERLAY.framebuffers[i], NULL);
+    }
+    free(OVERLAY.framebuffers);
+}
+
+bool overlayActive() {
+    return OVERLAY.active;
+}
+
+void overlayBegin(uint32_t frame) {
+    OVERLAY.buildStart = getTimeInNanoseconds();
+    OVERLAY.frame = frame;
+    OVERLAY.quads = OVERLAY.active ? OVERLAY.quadsMapped[frame] : NULL;
+    OVERLAY.quadCount = 0;
+    OVERLAY.dropped = 0;
+}
+
+void overlayEnd() {
+    if (!OVERLAY.active) return;
+    OVERLAY.quadCounts[OVERLAY.frame] = OVERLAY.quadCount;
+
+    OverlayStats* stats = &OVERLAY.stats;
+    stats->buildNs = getTimeInNanoseconds() - OVERLAY.buildStart;
+    if (stats->buildNs > stats->buildNsMax) stats->buildNsMax = stats->buildNs;
+    stats->quads = OVERLAY.quadCount;
+    stats->droppedQuads = OVERLAY.dropped;
+    ++stats->frames;
+    stats->quadsTotal += OVERLAY.quadCount;
+    stats->buildNsTotal += stats->buildNs;
+}
+
+// the mapped memory is write combined, quads are written whole and in order
+static void pushQuad(float x, float y, float width, float height, const uint16_t* uv, uint32_t color) {
+    if (OVERLAY.quadCount == OVERLAY_MAX_QUADS) {
+        ++OVERLAY.dropped;
+        return;
+    }
+    OverlayQuad quad = {
+        .rect = { (int16_t)x, (int16_t)y, (int16_t)width, (int16_t)height },
+        .uv = { uv[0], uv[1], uv[2], uv[3] },
+        .color = color
+    };
+    OVERLAY.quads[OVERLAY.quadCount++] = quad;
+}
+
+void overlayRect(float x, float y, float width, float height, uint32_t color) {
+    if (!OVERLAY.quads) return;
+    pushQuad(x, y, width, height, OVERLAY.cellUv[OVERLAY_SOLID_CELL], color);
+}
+
+float overlayText(float x, float y, uint32_t color, const char* text) {
+    if (!OVERLAY.quads) return x;
+    float left = x;
+    for (const char* c = text; *c; ++c) {
+        if (*c == '\n') {
+            x = left;
+            y += OVERLAY_GLYPH_HEIGHT;
+            continue;
+        }
+        uint32_t glyph = (uint32_t)(unsigned char)*c - OVERLAY_FIRST_CHAR;
+        // spaces and anything outside printable ascii only advance
+        if (glyph != 0 && glyph < OVERLAY_GLYPH_COUNT) {
+            pushQuad(x, y, OVERLAY_GLYPH_WIDTH, OVERLAY_GLYPH_HEIGHT, OVERLAY.cellUv[glyph], color);
+        }
+        x += OVERLAY_GLYPH_WIDTH;
+    }
+    return x;
+}
+
+float overlayTextf(float x, float y, uint32_t color, const char* format, ...) {
+    if (!OVERLAY.quads) return x;
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return overlayText(x, y, color, text);
+}
+
+void recordOverlay(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (!OVERLAY.active || OVERLAY.quadCounts[frame] == 0) return;
+    VkPipeline pipeline = getPipeline(OVERLAY.pipeline);
+    if (pipeline == VK_NULL_HANDLE) return;
+
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = OVERLAY.renderPass,
+        .framebuffer = OVERLAY.framebuffers[frame],
+        .renderArea = {
+            .offset = {0,0},
+            .extent = VULKAN.swapchainExtent
+        },
+        .clearValueCount = 0,
+        .pClearValues = NULL,
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)VULKAN.swapchainExtent.width,
+        .height = (float)VULKAN.swapchainExtent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {
+        .offset = {0,0},
+        .extent = VULKAN.swapchainExtent
+    };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    float scale[2] = { 2.0f / (float)VULKAN.swapchainExtent.width, 2.0f / (float)VULKAN.swapchainExtent.height };
+    VkDeviceSize offset = 0;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, OVERLAY.layout,
+        0, 1, &OVERLAY.set, 0, NULL);
+    vkCmdPushConstants(commandBuffer, OVERLAY.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(scale), scale);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, OVERLAY.quadBuffers + frame, &offset);
+    vkCmdDraw(commandBuffer, 4, OVERLAY.quadCounts[frame], 0, 0);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+OverlayStats getOverlayStats() {
+    return OVERLAY.stats;
+}
+
+void printOverlayStats() {
+    const OverlayStats* stats = &OVERLAY.stats;
+    if (!OVERLAY.active) return;
+    printf("overlay: %.0f quads a frame on average, %.1f us cpu on average and %.1f us at worst",
+        stats->frames ? (double)stats->quadsTotal / (double)stats->frames : 0.0,
+        stats->frames ? (double)stats->buildNsTotal / (double)stats->frames / 1e3 : 0.0,
+        (double)stats->buildNsMax / 1e3);
+    if (stats->droppedQuads) printf(", %u quads over the limit last frame", stats->droppedQuads);
+    printf("\n");
+}
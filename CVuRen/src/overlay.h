@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* quads a frame can hold, the rest of a frame's are dropped */
+#define OVERLAY_MAX_QUADS 8192
+/* the baked font's cell, printable ascii only */
+#define OVERLAY_GLYPH_WIDTH 8
+#define OVERLAY_GLYPH_HEIGHT 16
+
+/* srgb as any color picker gives it, red in the low byte */
+#define OVERLAY_RGBA(r, g, b, a) \
+    ((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+
+typedef struct OverlayStats {
+    uint32_t quads, droppedQuads;
+    /* between overlayBegin and overlayEnd, everything the cpu spends on the overlay */
+    uint64_t buildNs, buildNsMax;
+
+    uint64_t frames, quadsTotal, buildNsTotal;
+} OverlayStats;
+
+/*
+ * Immediate mode 2D overlay drawn over the finished output, after the post
+ * stack so text stays crisp and untouched by tonemapping. Between
+ * overlayBegin and overlayEnd the calls append instanced quads straight into
+ * the frame's persistently mapped vertex buffer, glyphs and rectangles alike,
+ * since rectangles sample a solid cell of the font atlas. The whole overlay
+ * is then one draw of 4 vertices per instance with its own pipeline.
+ * Off for regression runs, whose images mustn't depend on timings.
+ */
+void createOverlayResources();
+void destroyOverlayResources();
+
+/* framebuffers on the resolution outputs, after createRenderTargets */
+void createOverlayTargets();
+void destroyOverlayTargets();
+
+bool overlayActive();
+
+/* render thread only, once per frame before recording it */
+void overlayBegin(uint32_t frame);
+void overlayEnd();
+
+/* in pixels from the top left of the window */
+void overlayRect(float x, float y, float width, float height, uint32_t color);
+/* returns where the next character would go */
+float overlayText(float x, float y, uint32_t color, const char* text);
+float overlayTextf(float x, float y, uint32_t color, const char* format, ...);
+
+/* after the upscale, leaves the output in GENERAL */
+void recordOverlay(VkCommandBuffer commandBuffer, uint32_t frame);
+
+OverlayStats getOverlayStats();
+void printOverlayStats();
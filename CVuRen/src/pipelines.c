@@ -0,0 +1,448 @@
+#include "pipelines.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkcontext.h"
+
+#include "utils/assetio.h"
+#include "utils/threading.h"
+#include "utils/trace.h"
+#include "utils/utils.h"
+
+enum {
+    PIPELINE_STATE_PENDING,
+    PIPELINE_STATE_READY,
+    PIPELINE_STATE_FAILED
+};
+
+typedef struct PipelineEntry {
+    PipelineDesc desc;
+    uint64_t hash;
+    VkPipeline pipeline;
+    PipelineHandle fallback;
+    volatile int32_t state;
+} PipelineEntry;
+
+#define PIPELINE_SLOTS (PIPELINE_CACHE_CAPACITY * 2)
+
+static struct PIPELINES {
+    VkPipelineCache vkCache;
+
+    /* entries never move, so workers can hold a pointer to theirs */
+    PipelineEntry entries[PIPELINE_CACHE_CAPACITY];
+    uint32_t count;
+    /* open addressing, entry index + 1, zero is an empty slot */
+    uint32_t slots[PIPELINE_SLOTS];
+
+    PipelineCacheStats stats;
+
+    c_mutex lock;
+    c_cond compiled;
+} PIPELINES;
+
+void pipelineDescDefault(PipelineDesc* desc) {
+    memset(desc, 0, sizeof(PipelineDesc));
+    desc->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc->polygonMode = VK_POLYGON_MODE_FILL;
+    desc->cullMode = VK_CULL_MODE_BACK_BIT;
+    desc->frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    desc->blend = PIPELINE_BLEND_NONE;
+    desc->depthTest = VK_TRUE;
+    desc->depthWrite = VK_TRUE;
+    desc->depthCompare = VK_COMPARE_OP_LESS;
+    desc->subpass = 0;
+}
+
+uint64_t pipelineDescHash(const PipelineDesc* desc) {
+    // FNV-1a over the whole zero-initialized struct
+    const uint8_t* bytes = (const uint8_t*)desc;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(PipelineDesc); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint32_t histogramBucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    uint32_t bucket = 0;
+    while (us > 1 && bucket < PIPELINE_HISTOGRAM_BUCKETS - 1) {
+        us >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+static VkPipeline compilePipeline(const PipelineDesc* desc) {
+    bool depthOnly = desc->fragShader[0] == '\0';
+    assetfile vert, frag;
+    if (!asset_open(desc->vertShader, &vert) || (!depthOnly && !asset_open(desc->fragShader, &frag))) {
+        c_throw("can't find shader file");
+    }
+
+    // spir-v goes to the driver straight from the mapped view
+    VkShaderModule vertShaderModule = createShaderModule((shaderfile){ (const char*)vert.data, vert.size });
+    asset_close(&vert);
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    if (!depthOnly) {
+        fragShaderModule = createShaderModule((shaderfile){ (const char*)frag.data, frag.size });
+        asset_close(&frag);
+    }
+
+    VkSpecializationInfo specInfo = {
+        .mapEntryCount = desc->specEntryCount,
+        .pMapEntries = desc->specEntries,
+        .dataSize = desc->specDataSize,
+        .pData = desc->specData
+    };
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertShaderModule,
+            .pName = "main",
+            .pSpecializationInfo = desc->specEntryCount ? &specInfo : NULL
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragShaderModule,
+            .pName = "main",
+            .pSpecializationInfo = desc->specEntryCount ? &specInfo : NULL
+        }
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .vertexBindingDescriptionCount = desc->bindingCount,
+        .pVertexBindingDescriptions = desc->bindings,
+        .vertexAttributeDescriptionCount = desc->attributeCount,
+        .pVertexAttributeDescriptions = desc->attributes
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .topology = desc->topology,
+        .primitiveRestartEnable = VK_FALSE
+    };
+
+    // viewport and scissor are always dynamic
+    VkDynamicState dynamicStates[2] = {
+        VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates
+    };
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .viewportCount = 1,
+        .pViewports = NULL,
+        .scissorCount = 1,
+        .pScissors = NULL,
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = desc->polygonMode,
+        .cullMode = desc->cullMode,
+        .frontFace = desc->frontFace,
+        .depthBiasEnable = desc->depthBiasConstant != 0.0f || desc->depthBiasSlope != 0.0f,
+        .depthBiasConstantFactor = desc->depthBiasConstant,
+        .depthBiasClamp = 0.0f,
+        .depthBiasSlopeFactor = desc->depthBiasSlope,
+        .lineWidth = 1.0f
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .sampleShadingEnable = VK_FALSE,
+        .minSampleShading = 1.0f,
+        .pSampleMask = NULL,
+        .alphaToCoverageEnable = VK_FALSE,
+        .alphaToOneEnable = VK_FALSE
+    };
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
+        .blendEnable = desc->blend != PIPELINE_BLEND_NONE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+        VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+        VK_COLOR_COMPONENT_A_BIT
+    };
+    if (desc->blend == PIPELINE_BLEND_ADDITIVE) {
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    }
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .attachmentCount = depthOnly ? 0 : 1,
+        .pAttachments = &colorBlendAttachment,
+        .blendConstants = {0.0f,0.0f,0.0f,0.0f}
+    };
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .depthTestEnable = desc->depthTest,
+        .depthWriteEnable = desc->depthWrite,
+        .depthCompareOp = desc->depthCompare,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+        .front = {0,0,0,0,0,0,0},
+        .back = {0,0,0,0,0,0,0},
+        .minDepthBounds = 0.0f,
+        .maxDepthBounds = 1.0f
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .stageCount = depthOnly ? 1 : 2,
+        .pStages = shaderStages,
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssembly,
+        .pTessellationState = NULL,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depthStencil,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+        .layout = desc->layout,
+        .renderPass = desc->renderPass,
+        .subpass = desc->subpass,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateGraphicsPipelines(VULKAN.device, PIPELINES.vkCache, 1, &pipelineInfo, NULL, &pipeline) != VK_SUCCESS) {
+        pipeline = VK_NULL_HANDLE;
+    }
+
+    vkDestroyShaderModule(VULKAN.device, vertShaderModule, NULL);
+    if (!depthOnly) vkDestroyShaderModule(VULKAN.device, fragShaderModule, NULL);
+
+    return pipeline;
+}
+
+static void compileJob(void* arg) {
+    PipelineEntry* entry = arg;
+
+    TRACE_BEGIN("compilePipeline");
+    uint64_t start = getTimeInNanoseconds();
+    VkPipeline pipeline = compilePipeline(&entry->desc);
+    uint64_t elapsed = getTimeInNanoseconds() - start;
+    TRACE_END();
+
+    c_mutex_lock(&PIPELINES.lock);
+    entry->pipeline = pipeline;
+    --PIPELINES.stats.pending;
+    if (pipeline != VK_NULL_HANDLE) {
+        ++PIPELINES.stats.compiled;
+        PIPELINES.stats.compileTimeTotalNs += elapsed;
+        ++PIPELINES.stats.compileHistogram[histogramBucket(elapsed)];
+        c_atomic_store(&entry->state, PIPELINE_STATE_READY);
+    } else {
+        ++PIPELINES.stats.failed;
+        fprintf(stderr, "failed to create graphics pipeline (%s, %s)\n",
+            entry->desc.vertShader, entry->desc.fragShader);
+        c_atomic_store(&entry->state, PIPELINE_STATE_FAILED);
+    }
+    c_cond_broadcast(&PIPELINES.compiled);
+    c_mutex_unlock(&PIPELINES.lock);
+}
+
+void initPipelineCache() {
+    memset(&PIPELINES, 0, sizeof(PIPELINES));
+
+    VkPipelineCacheCreateInfo cacheInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .initialDataSize = 0,
+        .pInitialData = NULL
+    };
+    if (vkCreatePipelineCache(VULKAN.device, &cacheInfo, NULL, &PIPELINES.vkCache) != VK_SUCCESS) {
+        c_throw("failed to create pipeline cache");
+    }
+}
+
+void destroyPipelineCache() {
+    c_mutex_lock(&PIPELINES.lock);
+    while (PIPELINES.stats.pending) {
+        c_cond_wait(&PIPELINES.compiled, &PIPELINES.lock);
+    }
+    c_mutex_unlock(&PIPELINES.lock);
+
+    for (uint32_t i = 0; i < PIPELINES.count; ++i) {
+        if (PIPELINES.entries[i].pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(VULKAN.device, PIPELINES.entries[i].pipeline, NULL);
+        }
+    }
+    vkDestroyPipelineCache(VULKAN.device, PIPELINES.vkCache, NULL);
+    PIPELINES.count = 0;
+}
+
+PipelineHandle requestPipeline(const PipelineDesc* desc, PipelineHandle fallback) {
+    uint64_t hash = pipelineDescHash(desc);
+
+    c_mutex_lock(&PIPELINES.lock);
+    ++PIPELINES.stats.requests;
+
+    uint32_t slot = (uint32_t)(hash % PIPELINE_SLOTS);
+    while (PIPELINES.slots[slot]) {
+        PipelineEntry* entry = PIPELINES.entries + PIPELINES.slots[slot] - 1;
+        if (entry->hash == hash && memcmp(&entry->desc, desc, sizeof(PipelineDesc)) == 0) {
+            ++PIPELINES.stats.hits;
+            c_mutex_unlock(&PIPELINES.lock);
+            return PIPELINES.slots[slot] - 1;
+        }
+        slot = (slot + 1) % PIPELINE_SLOTS;
+    }
+
+    if (PIPELINES.count == PIPELINE_CACHE_CAPACITY) {
+        c_throw("pipeline cache is full");
+    }
+
+    PipelineHandle handle = PIPELINES.count++;
+    PipelineEntry* entry = PIPELINES.entries + handle;
+    entry->desc = *desc;
+    entry->hash = hash;
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->fallback = fallback;
+    entry->state = PIPELINE_STATE_PENDING;
+    PIPELINES.slots[slot] = handle + 1;
+
+    ++PIPELINES.stats.misses;
+    ++PIPELINES.stats.pending;
+    c_mutex_unlock(&PIPELINES.lock);
+
+    tp_submit(compileJob, entry);
+    return handle;
+}
+
+VkPipeline getPipeline(PipelineHandle handle) {
+    if (handle == PIPELINE_HANDLE_NONE || handle >= PIPELINE_CACHE_CAPACITY) return VK_NULL_HANDLE;
+
+    PipelineEntry* entry = PIPELINES.entries + handle;
+    if (c_atomic_load(&entry->state) == PIPELINE_STATE_READY) {
+        return entry->pipeline;
+    }
+
+    if (entry->fallback != PIPELINE_HANDLE_NONE) {
+        PipelineEntry* fallback = PIPELINES.entries + entry->fallback;
+        if (c_atomic_load(&fallback->state) == PIPELINE_STATE_READY) {
+            return fallback->pipeline;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+void waitPipeline(PipelineHandle handle) {
+    if (handle == PIPELINE_HANDLE_NONE) return;
+
+    PipelineEntry* entry = PIPELINES.entries + handle;
+    c_mutex_lock(&PIPELINES.lock);
+    while (c_atomic_load(&entry->state) == PIPELINE_STATE_PENDING) {
+        c_cond_wait(&PIPELINES.compiled, &PIPELINES.lock);
+    }
+    c_mutex_unlock(&PIPELINES.lock);
+}
+
+PipelineCacheStats getPipelineCacheStats() {
+    c_mutex_lock(&PIPELINES.lock);
+    PipelineCacheStats stats = PIPELINES.stats;
+    c_mutex_unlock(&PIPELINES.lock);
+    return stats;
+}
+
+void printPipelineCacheStats() {
+    PipelineCacheStats stats = getPipelineCacheStats();
+
+    printf("pipelines: %llu requests, %llu hits (%.1f%%), %u compiled, %u failed, %u pending\n",
+        (unsigned long long)stats.requests, (unsigned long long)stats.hits,
+        stats.requests ? 100.0 * (double)stats.hits / (double)stats.requests : 0.0,
+        stats.compiled, stats.failed, stats.pending);
+    if (stats.compiled) {
+        printf("  average compile %.3f ms\n", (double)stats.compileTimeTotalNs / stats.compiled / 1e6);
+    }
+    for (uint32_t i = 0; i < PIPELINE_HISTOGRAM_BUCKETS; ++i) {
+        if (stats.compileHistogram[i]) {
+            printf("  %6u - %6u us: %u\n", i ? 1u << i : 0u, 1u << (i + 1), stats.compileHistogram[i]);
+        }
+    }
+}
+
+VkPipeline createComputePipeline(const char* shader, VkPipelineLayout layout) {
+    assetfile comp;
+    if (!asset_open(shader, &comp)) {
+        c_throw("can't find shader file");
+    }
+    VkShaderModule module = createShaderModule((shaderfile){ (const char*)comp.data, comp.size });
+    asset_close(&comp);
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+            .pSpecializationInfo = NULL
+        },
+        .layout = layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(VULKAN.device, PIPELINES.vkCache, 1, &pipelineInfo, NULL, &pipeline) != VK_SUCCESS) {
+        c_throw("failed to create compute pipeline");
+    }
+    vkDestroyShaderModule(VULKAN.device, module, NULL);
+    return pipeline;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+#define PIPELINE_MAX_BINDINGS 4
+#define PIPELINE_MAX_ATTRIBUTES 16
+#define PIPELINE_MAX_SPEC_ENTRIES 8
+#define PIPELINE_MAX_SPEC_DATA 64
+#define PIPELINE_SHADER_PATH 64
+
+#define PIPELINE_CACHE_CAPACITY 256
+#define PIPELINE_HISTOGRAM_BUCKETS 16
+
+typedef uint32_t PipelineHandle;
+#define PIPELINE_HANDLE_NONE UINT32_MAX
+
+typedef enum PipelineBlendMode {
+    PIPELINE_BLEND_NONE,
+    PIPELINE_BLEND_ALPHA,
+    PIPELINE_BLEND_ADDITIVE
+} PipelineBlendMode;
+
+/*
+ * Everything that makes two pipelines different. Always start from
+ * pipelineDescDefault() - the struct is hashed as raw bytes, so padding
+ * and unused array slots must stay zeroed. An empty fragShader makes a
+ * depth only pipeline, for render passes without a color attachment.
+ */
+typedef struct PipelineDesc {
+    char vertShader[PIPELINE_SHADER_PATH];
+    char fragShader[PIPELINE_SHADER_PATH];
+
+    VkVertexInputBindingDescription bindings[PIPELINE_MAX_BINDINGS];
+    VkVertexInputAttributeDescription attributes[PIPELINE_MAX_ATTRIBUTES];
+    uint32_t bindingCount, attributeCount;
+
+    VkPrimitiveTopology topology;
+    VkPolygonMode polygonMode;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    PipelineBlendMode blend;
+
+    VkBool32 depthTest, depthWrite;
+    VkCompareOp depthCompare;
+    /* depth bias is on when either is non-zero */
+    float depthBiasConstant, depthBiasSlope;
+
+    VkRenderPass renderPass;
+    uint32_t subpass;
+    VkPipelineLayout layout;
+
+    VkSpecializationMapEntry specEntries[PIPELINE_MAX_SPEC_ENTRIES];
+    uint32_t specEntryCount;
+    uint8_t specData[PIPELINE_MAX_SPEC_DATA];
+    uint32_t specDataSize;
+} PipelineDesc;
+
+typedef struct PipelineCacheStats {
+    uint64_t requests, hits, misses;
+    uint32_t compiled, failed, pending;
+    uint64_t compileTimeTotalNs;
+    /* bucket i counts compiles that took [2^i, 2^(i+1)) microseconds */
+    uint32_t compileHistogram[PIPELINE_HISTOGRAM_BUCKETS];
+} PipelineCacheStats;
+
+void pipelineDescDefault(PipelineDesc* desc);
+uint64_t pipelineDescHash(const PipelineDesc* desc);
+
+void initPipelineCache();
+void destroyPipelineCache();
+
+/*
+ * Returns the handle for desc, compiling it on a worker thread on a miss.
+ * Until that compile finishes getPipeline() hands out the fallback pipeline,
+ * or VK_NULL_HANDLE if fallback is PIPELINE_HANDLE_NONE (caller skips the draw).
+ */
+PipelineHandle requestPipeline(const PipelineDesc* desc, PipelineHandle fallback);
+VkPipeline getPipeline(PipelineHandle handle);
+void waitPipeline(PipelineHandle handle);
+
+PipelineCacheStats getPipelineCacheStats();
+void printPipelineCacheStats();
+
+/* compute pipelines are few and built once, so they skip the table and compile right away */
+VkPipeline createComputePipeline(const char* shader, VkPipelineLayout layout);
@@ -0,0 +1,738 @@
+#include "post.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "resolution.h"
+#include "overdraw.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+#define BLOOM_GROUP_SIZE 8
+#define POST_FRAME_QUERIES (POST_PASS_COUNT + 1)
+/* bytes of a texel in the scene target, the bloom chain and the output */
+#define POST_TEXEL_BYTES 8.0
+
+/* match bloom_down.comp and bloom_up.comp */
+#define BLOOM_FIRST 1u
+#define BLOOM_TILED 2u
+
+typedef struct BloomParams {
+    /* only for the first level down, which samples the rendered rectangle of the scene */
+    float uvScale[2];
+    float uvMax[2];
+    int32_t sourceSize[2];
+    int32_t destSize[2];
+    uint32_t flags;
+} BloomParams;
+
+static struct POST {
+    VkSampler sampler;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkPipeline downPipeline, upPipeline;
+
+    VkImage lut;
+    VkDeviceMemory lutMemory;
+    VkImageView lutView;
+    uint32_t lutSize;
+    bool lutLoaded;
+
+    VkImage bloom;
+    VkDeviceMemory bloomMemory;
+    VkImageView levelViews[POST_BLOOM_LEVELS];
+    VkExtent2D levelSizes[POST_BLOOM_LEVELS];
+    uint32_t levelCount;
+    VkDescriptorPool pool;
+    /* down[i] writes level i, up[i] adds level i into level i - 1 */
+    VkDescriptorSet downSets[POST_BLOOM_LEVELS], upSets[POST_BLOOM_LEVELS];
+
+    VkQueryPool queries;
+    bool timestamps;
+    uint64_t validMask;
+    double timestampPeriod;
+    bool* queriesPending;
+    uint32_t* passesRecorded;
+    double* frameBytes;
+
+    PostStats stats;
+} POST;
+
+static uint8_t unorm(float value) {
+    if (value < 0.0f) value = 0.0f;
+    if (value > 1.0f) value = 1.0f;
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+// .cube as Resolve and most grading tools write it, red changes fastest like x in a 3D image
+static uint8_t* loadCube(const char* path, uint32_t* size) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "post: can't open %s, using the built in lut\n", path);
+        return NULL;
+    }
+
+    uint8_t* texels = NULL;
+    uint32_t count = 0, expected = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned int edge;
+        float r, g, b;
+        if (sscanf(line, "LUT_3D_SIZE %u", &edge) == 1) {
+            if (texels || edge < 2 || edge > POST_LUT_MAX_SIZE) break;
+            *size = edge;
+            expected = edge * edge * edge;
+            texels = malloc((size_t)expected * 4);
+        } else if (texels && count < expected && sscanf(line, "%f %f %f", &r, &g, &b) == 3) {
+            uint8_t* texel = texels + (size_t)count++ * 4;
+            texel[0] = unorm(r);
+            texel[1] = unorm(g);
+            texel[2] = unorm(b);
+            texel[3] = 255;
+        }
+    }
+    fclose(file);
+
+    if (!texels || count != expected) {
+        fprintf(stderr, "post: %s isn't a 3D .cube lut up to %u, using the built in one\n", path, POST_LUT_MAX_SIZE);
+        free(texels);
+        return NULL;
+    }
+    return texels;
+}
+
+// a mild look so the stage does something visible: a touch of contrast and saturation, slightly warm
+static uint8_t* builtInLut(uint32_t* size) {
+    *size = POST_LUT_SIZE;
+    uint8_t* texels = malloc((size_t)POST_LUT_SIZE * POST_LUT_SIZE * POST_LUT_SIZE * 4);
+    const float warmth[3] = { 1.02f, 1.0f, 0.97f };
+    for (uint32_t b = 0; b < POST_LUT_SIZE; ++b) {
+        for (uint32_t g = 0; g < POST_LUT_SIZE; ++g) {
+            for (uint32_t r = 0; r < POST_LUT_SIZE; ++r) {
+                float color[3] = {
+                    (float)r / (POST_LUT_SIZE - 1), (float)g / (POST_LUT_SIZE - 1), (float)b / (POST_LUT_SIZE - 1)
+                };
+                for (uint32_t c = 0; c < 3; ++c) {
+                    float s = color[c] * color[c] * (3.0f - 2.0f * color[c]);
+                    color[c] = color[c] + (s - color[c]) * 0.25f;
+                }
+                float luma = color[0] * 0.2126f + color[1] * 0.7152f + color[2] * 0.0722f;
+                uint8_t* texel = texels + ((size_t)(b * POST_LUT_SIZE + g) * POST_LUT_SIZE + r) * 4;
+                for (uint32_t c = 0; c < 3; ++c) {
+                    float graded = (luma + (color[c] - luma) * 1.1f) * warmth[c];
+                    texel[c] = unorm(graded);
+                }
+                texel[3] = 255;
+            }
+        }
+    }
+    return texels;
+}
+
+static void createLut() {
+    uint8_t* texels = NULL;
+    if (SETTINGS.lutPath) texels = loadCube(SETTINGS.lutPath, &POST.lutSize);
+    POST.lutLoaded = texels != NULL;
+    if (!texels) texels = builtInLut(&POST.lutSize);
+    uint32_t edge = POST.lutSize;
+    VkDeviceSize bytes = (VkDeviceSize)edge * edge * edge * 4;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, &stagingBuffer, &stagingBufferMemory);
+    void* data;
+    vkMapMemory(VULKAN.device, stagingBufferMemory, 0, bytes, 0, &data);
+    memcpy(data, texels, (size_t)bytes);
+    vkUnmapMemory(VULKAN.device, stagingBufferMemory);
+    free(texels);
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_3D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { edge, edge, edge },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (vkCreateImage(VULKAN.device, &imageInfo, NULL, &POST.lut) != VK_SUCCESS) {
+        c_throw("failed to create grading lut");
+    }
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(VULKAN.device, POST.lut, &memReq);
+    uint32_t memoryType = findMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!allocateDeviceMemory(memReq.size, memoryType, MEMORY_CATEGORY_TEXTURE, &POST.lutMemory)) {
+        c_throw("failed to alloc grading lut memory");
+    }
+    vkBindImageMemory(VULKAN.device, POST.lut, POST.lutMemory, 0);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = POST.lut,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &barrier);
+
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { edge, edge, edge }
+    };
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, POST.lut, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, NULL, 0, NULL, 1, &barrier);
+    endSingleTimeCommands(commandBuffer);
+
+    vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
+    freeDeviceMemory(stagingBufferMemory);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = POST.lut,
+        .viewType = VK_IMAGE_VIEW_TYPE_3D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .components = {
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = barrier.subresourceRange
+    };
+    if (vkCreateImageView(VULKAN.device, &viewInfo, NULL, &POST.lutView) != VK_SUCCESS) {
+        c_throw("failed to create grading lut view");
+    }
+}
+
+static void createLayouts() {
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        }
+    };
+    VkDescriptorSetLayoutCreateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 2,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &setInfo, NULL, &POST.setLayout) != VK_SUCCESS) {
+        c_throw("failed to create bloom descriptor set layout");
+    }
+
+    VkPushConstantRange push = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(BloomParams)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &POST.setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &POST.layout) != VK_SUCCESS) {
+        c_throw("failed to create bloom pipeline layout");
+    }
+}
+
+static void createQueries() {
+    VkQueueFamilyProperties* families;
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, NULL);
+    families = malloc(sizeof(VkQueueFamilyProperties) * familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, families);
+    uint32_t validBits = families[VULKAN.queueFamilies.graphicsFamily].timestampValidBits;
+    free(families);
+
+    POST.timestamps = validBits > 0;
+    POST.queriesPending = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(bool));
+    POST.passesRecorded = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(uint32_t));
+    POST.frameBytes = calloc(MAX_FRAMES_IN_FLIGHT * POST_PASS_COUNT, sizeof(double));
+    if (!POST.timestamps) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(VULKAN.physicalDevice, &properties);
+    POST.validMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    POST.timestampPeriod = (double)properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MAX_FRAMES_IN_FLIGHT * POST_FRAME_QUERIES,
+        .pipelineStatistics = 0
+    };
+    if (vkCreateQueryPool(VULKAN.device, &poolInfo, NULL, &POST.queries) != VK_SUCCESS) {
+        c_throw("failed to create post timestamp query pool");
+    }
+}
+
+void createPostResources() {
+    createLayouts();
+    POST.downPipeline = createComputePipeline("shaders/bloom_down.spv", POST.layout);
+    POST.upPipeline = createComputePipeline("shaders/bloom_up.spv", POST.layout);
+    createQueries();
+    createLut();
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &POST.sampler) != VK_SUCCESS) {
+        c_throw("failed to create bloom sampler");
+    }
+}
+
+void destroyPostResources() {
+    vkDestroyPipeline(VULKAN.device, POST.downPipeline, NULL);
+    vkDestroyPipeline(VULKAN.device, POST.upPipeline, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, POST.layout, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, POST.setLayout, NULL);
+    vkDestroySampler(VULKAN.device, POST.sampler, NULL);
+
+    vkDestroyImageView(VULKAN.device, POST.lutView, NULL);
+    vkDestroyImage(VULKAN.device, POST.lut, NULL);
+    freeDeviceMemory(POST.lutMemory);
+
+    if (POST.timestamps) vkDestroyQueryPool(VULKAN.device, POST.queries, NULL);
+    free(POST.queriesPending);
+    free(POST.passesRecorded);
+    free(POST.frameBytes);
+}
+
+static void writeBloomSet(VkDescriptorSet set, VkImageView source, VkImageLayout sourceLayout, VkImageView dest) {
+    VkDescriptorImageInfo images[] = {
+        {
+            .sampler = POST.sampler,
+            .imageView = source,
+            .imageLayout = sourceLayout
+        },
+        {
+            .sampler = VK_NULL_HANDLE,
+            .imageView = dest,
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        }
+    };
+    VkWriteDescriptorSet writes[2];
+    for (uint32_t b = 0; b < 2; ++b) {
+        writes[b] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = NULL,
+            .dstSet = set,
+            .dstBinding = b,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo = images + b,
+            .pBufferInfo = NULL,
+            .pTexelBufferView = NULL
+        };
+    }
+    vkUpdateDescriptorSets(VULKAN.device, 2, writes, 0, NULL);
+}
+
+void createPostTargets() {
+    uint32_t width = VULKAN.swapchainExtent.width / 2, height = VULKAN.swapchainExtent.height / 2;
+    if (width == 0) width = 1;
+    if (height == 0) height = 1;
+    POST.levelCount = 0;
+    while (POST.levelCount < POST_BLOOM_LEVELS) {
+        POST.levelSizes[POST.levelCount++] = (VkExtent2D){ width, height };
+        if (width == 1 && height == 1) break;
+        // the same rounding as the image's mip chain
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    POST.stats.bloomLevels = POST.levelCount;
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = POST_BLOOM_FORMAT,
+        .extent = { POST.levelSizes[0].width, POST.levelSizes[0].height, 1 },
+        .mipLevels = POST.levelCount,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (vkCreateImage(VULKAN.device, &imageInfo, NULL, &POST.bloom) != VK_SUCCESS) {
+        c_throw("failed to create bloom chain");
+    }
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(VULKAN.device, POST.bloom, &memReq);
+    uint32_t memoryType = findMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!allocateDeviceMemory(memReq.size, memoryType, MEMORY_CATEGORY_ATTACHMENT, &POST.bloomMemory)) {
+        c_throw("failed to alloc bloom chain memory");
+    }
+    vkBindImageMemory(VULKAN.device, POST.bloom, POST.bloomMemory, 0);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = POST.bloom,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = POST_BLOOM_FORMAT,
+        .components = {
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    for (uint32_t i = 0; i < POST.levelCount; ++i) {
+        viewInfo.subresourceRange.baseMipLevel = i;
+        if (vkCreateImageView(VULKAN.device, &viewInfo, NULL, POST.levelViews + i) != VK_SUCCESS) {
+            c_throw("failed to create bloom level view");
+        }
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = POST.levelCount * 2
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = POST.levelCount * 2
+        }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = POST.levelCount * 2,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &POST.pool) != VK_SUCCESS) {
+        c_throw("failed to create bloom descriptor pool");
+    }
+
+    VkDescriptorSetLayout layouts[POST_BLOOM_LEVELS * 2];
+    for (uint32_t i = 0; i < POST.levelCount * 2; ++i) layouts[i] = POST.setLayout;
+    VkDescriptorSet sets[POST_BLOOM_LEVELS * 2];
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = POST.pool,
+        .descriptorSetCount = POST.levelCount * 2 - 1,
+        .pSetLayouts = layouts
+    };
+    if (vkAllocateDescriptorSets(VULKAN.device, &setInfo, sets) != VK_SUCCESS) {
+        c_throw("failed to allocate bloom descriptor sets");
+    }
+    for (uint32_t i = 0; i < POST.levelCount; ++i) {
+        POST.downSets[i] = sets[i];
+        if (i == 0) {
+            writeBloomSet(POST.downSets[i], renderTargetView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                POST.levelViews[i]);
+        } else {
+            writeBloomSet(POST.downSets[i], POST.levelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL, POST.levelViews[i]);
+            POST.upSets[i] = sets[POST.levelCount + i - 1];
+            writeBloomSet(POST.upSets[i], POST.levelViews[i], VK_IMAGE_LAYOUT_GENERAL, POST.levelViews[i - 1]);
+        }
+    }
+}
+
+void destroyPostTargets() {
+    vkDestroyDescriptorPool(VULKAN.device, POST.pool, NULL);
+    for (uint32_t i = 0; i < POST.levelCount; ++i) {
+        vkDestroyImageView(VULKAN.device, POST.levelViews[i], NULL);
+    }
+    vkDestroyImage(VULKAN.device, POST.bloom, NULL);
+    freeDeviceMemory(POST.bloomMemory);
+}
+
+VkImageView postBloomView() {
+    return POST.levelViews[0];
+}
+
+VkImageView postLutView() {
+    return POST.lutView;
+}
+
+bool postNaive() {
+    return SETTINGS.postNaive && !overdrawReady();
+}
+
+uint32_t postCompositeStages() {
+    // the heatmap already is display colors
+    if (overdrawReady()) return POST_STAGE_UPSCALE;
+
+    uint32_t stages = POST_STAGE_UPSCALE;
+    if (SETTINGS.bloomStrength > 0.0f) stages |= POST_STAGE_BLOOM;
+    if (!SETTINGS.postNaive) stages |= POST_STAGE_TONEMAP | POST_STAGE_GRADE;
+    return stages;
+}
+
+static double texels(VkExtent2D extent) {
+    return (double)extent.width * (double)extent.height;
+}
+
+static double passBytes(PostPass pass) {
+    bool bloom = postCompositeStages() & POST_STAGE_BLOOM;
+    double output = texels(VULKAN.swapchainExtent) * POST_TEXEL_BYTES;
+    double lut = (double)POST.lutSize * POST.lutSize * POST.lutSize * 4.0;
+    double bytes = 0.0;
+    switch (pass) {
+    case POST_PASS_BLOOM_DOWN:
+        if (!bloom) return 0.0;
+        bytes = texels(VULKAN.renderExtent) * POST_TEXEL_BYTES;
+        for (uint32_t i = 0; i < POST.levelCount; ++i) {
+            bytes += texels(POST.levelSizes[i]) * POST_TEXEL_BYTES * (i + 1 < POST.levelCount ? 2.0 : 1.0);
+        }
+        return bytes;
+    case POST_PASS_BLOOM_UP:
+        if (!bloom) return 0.0;
+        // every level but the last is read and written back, every level but the first is read once
+        for (uint32_t i = 1; i < POST.levelCount; ++i) {
+            bytes += (texels(POST.levelSizes[i]) + texels(POST.levelSizes[i - 1]) * 2.0) * POST_TEXEL_BYTES;
+        }
+        return bytes;
+    case POST_PASS_COMPOSITE: {
+        uint32_t stages = postCompositeStages();
+        bytes = texels(VULKAN.renderExtent) * POST_TEXEL_BYTES + output;
+        if (stages & POST_STAGE_BLOOM) bytes += texels(POST.levelSizes[0]) * POST_TEXEL_BYTES;
+        if (stages & POST_STAGE_GRADE) bytes += lut;
+        return bytes;
+    }
+    case POST_PASS_TONEMAP:
+        return output * 2.0;
+    case POST_PASS_GRADE:
+        return output * 2.0 + lut;
+    default:
+        return 0.0;
+    }
+}
+
+static void levelBarrier(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+void recordBloom(VkCommandBuffer commandBuffer, uint32_t frame, const float uvScale[2], const float uvMax[2]) {
+    POST.passesRecorded[frame] = 0;
+    if (POST.timestamps) {
+        uint32_t firstQuery = frame * POST_FRAME_QUERIES;
+        vkCmdResetQueryPool(commandBuffer, POST.queries, firstQuery, POST_FRAME_QUERIES);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, POST.queries, firstQuery);
+    }
+
+    bool bloom = postCompositeStages() & POST_STAGE_BLOOM;
+    uint32_t tiled = SETTINGS.postNaive ? 0 : BLOOM_TILED;
+    if (bloom) {
+        // the chain is rebuilt from scratch every frame, the last frame's composite only has to be done reading it
+        VkImageMemoryBarrier toGeneral = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = POST.bloom,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = POST.levelCount,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, NULL, 0, NULL, 1, &toGeneral);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, POST.downPipeline);
+        for (uint32_t i = 0; i < POST.levelCount; ++i) {
+            VkExtent2D source = i == 0 ? VULKAN.renderExtent : POST.levelSizes[i - 1];
+            VkExtent2D dest = POST.levelSizes[i];
+            BloomParams params = {
+                .uvScale = { uvScale[0], uvScale[1] },
+                .uvMax = { uvMax[0], uvMax[1] },
+                .sourceSize = { (int32_t)source.width, (int32_t)source.height },
+                .destSize = { (int32_t)dest.width, (int32_t)dest.height },
+                .flags = (i == 0 ? BLOOM_FIRST : 0) | tiled
+            };
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, POST.layout,
+                0, 1, POST.downSets + i, 0, NULL);
+            vkCmdPushConstants(commandBuffer, POST.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+            vkCmdDispatch(commandBuffer, (dest.width + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE,
+                (dest.height + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, 1);
+            levelBarrier(commandBuffer);
+        }
+    }
+    postPassDone(commandBuffer, frame, POST_PASS_BLOOM_DOWN);
+
+    if (bloom) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, POST.upPipeline);
+        for (uint32_t i = POST.levelCount - 1; i > 0; --i) {
+            VkExtent2D source = POST.levelSizes[i];
+            VkExtent2D dest = POST.levelSizes[i - 1];
+            BloomParams params = {
+                .uvScale = { 1.0f, 1.0f },
+                .uvMax = { 1.0f, 1.0f },
+                .sourceSize = { (int32_t)source.width, (int32_t)source.height },
+                .destSize = { (int32_t)dest.width, (int32_t)dest.height },
+                .flags = tiled
+            };
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, POST.layout,
+                0, 1, POST.upSets + i, 0, NULL);
+            vkCmdPushConstants(commandBuffer, POST.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+            vkCmdDispatch(commandBuffer, (dest.width + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE,
+                (dest.height + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, 1);
+            levelBarrier(commandBuffer);
+        }
+    }
+    postPassDone(commandBuffer, frame, POST_PASS_BLOOM_UP);
+}
+
+void postPassDone(VkCommandBuffer commandBuffer, uint32_t frame, PostPass pass) {
+    POST.frameBytes[frame * POST_PASS_COUNT + pass] = passBytes(pass);
+    POST.passesRecorded[frame] = pass + 1;
+    if (!POST.timestamps) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, POST.queries,
+        frame * POST_FRAME_QUERIES + pass + 1);
+    POST.queriesPending[frame] = true;
+}
+
+void collectPostStats(uint32_t frame) {
+    if (!POST.queriesPending[frame]) return;
+    POST.queriesPending[frame] = false;
+
+    // the passes are recorded in order, so the written queries are always the first ones
+    uint32_t passes = POST.passesRecorded[frame];
+    uint64_t results[POST_FRAME_QUERIES];
+    if (vkGetQueryPoolResults(VULKAN.device, POST.queries, frame * POST_FRAME_QUERIES, passes + 1,
+        sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    for (uint32_t p = 0; p < passes; ++p) {
+        uint64_t ticks = (results[p + 1] - results[p]) & POST.validMask;
+        PostPassStats* stats = POST.stats.passes + p;
+        ++stats->frames;
+        stats->msTotal += (double)ticks * POST.timestampPeriod / 1e6;
+        stats->bytesTotal += POST.frameBytes[frame * POST_PASS_COUNT + p];
+    }
+}
+
+PostStats getPostStats() {
+    return POST.stats;
+}
+
+void printPostStats() {
+    static const char* names[POST_PASS_COUNT] = { "bloom down", "bloom up", "composite", "tonemap", "grade" };
+    printf("post: %s stack, exposure %+.1f ev, bloom %.2f over %u levels, %s lut of %u\n",
+        SETTINGS.postNaive ? "naive" : "fused", SETTINGS.exposure, SETTINGS.bloomStrength, POST.stats.bloomLevels,
+        POST.lutLoaded ? SETTINGS.lutPath : "built in", POST.lutSize);
+    if (!POST.timestamps) {
+        printf("\tno timestamps on this queue, nothing measured\n");
+        return;
+    }
+
+    double totalMs = 0.0, totalBytes = 0.0;
+    for (uint32_t p = 0; p < POST_PASS_COUNT; ++p) {
+        const PostPassStats* stats = POST.stats.passes + p;
+        if (!stats->frames) continue;
+        double ms = stats->msTotal / (double)stats->frames;
+        double bytes = stats->bytesTotal / (double)stats->frames;
+        totalMs += ms;
+        totalBytes += bytes;
+        printf("\t%-10s %.3f ms, %.1f MB, %.1f GB/s\n", names[p], ms, bytes / 1e6, ms > 0.0 ? bytes / ms / 1e6 : 0.0);
+    }
+    printf("\t%-10s %.3f ms, %.1f MB a frame\n", "all", totalMs, totalBytes / 1e6);
+}
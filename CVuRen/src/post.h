@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define POST_BLOOM_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+/* the first level is half the output, every next one half of that */
+#define POST_BLOOM_LEVELS 6
+/* edge of the built in grading lut, a .cube file brings its own */
+#define POST_LUT_SIZE 32
+#define POST_LUT_MAX_SIZE 64
+
+/* what one dispatch of upscale.comp does, the fused stack sets them all at once */
+#define POST_STAGE_UPSCALE 1u
+#define POST_STAGE_BLOOM 2u
+#define POST_STAGE_TONEMAP 4u
+#define POST_STAGE_GRADE 8u
+
+typedef enum PostPass {
+    POST_PASS_BLOOM_DOWN,
+    POST_PASS_BLOOM_UP,
+    POST_PASS_COMPOSITE,
+    /* only recorded by the naive stack */
+    POST_PASS_TONEMAP,
+    POST_PASS_GRADE,
+    POST_PASS_COUNT
+} PostPass;
+
+typedef struct PostPassStats {
+    uint64_t frames;
+    double msTotal;
+    /* every image byte the pass reads or writes once, what it costs in memory traffic at best */
+    double bytesTotal;
+} PostPassStats;
+
+typedef struct PostStats {
+    PostPassStats passes[POST_PASS_COUNT];
+    uint32_t bloomLevels;
+} PostStats;
+
+/*
+ * HDR post processing. The scene renders into a float target and the
+ * upscale pass of resolution.c doubles as the composite: in one dispatch it
+ * resamples the scene, adds bloom, applies exposure and the ACES fit and
+ * looks the result up in a 3D grading lut, so the full resolution image is
+ * written exactly once.
+ *
+ * Bloom runs before it on a chain of half resolution levels: every level
+ * down is a 4x4 tent over the one above, staged through shared memory so a
+ * workgroup fetches its footprint once instead of sixteen times per texel,
+ * and every level up adds a tent filtered copy of the one below. With
+ * SETTINGS.postNaive the same work runs the obvious way for comparison: the
+ * bloom filters fetch straight from the textures and tonemapping and
+ * grading are passes of their own over the output. Each pass is timed and
+ * charged the image bytes it touches, printPostStats shows both side by side.
+ */
+void createPostResources();
+void destroyPostResources();
+
+/* the bloom chain, sized after the swapchain; the scene target has to exist already */
+void createPostTargets();
+void destroyPostTargets();
+
+/* level 0 of the bloom chain, in GENERAL */
+VkImageView postBloomView();
+VkImageView postLutView();
+
+/* the stages the composite dispatch does itself */
+uint32_t postCompositeStages();
+bool postNaive();
+
+/* resets the frame's queries and records the bloom chain, uv maps the output to the rendered rectangle */
+void recordBloom(VkCommandBuffer commandBuffer, uint32_t frame, const float uvScale[2], const float uvMax[2]);
+/* timestamps the end of a pass, in the order of PostPass */
+void postPassDone(VkCommandBuffer commandBuffer, uint32_t frame, PostPass pass);
+
+/* call after the frame's fence wait */
+void collectPostStats(uint32_t frame);
+PostStats getPostStats();
+void printPostStats();
@@ -0,0 +1,217 @@
+#include "regress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <direct.h>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "window.h"
+#include "vkthings.h"
+#include "vkcontext.h"
+#include "capture.h"
+#include "settings.h"
+#include "simulation.h"
+
+#include "utils/utils.h"
+
+#define MAX_BASELINES 32
+#define BASELINE_NAME 32
+
+typedef struct Baseline {
+	char name[BASELINE_NAME];
+	double ms;
+} Baseline;
+
+static struct REGRESS {
+	Baseline baselines[MAX_BASELINES];
+	uint32_t baselineCount;
+	bool baselinesChanged;
+
+	uint8_t* image;
+	uint32_t width, height;
+
+	uint32_t failures;
+} REGRESS;
+
+static void loadBaselines() {
+	FILE* file = fopen(REGRESS_BASELINES, "r");
+	if (!file) return;
+
+	char line[128];
+	while (fgets(line, sizeof(line), file) && REGRESS.baselineCount < MAX_BASELINES) {
+		if (line[0] == '#') continue;
+		Baseline* baseline = REGRESS.baselines + REGRESS.baselineCount;
+		if (sscanf(line, "%31s %lf", baseline->name, &baseline->ms) == 2) ++REGRESS.baselineCount;
+	}
+	fclose(file);
+}
+
+static void saveBaselines() {
+	FILE* file = fopen(REGRESS_BASELINES, "w");
+	if (!file) {
+		fprintf(stderr, "regress: can't write %s\n", REGRESS_BASELINES);
+		return;
+	}
+	fprintf(file, "# name milliseconds\n");
+	for (uint32_t i = 0; i < REGRESS.baselineCount; ++i) {
+		fprintf(file, "%s %.4f\n", REGRESS.baselines[i].name, REGRESS.baselines[i].ms);
+	}
+	fclose(file);
+}
+
+static void checkTiming(const char* name, double ms) {
+	Baseline* baseline = NULL;
+	for (uint32_t i = 0; i < REGRESS.baselineCount; ++i) {
+		if (strcmp(REGRESS.baselines[i].name, name) == 0) baseline = REGRESS.baselines + i;
+	}
+
+	if (!baseline && !SETTINGS.regressUpdate) {
+		printf("\t%s: %.3f ms, no baseline in %s - FAILED\n", name, ms, REGRESS_BASELINES);
+		++REGRESS.failures;
+		return;
+	}
+	if (SETTINGS.regressUpdate) {
+		if (!baseline) {
+			if (REGRESS.baselineCount == MAX_BASELINES) return;
+			baseline = REGRESS.baselines + REGRESS.baselineCount++;
+			snprintf(baseline->name, BASELINE_NAME, "%s", name);
+		}
+		baseline->ms = ms;
+		REGRESS.baselinesChanged = true;
+		printf("\t%s: %.3f ms recorded as the baseline\n", name, ms);
+		return;
+	}
+
+	double limit = baseline->ms * (1.0 + SETTINGS.regressSlack);
+	bool ok = ms <= limit;
+	printf("\t%s: %.3f ms, baseline %.3f ms, limit %.3f ms - %s\n", name, ms, baseline->ms, limit, ok ? "ok" : "FAILED");
+	if (!ok) ++REGRESS.failures;
+}
+
+static void captureSink(const CaptureImage* image, void* userData) {
+	size_t size = (size_t)image->width * image->height * 4;
+	REGRESS.image = realloc(REGRESS.image, size);
+	memcpy(REGRESS.image, image->pixels, size);
+	REGRESS.width = image->width;
+	REGRESS.height = image->height;
+}
+
+static void checkImage(const char* scene) {
+	if (!REGRESS.image) {
+		printf("\timage: nothing captured - FAILED\n");
+		++REGRESS.failures;
+		return;
+	}
+
+	char path[96];
+	snprintf(path, sizeof(path), REGRESS_DIRECTORY "/%s.png", scene);
+
+	if (SETTINGS.regressUpdate) {
+		if (stbi_write_png(path, (int)REGRESS.width, (int)REGRESS.height, 4, REGRESS.image, (int)REGRESS.width * 4)) {
+			printf("\timage: recorded as %s\n", path);
+		} else {
+			fprintf(stderr, "regress: can't write %s\n", path);
+			++REGRESS.failures;
+		}
+		return;
+	}
+
+	int width = 0, height = 0, channels = 0;
+	stbi_uc* golden = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
+	if (!golden) {
+		printf("\timage: no golden at %s - FAILED\n", path);
+		++REGRESS.failures;
+		return;
+	}
+
+	if ((uint32_t)width != REGRESS.width || (uint32_t)height != REGRESS.height) {
+		printf("\timage: %ux%u against a %dx%d golden - FAILED\n", REGRESS.width, REGRESS.height, width, height);
+		++REGRESS.failures;
+		stbi_image_free(golden);
+		return;
+	}
+
+	size_t pixelCount = (size_t)width * height;
+	size_t bad = 0;
+	int worst = 0;
+	for (size_t i = 0; i < pixelCount; ++i) {
+		int diff = 0;
+		for (int c = 0; c < 4; ++c) {
+			int d = abs((int)REGRESS.image[i * 4 + c] - (int)golden[i * 4 + c]);
+			if (d > diff) diff = d;
+		}
+		if (diff > worst) worst = diff;
+		if (diff > REGRESS_CHANNEL_TOLERANCE) ++bad;
+	}
+	stbi_image_free(golden);
+
+	double share = (double)bad / (double)pixelCount;
+	bool ok = share <= REGRESS_MAX_BAD_PIXELS;
+	printf("\timage: %zu pixels differ (%.4f%%), worst channel difference %d - %s\n",
+		bad, share * 100.0, worst, ok ? "ok" : "FAILED");
+	if (!ok) ++REGRESS.failures;
+}
+
+/* returns how many were drawn, fewer when the window got closed */
+static uint32_t drawFrames(uint32_t count) {
+	uint32_t drawn = 0;
+	for (; drawn < count && !glfwWindowShouldClose(WINDOW.window); ++drawn) {
+		glfwPollEvents();
+		windowPublishSize();
+		// in lockstep, a tick per frame, so the images don't depend on the frame rate
+		simulationStep();
+		drawFrame();
+	}
+	return drawn;
+}
+
+// a run cut short would check a stale image or time too few frames, so it fails and ends the run
+static bool drewAll(uint32_t drawn, uint32_t count) {
+	if (drawn == count) return true;
+	printf("	window closed after %u of %u frames - FAILED\n", drawn, count);
+	++REGRESS.failures;
+	return false;
+}
+
+bool regressRun() {
+	_mkdir(REGRESS_DIRECTORY);
+	loadBaselines();
+	captureSetSink(captureSink, NULL);
+
+	printf("regression run, %.0f%% slack on timings\n", SETTINGS.regressSlack * 100.0);
+	checkTiming("upload", (double)VULKAN.uploadTimeNs / 1e6);
+
+	for (uint32_t kind = 0; kind < SCENE_KIND_COUNT; ++kind) {
+		const char* name = sceneKindName(kind);
+		printf("scene %s:\n", name);
+		loadScene(kind);
+
+		if (!drewAll(drawFrames(REGRESS_WARMUP_FRAMES), REGRESS_WARMUP_FRAMES)) break;
+
+		// the copy is only handed out once its fence has been waited on a few frames later
+		free(REGRESS.image);
+		REGRESS.image = NULL;
+		captureStart(CAPTURE_FORMAT_RAW, 1);
+		uint32_t drawn = drawFrames(MAX_FRAMES_IN_FLIGHT + 1);
+		flushCaptures();
+		if (!drewAll(drawn, MAX_FRAMES_IN_FLIGHT + 1)) break;
+		checkImage(name);
+
+		uint64_t start = getTimeInNanoseconds();
+		drawn = drawFrames(REGRESS_TIMED_FRAMES);
+		uint64_t elapsed = getTimeInNanoseconds() - start;
+		if (!drewAll(drawn, REGRESS_TIMED_FRAMES)) break;
+		checkTiming(name, (double)elapsed / 1e6 / drawn);
+	}
+
+	captureSetSink(NULL, NULL);
+	free(REGRESS.image);
+	REGRESS.image = NULL;
+	if (REGRESS.baselinesChanged) saveBaselines();
+
+	printf("regression run: %u failures\n", REGRESS.failures);
+	return REGRESS.failures == 0;
+}
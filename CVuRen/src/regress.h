@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+
+#define REGRESS_DIRECTORY "regress"
+#define REGRESS_BASELINES REGRESS_DIRECTORY "/baselines.txt"
+
+/* frames drawn before anything is looked at, lods and occlusion history settle in them */
+#define REGRESS_WARMUP_FRAMES 60
+#define REGRESS_TIMED_FRAMES 240
+
+/* per channel difference a pixel may have before it counts as different */
+#define REGRESS_CHANNEL_TOLERANCE 8
+/* share of pixels that may differ before the image fails */
+#define REGRESS_MAX_BAD_PIXELS 0.001
+
+/*
+ * Renders every SceneKind in turn, compares the frame after the warmup with
+ * REGRESS_DIRECTORY/<scene>.png and the average frame time, plus the startup
+ * upload time, with the baselines file. A missing golden or baseline is a
+ * failure; SETTINGS.regressUpdate (--regress-update) writes all of them
+ * instead of checking, and a window closed mid-run fails it too.
+ * Goldens only mean something for one device and resolution, they are meant
+ * to come from the software device (--cpu-device). Returns true when nothing failed.
+ */
+bool regressRun();
@@ -0,0 +1,187 @@
+#include "renderqueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/utils.h"
+
+#define FIELD_MASK(bits) ((1ull << (bits)) - 1)
+
+#define OPAQUE_MESH_SHIFT RENDER_KEY_DEPTH_BITS
+#define OPAQUE_MATERIAL_SHIFT (OPAQUE_MESH_SHIFT + RENDER_KEY_MESH_BITS)
+#define OPAQUE_PIPELINE_SHIFT (OPAQUE_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS)
+
+#define TRANSPARENT_MATERIAL_SHIFT RENDER_KEY_MESH_BITS
+#define TRANSPARENT_PIPELINE_SHIFT (TRANSPARENT_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS)
+#define TRANSPARENT_DEPTH_SHIFT (TRANSPARENT_PIPELINE_SHIFT + RENDER_KEY_PIPELINE_BITS)
+
+#define PASS_SHIFT 60
+
+uint64_t renderKeyEncode(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+	if (depth < 0.0f) depth = 0.0f;
+	if (depth > 1.0f) depth = 1.0f;
+	uint64_t quantized = (uint64_t)(depth * (float)FIELD_MASK(RENDER_KEY_DEPTH_BITS));
+
+	uint64_t key = (uint64_t)(pass & 0xf) << PASS_SHIFT;
+	uint64_t p = pipeline & FIELD_MASK(RENDER_KEY_PIPELINE_BITS);
+	uint64_t m = material & FIELD_MASK(RENDER_KEY_MATERIAL_BITS);
+	uint64_t g = mesh & FIELD_MASK(RENDER_KEY_MESH_BITS);
+
+	if (pass == RENDER_PASS_TRANSPARENT) {
+		// far first
+		key |= (FIELD_MASK(RENDER_KEY_DEPTH_BITS) - quantized) << TRANSPARENT_DEPTH_SHIFT;
+		key |= p << TRANSPARENT_PIPELINE_SHIFT | m << TRANSPARENT_MATERIAL_SHIFT | g;
+	} else {
+		key |= p << OPAQUE_PIPELINE_SHIFT | m << OPAQUE_MATERIAL_SHIFT | g << OPAQUE_MESH_SHIFT | quantized;
+	}
+	return key;
+}
+
+RenderKeyFields renderKeyDecode(uint64_t key) {
+	RenderKeyFields fields;
+	fields.pass = (uint32_t)(key >> PASS_SHIFT);
+	if (fields.pass == RENDER_PASS_TRANSPARENT) {
+		fields.depth = (uint32_t)(FIELD_MASK(RENDER_KEY_DEPTH_BITS) -
+			((key >> TRANSPARENT_DEPTH_SHIFT) & FIELD_MASK(RENDER_KEY_DEPTH_BITS)));
+		fields.pipeline = (uint32_t)((key >> TRANSPARENT_PIPELINE_SHIFT) & FIELD_MASK(RENDER_KEY_PIPELINE_BITS));
+		fields.material = (uint32_t)((key >> TRANSPARENT_MATERIAL_SHIFT) & FIELD_MASK(RENDER_KEY_MATERIAL_BITS));
+		fields.mesh = (uint32_t)(key & FIELD_MASK(RENDER_KEY_MESH_BITS));
+	} else {
+		fields.pipeline = (uint32_t)((key >> OPAQUE_PIPELINE_SHIFT) & FIELD_MASK(RENDER_KEY_PIPELINE_BITS));
+		fields.material = (uint32_t)((key >> OPAQUE_MATERIAL_SHIFT) & FIELD_MASK(RENDER_KEY_MATERIAL_BITS));
+		fields.mesh = (uint32_t)((key >> OPAQUE_MESH_SHIFT) & FIELD_MASK(RENDER_KEY_MESH_BITS));
+		fields.depth = (uint32_t)(key & FIELD_MASK(RENDER_KEY_DEPTH_BITS));
+	}
+	return fields;
+}
+
+void renderQueueInit(RenderQueue* queue, uint32_t capacity) {
+	memset(queue, 0, sizeof(RenderQueue));
+	queue->capacity = capacity;
+	queue->keys = malloc(sizeof(uint64_t) * capacity);
+	queue->values = malloc(sizeof(uint32_t) * capacity);
+	queue->scratchKeys = malloc(sizeof(uint64_t) * capacity);
+	queue->scratchValues = malloc(sizeof(uint32_t) * capacity);
+}
+
+void renderQueueFree(RenderQueue* queue) {
+	free(queue->keys);
+	free(queue->values);
+	free(queue->scratchKeys);
+	free(queue->scratchValues);
+	memset(queue, 0, sizeof(RenderQueue));
+}
+
+void renderQueueClear(RenderQueue* queue) {
+	queue->count = 0;
+}
+
+void renderQueuePush(RenderQueue* queue, uint64_t key, uint32_t value) {
+	if (queue->count >= queue->capacity) {
+		c_throw("render queue is full");
+	}
+	queue->keys[queue->count] = key;
+	queue->values[queue->count] = value;
+	++queue->count;
+	++queue->stats.draws;
+}
+
+void renderQueueSort(RenderQueue* queue) {
+	uint32_t count = queue->count;
+	if (count < 2) return;
+
+	// every histogram in one read over the keys
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (uint32_t i = 0; i < count; ++i) {
+		uint64_t key = queue->keys[i];
+		for (int b = 0; b < 8; ++b) {
+			++histograms[b][(key >> (b * 8)) & 0xff];
+		}
+	}
+
+	uint64_t* keys = queue->keys;
+	uint32_t* values = queue->values;
+	uint64_t* outKeys = queue->scratchKeys;
+	uint32_t* outValues = queue->scratchValues;
+	for (int b = 0; b < 8; ++b) {
+		uint32_t* histogram = histograms[b];
+		// one bucket holds everything, this byte wouldn't move anything
+		if (histogram[(keys[0] >> (b * 8)) & 0xff] == count) continue;
+
+		uint32_t offset = 0;
+		for (int d = 0; d < 256; ++d) {
+			uint32_t n = histogram[d];
+			histogram[d] = offset;
+			offset += n;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t slot = histogram[(keys[i] >> (b * 8)) & 0xff]++;
+			outKeys[slot] = keys[i];
+			outValues[slot] = values[i];
+		}
+
+		uint64_t* tk = keys; keys = outKeys; outKeys = tk;
+		uint32_t* tv = values; values = outValues; outValues = tv;
+	}
+
+	// an odd number of passes leaves the result in the scratch arrays
+	if (keys != queue->keys) {
+		queue->scratchKeys = queue->keys;
+		queue->scratchValues = queue->values;
+		queue->keys = keys;
+		queue->values = values;
+	}
+}
+
+void renderBindReset(RenderQueue* queue, RenderBindState* state) {
+	++queue->stats.passes;
+	state->pipeline = UINT32_MAX;
+	state->material = UINT32_MAX;
+	state->valid = false;
+}
+
+bool renderBindPipeline(RenderQueue* queue, RenderBindState* state, uint32_t pipeline) {
+	if (state->valid && state->pipeline == pipeline) {
+		++queue->stats.bindsSkipped;
+		return false;
+	}
+	state->pipeline = pipeline;
+	state->valid = true;
+	++queue->stats.pipelineBinds;
+	return true;
+}
+
+bool renderBindMaterial(RenderQueue* queue, RenderBindState* state, uint32_t material) {
+	if (state->material == material) {
+		++queue->stats.bindsSkipped;
+		return false;
+	}
+	state->material = material;
+	++queue->stats.materialBinds;
+	return true;
+}
+
+void renderQueueBeginFrame(RenderQueue* queue) {
+	RenderQueueStats* stats = &queue->stats;
+	if (stats->draws) {
+		stats->bindsSkippedTotal += stats->bindsSkipped;
+		++stats->frames;
+	}
+	stats->draws = 0;
+	stats->passes = 0;
+	stats->pipelineBinds = 0;
+	stats->materialBinds = 0;
+	stats->bindsSkipped = 0;
+	stats->drawCalls = 0;
+}
+
+void printRenderQueueStats(const RenderQueue* queue) {
+	const RenderQueueStats* stats = &queue->stats;
+	printf("render queue: %.1f binds skipped per frame over %llu frames, last frame %u draws recorded by %u passes "
+		"in %u calls, %u pipeline and %u material binds, %u skipped\n",
+		stats->frames ? (double)stats->bindsSkippedTotal / (double)stats->frames : 0.0,
+		(unsigned long long)stats->frames, stats->draws, stats->passes, stats->drawCalls,
+		stats->pipelineBinds, stats->materialBinds, stats->bindsSkipped);
+}
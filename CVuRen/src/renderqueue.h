@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * 64 bit draw keys, most significant first:
+ *   opaque:      pass(4) pipeline(10) material(12) mesh(14) depth(24)
+ *   transparent: pass(4) ~depth(24) pipeline(10) material(12) mesh(14)
+ * Opaque draws group by state and go front to back inside a state, which
+ * keeps binds down and lets early-z reject more. Transparent ones have to
+ * go back to front, so depth outranks state there.
+ */
+#define RENDER_PASS_OPAQUE 0
+#define RENDER_PASS_TRANSPARENT 1
+
+#define RENDER_KEY_PIPELINE_BITS 10
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_MESH_BITS 14
+#define RENDER_KEY_DEPTH_BITS 24
+
+#define RENDER_MATERIAL_DEFAULT 0
+
+typedef struct RenderKeyFields {
+	uint32_t pass, pipeline, material, mesh, depth;
+} RenderKeyFields;
+
+/* depth is normalized, 0 at the near plane and 1 at the far one, and gets clamped */
+uint64_t renderKeyEncode(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+RenderKeyFields renderKeyDecode(uint64_t key);
+
+typedef struct RenderQueueStats {
+	/* batches pushed this frame, counted once however many passes record them */
+	uint32_t draws;
+	/* passes that recorded the queue, the counters below add up over all of them */
+	uint32_t passes;
+	uint32_t pipelineBinds, materialBinds;
+	/* binds an unconditional recorder would have issued on top of the ones above */
+	uint32_t bindsSkipped;
+	/* indirect calls after merging runs of draws with the same state */
+	uint32_t drawCalls;
+
+	uint64_t frames, bindsSkippedTotal;
+} RenderQueueStats;
+
+/* keys sort with their values (usually an index into the caller's draw list) */
+typedef struct RenderQueue {
+	uint64_t* keys;
+	uint32_t* values;
+	uint64_t* scratchKeys;
+	uint32_t* scratchValues;
+	uint32_t count, capacity;
+
+	RenderQueueStats stats;
+} RenderQueue;
+
+void renderQueueInit(RenderQueue* queue, uint32_t capacity);
+void renderQueueFree(RenderQueue* queue);
+void renderQueueClear(RenderQueue* queue);
+void renderQueuePush(RenderQueue* queue, uint64_t key, uint32_t value);
+
+/* stable LSD radix sort, a byte at a time, bytes every key shares are skipped */
+void renderQueueSort(RenderQueue* queue);
+
+/*
+ * Bind tracking for the recorder: returns true when the state differs from
+ * what was bound last and updates the counters either way. Call both once
+ * per draw. Reset once per recorded pass, the command buffer forgets its
+ * bindings between passes, and the reset counts the pass.
+ */
+typedef struct RenderBindState {
+	uint32_t pipeline, material;
+	bool valid;
+} RenderBindState;
+
+void renderBindReset(RenderQueue* queue, RenderBindState* state);
+bool renderBindPipeline(RenderQueue* queue, RenderBindState* state, uint32_t pipeline);
+bool renderBindMaterial(RenderQueue* queue, RenderBindState* state, uint32_t material);
+
+/* closes the frame's counters, call once per frame before recording */
+void renderQueueBeginFrame(RenderQueue* queue);
+void printRenderQueueStats(const RenderQueue* queue);
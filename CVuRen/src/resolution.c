@@ -0,0 +1,574 @@
+#include "resolution.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "post.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+#define UPSCALE_GROUP_SIZE 8
+#define RESOLUTION_FRAME_QUERIES 2
+
+typedef struct UpscaleParams {
+    /* from output uv to the rendered rectangle's, and the last uv inside it bilinear can take */
+    float uvScale[2];
+    float uvMax[2];
+    int32_t outputSize[2];
+    float sharpness;
+    /* the rest of the post stack, see post.h */
+    float exposure;
+    float bloomStrength;
+    uint32_t stages;
+} UpscaleParams;
+
+static struct RESOLUTION {
+    VkImage color;
+    VkDeviceMemory colorMemory;
+    VkImageView colorView;
+    /* one per frame in flight, so a late present of the last frame doesn't hold this one's upscale */
+    VkImage* output;
+    VkDeviceMemory* outputMemory;
+    VkImageView* outputViews;
+    VkExtent2D targetExtent;
+
+    VkSampler sampler;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet* sets;
+    VkPipeline pipeline;
+
+    VkQueryPool queries;
+    bool timestamps;
+    uint64_t validMask;
+    double timestampPeriod;
+    bool* queriesPending;
+
+    float scale;
+    bool controlled;
+    uint32_t settleFrames;
+
+    ResolutionStats stats;
+} RESOLUTION;
+
+static float clampScale(float scale) {
+    if (scale < RESOLUTION_MIN_SCALE) return RESOLUTION_MIN_SCALE;
+    if (scale > RESOLUTION_MAX_SCALE) return RESOLUTION_MAX_SCALE;
+    return scale;
+}
+
+static void createLayouts() {
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 2,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 3,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = NULL
+        }
+    };
+    VkDescriptorSetLayoutCreateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 4,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &setInfo, NULL, &RESOLUTION.setLayout) != VK_SUCCESS) {
+        c_throw("failed to create upscale descriptor set layout");
+    }
+
+    VkPushConstantRange push = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(UpscaleParams)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &RESOLUTION.setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &RESOLUTION.layout) != VK_SUCCESS) {
+        c_throw("failed to create upscale pipeline layout");
+    }
+}
+
+static void createSets() {
+    VkDescriptorPoolSize poolSizes[] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = MAX_FRAMES_IN_FLIGHT * 3
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = MAX_FRAMES_IN_FLIGHT
+        }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &RESOLUTION.pool) != VK_SUCCESS) {
+        c_throw("failed to create upscale descriptor pool");
+    }
+
+    VkDescriptorSetLayout* layouts = malloc(sizeof(VkDescriptorSetLayout) * MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) layouts[i] = RESOLUTION.setLayout;
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = RESOLUTION.pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = layouts
+    };
+    RESOLUTION.sets = malloc(sizeof(VkDescriptorSet) * MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, RESOLUTION.sets) != VK_SUCCESS) {
+        c_throw("failed to allocate upscale descriptor sets");
+    }
+    free(layouts);
+}
+
+static void createQueries() {
+    VkQueueFamilyProperties* families;
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, NULL);
+    families = malloc(sizeof(VkQueueFamilyProperties) * familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, families);
+    uint32_t validBits = families[VULKAN.queueFamilies.graphicsFamily].timestampValidBits;
+    free(families);
+
+    RESOLUTION.timestamps = validBits > 0;
+    RESOLUTION.queriesPending = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(bool));
+    if (!RESOLUTION.timestamps) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(VULKAN.physicalDevice, &properties);
+    RESOLUTION.validMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    RESOLUTION.timestampPeriod = (double)properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MAX_FRAMES_IN_FLIGHT * RESOLUTION_FRAME_QUERIES,
+        .pipelineStatistics = 0
+    };
+    if (vkCreateQueryPool(VULKAN.device, &poolInfo, NULL, &RESOLUTION.queries) != VK_SUCCESS) {
+        c_throw("failed to create resolution timestamp query pool");
+    }
+}
+
+void createResolutionResources() {
+    createLayouts();
+    createSets();
+    RESOLUTION.pipeline = createComputePipeline("shaders/upscale.spv", RESOLUTION.layout);
+    createQueries();
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &RESOLUTION.sampler) != VK_SUCCESS) {
+        c_throw("failed to create upscale sampler");
+    }
+
+    RESOLUTION.scale = clampScale(SETTINGS.renderScale);
+    // timings of a regression run would make its images depend on the machine
+    RESOLUTION.controlled = SETTINGS.frameTargetMs > 0.0f && !SETTINGS.regress;
+    RESOLUTION.stats.lowestScale = RESOLUTION.stats.highestScale = RESOLUTION.scale;
+}
+
+void destroyResolutionResources() {
+    vkDestroyPipeline(VULKAN.device, RESOLUTION.pipeline, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, RESOLUTION.layout, NULL);
+    vkDestroyDescriptorPool(VULKAN.device, RESOLUTION.pool, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, RESOLUTION.setLayout, NULL);
+    vkDestroySampler(VULKAN.device, RESOLUTION.sampler, NULL);
+    free(RESOLUTION.sets);
+
+    if (RESOLUTION.timestamps) vkDestroyQueryPool(VULKAN.device, RESOLUTION.queries, NULL);
+    free(RESOLUTION.queriesPending);
+}
+
+void createRenderTargets() {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(VULKAN.physicalDevice, VULKAN.swapchainImageFormat, &properties);
+    if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+        c_throw("swapchain format can't be blitted to");
+    }
+
+    RESOLUTION.targetExtent = (VkExtent2D){
+        (uint32_t)ceilf((float)VULKAN.swapchainExtent.width * RESOLUTION_MAX_SCALE),
+        (uint32_t)ceilf((float)VULKAN.swapchainExtent.height * RESOLUTION_MAX_SCALE)
+    };
+    createImage(RESOLUTION.targetExtent.width, RESOLUTION.targetExtent.height, RESOLUTION_COLOR_FORMAT,
+        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENT, &RESOLUTION.color, &RESOLUTION.colorMemory);
+    RESOLUTION.colorView = createImageView(RESOLUTION.color, RESOLUTION_COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+    // bloom reads the color target and the upscale reads bloom, so its chain is made in between
+    createPostTargets();
+
+    RESOLUTION.output = malloc(sizeof(VkImage) * MAX_FRAMES_IN_FLIGHT);
+    RESOLUTION.outputMemory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    RESOLUTION.outputViews = malloc(sizeof(VkImageView) * MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createImage(VULKAN.swapchainExtent.width, VULKAN.swapchainExtent.height, RESOLUTION_OUTPUT_FORMAT,
+            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENT, RESOLUTION.output + i,
+            RESOLUTION.outputMemory + i);
+        RESOLUTION.outputViews[i] = createImageView(RESOLUTION.output[i], RESOLUTION_OUTPUT_FORMAT,
+            VK_IMAGE_ASPECT_COLOR_BIT);
+
+        VkDescriptorImageInfo images[] = {
+            {
+                .sampler = RESOLUTION.sampler,
+                .imageView = RESOLUTION.colorView,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            },
+            {
+                .sampler = VK_NULL_HANDLE,
+                .imageView = RESOLUTION.outputViews[i],
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+            },
+            {
+                .sampler = RESOLUTION.sampler,
+                .imageView = postBloomView(),
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+            },
+            {
+                .sampler = RESOLUTION.sampler,
+                .imageView = postLutView(),
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            }
+        };
+        VkWriteDescriptorSet writes[4];
+        for (uint32_t b = 0; b < 4; ++b) {
+            writes[b] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = RESOLUTION.sets[i],
+                .dstBinding = b,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = b == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = images + b,
+                .pBufferInfo = NULL,
+                .pTexelBufferView = NULL
+            };
+        }
+        vkUpdateDescriptorSets(VULKAN.device, 4, writes, 0, NULL);
+    }
+}
+
+void destroyRenderTargets() {
+    destroyPostTargets();
+    vkDestroyImageView(VULKAN.device, RESOLUTION.colorView, NULL);
+    vkDestroyImage(VULKAN.device, RESOLUTION.color, NULL);
+    freeDeviceMemory(RESOLUTION.colorMemory);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyImageView(VULKAN.device, RESOLUTION.outputViews[i], NULL);
+        vkDestroyImage(VULKAN.device, RESOLUTION.output[i], NULL);
+        freeDeviceMemory(RESOLUTION.outputMemory[i]);
+    }
+    free(RESOLUTION.output);
+    free(RESOLUTION.outputMemory);
+    free(RESOLUTION.outputViews);
+}
+
+VkImageView renderTargetView() {
+    return RESOLUTION.colorView;
+}
+
+VkImageView resolutionOutputView(uint32_t frame) {
+    return RESOLUTION.outputViews[frame];
+}
+
+static uint32_t scaledSize(uint32_t size, uint32_t limit) {
+    uint32_t scaled = (uint32_t)((float)size * RESOLUTION.scale + 0.5f);
+    if (scaled < 1) scaled = 1;
+    return scaled > limit ? limit : scaled;
+}
+
+bool updateRenderScale() {
+    VkExtent2D extent = {
+        scaledSize(VULKAN.swapchainExtent.width, RESOLUTION.targetExtent.width),
+        scaledSize(VULKAN.swapchainExtent.height, RESOLUTION.targetExtent.height)
+    };
+    bool changed = extent.width != VULKAN.renderExtent.width || extent.height != VULKAN.renderExtent.height;
+    VULKAN.renderExtent = extent;
+    return changed;
+}
+
+void beginResolutionFrame(VkCommandBuffer commandBuffer, uint32_t frame) {
+    if (!RESOLUTION.timestamps) return;
+    uint32_t firstQuery = frame * RESOLUTION_FRAME_QUERIES;
+    vkCmdResetQueryPool(commandBuffer, RESOLUTION.queries, firstQuery, RESOLUTION_FRAME_QUERIES);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, RESOLUTION.queries, firstQuery);
+}
+
+void recordUpscale(VkCommandBuffer commandBuffer, uint32_t frame) {
+    VkExtent2D output = VULKAN.swapchainExtent;
+    VkExtent2D rendered = VULKAN.renderExtent;
+    VkExtent2D target = RESOLUTION.targetExtent;
+    UpscaleParams params = {
+        .uvScale = { (float)rendered.width / (float)target.width, (float)rendered.height / (float)target.height },
+        .uvMax = { ((float)rendered.width - 0.5f) / (float)target.width,
+            ((float)rendered.height - 0.5f) / (float)target.height },
+        .outputSize = { (int32_t)output.width, (int32_t)output.height },
+        .sharpness = SETTINGS.upscaleSharpness,
+        .exposure = exp2f(SETTINGS.exposure),
+        .bloomStrength = SETTINGS.bloomStrength,
+        .stages = postCompositeStages()
+    };
+    recordBloom(commandBuffer, frame, params.uvScale, params.uvMax);
+
+    // the fence of this frame covers the last blit out of it, so whatever it held can go
+    VkImageMemoryBarrier toGeneral = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = RESOLUTION.output[frame],
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, NULL, 0, NULL, 1, &toGeneral);
+
+    uint32_t groupsX = (output.width + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE;
+    uint32_t groupsY = (output.height + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, RESOLUTION.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, RESOLUTION.layout,
+        0, 1, RESOLUTION.sets + frame, 0, NULL);
+    vkCmdPushConstants(commandBuffer, RESOLUTION.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+    postPassDone(commandBuffer, frame, POST_PASS_COMPOSITE);
+
+    // the comparison the fused stack is measured against, every stage a round trip through the output
+    if (postNaive()) {
+        const uint32_t stages[] = { POST_STAGE_TONEMAP, POST_STAGE_GRADE };
+        const PostPass passes[] = { POST_PASS_TONEMAP, POST_PASS_GRADE };
+        VkMemoryBarrier between = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        };
+        for (uint32_t i = 0; i < 2; ++i) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &between, 0, NULL, 0, NULL);
+            params.stages = stages[i];
+            vkCmdPushConstants(commandBuffer, RESOLUTION.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params),
+                &params);
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+            postPassDone(commandBuffer, frame, passes[i]);
+        }
+    }
+
+}
+
+void finishOutput(VkCommandBuffer commandBuffer, uint32_t frame) {
+    // written by the post stack and maybe drawn over by the overlay
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = RESOLUTION.output[frame],
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &toTransfer);
+
+    if (RESOLUTION.timestamps) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, RESOLUTION.queries,
+            frame * RESOLUTION_FRAME_QUERIES + 1);
+        RESOLUTION.queriesPending[frame] = true;
+    }
+}
+
+void recordPresentBlit(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t imageIndex) {
+    VkImage image = VULKAN.swapchainImages.swapchainImages[imageIndex];
+    // transfer is the stage the acquire semaphore is waited on, so this chains onto it
+    VkImageMemoryBarrier toDst = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &toDst);
+
+    // same size, this is only the format conversion and the srgb encode
+    VkImageBlit region = {
+        .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .srcOffsets = { { 0, 0, 0 }, { (int32_t)VULKAN.swapchainExtent.width, (int32_t)VULKAN.swapchainExtent.height, 1 } },
+        .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .dstOffsets = { { 0, 0, 0 }, { (int32_t)VULKAN.swapchainExtent.width, (int32_t)VULKAN.swapchainExtent.height, 1 } }
+    };
+    vkCmdBlitImage(commandBuffer, RESOLUTION.output[frame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+
+    VkImageMemoryBarrier toPresent = toDst;
+    toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toPresent.dstAccessMask = 0;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, NULL, 0, NULL, 1, &toPresent);
+}
+
+// pixel cost goes with the area, so the scale moves by the square root of how far off the time is
+static void adjustScale(float gpuMs) {
+    ResolutionStats* stats = &RESOLUTION.stats;
+    stats->gpuMs = stats->frames == 1 ? gpuMs : stats->gpuMs + (gpuMs - stats->gpuMs) * 0.2f;
+
+    if (RESOLUTION.settleFrames) {
+        --RESOLUTION.settleFrames;
+        return;
+    }
+    float ratio = SETTINGS.frameTargetMs / stats->gpuMs;
+    if (fabsf(1.0f - ratio) <= RESOLUTION_DEADBAND) return;
+
+    float step = RESOLUTION.scale * sqrtf(ratio) - RESOLUTION.scale;
+    if (step > RESOLUTION_MAX_STEP) step = RESOLUTION_MAX_STEP;
+    if (step < -RESOLUTION_MAX_STEP) step = -RESOLUTION_MAX_STEP;
+    float scale = clampScale(RESOLUTION.scale + step);
+    if (scale == RESOLUTION.scale) return;
+
+    RESOLUTION.scale = scale;
+    RESOLUTION.settleFrames = RESOLUTION_SETTLE_FRAMES;
+    ++stats->scaleChanges;
+    if (scale < stats->lowestScale) stats->lowestScale = scale;
+    if (scale > stats->highestScale) stats->highestScale = scale;
+}
+
+void collectResolutionStats(uint32_t frame) {
+    if (!RESOLUTION.queriesPending[frame]) return;
+    RESOLUTION.queriesPending[frame] = false;
+
+    uint64_t results[RESOLUTION_FRAME_QUERIES];
+    if (vkGetQueryPoolResults(VULKAN.device, RESOLUTION.queries, frame * RESOLUTION_FRAME_QUERIES,
+        RESOLUTION_FRAME_QUERIES, sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    uint64_t ticks = (results[1] - results[0]) & RESOLUTION.validMask;
+    float gpuMs = (float)((double)ticks * RESOLUTION.timestampPeriod / 1e6);
+
+    ResolutionStats* stats = &RESOLUTION.stats;
+    ++stats->frames;
+    stats->gpuMsTotal += gpuMs;
+    stats->scaleTotal += RESOLUTION.scale;
+    if (SETTINGS.frameTargetMs > 0.0f && gpuMs > SETTINGS.frameTargetMs) ++stats->overBudgetFrames;
+    if (RESOLUTION.controlled) {
+        adjustScale(gpuMs);
+    } else {
+        stats->gpuMs = gpuMs;
+    }
+    stats->scale = RESOLUTION.scale;
+}
+
+ResolutionStats getResolutionStats() {
+    return RESOLUTION.stats;
+}
+
+void printResolutionStats() {
+    const ResolutionStats* stats = &RESOLUTION.stats;
+    if (!RESOLUTION.controlled) {
+        printf("resolution: fixed at %.2f, %s upscale\n", RESOLUTION.scale,
+            SETTINGS.upscaleSharpness > 0.0f ? "sharpening" : "bilinear");
+        return;
+    }
+    printf("resolution: target %.2f ms, scale %.2f now, %.2f to %.2f, %llu changes, %s upscale\n",
+        SETTINGS.frameTargetMs, RESOLUTION.scale, stats->lowestScale, stats->highestScale,
+        (unsigned long long)stats->scaleChanges, SETTINGS.upscaleSharpness > 0.0f ? "sharpening" : "bilinear");
+    if (stats->frames) {
+        printf("\t%.3f ms gpu and %.2f scale on average over %llu frames, %.1f%% of them over the target\n",
+            stats->gpuMsTotal / (double)stats->frames, stats->scaleTotal / (double)stats->frames,
+            (unsigned long long)stats->frames, 100.0 * (double)stats->overBudgetFrames / (double)stats->frames);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* what the scene renders into, linear hdr until the post stack tonemaps it; always sampled and color renderable */
+#define RESOLUTION_COLOR_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+/* the upscale writes here and it's blitted to the swapchain, which can't be a storage image in srgb */
+#define RESOLUTION_OUTPUT_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+
+/* share of the swapchain extent per axis, targets are allocated at the largest */
+#define RESOLUTION_MIN_SCALE 0.5f
+#define RESOLUTION_MAX_SCALE 1.0f
+/* the scale is left alone while the gpu time is within this share of the target */
+#define RESOLUTION_DEADBAND 0.05f
+/* most the scale moves in one adjustment */
+#define RESOLUTION_MAX_STEP 0.05f
+/* frames between adjustments, so the last one shows up in the timings first */
+#define RESOLUTION_SETTLE_FRAMES 8
+
+typedef struct ResolutionStats {
+    float scale;
+    /* smoothed, what the controller looks at */
+    float gpuMs;
+    float lowestScale, highestScale;
+    uint64_t scaleChanges;
+
+    uint64_t frames, overBudgetFrames;
+    double gpuMsTotal, scaleTotal;
+} ResolutionStats;
+
+/*
+ * Dynamic resolution. The scene renders into the top left of a target sized
+ * for the swapchain at RESOLUTION_MAX_SCALE, so changing the scale only
+ * changes the viewport and nothing gets reallocated. A compute pass then
+ * upscales that rectangle to the full extent, bilinear or with contrast
+ * adaptive sharpening, doing the post stack of post.h on the way, and the
+ * result is blitted to the swapchain image in a
+ * submit of its own, so only the blit waits for the acquire and the timed
+ * part of the frame never includes it.
+ *
+ * With SETTINGS.frameTargetMs set, a controller reads the whole frame's gpu
+ * time from timestamps and moves the scale towards the target: pixel cost
+ * goes with the area, so it steps by the square root of target over time,
+ * limited to RESOLUTION_MAX_STEP and held for RESOLUTION_SETTLE_FRAMES after
+ * every change, since results arrive frames late. Otherwise the scale stays
+ * at SETTINGS.renderScale, which is also what regression runs use.
+ */
+void createResolutionResources();
+void destroyResolutionResources();
+
+/* sized after the swapchain */
+void createRenderTargets();
+void destroyRenderTargets();
+
+/* the scene framebuffer's color attachment */
+VkImageView renderTargetView();
+/* the frame's upscaled output, RESOLUTION_OUTPUT_FORMAT at the swapchain extent */
+VkImageView resolutionOutputView(uint32_t frame);
+
+/* sets VULKAN.renderExtent for the frame, true when it changed */
+bool updateRenderScale();
+
+/* first thing in the frame's command buffer, outside of a render pass */
+void beginResolutionFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+/* after the scene passes, records bloom and the post stack too, leaves the output in GENERAL */
+void recordUpscale(VkCommandBuffer commandBuffer, uint32_t frame);
+/* once nothing else draws into the output, readies it for the blit and ends the timed part of the frame */
+void finishOutput(VkCommandBuffer commandBuffer, uint32_t frame);
+/* in the submit that waits on the acquire at the transfer stage, leaves the image ready to present */
+void recordPresentBlit(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t imageIndex);
+
+/* call after the frame's fence wait, feeds the controller */
+void collectResolutionStats(uint32_t frame);
+ResolutionStats getResolutionStats();
+void printResolutionStats();
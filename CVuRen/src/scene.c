@@ -0,0 +1,216 @@
+#include "scene.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "utils/utils.h"
+
+void sceneInit(Scene* scene, uint32_t capacity) {
+	memset(scene, 0, sizeof(Scene));
+	scene->capacity = capacity;
+	scene->parent = malloc(sizeof(uint32_t) * capacity);
+	scene->mesh = malloc(sizeof(uint32_t) * capacity);
+	scene->world = _aligned_malloc(sizeof(mat4) * capacity, 32);
+	scene->dirty = malloc(capacity);
+	scene->changed = malloc(capacity);
+	scene->lod = malloc(capacity);
+	scene->drawKey = malloc(sizeof(uint32_t) * capacity);
+	transformsInit(&scene->local, capacity);
+}
+
+void sceneFree(Scene* scene) {
+	free(scene->parent);
+	free(scene->mesh);
+	_aligned_free(scene->world);
+	free(scene->dirty);
+	free(scene->changed);
+	free(scene->lod);
+	free(scene->drawKey);
+	transformsFree(&scene->local);
+	memset(scene, 0, sizeof(Scene));
+}
+
+uint32_t sceneAddNode(Scene* scene, uint32_t parent, uint32_t mesh,
+	const float position[3], const float rotation[4], const float scale[3]) {
+	if (scene->count == scene->capacity) {
+		c_throw("scene is full");
+	}
+	if (parent != SCENE_NO_PARENT && parent >= scene->count) {
+		c_throw("scene nodes must be added after their parent");
+	}
+
+	uint32_t node = transformsAdd(&scene->local, position, rotation, scale);
+	scene->parent[node] = parent;
+	scene->mesh[node] = mesh;
+	scene->dirty[node] = 1;
+	scene->lod[node] = 0;
+	scene->count = scene->local.count;
+	if (mesh != SCENE_NO_MESH) {
+		++scene->renderableCount;
+	}
+	return node;
+}
+
+void sceneSetLocal(Scene* scene, uint32_t node, const float position[3], const float rotation[4], const float scale[3]) {
+	transformsSet(&scene->local, node, position, rotation, scale);
+	scene->dirty[node] = 1;
+}
+
+void sceneRotateLocal(Scene* scene, uint32_t node, const float rotation[4]) {
+	TransformSoA* t = &scene->local;
+	versor current = { t->qx[node], t->qy[node], t->qz[node], t->qw[node] };
+	versor r = { rotation[0], rotation[1], rotation[2], rotation[3] };
+	versor result;
+	glm_quat_mul(r, current, result);
+	glm_quat_normalize(result);
+	t->qx[node] = result[0]; t->qy[node] = result[1]; t->qz[node] = result[2]; t->qw[node] = result[3];
+	scene->dirty[node] = 1;
+}
+
+void sceneSetRotation(Scene* scene, uint32_t node, const float rotation[4]) {
+	TransformSoA* t = &scene->local;
+	if (t->qx[node] == rotation[0] && t->qy[node] == rotation[1] && t->qz[node] == rotation[2] && t->qw[node] == rotation[3]) {
+		return;
+	}
+	t->qx[node] = rotation[0]; t->qy[node] = rotation[1]; t->qz[node] = rotation[2]; t->qw[node] = rotation[3];
+	scene->dirty[node] = 1;
+}
+
+uint32_t sceneUpdate(Scene* scene) {
+	uint32_t recomputed = 0;
+
+	uint32_t i = 0;
+	while (i < scene->count) {
+		uint32_t parent = scene->parent[i];
+		if (parent == SCENE_NO_PARENT) {
+			// dirty roots don't need a parent multiply, compose whole runs of them in simd batches
+			uint32_t run = 0;
+			while (i + run < scene->count && scene->parent[i + run] == SCENE_NO_PARENT && scene->dirty[i + run]) {
+				++run;
+			}
+			if (run) {
+				transformsCompose(&scene->local, i, run, scene->world + i, sizeof(mat4));
+				memset(scene->changed + i, 1, run);
+				memset(scene->dirty + i, 0, run);
+				recomputed += run;
+				i += run;
+			} else {
+				scene->changed[i++] = 0;
+			}
+			continue;
+		}
+
+		if (scene->dirty[i] || scene->changed[parent]) {
+			mat4 local;
+			transformsComposeScalar(&scene->local, i, 1, local, sizeof(mat4));
+			glm_mat4_mul(scene->world[parent], local, scene->world[i]);
+			scene->changed[i] = 1;
+			scene->dirty[i] = 0;
+			++recomputed;
+		} else {
+			scene->changed[i] = 0;
+		}
+		++i;
+	}
+
+	scene->recomputed = recomputed;
+	scene->recomputedTotal += recomputed;
+	++scene->updates;
+	return recomputed;
+}
+
+uint32_t sceneBuildDraws(Scene* scene, const Mesh* meshes, uint32_t meshCount, const Camera* camera,
+	float viewportHeight, InstanceData* instances, uint32_t* instanceNodes, DrawBatch* batches, DrawStats* stats) {
+	uint32_t keyCount = meshCount * MESH_MAX_LODS;
+	for (uint32_t k = 0; k < keyCount; ++k) {
+		batches[k] = (DrawBatch){ k / MESH_MAX_LODS, k % MESH_MAX_LODS, 0, 0 };
+	}
+
+	for (uint32_t i = 0; i < scene->count; ++i) {
+		uint32_t mesh = scene->mesh[i];
+		if (mesh == SCENE_NO_MESH) continue;
+		uint32_t lod = meshSelectLod(meshes + mesh, scene->lod[i], scene->world[i], camera, viewportHeight);
+		scene->lod[i] = (uint8_t)lod;
+		scene->drawKey[i] = mesh * MESH_MAX_LODS + lod;
+		++batches[scene->drawKey[i]].instanceCount;
+	}
+
+	// counting sort, instanceCount is reused as the fill cursor
+	uint32_t first = 0;
+	for (uint32_t k = 0; k < keyCount; ++k) {
+		batches[k].firstInstance = first;
+		first += batches[k].instanceCount;
+		batches[k].instanceCount = 0;
+	}
+	for (uint32_t i = 0; i < scene->count; ++i) {
+		if (scene->mesh[i] == SCENE_NO_MESH) continue;
+		DrawBatch* batch = batches + scene->drawKey[i];
+		uint32_t slot = batch->firstInstance + batch->instanceCount++;
+		memcpy(instances[slot].model, scene->world[i], sizeof(mat4));
+		if (instanceNodes) instanceNodes[slot] = i;
+	}
+
+	memset(stats->lodInstances, 0, sizeof(stats->lodInstances));
+	stats->instances = first;
+	stats->triangles = 0;
+	uint32_t batchCount = 0;
+	for (uint32_t k = 0; k < keyCount; ++k) {
+		if (batches[k].instanceCount == 0) continue;
+		const MeshLod* lod = meshes[batches[k].mesh].lods + batches[k].lod;
+		stats->triangles += (uint64_t)(lod->indexCount / 3) * batches[k].instanceCount;
+		stats->lodInstances[batches[k].lod] += batches[k].instanceCount;
+		batches[batchCount++] = batches[k];
+	}
+	stats->batches = batchCount;
+	stats->trianglesTotal += stats->triangles;
+	++stats->frames;
+	return batchCount;
+}
+
+void scenePrintStats(const Scene* scene) {
+	printf("scene: %u nodes, %.2f recomputed per update on average over %llu updates\n",
+		scene->count, scene->updates ? (double)scene->recomputedTotal / (double)scene->updates : 0.0,
+		(unsigned long long)scene->updates);
+}
+
+void cameraInit(Camera* camera, float fovy, float znear, float zfar) {
+	memset(camera, 0, sizeof(Camera));
+	camera->fovy = fovy;
+	camera->znear = znear;
+	camera->zfar = zfar;
+	camera->aspect = 1.0f;
+	camera->up[2] = 1.0f;
+	camera->dirty = true;
+}
+
+void cameraLookAt(Camera* camera, const vec3 eye, const vec3 center, const vec3 up) {
+	if (memcmp(camera->eye, eye, sizeof(vec3)) || memcmp(camera->center, center, sizeof(vec3)) ||
+		memcmp(camera->up, up, sizeof(vec3))) {
+		memcpy(camera->eye, eye, sizeof(vec3));
+		memcpy(camera->center, center, sizeof(vec3));
+		memcpy(camera->up, up, sizeof(vec3));
+		camera->dirty = true;
+	}
+}
+
+void cameraSetAspect(Camera* camera, float aspect) {
+	if (camera->aspect != aspect) {
+		camera->aspect = aspect;
+		camera->dirty = true;
+	}
+}
+
+bool cameraUpdate(Camera* camera) {
+	if (!camera->dirty) return false;
+
+	glm_lookat(camera->eye, camera->center, camera->up, camera->view);
+	glm_perspective(camera->fovy, camera->aspect, camera->znear, camera->zfar, camera->proj);
+	camera->proj[1][1] *= -1;
+
+	camera->dirty = false;
+	++camera->version;
+	++camera->recomputes;
+	return true;
+}
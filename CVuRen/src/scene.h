@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vertexes.h"
+#include "transforms.h"
+#include "mesh.h"
+
+#define SCENE_NO_PARENT UINT32_MAX
+#define SCENE_NO_MESH UINT32_MAX
+
+/*
+ * Flat scene graph. Nodes are stored in topological order (a parent always
+ * has a lower index than its children), so one forward pass updates
+ * everything. Only nodes whose local transform changed, or whose parent's
+ * world matrix changed in the same pass, are recomputed.
+ */
+typedef struct Scene {
+	uint32_t count, capacity;
+	uint32_t* parent;
+	uint32_t* mesh;
+	TransformSoA local;
+	mat4* world;
+	uint8_t* dirty;
+	uint8_t* changed;
+	uint8_t* lod;
+	uint32_t* drawKey;
+
+	uint32_t renderableCount;
+
+	uint32_t recomputed;
+	uint64_t recomputedTotal;
+	uint64_t updates;
+} Scene;
+
+void sceneInit(Scene* scene, uint32_t capacity);
+void sceneFree(Scene* scene);
+uint32_t sceneAddNode(Scene* scene, uint32_t parent, uint32_t mesh,
+	const float position[3], const float rotation[4], const float scale[3]);
+void sceneSetLocal(Scene* scene, uint32_t node, const float position[3], const float rotation[4], const float scale[3]);
+void sceneRotateLocal(Scene* scene, uint32_t node, const float rotation[4]);
+/* the node stays clean when rotation is what it already has */
+void sceneSetRotation(Scene* scene, uint32_t node, const float rotation[4]);
+
+/* returns the number of nodes recomputed */
+uint32_t sceneUpdate(Scene* scene);
+
+/*
+ * Picks a lod for every node with a mesh and writes their world matrices
+ * grouped by mesh and lod, so each group is one instanced draw. batches needs
+ * room for meshCount * MESH_MAX_LODS entries. Returns the number of batches.
+ * instanceNodes gets the node of every instance written, it can be NULL.
+ */
+uint32_t sceneBuildDraws(Scene* scene, const Mesh* meshes, uint32_t meshCount, const Camera* camera,
+	float viewportHeight, InstanceData* instances, uint32_t* instanceNodes, DrawBatch* batches, DrawStats* stats);
+
+void scenePrintStats(const Scene* scene);
+
+/* view and projection are only rebuilt when something they depend on changes */
+typedef struct Camera {
+	vec3 eye, center, up;
+	float fovy, znear, zfar, aspect;
+
+	mat4 view, proj;
+	bool dirty;
+	uint32_t version;
+	uint32_t recomputes;
+} Camera;
+
+void cameraInit(Camera* camera, float fovy, float znear, float zfar);
+void cameraLookAt(Camera* camera, const vec3 eye, const vec3 center, const vec3 up);
+void cameraSetAspect(Camera* camera, float aspect);
+bool cameraUpdate(Camera* camera);
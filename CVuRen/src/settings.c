@@ -0,0 +1,32 @@
+#include "settings.h"
+
+#include "devices.h"
+
+struct SETTINGS SETTINGS = {
+	.meshOptimize = true,
+	.occlusionCulling = true,
+	.capture = false,
+	.captureRaw = false,
+	.overdraw = false,
+	.scene = 0,
+	.lightCount = 4096,
+	.spriteCount = 0,
+	.shadowCache = true,
+	.frameTargetMs = 0.0f,
+	.renderScale = 1.0f,
+	.upscaleSharpness = 0.0f,
+	.exposure = 0.0f,
+	.bloomStrength = 0.04f,
+	.lutPath = NULL,
+	.postNaive = false,
+	.overlay = true,
+	.viewCount = 1,
+	.cpuDevice = false,
+	.device = NULL,
+	.deviceTier = DEVICE_TIER_COUNT,
+	.regress = false,
+	.regressUpdate = false,
+	.regressSlack = 0.25f,
+	.memoryReportFrames = 0,
+	.tracePath = NULL
+};
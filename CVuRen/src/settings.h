@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* runtime switches, filled from the command line before anything starts */
+struct SETTINGS {
+	bool meshOptimize;
+	bool occlusionCulling;
+	/* every frame from the start, png unless captureRaw */
+	bool capture;
+	bool captureRaw;
+	/* draws the overdraw heatmap instead of the scene */
+	bool overdraw;
+	/* a SceneKind, what the renderer starts with */
+	uint32_t scene;
+	/* dynamic lights scattered over the scene, up to LIGHTING_MAX_LIGHTS */
+	uint32_t lightCount;
+	/* drifting 2D sprites drawn over the scene, up to SPRITE_MAX_SPRITES */
+	uint32_t spriteCount;
+	/* keeps still shadow casters in a per cascade cache instead of redrawing them every frame */
+	bool shadowCache;
+	/* gpu milliseconds the render scale is steered towards, 0 keeps it at renderScale */
+	float frameTargetMs;
+	/* share of the window per axis the scene is drawn at before upscaling */
+	float renderScale;
+	/* 0 upscales bilinear, up to 1 sharpens the result */
+	float upscaleSharpness;
+	/* in stops, applied before tonemapping */
+	float exposure;
+	/* share of the bloom chain mixed into the scene, 0 skips bloom */
+	float bloomStrength;
+	/* a .cube grading lut, NULL uses the built in one */
+	const char* lutPath;
+	/* runs the post stack as separate unfused passes, to measure against */
+	bool postNaive;
+	/* the stats panel over the output, never drawn in regression runs */
+	bool overlay;
+	/* windows the scene is shown in, each with its own camera, up to VIEW_MAX; never more than one in regression runs */
+	uint32_t viewCount;
+	/* prefers a software device over any gpu */
+	bool cpuDevice;
+	/* index or part of the name of the device to use, NULL picks the best scoring one */
+	const char* device;
+	/* a DeviceTier forced on the chosen device, DEVICE_TIER_COUNT leaves it to the device */
+	uint32_t deviceTier;
+	/* runs the regression suite instead of the main loop */
+	bool regress;
+	/* rewrites golden images and baselines instead of checking against them */
+	bool regressUpdate;
+	/* how much slower than the baseline a timing may get before it fails, 0.25 is 25% */
+	float regressSlack;
+	/* frames between gpu memory reports, 0 only reports at exit */
+	uint32_t memoryReportFrames;
+	/* chrome trace written here at exit, NULL leaves tracing off */
+	const char* tracePath;
+};
+
+extern struct SETTINGS SETTINGS;
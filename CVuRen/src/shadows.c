@@ -0,0 +1,723 @@
+#include "shadows.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vkthings.h"
+#include "vkcontext.h"
+#include "geometry.h"
+#include "pipelines.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+_Static_assert(sizeof(((UniformBufferObject*)0)->shadowMatrices) == sizeof(mat4) * SHADOW_CASCADES,
+    "the ubo has room for a different number of cascades");
+
+#define SHADOW_FRAME_QUERIES (SHADOW_CASCADES * 2)
+
+typedef struct ShadowCascade {
+    mat4 viewProj;
+    /* view depth the cascade ends at */
+    float farDepth;
+    /* world size of one texel */
+    float texelSize;
+} ShadowCascade;
+
+static struct SHADOWS {
+    VkFormat format;
+    VkImage maps, cache;
+    VkDeviceMemory mapsMemory, cacheMemory;
+    VkImageView mapsView;
+    VkImageView mapsLayerViews[SHADOW_CASCADES], cacheLayerViews[SHADOW_CASCADES];
+    VkFramebuffer mapsFramebuffers[SHADOW_CASCADES], cacheFramebuffers[SHADOW_CASCADES];
+    /* cache: clears and leaves it for the copy, maps: loads the copy, clear: for runs without the cache */
+    VkRenderPass cachePass, mapsPass, clearPass;
+    VkSampler sampler;
+
+    VkPipelineLayout layout;
+    PipelineHandle pipeline;
+
+    VkBuffer* casters;
+    VkDeviceMemory* castersMemory;
+    void** castersMapped;
+
+    VkQueryPool queries;
+    bool timestamps;
+    uint64_t validMask;
+    double timestampPeriod;
+    bool* queriesPending;
+
+    vec3 sunDirection, sunColor;
+    bool lightChanged;
+    mat4 lightView;
+    ShadowCascade cascades[SHADOW_CASCADES];
+    bool cacheValid[SHADOW_CASCADES];
+    /* SETTINGS.shadowCache until a heap goes over its budget and the cache is released */
+    bool cacheOn;
+    /* set by the budget callback on any thread, the render thread releases the cache */
+    volatile bool cacheReleaseRequested;
+
+    /* per scene node, unchanged frames up to SHADOW_STATIC_FRAMES and whether it's in the cache */
+    uint8_t still[MAX_INSTANCES];
+    uint8_t inStatic[MAX_INSTANCES];
+
+    /* static casters come first in the frame's instances, then the dynamic ones */
+    DrawBatch staticBatches[MAX_DRAW_BATCHES];
+    DrawBatch dynamicBatches[MAX_DRAW_BATCHES];
+    uint32_t staticBatchCount, dynamicBatchCount;
+    uint32_t staticInstances;
+
+    ShadowStats stats;
+} SHADOWS;
+
+static VkRenderPass createShadowPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout,
+    VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkAttachmentDescription depthAttachment = {
+        .flags = 0,
+        .format = SHADOWS.format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = loadOp,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = initialLayout,
+        .finalLayout = finalLayout
+    };
+    VkAttachmentReference depthAttachmentRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+    VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = 0,
+        .pColorAttachments = NULL,
+        .pResolveAttachments = NULL,
+        .pDepthStencilAttachment = &depthAttachmentRef,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL
+    };
+    VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    VkAccessFlags depthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    VkSubpassDependency dependencies[2] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = srcStage,
+            .dstStageMask = depthStages,
+            .srcAccessMask = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_ACCESS_TRANSFER_WRITE_BIT : 0,
+            .dstAccessMask = depthAccess,
+            .dependencyFlags = 0
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = depthStages,
+            .dstStageMask = dstStage,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = dstAccess,
+            .dependencyFlags = 0
+        }
+    };
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = 1,
+        .pAttachments = &depthAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 2,
+        .pDependencies = dependencies
+    };
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &renderPass) != VK_SUCCESS) {
+        c_throw("failed to create shadow render pass");
+    }
+    return renderPass;
+}
+
+static VkFramebuffer createShadowFramebuffer(VkRenderPass renderPass, VkImageView view) {
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = renderPass,
+        .attachmentCount = 1,
+        .pAttachments = &view,
+        .width = SHADOW_MAP_SIZE,
+        .height = SHADOW_MAP_SIZE,
+        .layers = 1
+    };
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, &framebuffer) != VK_SUCCESS) {
+        c_throw("failed to create shadow framebuffer");
+    }
+    return framebuffer;
+}
+
+static void createTargets() {
+    SHADOWS.format = findShadowFormat();
+    createImageLayers(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, SHADOWS.format, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENT, &SHADOWS.maps, &SHADOWS.mapsMemory);
+    createImageLayers(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, SHADOWS.format, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_ATTACHMENT, &SHADOWS.cache, &SHADOWS.cacheMemory);
+    SHADOWS.mapsView = createImageViewLayers(SHADOWS.maps, SHADOWS.format, VK_IMAGE_ASPECT_DEPTH_BIT,
+        VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, SHADOW_CASCADES);
+
+    SHADOWS.cachePass = createShadowPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    SHADOWS.mapsPass = createShadowPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    // the previous frame's scene pass may still be sampling the layer
+    SHADOWS.clearPass = createShadowPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        SHADOWS.mapsLayerViews[c] = createImageViewLayers(SHADOWS.maps, SHADOWS.format, VK_IMAGE_ASPECT_DEPTH_BIT,
+            VK_IMAGE_VIEW_TYPE_2D, c, 1);
+        SHADOWS.cacheLayerViews[c] = createImageViewLayers(SHADOWS.cache, SHADOWS.format, VK_IMAGE_ASPECT_DEPTH_BIT,
+            VK_IMAGE_VIEW_TYPE_2D, c, 1);
+        // the three passes are compatible, so the maps framebuffers serve the clear pass as well
+        SHADOWS.mapsFramebuffers[c] = createShadowFramebuffer(SHADOWS.mapsPass, SHADOWS.mapsLayerViews[c]);
+        SHADOWS.cacheFramebuffers[c] = createShadowFramebuffer(SHADOWS.cachePass, SHADOWS.cacheLayerViews[c]);
+    }
+
+    // nothing is shadowed until the first cascades are drawn
+    VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = SHADOW_CASCADES
+    };
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = SHADOWS.maps,
+        .subresourceRange = range
+    };
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &barrier);
+    VkClearDepthStencilValue clear = { 1.0f, 0 };
+    vkCmdClearDepthStencilImage(commandBuffer, SHADOWS.maps, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear, 1, &range);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 0, NULL, 0, NULL, 1, &barrier);
+    endSingleTimeCommands(commandBuffer);
+
+    // hardware pcf, and everything outside of a cascade is lit
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_TRUE,
+        .compareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &SHADOWS.sampler) != VK_SUCCESS) {
+        c_throw("failed to create shadow sampler");
+    }
+}
+
+static void createPipeline() {
+    VkPushConstantRange push = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(mat4)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 0,
+        .pSetLayouts = NULL,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &SHADOWS.layout) != VK_SUCCESS) {
+        c_throw("failed to create shadow pipeline layout");
+    }
+
+    PipelineDesc desc;
+    sceneVertexInput(&desc);
+    memset(desc.vertShader, 0, PIPELINE_SHADER_PATH);
+    strncpy(desc.vertShader, "shaders/shadow.spv", PIPELINE_SHADER_PATH - 1);
+    // the quads are one sided, the sun has to see their backs too
+    desc.cullMode = VK_CULL_MODE_NONE;
+    desc.depthBiasConstant = 1.25f;
+    desc.depthBiasSlope = 1.75f;
+    desc.renderPass = SHADOWS.cachePass;
+    desc.layout = SHADOWS.layout;
+    SHADOWS.pipeline = requestPipeline(&desc, PIPELINE_HANDLE_NONE);
+}
+
+static void createQueries() {
+    VkQueueFamilyProperties* families;
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, NULL);
+    families = malloc(sizeof(VkQueueFamilyProperties) * familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(VULKAN.physicalDevice, &familyCount, families);
+    uint32_t validBits = families[VULKAN.queueFamilies.graphicsFamily].timestampValidBits;
+    free(families);
+
+    SHADOWS.timestamps = validBits > 0;
+    SHADOWS.queriesPending = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(bool));
+    if (!SHADOWS.timestamps) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(VULKAN.physicalDevice, &properties);
+    SHADOWS.validMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    SHADOWS.timestampPeriod = (double)properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MAX_FRAMES_IN_FLIGHT * SHADOW_FRAME_QUERIES,
+        .pipelineStatistics = 0
+    };
+    if (vkCreateQueryPool(VULKAN.device, &poolInfo, NULL, &SHADOWS.queries) != VK_SUCCESS) {
+        c_throw("failed to create shadow timestamp query pool");
+    }
+}
+
+// the cache only saves redraws, so it's what goes first when device memory runs short
+static void onMemoryBudget(uint32_t heap, VkDeviceSize usage, VkDeviceSize budget, void* userData) {
+    if (getMemoryHeapStats(heap).deviceLocal) SHADOWS.cacheReleaseRequested = true;
+}
+
+// render thread, before the frame's casters are written
+static void releaseCache() {
+    // frames in flight may still be copying out of it
+    deviceIdle();
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        vkDestroyFramebuffer(VULKAN.device, SHADOWS.cacheFramebuffers[c], NULL);
+        vkDestroyImageView(VULKAN.device, SHADOWS.cacheLayerViews[c], NULL);
+        SHADOWS.cacheFramebuffers[c] = VK_NULL_HANDLE;
+        SHADOWS.cacheLayerViews[c] = VK_NULL_HANDLE;
+    }
+    vkDestroyImage(VULKAN.device, SHADOWS.cache, NULL);
+    freeDeviceMemory(SHADOWS.cacheMemory);
+    SHADOWS.cache = VK_NULL_HANDLE;
+    SHADOWS.cacheMemory = VK_NULL_HANDLE;
+
+    SHADOWS.cacheOn = false;
+    memset(SHADOWS.cacheValid, 0, sizeof(SHADOWS.cacheValid));
+    memoryRemoveBudgetCallback(onMemoryBudget, NULL);
+    printf("shadows: device memory over budget, the static caster cache is released\n");
+}
+
+void createShadowResources() {
+    SHADOWS.cacheOn = SETTINGS.shadowCache;
+    createTargets();
+    createPipeline();
+    createQueries();
+
+    SHADOWS.casters = malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
+    SHADOWS.castersMemory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    SHADOWS.castersMapped = malloc(sizeof(void*) * MAX_FRAMES_IN_FLIGHT);
+    VkDeviceSize size = sizeof(InstanceData) * MAX_INSTANCES;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_VERTEX, SHADOWS.casters + i, SHADOWS.castersMemory + i);
+        vkMapMemory(VULKAN.device, SHADOWS.castersMemory[i], 0, size, 0, SHADOWS.castersMapped + i);
+    }
+    if (SHADOWS.cacheOn) memoryAddBudgetCallback(onMemoryBudget, NULL);
+}
+
+void destroyShadowResources() {
+    if (SHADOWS.cacheOn) memoryRemoveBudgetCallback(onMemoryBudget, NULL);
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        vkDestroyFramebuffer(VULKAN.device, SHADOWS.mapsFramebuffers[c], NULL);
+        vkDestroyFramebuffer(VULKAN.device, SHADOWS.cacheFramebuffers[c], NULL);
+        vkDestroyImageView(VULKAN.device, SHADOWS.mapsLayerViews[c], NULL);
+        vkDestroyImageView(VULKAN.device, SHADOWS.cacheLayerViews[c], NULL);
+    }
+    vkDestroyImageView(VULKAN.device, SHADOWS.mapsView, NULL);
+    vkDestroyImage(VULKAN.device, SHADOWS.maps, NULL);
+    vkDestroyImage(VULKAN.device, SHADOWS.cache, NULL);
+    freeDeviceMemory(SHADOWS.mapsMemory);
+    freeDeviceMemory(SHADOWS.cacheMemory);
+    vkDestroyRenderPass(VULKAN.device, SHADOWS.cachePass, NULL);
+    vkDestroyRenderPass(VULKAN.device, SHADOWS.mapsPass, NULL);
+    vkDestroyRenderPass(VULKAN.device, SHADOWS.clearPass, NULL);
+    vkDestroySampler(VULKAN.device, SHADOWS.sampler, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, SHADOWS.layout, NULL);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyBuffer(VULKAN.device, SHADOWS.casters[i], NULL);
+        freeDeviceMemory(SHADOWS.castersMemory[i]);
+    }
+    free(SHADOWS.casters);
+    free(SHADOWS.castersMemory);
+    free(SHADOWS.castersMapped);
+
+    if (SHADOWS.timestamps) vkDestroyQueryPool(VULKAN.device, SHADOWS.queries, NULL);
+    free(SHADOWS.queriesPending);
+}
+
+void setShadowLight(const vec3 direction, const vec3 color) {
+    vec3 normalized;
+    glm_vec3_normalize_to((float*)direction, normalized);
+    if (memcmp(normalized, SHADOWS.sunDirection, sizeof(vec3)) != 0) {
+        glm_vec3_copy(normalized, SHADOWS.sunDirection);
+        SHADOWS.lightChanged = true;
+    }
+    // a new color only has to reach the ubo, the cascades stay put
+    if (memcmp(color, SHADOWS.sunColor, sizeof(vec3)) != 0) {
+        glm_vec3_copy((float*)color, SHADOWS.sunColor);
+        SHADOWS.lightChanged = true;
+    }
+}
+
+void invalidateShadowCache() {
+    memset(SHADOWS.still, 0, sizeof(SHADOWS.still));
+    memset(SHADOWS.inStatic, 0, sizeof(SHADOWS.inStatic));
+    memset(SHADOWS.cacheValid, 0, sizeof(SHADOWS.cacheValid));
+    SHADOWS.staticBatchCount = 0;
+    SHADOWS.staticInstances = 0;
+}
+
+/*
+ * The sphere around a frustum slice sits on the view axis at the depth that
+ * is as far from the near corners as from the far ones, or at the far plane
+ * when the slice is wider than it is deep.
+ */
+static void sliceSphere(const Camera* camera, float nearDepth, float farDepth, float* centerDepth, float* radius) {
+    float tanY = tanf(camera->fovy * 0.5f);
+    float tanX = tanY * camera->aspect;
+    float slope = tanX * tanX + tanY * tanY;
+    float center = 0.5f * (nearDepth + farDepth) * (1.0f + slope);
+    if (center > farDepth) center = farDepth;
+    float offset = nearDepth - center;
+    *centerDepth = center;
+    *radius = sqrtf(offset * offset + nearDepth * nearDepth * slope);
+}
+
+bool updateShadowCascades(const Camera* camera) {
+    bool lightChanged = SHADOWS.lightChanged;
+    if (lightChanged) {
+        vec3 origin = { 0.0f, 0.0f, 0.0f };
+        vec3 up = { 0.0f, 0.0f, 1.0f };
+        if (fabsf(SHADOWS.sunDirection[2]) > 0.99f) {
+            up[1] = 1.0f;
+            up[2] = 0.0f;
+        }
+        glm_lookat(origin, SHADOWS.sunDirection, up, SHADOWS.lightView);
+        SHADOWS.lightChanged = false;
+    }
+
+    mat4 invView;
+    glm_mat4_inv((vec4*)camera->view, invView);
+
+    float nearDepth = camera->znear;
+    float farDepth = fminf(SHADOW_DISTANCE, camera->zfar);
+    float sliceNear = nearDepth;
+    bool moved = lightChanged;
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        float t = (float)(c + 1) / (float)SHADOW_CASCADES;
+        float logSplit = nearDepth * powf(farDepth / nearDepth, t);
+        float uniformSplit = nearDepth + (farDepth - nearDepth) * t;
+        float sliceFar = SHADOW_SPLIT_LAMBDA * logSplit + (1.0f - SHADOW_SPLIT_LAMBDA) * uniformSplit;
+
+        float centerDepth, radius;
+        sliceSphere(camera, sliceNear, sliceFar, &centerDepth, &radius);
+        // whole sixteenths, so float noise in the fit never resizes the cascade
+        radius = ceilf(radius * 16.0f) / 16.0f;
+        float texel = 2.0f * radius / (float)SHADOW_MAP_SIZE;
+
+        vec4 center = { 0.0f, 0.0f, -centerDepth, 1.0f };
+        vec4 world, light;
+        glm_mat4_mulv(invView, center, world);
+        glm_mat4_mulv(SHADOWS.lightView, world, light);
+        for (uint32_t i = 0; i < 3; ++i) {
+            light[i] = floorf(light[i] / texel) * texel;
+        }
+
+        mat4 proj;
+        glm_ortho(light[0] - radius, light[0] + radius, light[1] - radius, light[1] + radius,
+            -light[2] - radius - SHADOW_CASTER_REACH, -light[2] + radius, proj);
+        ShadowCascade* cascade = SHADOWS.cascades + c;
+        mat4 viewProj;
+        glm_mat4_mul(proj, SHADOWS.lightView, viewProj);
+        if (memcmp(viewProj, cascade->viewProj, sizeof(mat4)) != 0) {
+            glm_mat4_copy(viewProj, cascade->viewProj);
+            SHADOWS.cacheValid[c] = false;
+            moved = true;
+        }
+        cascade->farDepth = sliceFar;
+        cascade->texelSize = texel;
+        sliceNear = sliceFar;
+    }
+    return moved;
+}
+
+// counting sort by mesh and lod, like sceneBuildDraws, static casters always go out at lod 0
+static uint32_t writeCasterBatches(const Scene* scene, bool staticCasters, InstanceData* instances,
+    uint32_t firstInstance, DrawBatch* batches) {
+    uint32_t keyCount = VULKAN.meshCount * MESH_MAX_LODS;
+    for (uint32_t k = 0; k < keyCount; ++k) {
+        batches[k] = (DrawBatch){ k / MESH_MAX_LODS, k % MESH_MAX_LODS, 0, 0 };
+    }
+    for (uint32_t i = 0; i < scene->count; ++i) {
+        if (scene->mesh[i] == SCENE_NO_MESH || SHADOWS.inStatic[i] != staticCasters) continue;
+        ++batches[scene->mesh[i] * MESH_MAX_LODS + (staticCasters ? 0 : scene->lod[i])].instanceCount;
+    }
+
+    uint32_t first = firstInstance;
+    for (uint32_t k = 0; k < keyCount; ++k) {
+        batches[k].firstInstance = first;
+        first += batches[k].instanceCount;
+        batches[k].instanceCount = 0;
+    }
+    for (uint32_t i = 0; i < scene->count; ++i) {
+        if (scene->mesh[i] == SCENE_NO_MESH || SHADOWS.inStatic[i] != staticCasters) continue;
+        DrawBatch* batch = batches + scene->mesh[i] * MESH_MAX_LODS + (staticCasters ? 0 : scene->lod[i]);
+        memcpy(instances[batch->firstInstance + batch->instanceCount++].model, scene->world[i], sizeof(mat4));
+    }
+
+    uint32_t batchCount = 0;
+    for (uint32_t k = 0; k < keyCount; ++k) {
+        if (batches[k].instanceCount) batches[batchCount++] = batches[k];
+    }
+    return batchCount;
+}
+
+void writeShadowCasters(uint32_t frame, const Scene* scene) {
+    if (SHADOWS.cacheReleaseRequested && SHADOWS.cacheOn) releaseCache();
+
+    bool setChanged = false;
+    uint32_t staticCount = 0;
+    for (uint32_t i = 0; i < scene->count; ++i) {
+        if (scene->mesh[i] == SCENE_NO_MESH) continue;
+        if (scene->changed[i]) {
+            SHADOWS.still[i] = 0;
+        } else if (SHADOWS.still[i] < SHADOW_STATIC_FRAMES) {
+            ++SHADOWS.still[i];
+        }
+        // without the cache everything is drawn every frame, the way it would be without this pass
+        uint8_t isStatic = SHADOWS.cacheOn && SHADOWS.still[i] >= SHADOW_STATIC_FRAMES;
+        if (isStatic != SHADOWS.inStatic[i]) {
+            SHADOWS.inStatic[i] = isStatic;
+            setChanged = true;
+        }
+        staticCount += isStatic;
+    }
+    if (setChanged) {
+        memset(SHADOWS.cacheValid, 0, sizeof(SHADOWS.cacheValid));
+        SHADOWS.staticInstances = staticCount;
+        ++SHADOWS.stats.staticSetChanges;
+    }
+
+    InstanceData* instances = SHADOWS.castersMapped[frame];
+    bool redraw = false;
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        redraw |= !SHADOWS.cacheValid[c];
+    }
+    // the static instances only matter to a frame that redraws the cache
+    if (redraw && SHADOWS.cacheOn) {
+        SHADOWS.staticBatchCount = writeCasterBatches(scene, true, instances, 0, SHADOWS.staticBatches);
+    }
+    SHADOWS.dynamicBatchCount = writeCasterBatches(scene, false, instances, SHADOWS.staticInstances,
+        SHADOWS.dynamicBatches);
+
+    SHADOWS.stats.staticCasters = SHADOWS.staticInstances;
+    SHADOWS.stats.dynamicCasters = scene->renderableCount - SHADOWS.staticInstances;
+}
+
+void writeShadowUniforms(const Camera* camera, UniformBufferObject* ubo) {
+    // the scene shaders shade in view space, so the matrices start from there
+    mat4 invView;
+    glm_mat4_inv((vec4*)camera->view, invView);
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        glm_mat4_mul(SHADOWS.cascades[c].viewProj, invView, ubo->shadowMatrices[c]);
+        ubo->cascadeSplits[c] = SHADOWS.cascades[c].farDepth;
+        ubo->cascadeTexels[c] = SHADOWS.cascades[c].texelSize;
+    }
+    vec3 toSun;
+    glm_vec3_negate_to(SHADOWS.sunDirection, toSun);
+    glm_mat4_mulv3((vec4*)camera->view, toSun, 0.0f, ubo->sunDirection);
+    ubo->sunDirection[3] = 0.0f;
+    glm_vec3_copy(SHADOWS.sunColor, ubo->sunColor);
+    ubo->sunColor[3] = 1.0f;
+}
+
+static void drawCasters(VkCommandBuffer commandBuffer, uint32_t frame, VkRenderPass renderPass,
+    VkFramebuffer framebuffer, uint32_t cascade, const DrawBatch* batches, uint32_t batchCount) {
+    VkClearValue clear = { .depthStencil = { 1.0f, 0 } };
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = renderPass,
+        .framebuffer = framebuffer,
+        .renderArea = {
+            .offset = {0,0},
+            .extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE }
+        },
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (batchCount) {
+        VkViewport viewport = { 0.0f, 0.0f, (float)SHADOW_MAP_SIZE, (float)SHADOW_MAP_SIZE, 0.0f, 1.0f };
+        VkRect2D scissor = { {0,0}, { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE } };
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(SHADOWS.pipeline));
+        vkCmdPushConstants(commandBuffer, SHADOWS.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4),
+            SHADOWS.cascades[cascade].viewProj);
+        bindGeometry(commandBuffer);
+        VkDeviceSize instanceOffset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, SHADOWS.casters + frame, &instanceOffset);
+        for (uint32_t b = 0; b < batchCount; ++b) {
+            const DrawBatch* batch = batches + b;
+            const Mesh* mesh = VULKAN.meshes + batch->mesh;
+            const MeshLod* lod = mesh->lods + batch->lod;
+            vkCmdDrawIndexed(commandBuffer, lod->indexCount, batch->instanceCount, lod->firstIndex,
+                mesh->vertexOffset, batch->firstInstance);
+        }
+    }
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+static void copyCacheLayer(VkCommandBuffer commandBuffer, uint32_t cascade) {
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = SHADOWS.maps,
+        .subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, cascade, 1 }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &barrier);
+
+    VkImageCopy region = {
+        .srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, cascade, 1 },
+        .srcOffset = { 0, 0, 0 },
+        .dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, cascade, 1 },
+        .dstOffset = { 0, 0, 0 },
+        .extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 }
+    };
+    vkCmdCopyImage(commandBuffer, SHADOWS.cache, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        SHADOWS.maps, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void recordShadows(VkCommandBuffer commandBuffer, uint32_t frame) {
+    // still compiling, the maps keep whatever they had and the scene samples that
+    if (getPipeline(SHADOWS.pipeline) == VK_NULL_HANDLE) return;
+
+    uint32_t firstQuery = frame * SHADOW_FRAME_QUERIES;
+    if (SHADOWS.timestamps) vkCmdResetQueryPool(commandBuffer, SHADOWS.queries, firstQuery, SHADOW_FRAME_QUERIES);
+
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        if (SHADOWS.timestamps) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, SHADOWS.queries, firstQuery + 2 * c);
+        }
+
+        if (!SHADOWS.cacheOn) {
+            drawCasters(commandBuffer, frame, SHADOWS.clearPass, SHADOWS.mapsFramebuffers[c], c,
+                SHADOWS.dynamicBatches, SHADOWS.dynamicBatchCount);
+        } else {
+            if (SHADOWS.cacheValid[c]) {
+                ++SHADOWS.stats.cacheHits[c];
+            } else {
+                drawCasters(commandBuffer, frame, SHADOWS.cachePass, SHADOWS.cacheFramebuffers[c], c,
+                    SHADOWS.staticBatches, SHADOWS.staticBatchCount);
+                SHADOWS.cacheValid[c] = true;
+                ++SHADOWS.stats.cacheMisses[c];
+            }
+            copyCacheLayer(commandBuffer, c);
+            drawCasters(commandBuffer, frame, SHADOWS.mapsPass, SHADOWS.mapsFramebuffers[c], c,
+                SHADOWS.dynamicBatches, SHADOWS.dynamicBatchCount);
+        }
+
+        if (SHADOWS.timestamps) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, SHADOWS.queries,
+                firstQuery + 2 * c + 1);
+        }
+    }
+    SHADOWS.queriesPending[frame] = SHADOWS.timestamps;
+}
+
+VkImageView shadowMapView() {
+    return SHADOWS.mapsView;
+}
+
+VkSampler shadowMapSampler() {
+    return SHADOWS.sampler;
+}
+
+void collectShadowStats(uint32_t frame) {
+    if (!SHADOWS.queriesPending[frame]) return;
+    SHADOWS.queriesPending[frame] = false;
+
+    uint64_t results[SHADOW_FRAME_QUERIES];
+    if (vkGetQueryPoolResults(VULKAN.device, SHADOWS.queries, frame * SHADOW_FRAME_QUERIES, SHADOW_FRAME_QUERIES,
+        sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        uint64_t ticks = (results[2 * c + 1] - results[2 * c]) & SHADOWS.validMask;
+        SHADOWS.stats.timeTotalNs[c] += (uint64_t)((double)ticks * SHADOWS.timestampPeriod);
+        ++SHADOWS.stats.timedFrames[c];
+    }
+}
+
+ShadowStats getShadowStats() {
+    return SHADOWS.stats;
+}
+
+void printShadowStats() {
+    const ShadowStats* stats = &SHADOWS.stats;
+    printf("shadows: %u cascades of %ux%u, %u static and %u dynamic casters, static set changed %llu times%s\n",
+        SHADOW_CASCADES, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, stats->staticCasters, stats->dynamicCasters,
+        (unsigned long long)stats->staticSetChanges,
+        SHADOWS.cacheOn ? "" : SETTINGS.shadowCache ? ", cache released over the memory budget" : ", cache off");
+    for (uint32_t c = 0; c < SHADOW_CASCADES; ++c) {
+        uint64_t lookups = stats->cacheHits[c] + stats->cacheMisses[c];
+        printf("\tcascade %u: to %.2f, %.3f ms gpu on average, cache hit rate %.1f%% (%llu redraws)\n",
+            c, SHADOWS.cascades[c].farDepth,
+            stats->timedFrames[c] ? (double)stats->timeTotalNs[c] / (double)stats->timedFrames[c] / 1e6 : 0.0,
+            lookups ? 100.0 * (double)stats->cacheHits[c] / (double)lookups : 0.0,
+            (unsigned long long)stats->cacheMisses[c]);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scene.h"
+
+#define SHADOW_CASCADES 4
+#define SHADOW_MAP_SIZE 2048
+/* view depth the last cascade ends at, the rest of the frustum is unshadowed */
+#define SHADOW_DISTANCE 12.0f
+/* blend of logarithmic (1) and uniform (0) splits */
+#define SHADOW_SPLIT_LAMBDA 0.8f
+/* how far behind a cascade, towards the sun, casters still land in it */
+#define SHADOW_CASTER_REACH 8.0f
+/* frames a caster has to stay put before it moves into the cache */
+#define SHADOW_STATIC_FRAMES 16
+
+typedef struct ShadowStats {
+    uint32_t staticCasters, dynamicCasters;
+    /* times a caster moved into or out of the static set, each one clears the cache */
+    uint64_t staticSetChanges;
+
+    uint64_t cacheHits[SHADOW_CASCADES], cacheMisses[SHADOW_CASCADES];
+    uint64_t timedFrames[SHADOW_CASCADES];
+    uint64_t timeTotalNs[SHADOW_CASCADES];
+} ShadowStats;
+
+/*
+ * Cascaded shadow maps for one directional light. The frustum up to
+ * SHADOW_DISTANCE is split into SHADOW_CASCADES slices, each covered by the
+ * bounding sphere of the slice, so a cascade keeps its size while the camera
+ * turns, and its center is snapped to whole texels in light space, so the
+ * edges don't shimmer as the camera moves.
+ *
+ * Casters that haven't moved for SHADOW_STATIC_FRAMES are static. They are
+ * rendered into a cache layer per cascade, which is only redrawn when the
+ * cascade moves by a texel, the light changes or the static set does. Every
+ * frame the cache is copied into the sampled maps and the dynamic casters
+ * are drawn on top. A device heap going over its memory budget releases the
+ * cache for the rest of the run and every caster is drawn each frame.
+ * Casters aren't culled per cascade, the clipper does it.
+ */
+void createShadowResources();
+void destroyShadowResources();
+
+/* the sun travels along direction, color is premultiplied by the intensity */
+void setShadowLight(const vec3 direction, const vec3 color);
+/* the scene was replaced, nothing about the old casters holds */
+void invalidateShadowCache();
+
+/* refits the cascades after cameraUpdate, true when one of them moved */
+bool updateShadowCascades(const Camera* camera);
+/* sorts the casters into static and dynamic after sceneUpdate and writes the frame's instances */
+void writeShadowCasters(uint32_t frame, const Scene* scene);
+void writeShadowUniforms(const Camera* camera, UniformBufferObject* ubo);
+
+/* outside of a render pass, before the scene samples the maps */
+void recordShadows(VkCommandBuffer commandBuffer, uint32_t frame);
+
+/* bound to the scene descriptor sets at 5 */
+VkImageView shadowMapView();
+VkSampler shadowMapSampler();
+
+/* call after the frame's fence wait */
+void collectShadowStats(uint32_t frame);
+ShadowStats getShadowStats();
+void printShadowStats();
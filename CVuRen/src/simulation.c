@@ -0,0 +1,168 @@
+#include "simulation.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "utils/threading.h"
+#include "utils/trace.h"
+#include "utils/utils.h"
+
+/* per tick, what used to be per frame before the simulation had its own clock */
+#define SPIN_DEGREES 3.0f
+#define ORBIT_DEGREES 0.5f
+
+/* set on the ready slot when it holds a snapshot the reader hasn't taken yet */
+#define SLOT_FRESH 4
+
+typedef struct SimSnapshot {
+	SimState previous, current;
+	/* when current is due, previous is a step before it */
+	uint64_t time;
+} SimSnapshot;
+
+static struct SIMULATION {
+	SimSnapshot slots[3];
+	/* the simulation owns writing, the render side owns reading, ready is swapped between them */
+	int32_t writing, reading;
+	volatile int32_t ready;
+
+	/* simulation side */
+	SimState state;
+	uint64_t time;
+
+	bool threaded;
+	volatile int32_t running;
+	c_thread thread;
+
+	SimulationStats stats;
+} SIMULATION;
+
+static void advance(SimState* state) {
+	versor step, spin;
+	glm_quatv(step, glm_rad(SPIN_DEGREES), (vec3){ 0.0f, 0.0f, 1.0f });
+	glm_quat_mul(step, state->spin, spin);
+	glm_quat_normalize(spin);
+	glm_vec4_copy(spin, state->spin);
+
+	state->lightOrbit += glm_rad(ORBIT_DEGREES);
+	if (state->lightOrbit >= GLM_PIf * 2.0f) state->lightOrbit -= GLM_PIf * 2.0f;
+	++state->tick;
+}
+
+// the writes to the slot are done before the exchange hands it over, Interlocked ops are full barriers
+static void publish(const SimState* previous, uint64_t time) {
+	SimSnapshot* snapshot = SIMULATION.slots + SIMULATION.writing;
+	snapshot->previous = *previous;
+	snapshot->current = SIMULATION.state;
+	snapshot->time = time;
+	SIMULATION.writing = c_atomic_exchange(&SIMULATION.ready, SIMULATION.writing | SLOT_FRESH) & ~SLOT_FRESH;
+}
+
+static void tick(uint64_t time) {
+	TRACE_BEGIN("tick");
+	SimState previous = SIMULATION.state;
+	advance(&SIMULATION.state);
+	SIMULATION.time = time;
+	publish(&previous, time);
+	++SIMULATION.stats.ticks;
+	TRACE_END();
+}
+
+void simulationReset() {
+	memset(&SIMULATION.state, 0, sizeof(SimState));
+	glm_quat_identity(SIMULATION.state.spin);
+	SIMULATION.time = getTimeInNanoseconds();
+
+	SIMULATION.writing = 0;
+	SIMULATION.ready = 1;
+	SIMULATION.reading = 2;
+	publish(&SIMULATION.state, SIMULATION.time);
+}
+
+void simulationStep() {
+	tick(SIMULATION.time + SIMULATION_STEP_NS);
+}
+
+static void simulationLoop(void* arg) {
+	TRACE_THREAD_NAME("simulation");
+	uint64_t next = SIMULATION.time + SIMULATION_STEP_NS;
+	while (c_atomic_load(&SIMULATION.running)) {
+		uint64_t now = getTimeInNanoseconds();
+		if (now < next) {
+			c_sleep_ns(next - now);
+			continue;
+		}
+
+		// after a stall the ticks past the cap are skipped, so the newest one lands close to now
+		uint64_t due = (now - next) / SIMULATION_STEP_NS + 1;
+		if (due > SIMULATION_MAX_STEPS) {
+			uint64_t dropped = due - SIMULATION_MAX_STEPS;
+			SIMULATION.stats.droppedTicks += dropped;
+			next += dropped * SIMULATION_STEP_NS;
+			due = SIMULATION_MAX_STEPS;
+		}
+		for (uint64_t i = 0; i < due; ++i) {
+			tick(next);
+			next += SIMULATION_STEP_NS;
+		}
+	}
+}
+
+void simulationStart() {
+	if (SIMULATION.threaded) return;
+	SIMULATION.threaded = true;
+	c_atomic_store(&SIMULATION.running, 1);
+	SIMULATION.thread = c_thread_start(simulationLoop, NULL);
+}
+
+void simulationStop() {
+	if (!SIMULATION.threaded) return;
+	c_atomic_store(&SIMULATION.running, 0);
+	c_thread_join(SIMULATION.thread);
+	SIMULATION.threaded = false;
+}
+
+void simulationSample(uint64_t now, SimState* state) {
+	if (c_atomic_load(&SIMULATION.ready) & SLOT_FRESH) {
+		SIMULATION.reading = c_atomic_exchange(&SIMULATION.ready, SIMULATION.reading) & ~SLOT_FRESH;
+		++SIMULATION.stats.snapshotsTaken;
+	}
+	const SimSnapshot* snapshot = SIMULATION.slots + SIMULATION.reading;
+	++SIMULATION.stats.samples;
+
+	if (!SIMULATION.threaded) {
+		*state = snapshot->current;
+		return;
+	}
+
+	// drawn a tick late, so between the two states there's always a newer one to head for
+	float alpha = now > snapshot->time ? (float)((double)(now - snapshot->time) / (double)SIMULATION_STEP_NS) : 0.0f;
+	if (alpha > 1.0f) {
+		// the simulation is late, hold the newest state rather than guess past it
+		alpha = 1.0f;
+		++SIMULATION.stats.clampedSamples;
+	}
+
+	const SimState* from = &snapshot->previous;
+	const SimState* to = &snapshot->current;
+	state->tick = to->tick;
+	glm_quat_slerp((float*)from->spin, (float*)to->spin, alpha, state->spin);
+	float travelled = to->lightOrbit - from->lightOrbit;
+	if (travelled < 0.0f) travelled += GLM_PIf * 2.0f;
+	state->lightOrbit = from->lightOrbit + travelled * alpha;
+}
+
+SimulationStats getSimulationStats() {
+	return SIMULATION.stats;
+}
+
+void printSimulationStats() {
+	const SimulationStats* stats = &SIMULATION.stats;
+	printf("simulation: %llu ticks at %u Hz, %llu dropped\n",
+		(unsigned long long)stats->ticks, SIMULATION_HZ, (unsigned long long)stats->droppedTicks);
+	if (stats->samples) {
+		printf("\t%llu frames sampled %llu snapshots, %.1f%% of them past the newest tick\n",
+			(unsigned long long)stats->samples, (unsigned long long)stats->snapshotsTaken,
+			100.0 * (double)stats->clampedSamples / (double)stats->samples);
+	}
+}
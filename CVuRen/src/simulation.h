@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cglm/cglm.h"
+
+#define SIMULATION_HZ 60
+#define SIMULATION_STEP_NS (1000000000ull / SIMULATION_HZ)
+/* a stall longer than this many ticks is dropped instead of caught up */
+#define SIMULATION_MAX_STEPS 8
+
+/* what the world looks like after a tick, everything the render side animates from */
+typedef struct SimState {
+	uint64_t tick;
+	/* the scene root's rotation */
+	versor spin;
+	/* radians the lights have travelled from where they were scattered, in [0, 2pi) */
+	float lightOrbit;
+} SimState;
+
+typedef struct SimulationStats {
+	uint64_t ticks, droppedTicks;
+	/* snapshots the render side picked up, and frames it drew past the newest one */
+	uint64_t snapshotsTaken, samples, clampedSamples;
+} SimulationStats;
+
+/*
+ * Fixed timestep simulation. It either runs on a thread of its own, ticking
+ * at SIMULATION_HZ whatever the frame rate is, or in lockstep with the frames,
+ * one simulationStep() per frame, which regression runs use to stay
+ * deterministic. Each tick publishes an immutable snapshot of the previous
+ * and the new state through a triple buffer: the simulation always has a slot
+ * to write, the render side always has one to read, and the third holds the
+ * newest, so neither side ever waits on the other. The render side draws a
+ * tick behind and blends between the two states by how far into the tick it
+ * is, so motion stays smooth when the frame rate doesn't divide the tick rate.
+ */
+
+/* back to the first tick, only while the thread isn't running */
+void simulationReset();
+/* one tick on the calling thread, for lockstep runs */
+void simulationStep();
+
+void simulationStart();
+void simulationStop();
+
+/* the state to draw at now, interpolated when the simulation runs on its thread; render thread only */
+void simulationSample(uint64_t now, SimState* state);
+
+SimulationStats getSimulationStats();
+void printSimulationStats();
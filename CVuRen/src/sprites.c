@@ -0,0 +1,725 @@
+#include "sprites.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "resolution.h"
+#include "settings.h"
+#include "simulation.h"
+#include "vkthings.h"
+
+#include "utils/threading.h"
+#include "utils/trace.h"
+#include "utils/utils.h"
+
+/* sprites one claim of the field animation covers */
+#define SPRITE_CHUNK 16384
+/* how far past the window edges the field wraps, so sprites leave before they reappear */
+#define SPRITE_FIELD_MARGIN 32.0f
+#define SPRITE_PI 3.14159265f
+
+typedef struct SpriteParams {
+    /* 2 / the output extent, pixels to clip space */
+    float scale[2];
+} SpriteParams;
+
+static struct SPRITES {
+    bool active;
+    uint32_t capacity;
+
+    VkImage texture;
+    VkDeviceMemory textureMemory;
+    VkImageView textureView;
+    VkSampler sampler;
+
+    VkRenderPass renderPass;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet* sets;
+    PipelineHandle pipeline;
+    VkFramebuffer framebuffer;
+
+    VkBuffer* buffers;
+    VkDeviceMemory* buffersMemory;
+    Sprite** mapped;
+    uint32_t* counts;
+
+    /* the frame being written */
+    uint32_t frame, used;
+    uint64_t writeStart;
+
+    /* the field, chunks go to whoever claims them first */
+    Sprite* field;
+    uint32_t fieldCount;
+    /* from spritesSetField, taken up by the next spritesBegin */
+    uint32_t fieldRequest;
+    bool fieldReset;
+    /* frames since the field was set, its clock in regression runs */
+    uint64_t fieldFrames;
+    int32_t chunkCount;
+    volatile int32_t nextChunk, doneChunks;
+    c_mutex lock;
+    c_cond done;
+    float time, extent[2];
+    uint64_t startNs;
+
+    SpriteStats stats;
+} SPRITES;
+
+static float unorm(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// coverage of the layer's shape at p, which spans -1..1 over the cell
+static float shapeCoverage(uint32_t layer, float x, float y) {
+    float r = sqrtf(x * x + y * y);
+    switch (layer) {
+    case 0: // disc
+        return r < 0.9f ? 1.0f : 0.0f;
+    case 1: // ring
+        return r < 0.9f && r > 0.6f ? 1.0f : 0.0f;
+    case 2: // square
+        return fabsf(x) < 0.8f && fabsf(y) < 0.8f ? 1.0f : 0.0f;
+    case 3: // diamond
+        return fabsf(x) + fabsf(y) < 0.9f ? 1.0f : 0.0f;
+    case 4: // cross
+        return (fabsf(x) < 0.25f || fabsf(y) < 0.25f) && fabsf(x) < 0.9f && fabsf(y) < 0.9f ? 1.0f : 0.0f;
+    case 5: // soft glow
+        return unorm(1.0f - r) * unorm(1.0f - r);
+    case 6: // triangle, pointing up
+        return y > -0.7f && fabsf(x) * 1.7f < y + 0.7f && y < 0.9f ? 1.0f : 0.0f;
+    default: { // five pointed star
+        float angle = atan2f(x, y);
+        float spike = 0.5f + 0.5f * cosf(5.0f * angle);
+        return r < 0.4f + 0.5f * spike * spike ? 1.0f : 0.0f;
+    }
+    }
+}
+
+// every level is rasterized on its own, 4x4 samples a texel, which box filters it the same as a downsample would
+static void createTexture() {
+    VkDeviceSize bytes = 0;
+    for (uint32_t mip = 0; mip < SPRITE_TEXTURE_MIPS; ++mip) {
+        uint32_t size = SPRITE_TEXTURE_SIZE >> mip;
+        bytes += (VkDeviceSize)size * size * 4 * SPRITE_TEXTURE_LAYERS;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, &stagingBuffer, &stagingBufferMemory);
+    uint8_t* data;
+    vkMapMemory(VULKAN.device, stagingBufferMemory, 0, bytes, 0, (void**)&data);
+
+    VkBufferImageCopy regions[SPRITE_TEXTURE_MIPS];
+    VkDeviceSize offset = 0;
+    for (uint32_t mip = 0; mip < SPRITE_TEXTURE_MIPS; ++mip) {
+        uint32_t size = SPRITE_TEXTURE_SIZE >> mip;
+        regions[mip] = (VkBufferImageCopy){
+            .bufferOffset = offset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, SPRITE_TEXTURE_LAYERS },
+            .imageOffset = { 0, 0, 0 },
+            .imageExtent = { size, size, 1 }
+        };
+        for (uint32_t layer = 0; layer < SPRITE_TEXTURE_LAYERS; ++layer) {
+            for (uint32_t y = 0; y < size; ++y) {
+                for (uint32_t x = 0; x < size; ++x) {
+                    float coverage = 0.0f;
+                    for (uint32_t s = 0; s < 16; ++s) {
+                        float u = ((float)x + ((float)(s & 3) + 0.5f) / 4.0f) / (float)size * 2.0f - 1.0f;
+                        float v = ((float)y + ((float)(s >> 2) + 0.5f) / 4.0f) / (float)size * 2.0f - 1.0f;
+                        coverage += shapeCoverage(layer, u, -v);
+                    }
+                    // white, the sprite's color tints it
+                    uint8_t* texel = data + offset + 4 * (y * size + x);
+                    texel[0] = texel[1] = texel[2] = 255;
+                    texel[3] = (uint8_t)(coverage / 16.0f * 255.0f + 0.5f);
+                }
+            }
+            offset += (VkDeviceSize)size * size * 4;
+        }
+    }
+    vkUnmapMemory(VULKAN.device, stagingBufferMemory);
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = SPRITE_TEXTURE_FORMAT,
+        .extent = { SPRITE_TEXTURE_SIZE, SPRITE_TEXTURE_SIZE, 1 },
+        .mipLevels = SPRITE_TEXTURE_MIPS,
+        .arrayLayers = SPRITE_TEXTURE_LAYERS,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = NULL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    if (vkCreateImage(VULKAN.device, &imageInfo, NULL, &SPRITES.texture) != VK_SUCCESS) {
+        c_throw("failed to create sprite texture");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(VULKAN.device, SPRITES.texture, &requirements);
+    if (!allocateDeviceMemory(requirements.size, findMemoryType(requirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), MEMORY_CATEGORY_TEXTURE, &SPRITES.textureMemory)) {
+        c_throw("failed to allocate sprite texture memory");
+    }
+    vkBindImageMemory(VULKAN.device, SPRITES.texture, SPRITES.textureMemory, 0);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = SPRITES.texture,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = SPRITE_TEXTURE_MIPS,
+            .baseArrayLayer = 0,
+            .layerCount = SPRITE_TEXTURE_LAYERS
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &toTransfer);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, SPRITES.texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        SPRITE_TEXTURE_MIPS, regions);
+    VkImageMemoryBarrier toShader = toTransfer;
+    toShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 0, NULL, 0, NULL, 1, &toShader);
+    endSingleTimeCommands(commandBuffer);
+
+    vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
+    freeDeviceMemory(stagingBufferMemory);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = SPRITES.texture,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = SPRITE_TEXTURE_FORMAT,
+        .components = {
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = toTransfer.subresourceRange
+    };
+    if (vkCreateImageView(VULKAN.device, &viewInfo, NULL, &SPRITES.textureView) != VK_SUCCESS) {
+        c_throw("failed to create sprite texture view");
+    }
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = (float)SPRITE_TEXTURE_MIPS,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    if (vkCreateSampler(VULKAN.device, &samplerInfo, NULL, &SPRITES.sampler) != VK_SUCCESS) {
+        c_throw("failed to create sprite sampler");
+    }
+}
+
+static void createRenderPass() {
+    // loads what the scene left and hands it on sampled, the same as the scene pass does
+    VkAttachmentDescription colorAttachment = {
+        .flags = 0,
+        .format = RESOLUTION_COLOR_FORMAT,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkAttachmentReference colorRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+    VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRef,
+        .pResolveAttachments = NULL,
+        .pDepthStencilAttachment = NULL,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL
+    };
+    VkSubpassDependency dependencies[2] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = 0
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .dependencyFlags = 0
+        }
+    };
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = 1,
+        .pAttachments = &colorAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 2,
+        .pDependencies = dependencies
+    };
+    if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &SPRITES.renderPass) != VK_SUCCESS) {
+        c_throw("failed to create sprite render pass");
+    }
+}
+
+static void createDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = NULL
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = NULL
+        }
+    };
+    VkDescriptorSetLayoutCreateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = 2,
+        .pBindings = bindings
+    };
+    if (vkCreateDescriptorSetLayout(VULKAN.device, &setInfo, NULL, &SPRITES.setLayout) != VK_SUCCESS) {
+        c_throw("failed to create sprite descriptor set layout");
+    }
+
+    VkPushConstantRange push = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(SpriteParams)
+    };
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &SPRITES.setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push
+    };
+    if (vkCreatePipelineLayout(VULKAN.device, &layoutInfo, NULL, &SPRITES.layout) != VK_SUCCESS) {
+        c_throw("failed to create sprite pipeline layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &SPRITES.pool) != VK_SUCCESS) {
+        c_throw("failed to create sprite descriptor pool");
+    }
+
+    VkDescriptorSetLayout* layouts = malloc(sizeof(VkDescriptorSetLayout) * MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) layouts[i] = SPRITES.setLayout;
+    SPRITES.sets = malloc(sizeof(VkDescriptorSet) * MAX_FRAMES_IN_FLIGHT);
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = SPRITES.pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = layouts
+    };
+    if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, SPRITES.sets) != VK_SUCCESS) {
+        c_throw("failed to allocate sprite descriptor sets");
+    }
+    free(layouts);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        VkDescriptorBufferInfo bufferInfo = {
+            .buffer = SPRITES.buffers[i],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+        VkDescriptorImageInfo imageInfo = {
+            .sampler = SPRITES.sampler,
+            .imageView = SPRITES.textureView,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        };
+        VkWriteDescriptorSet writes[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = SPRITES.sets[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = NULL,
+                .pBufferInfo = &bufferInfo,
+                .pTexelBufferView = NULL
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = SPRITES.sets[i],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &imageInfo,
+                .pBufferInfo = NULL,
+                .pTexelBufferView = NULL
+            }
+        };
+        vkUpdateDescriptorSets(VULKAN.device, 2, writes, 0, NULL);
+    }
+}
+
+static void requestSpritePipeline() {
+    // no vertex input, the shader reads the sprite it belongs to from the storage buffer
+    PipelineDesc desc;
+    pipelineDescDefault(&desc);
+    strncpy(desc.vertShader, "shaders/sprite_vert.spv", PIPELINE_SHADER_PATH - 1);
+    strncpy(desc.fragShader, "shaders/sprite_frag.spv", PIPELINE_SHADER_PATH - 1);
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.cullMode = VK_CULL_MODE_NONE;
+    desc.blend = PIPELINE_BLEND_ALPHA;
+    desc.depthTest = VK_FALSE;
+    desc.depthWrite = VK_FALSE;
+    desc.renderPass = SPRITES.renderPass;
+    desc.layout = SPRITES.layout;
+    SPRITES.pipeline = requestPipeline(&desc, PIPELINE_HANDLE_NONE);
+}
+
+void createSpriteResources() {
+    // the textures scene needs them whatever --sprites says
+    bool texturesScene = SETTINGS.regress || SETTINGS.scene == SCENE_KIND_TEXTURES;
+    SPRITES.active = SETTINGS.spriteCount > 0 || texturesScene;
+    if (!SPRITES.active) return;
+    uint32_t capacity = SETTINGS.spriteCount;
+    if (texturesScene && capacity < SPRITE_SCENE_SPRITES) capacity = SPRITE_SCENE_SPRITES;
+    SPRITES.capacity = capacity < SPRITE_MAX_SPRITES ? capacity : SPRITE_MAX_SPRITES;
+
+    SPRITES.buffers = malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
+    SPRITES.buffersMemory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    SPRITES.mapped = malloc(sizeof(Sprite*) * MAX_FRAMES_IN_FLIGHT);
+    SPRITES.counts = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(uint32_t));
+    VkDeviceSize bytes = sizeof(Sprite) * (VkDeviceSize)SPRITES.capacity;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_VERTEX, SPRITES.buffers + i,
+            SPRITES.buffersMemory + i);
+        vkMapMemory(VULKAN.device, SPRITES.buffersMemory[i], 0, bytes, 0, (void**)(SPRITES.mapped + i));
+    }
+
+    createTexture();
+    createRenderPass();
+    createDescriptors();
+    requestSpritePipeline();
+}
+
+void destroySpriteResources() {
+    if (!SPRITES.active) return;
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyBuffer(VULKAN.device, SPRITES.buffers[i], NULL);
+        freeDeviceMemory(SPRITES.buffersMemory[i]);
+    }
+    free(SPRITES.buffers);
+    free(SPRITES.buffersMemory);
+    free(SPRITES.mapped);
+    free(SPRITES.counts);
+    free(SPRITES.sets);
+
+    vkDestroyDescriptorPool(VULKAN.device, SPRITES.pool, NULL);
+    vkDestroyPipelineLayout(VULKAN.device, SPRITES.layout, NULL);
+    vkDestroyDescriptorSetLayout(VULKAN.device, SPRITES.setLayout, NULL);
+    vkDestroyRenderPass(VULKAN.device, SPRITES.renderPass, NULL);
+    vkDestroySampler(VULKAN.device, SPRITES.sampler, NULL);
+    vkDestroyImageView(VULKAN.device, SPRITES.textureView, NULL);
+    vkDestroyImage(VULKAN.device, SPRITES.texture, NULL);
+    freeDeviceMemory(SPRITES.textureMemory);
+}
+
+void createSpriteTargets() {
+    if (!SPRITES.active) return;
+
+    VkImageView attachment = renderTargetView();
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = SPRITES.renderPass,
+        .attachmentCount = 1,
+        .pAttachments = &attachment,
+        .width = VULKAN.swapchainExtent.width,
+        .height = VULKAN.swapchainExtent.height,
+        .layers = 1
+    };
+    if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, &SPRITES.framebuffer) != VK_SUCCESS) {
+        c_throw("failed to create sprite framebuffer");
+    }
+}
+
+void destroySpriteTargets() {
+    if (!SPRITES.active) return;
+    vkDestroyFramebuffer(VULKAN.device, SPRITES.framebuffer, NULL);
+}
+
+bool spritesActive() {
+    return SPRITES.active;
+}
+
+static uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static float fract(float v) {
+    return v - floorf(v);
+}
+
+// everything about a sprite but where it is comes from hashing its index, so the field keeps no state
+static void animateRange(uint32_t first, uint32_t last) {
+    static const uint32_t palette[] = {
+        0xff6bc5ffu, 0xff5ae0ffu, 0xff4de66bu, 0xff3d9bffu, 0xffff9b3du, 0xffffe14du, 0xffd26bffu, 0xffffffffu
+    };
+    float time = SPRITES.time;
+    float width = SPRITES.extent[0] + 2.0f * SPRITE_FIELD_MARGIN;
+    float height = SPRITES.extent[1] + 2.0f * SPRITE_FIELD_MARGIN;
+    Sprite* out = SPRITES.field;
+    for (uint32_t i = first; i < last; ++i) {
+        uint32_t a = hash(i);
+        uint32_t b = hash(a ^ 0x9e3779b9u);
+        float originX = (float)(a & 0xffff) / 65536.0f;
+        float originY = (float)(a >> 16) / 65536.0f;
+        float heading = (float)(b & 0x3ff) / 1024.0f * 2.0f * SPRITE_PI;
+        float speed = 0.01f + (float)((b >> 10) & 0xff) / 256.0f * 0.05f;
+        float size = 4.0f + (float)((b >> 18) & 0x1f);
+        float spin = ((float)((b >> 23) & 0xf) - 7.5f) / 8.0f;
+
+        Sprite sprite = {
+            .position = {
+                fract(originX + cosf(heading) * speed * time) * width - SPRITE_FIELD_MARGIN,
+                fract(originY + sinf(heading) * speed * time) * height - SPRITE_FIELD_MARGIN
+            },
+            .size = { size, size },
+            .uv = { 0, 0, 65535, 65535 },
+            .color = palette[(b >> 27) & 7],
+            .rotation = (uint16_t)(fract(spin * time) * 65535.0f),
+            .layer = (uint16_t)(a % SPRITE_TEXTURE_LAYERS)
+        };
+        out[i] = sprite;
+    }
+}
+
+static void animateChunks() {
+    for (;;) {
+        int32_t chunk = c_atomic_add(&SPRITES.nextChunk, 1) - 1;
+        if (chunk >= SPRITES.chunkCount) return;
+        uint32_t first = (uint32_t)chunk * SPRITE_CHUNK;
+        uint32_t last = first + SPRITE_CHUNK < SPRITES.fieldCount ? first + SPRITE_CHUNK : SPRITES.fieldCount;
+        animateRange(first, last);
+        if (c_atomic_add(&SPRITES.doneChunks, 1) == SPRITES.chunkCount) {
+            c_mutex_lock(&SPRITES.lock);
+            c_cond_broadcast(&SPRITES.done);
+            c_mutex_unlock(&SPRITES.lock);
+        }
+    }
+}
+
+// a job that runs late finds the counter spent, or helps with a later frame, which is just as good
+static void animateJob(void* arg) {
+    (void)arg;
+    animateChunks();
+}
+
+void spritesBegin(uint32_t frame) {
+    if (!SPRITES.active) return;
+    SPRITES.writeStart = getTimeInNanoseconds();
+    SPRITES.frame = frame;
+    SPRITES.used = 0;
+
+    if (SPRITES.fieldReset) {
+        SPRITES.fieldCount = SPRITES.fieldRequest < SPRITES.capacity ? SPRITES.fieldRequest : SPRITES.capacity;
+        SPRITES.chunkCount = (int32_t)((SPRITES.fieldCount + SPRITE_CHUNK - 1) / SPRITE_CHUNK);
+        SPRITES.startNs = SPRITES.writeStart;
+        SPRITES.fieldFrames = 0;
+        SPRITES.fieldReset = false;
+    }
+
+    TRACE_BEGIN("spriteField");
+    SPRITES.field = spriteAlloc(SPRITES.fieldCount);
+    // regression images can't depend on the frame rate, they advance a simulation tick a frame
+    SPRITES.time = SETTINGS.regress ? (float)SPRITES.fieldFrames / (float)SIMULATION_HZ :
+        (float)((double)(SPRITES.writeStart - SPRITES.startNs) / 1e9);
+    ++SPRITES.fieldFrames;
+    SPRITES.extent[0] = (float)VULKAN.swapchainExtent.width;
+    SPRITES.extent[1] = (float)VULKAN.swapchainExtent.height;
+    // the atomics are full barriers, whoever claims a chunk sees the frame's parameters
+    c_atomic_store(&SPRITES.doneChunks, 0);
+    c_atomic_store(&SPRITES.nextChunk, 0);
+    for (uint32_t i = 0; i < tp_thread_count(); ++i) {
+        tp_submit(animateJob, NULL);
+    }
+    animateChunks();
+    c_mutex_lock(&SPRITES.lock);
+    while (c_atomic_load(&SPRITES.doneChunks) < SPRITES.chunkCount) {
+        c_cond_wait(&SPRITES.done, &SPRITES.lock);
+    }
+    c_mutex_unlock(&SPRITES.lock);
+    TRACE_END();
+}
+
+void spritesSetField(uint32_t count) {
+    SPRITES.fieldRequest = count;
+    SPRITES.fieldReset = true;
+}
+
+Sprite* spriteAlloc(uint32_t count) {
+    if (!SPRITES.active || count > SPRITES.capacity - SPRITES.used) return NULL;
+    Sprite* sprites = SPRITES.mapped[SPRITES.frame] + SPRITES.used;
+    SPRITES.used += count;
+    return sprites;
+}
+
+void spritesEnd() {
+    if (!SPRITES.active) return;
+    SPRITES.counts[SPRITES.frame] = SPRITES.used;
+
+    SpriteStats* stats = &SPRITES.stats;
+    stats->writeNs = getTimeInNanoseconds() - SPRITES.writeStart;
+    if (stats->writeNs > stats->writeNsMax) stats->writeNsMax = stats->writeNs;
+    stats->sprites = SPRITES.used;
+    ++stats->frames;
+    stats->spritesTotal += SPRITES.used;
+    stats->writeNsTotal += stats->writeNs;
+}
+
+void recordSprites(VkCommandBuffer commandBuffer, uint32_t frame) {
+    SPRITES.stats.draws = 0;
+    if (!SPRITES.active || SPRITES.counts[frame] == 0) return;
+    VkPipeline pipeline = getPipeline(SPRITES.pipeline);
+    if (pipeline == VK_NULL_HANDLE) return;
+
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = SPRITES.renderPass,
+        .framebuffer = SPRITES.framebuffer,
+        .renderArea = {
+            .offset = {0,0},
+            .extent = VULKAN.renderExtent
+        },
+        .clearValueCount = 0,
+        .pClearValues = NULL,
+    };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // positions are in output pixels, the viewport shrinks them with the render scale
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)VULKAN.renderExtent.width,
+        .height = (float)VULKAN.renderExtent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {
+        .offset = {0,0},
+        .extent = VULKAN.renderExtent
+    };
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    SpriteParams params = {
+        .scale = { 2.0f / (float)VULKAN.swapchainExtent.width, 2.0f / (float)VULKAN.swapchainExtent.height }
+    };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, SPRITES.layout,
+        0, 1, SPRITES.sets + frame, 0, NULL);
+    vkCmdPushConstants(commandBuffer, SPRITES.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(params), &params);
+    vkCmdDraw(commandBuffer, 6 * SPRITES.counts[frame], 1, 0, 0);
+    SPRITES.stats.draws = 1;
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+SpriteStats getSpriteStats() {
+    return SPRITES.stats;
+}
+
+void printSpriteStats() {
+    const SpriteStats* stats = &SPRITES.stats;
+    if (!SPRITES.active) return;
+    printf("sprites: %.0f a frame on average in one draw, %zu bytes each, "
+        "%.2f ms to write on average and %.2f ms at worst\n",
+        stats->frames ? (double)stats->spritesTotal / (double)stats->frames : 0.0, sizeof(Sprite),
+        stats->frames ? (double)stats->writeNsTotal / (double)stats->frames / 1e6 : 0.0,
+        (double)stats->writeNsMax / 1e6);
+}
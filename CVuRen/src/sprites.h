@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* most sprites a frame can hold, SETTINGS.spriteCount is clamped to it */
+#define SPRITE_MAX_SPRITES (1u << 22)
+/* layers of the sprite texture array, every sprite picks one */
+#define SPRITE_TEXTURE_LAYERS 8
+#define SPRITE_TEXTURE_SIZE 64
+#define SPRITE_TEXTURE_MIPS 7
+#define SPRITE_TEXTURE_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+/* the field SCENE_KIND_TEXTURES draws over its quads */
+#define SPRITE_SCENE_SPRITES 4096
+
+/* 32 bytes against 4 Vertex and 6 indices for a quad through the mesh path */
+typedef struct Sprite {
+    /* center, in output pixels from the top left */
+    float position[2];
+    float size[2];
+    /* rectangle within the layer as unorm, top left then bottom right */
+    uint16_t uv[4];
+    /* srgb, red in the low byte */
+    uint32_t color;
+    /* in turns as unorm, counter clockwise */
+    uint16_t rotation;
+    uint16_t layer;
+} Sprite;
+
+typedef struct SpriteStats {
+    uint32_t sprites, draws;
+    /* writing the frame's sprites, spread over the worker pool */
+    uint64_t writeNs, writeNsMax;
+
+    uint64_t frames, spritesTotal, writeNsTotal;
+} SpriteStats;
+
+/*
+ * 2D sprites without the mesh path. Sprites are written straight into the
+ * frame's persistently mapped storage buffer and the vertex shader expands
+ * each into two triangles from gl_VertexIndex, so there's no vertex or
+ * index data at all and one draw takes every sprite of the frame. All
+ * textures are layers of one array, so sprites with different textures
+ * still share the draw. Drawn over the scene into the render target, before
+ * the post stack, in submission order with alpha blending.
+ *
+ * With SETTINGS.spriteCount set, or in the textures scene, a field of
+ * drifting sprites is animated every frame, split into chunks the render thread and any idle
+ * pool workers take from a shared counter, so a busy pool never holds the
+ * frame back.
+ */
+void createSpriteResources();
+void destroySpriteResources();
+
+/* the framebuffer on the render target, after createRenderTargets */
+void createSpriteTargets();
+void destroySpriteTargets();
+
+bool spritesActive();
+
+/* the field's size from the next frame on, clamped to what was allocated; its animation starts over */
+void spritesSetField(uint32_t count);
+
+/* render thread only, after the frame's fence wait; animates the sprite field */
+void spritesBegin(uint32_t frame);
+/* room for count sprites in the frame, NULL once the frame is full */
+Sprite* spriteAlloc(uint32_t count);
+void spritesEnd();
+
+/* after the scene passes, the render target goes back to being sampled */
+void recordSprites(VkCommandBuffer commandBuffer, uint32_t frame);
+
+SpriteStats getSpriteStats();
+void printSpriteStats();
@@ -0,0 +1,302 @@
+#include "transforms.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "vertexes.h"
+
+#include "utils/utils.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define TRANSFORMS_SSE 1
+// built whatever /arch says and picked at runtime, msvc takes avx intrinsics as they are
+#define TRANSFORMS_AVX 1
+#ifdef _MSC_VER
+#define TRANSFORMS_AVX_TARGET
+#else
+#define TRANSFORMS_AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+#define TRANSFORMS_ALIGN 32
+
+static float* allocComponent(uint32_t capacity) {
+	// rounded up so the last vector load of a full batch stays inside
+	size_t size = sizeof(float) * (((size_t)capacity + 7) & ~(size_t)7);
+	float* p = _aligned_malloc(size, TRANSFORMS_ALIGN);
+	if (!p) {
+		c_throw("failed to allocate transforms");
+	}
+	return p;
+}
+
+void transformsInit(TransformSoA* t, uint32_t capacity) {
+	t->count = 0;
+	t->capacity = capacity;
+	float** components[] = { &t->px, &t->py, &t->pz, &t->qx, &t->qy, &t->qz, &t->qw, &t->sx, &t->sy, &t->sz };
+	for (size_t i = 0; i < sizeof(components) / sizeof(components[0]); ++i) {
+		*components[i] = allocComponent(capacity);
+	}
+}
+
+void transformsFree(TransformSoA* t) {
+	float* components[] = { t->px, t->py, t->pz, t->qx, t->qy, t->qz, t->qw, t->sx, t->sy, t->sz };
+	for (size_t i = 0; i < sizeof(components) / sizeof(components[0]); ++i) {
+		_aligned_free(components[i]);
+	}
+	memset(t, 0, sizeof(TransformSoA));
+}
+
+void transformsSet(TransformSoA* t, uint32_t index, const float position[3], const float rotation[4], const float scale[3]) {
+	t->px[index] = position[0]; t->py[index] = position[1]; t->pz[index] = position[2];
+	t->qx[index] = rotation[0]; t->qy[index] = rotation[1]; t->qz[index] = rotation[2]; t->qw[index] = rotation[3];
+	t->sx[index] = scale[0]; t->sy[index] = scale[1]; t->sz[index] = scale[2];
+}
+
+uint32_t transformsAdd(TransformSoA* t, const float position[3], const float rotation[4], const float scale[3]) {
+	if (t->count == t->capacity) {
+		c_throw("transform storage is full");
+	}
+	transformsSet(t, t->count, position, rotation, scale);
+	return t->count++;
+}
+
+static void composeOne(const TransformSoA* t, uint32_t i, float* m) {
+	float x = t->qx[i], y = t->qy[i], z = t->qz[i], w = t->qw[i];
+	float xx = x * x, yy = y * y, zz = z * z;
+	float xy = x * y, xz = x * z, yz = y * z;
+	float wx = w * x, wy = w * y, wz = w * z;
+
+	m[0] = t->sx[i] * (1.0f - 2.0f * (yy + zz));
+	m[1] = t->sx[i] * (2.0f * (xy + wz));
+	m[2] = t->sx[i] * (2.0f * (xz - wy));
+	m[3] = 0.0f;
+	m[4] = t->sy[i] * (2.0f * (xy - wz));
+	m[5] = t->sy[i] * (1.0f - 2.0f * (xx + zz));
+	m[6] = t->sy[i] * (2.0f * (yz + wx));
+	m[7] = 0.0f;
+	m[8] = t->sz[i] * (2.0f * (xz + wy));
+	m[9] = t->sz[i] * (2.0f * (yz - wx));
+	m[10] = t->sz[i] * (1.0f - 2.0f * (xx + yy));
+	m[11] = 0.0f;
+	m[12] = t->px[i];
+	m[13] = t->py[i];
+	m[14] = t->pz[i];
+	m[15] = 1.0f;
+}
+
+void transformsComposeScalar(const TransformSoA* t, uint32_t first, uint32_t count, void* dst, size_t stride) {
+	uint8_t* out = dst;
+	for (uint32_t i = 0; i < count; ++i) {
+		composeOne(t, first + i, (float*)(out + stride * i));
+	}
+}
+
+#ifdef TRANSFORMS_SSE
+/* c[k] holds element k of 4 matrices, transposed so every matrix gets written as 4 whole columns */
+static void storeBatch4(__m128 c[16], uint8_t* out, size_t stride) {
+	for (int col = 0; col < 4; ++col) {
+		__m128 r0 = c[col * 4 + 0], r1 = c[col * 4 + 1], r2 = c[col * 4 + 2], r3 = c[col * 4 + 3];
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps((float*)(out + stride * 0) + col * 4, r0);
+		_mm_storeu_ps((float*)(out + stride * 1) + col * 4, r1);
+		_mm_storeu_ps((float*)(out + stride * 2) + col * 4, r2);
+		_mm_storeu_ps((float*)(out + stride * 3) + col * 4, r3);
+	}
+}
+
+static void composeBatch4(const TransformSoA* t, uint32_t i, uint8_t* out, size_t stride) {
+	const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+	__m128 x = _mm_loadu_ps(t->qx + i), y = _mm_loadu_ps(t->qy + i);
+	__m128 z = _mm_loadu_ps(t->qz + i), w = _mm_loadu_ps(t->qw + i);
+	__m128 sx = _mm_loadu_ps(t->sx + i), sy = _mm_loadu_ps(t->sy + i), sz = _mm_loadu_ps(t->sz + i);
+
+	__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+	__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+	__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+	__m128 c[16];
+	c[0] = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+	c[1] = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, wz)));
+	c[2] = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, wy)));
+	c[3] = zero;
+	c[4] = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, wz)));
+	c[5] = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+	c[6] = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, wx)));
+	c[7] = zero;
+	c[8] = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, wy)));
+	c[9] = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, wx)));
+	c[10] = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+	c[11] = zero;
+	c[12] = _mm_loadu_ps(t->px + i);
+	c[13] = _mm_loadu_ps(t->py + i);
+	c[14] = _mm_loadu_ps(t->pz + i);
+	c[15] = one;
+
+	storeBatch4(c, out, stride);
+}
+#endif
+
+#ifdef TRANSFORMS_AVX
+/* composeBatch8 only needs avx float math, none of the avx2 integer ops */
+static bool cpuHasAvx() {
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 1);
+	bool osxsave = regs[2] & (1 << 27), avx = regs[2] & (1 << 28);
+	// the os has to save the ymm registers too
+	return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+
+static bool avxAvailable() {
+	static int available = -1;
+	if (available < 0) available = cpuHasAvx();
+	return available;
+}
+
+TRANSFORMS_AVX_TARGET static void composeBatch8(const TransformSoA* t, uint32_t i, uint8_t* out, size_t stride) {
+	const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+	__m256 x = _mm256_loadu_ps(t->qx + i), y = _mm256_loadu_ps(t->qy + i);
+	__m256 z = _mm256_loadu_ps(t->qz + i), w = _mm256_loadu_ps(t->qw + i);
+	__m256 sx = _mm256_loadu_ps(t->sx + i), sy = _mm256_loadu_ps(t->sy + i), sz = _mm256_loadu_ps(t->sz + i);
+
+	__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+	__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+	__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+	__m256 c[16];
+	c[0] = _mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))));
+	c[1] = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, wz)));
+	c[2] = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, wy)));
+	c[3] = zero;
+	c[4] = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, wz)));
+	c[5] = _mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))));
+	c[6] = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, wx)));
+	c[7] = zero;
+	c[8] = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, wy)));
+	c[9] = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, wx)));
+	c[10] = _mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))));
+	c[11] = zero;
+	c[12] = _mm256_loadu_ps(t->px + i);
+	c[13] = _mm256_loadu_ps(t->py + i);
+	c[14] = _mm256_loadu_ps(t->pz + i);
+	c[15] = one;
+
+	// two sse transposes per half keep the stores sequential per matrix
+	__m128 lo[16], hi[16];
+	for (int k = 0; k < 16; ++k) {
+		lo[k] = _mm256_castps256_ps128(c[k]);
+		hi[k] = _mm256_extractf128_ps(c[k], 1);
+	}
+	// storeBatch4 may be legacy sse encoded, don't pay the transition with dirty upper halves
+	_mm256_zeroupper();
+	storeBatch4(lo, out, stride);
+	storeBatch4(hi, out + stride * 4, stride);
+}
+#endif
+
+static void composeSimd(const TransformSoA* t, uint32_t first, uint32_t count, void* dst, size_t stride, bool avx) {
+	uint8_t* out = dst;
+	uint32_t i = 0;
+#ifdef TRANSFORMS_AVX
+	if (avx) {
+		for (; i + 8 <= count; i += 8) {
+			composeBatch8(t, first + i, out + stride * i, stride);
+		}
+	}
+#endif
+#ifdef TRANSFORMS_SSE
+	for (; i + 4 <= count; i += 4) {
+		composeBatch4(t, first + i, out + stride * i, stride);
+	}
+#endif
+	transformsComposeScalar(t, first + i, count - i, out + stride * i, stride);
+}
+
+void transformsCompose(const TransformSoA* t, uint32_t first, uint32_t count, void* dst, size_t stride) {
+#ifdef TRANSFORMS_AVX
+	composeSimd(t, first, count, dst, stride, avxAvailable());
+#else
+	composeSimd(t, first, count, dst, stride, false);
+#endif
+}
+
+static void composeCglm(const TransformSoA* t, uint32_t count, mat4* dst) {
+	for (uint32_t i = 0; i < count; ++i) {
+		versor q = { t->qx[i], t->qy[i], t->qz[i], t->qw[i] };
+		vec3 s = { t->sx[i], t->sy[i], t->sz[i] };
+		vec3 p = { t->px[i], t->py[i], t->pz[i] };
+		mat4 m;
+		glm_translate_make(m, p);
+		glm_quat_rotate(m, q, m);
+		glm_scale(m, s);
+		glm_mat4_copy(m, dst[i]);
+	}
+}
+
+void transformsBenchmark(uint32_t count, uint32_t iterations) {
+	TransformSoA t;
+	transformsInit(&t, count);
+	srand(1);
+	for (uint32_t i = 0; i < count; ++i) {
+		float p[3] = { (float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX };
+		versor q;
+		glm_quatv(q, (float)rand() / RAND_MAX * 6.28f, (vec3){ 0.0f, 0.0f, 1.0f });
+		float s[3] = { 1.0f, 2.0f, 3.0f };
+		transformsAdd(&t, p, q, s);
+	}
+
+	mat4* out = _aligned_malloc(sizeof(mat4) * count, TRANSFORMS_ALIGN);
+	mat4* check = _aligned_malloc(sizeof(mat4) * count, TRANSFORMS_ALIGN);
+
+	uint64_t start = getTimeInNanoseconds();
+	for (uint32_t it = 0; it < iterations; ++it) composeCglm(&t, count, out);
+	uint64_t cglmTime = getTimeInNanoseconds() - start;
+
+	start = getTimeInNanoseconds();
+	for (uint32_t it = 0; it < iterations; ++it) transformsComposeScalar(&t, 0, count, out, sizeof(mat4));
+	uint64_t scalarTime = getTimeInNanoseconds() - start;
+
+	double total = (double)count * iterations;
+	printf("transforms: %u objects x %u iterations\n", count, iterations);
+	printf("  cglm   %8.2f M matrices/s\n", total / ((double)cglmTime / 1e9) / 1e6);
+	printf("  scalar %8.2f M matrices/s\n", total / ((double)scalarTime / 1e9) / 1e6);
+
+	const char* names[] = { "sse", "avx" };
+	for (int avx = 0; avx < 2; ++avx) {
+#ifdef TRANSFORMS_AVX
+		if (avx && !avxAvailable()) {
+			printf("  %-6s not supported by this cpu\n", names[avx]);
+			continue;
+		}
+#endif
+		start = getTimeInNanoseconds();
+		for (uint32_t it = 0; it < iterations; ++it) composeSimd(&t, 0, count, check, sizeof(mat4), avx);
+		uint64_t simdTime = getTimeInNanoseconds() - start;
+
+		float maxError = 0.0f;
+		for (uint32_t i = 0; i < count; ++i) {
+			for (int k = 0; k < 16; ++k) {
+				float e = out[i][k / 4][k % 4] - check[i][k / 4][k % 4];
+				if (e < 0.0f) e = -e;
+				if (e > maxError) maxError = e;
+			}
+		}
+		printf("  %-6s %8.2f M matrices/s (%.2fx scalar, max error %g)\n", names[avx],
+			total / ((double)simdTime / 1e9) / 1e6, (double)scalarTime / (double)simdTime, maxError);
+	}
+
+	_aligned_free(out);
+	_aligned_free(check);
+	transformsFree(&t);
+}
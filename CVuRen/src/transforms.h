@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Transforms kept as structure of arrays so a batch of 4 (SSE) or 8 (AVX)
+ * objects loads each component with one vector load, AVX picked at runtime
+ * from cpuid. Rotations are unit quaternions (x, y, z, w).
+ */
+typedef struct TransformSoA {
+	float* px, * py, * pz;
+	float* qx, * qy, * qz, * qw;
+	float* sx, * sy, * sz;
+	uint32_t count, capacity;
+} TransformSoA;
+
+void transformsInit(TransformSoA* t, uint32_t capacity);
+void transformsFree(TransformSoA* t);
+uint32_t transformsAdd(TransformSoA* t, const float position[3], const float rotation[4], const float scale[3]);
+void transformsSet(TransformSoA* t, uint32_t index, const float position[3], const float rotation[4], const float scale[3]);
+
+/* writes column-major local-to-world mat4s, stride is the byte distance between two of them in dst */
+void transformsCompose(const TransformSoA* t, uint32_t first, uint32_t count, void* dst, size_t stride);
+void transformsComposeScalar(const TransformSoA* t, uint32_t first, uint32_t count, void* dst, size_t stride);
+
+/* matrices per second of the scalar, cglm, sse and avx paths; transformsCompose takes avx when the cpu has it */
+void transformsBenchmark(uint32_t count, uint32_t iterations);
@@ -0,0 +1,151 @@
+#include "assetio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#include "threading.h"
+#include "utils.h"
+
+#define ASSET_RECORDS 64
+#define ASSET_NAME 64
+/* opened after the table filled up, not in the stats */
+#define ASSET_NOT_RECORDED UINT32_MAX
+
+typedef struct asset_record {
+	char name[ASSET_NAME];
+	size_t size;
+	bool mapped;
+	uint64_t ioTimeNs;
+	uint64_t bytesCopied;
+} asset_record;
+
+static struct ASSETS {
+	asset_record records[ASSET_RECORDS];
+	uint32_t count;
+	uint32_t notRecorded;
+	c_mutex lock;
+} ASSETS;
+
+static uint32_t addRecord(const char* path, size_t size, bool mapped, uint64_t ioTimeNs) {
+	c_mutex_lock(&ASSETS.lock);
+	if (ASSETS.count == ASSET_RECORDS) {
+		++ASSETS.notRecorded;
+		c_mutex_unlock(&ASSETS.lock);
+		return ASSET_NOT_RECORDED;
+	}
+	uint32_t index = ASSETS.count++;
+	asset_record* record = ASSETS.records + index;
+	strncpy(record->name, path, ASSET_NAME - 1);
+	record->size = size;
+	record->mapped = mapped;
+	record->ioTimeNs = ioTimeNs;
+	record->bytesCopied = 0;
+	c_mutex_unlock(&ASSETS.lock);
+	return index;
+}
+
+static bool openBuffered(const char* path, assetfile* asset) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	asset->size = (size_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	// keep the buffer 4 byte padded, spir-v consumers read whole words
+	asset->buffer = malloc(asset->size + 4);
+	if (fread(asset->buffer, 1, asset->size, file) != asset->size) {
+		free(asset->buffer);
+		asset->buffer = NULL;
+		fclose(file);
+		return false;
+	}
+	memset(asset->buffer + asset->size, 0, 4);
+	fclose(file);
+
+	asset->data = asset->buffer;
+	asset->mapped = false;
+	return true;
+}
+
+bool asset_open(const char* path, assetfile* asset) {
+	memset(asset, 0, sizeof(assetfile));
+	uint64_t start = getTimeInNanoseconds();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	const uint8_t* view = NULL;
+	// empty files can't be mapped
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping) {
+			view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+	}
+
+	if (view) {
+		asset->data = view;
+		asset->size = (size_t)size.QuadPart;
+		asset->mapped = true;
+		asset->file = file;
+		asset->mapping = mapping;
+
+		// the whole file is consumed front to back, start paging it in now
+		WIN32_MEMORY_RANGE_ENTRY range = { (PVOID)view, asset->size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	} else {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		if (!openBuffered(path, asset)) {
+			return false;
+		}
+	}
+
+	asset->record = addRecord(path, asset->size, asset->mapped, getTimeInNanoseconds() - start);
+	return true;
+}
+
+void asset_close(assetfile* asset) {
+	if (asset->mapped) {
+		UnmapViewOfFile(asset->data);
+		CloseHandle((HANDLE)asset->mapping);
+		CloseHandle((HANDLE)asset->file);
+	} else {
+		free(asset->buffer);
+	}
+	memset(asset, 0, sizeof(assetfile));
+}
+
+void asset_copy(assetfile* asset, void* dst, const void* src, size_t size) {
+	memcpy(dst, src, size);
+	if (asset->record == ASSET_NOT_RECORDED) return;
+
+	c_mutex_lock(&ASSETS.lock);
+	ASSETS.records[asset->record].bytesCopied += size;
+	c_mutex_unlock(&ASSETS.lock);
+}
+
+void asset_print_stats() {
+	c_mutex_lock(&ASSETS.lock);
+	printf("%-28s %10s %8s %10s %12s\n", "asset", "bytes", "mode", "io ms", "copied");
+	for (uint32_t i = 0; i < ASSETS.count; ++i) {
+		asset_record* record = ASSETS.records + i;
+		printf("%-28s %10zu %8s %10.3f %12llu\n", record->name, record->size,
+			record->mapped ? "mapped" : "buffered", (double)record->ioTimeNs / 1e6,
+			(unsigned long long)record->bytesCopied);
+	}
+	if (ASSETS.notRecorded) {
+		printf("%u assets not recorded\n", ASSETS.notRecorded);
+	}
+	c_mutex_unlock(&ASSETS.lock);
+}
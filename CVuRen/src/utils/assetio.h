@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* read-only view of an asset file, memory mapped when possible,
+   read into one heap buffer otherwise */
+typedef struct assetfile {
+	const uint8_t* data;
+	size_t size;
+	bool mapped;
+
+	void* file;
+	void* mapping;
+	uint8_t* buffer;
+
+	uint32_t record;
+} assetfile;
+
+bool asset_open(const char* path, assetfile* asset);
+void asset_close(assetfile* asset);
+
+/* copies a range of the asset (or data decoded from it) out, counted in the stats */
+void asset_copy(assetfile* asset, void* dst, const void* src, size_t size);
+
+void asset_print_stats();
@@ -0,0 +1,125 @@
+#include "taskgraph.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+#include "utils.h"
+
+void tg_init(task_graph* graph) {
+	memset(graph, 0, sizeof(task_graph));
+}
+
+uint32_t tg_add(task_graph* graph, const char* name, tg_task_fn fn, bool mainThread) {
+	if (graph->count == TG_MAX_TASKS) {
+		c_throw("task graph is full");
+	}
+	tg_task* task = graph->tasks + graph->count;
+	task->name = name;
+	task->fn = fn;
+	task->mainThread = mainThread;
+	task->graph = graph;
+	return graph->count++;
+}
+
+void tg_depend(task_graph* graph, uint32_t task, uint32_t dependency) {
+	tg_task* dep = graph->tasks + dependency;
+	if (dep->dependentCount == TG_MAX_DEPENDENTS) {
+		c_throw("too many dependents for a task");
+	}
+	dep->dependents[dep->dependentCount++] = task;
+	++graph->tasks[task].dependencyCount;
+}
+
+/* called with graph->lock held, pool submits are collected and done after unlock */
+static void dispatch(task_graph* graph, uint32_t index, uint32_t* toPool, uint32_t* toPoolCount) {
+	if (graph->tasks[index].mainThread) {
+		graph->mainQueue[graph->mainQueueCount++] = index;
+		c_cond_broadcast(&graph->changed);
+	} else {
+		toPool[(*toPoolCount)++] = index;
+	}
+}
+
+static void runTask(void* arg) {
+	tg_task* task = arg;
+	task_graph* graph = task->graph;
+
+	TRACE_BEGIN(task->name);
+	task->start = getTimeInNanoseconds();
+	task->fn();
+	task->end = getTimeInNanoseconds();
+	TRACE_END();
+
+	uint32_t toPool[TG_MAX_DEPENDENTS];
+	uint32_t toPoolCount = 0;
+
+	c_mutex_lock(&graph->lock);
+	for (uint32_t i = 0; i < task->dependentCount; ++i) {
+		tg_task* dependent = graph->tasks + task->dependents[i];
+		if (--dependent->remaining == 0) {
+			dispatch(graph, task->dependents[i], toPool, &toPoolCount);
+		}
+	}
+	++graph->finished;
+	c_cond_broadcast(&graph->changed);
+	c_mutex_unlock(&graph->lock);
+
+	for (uint32_t i = 0; i < toPoolCount; ++i) {
+		tp_submit(runTask, graph->tasks + toPool[i]);
+	}
+}
+
+void tg_run(task_graph* graph) {
+	uint32_t toPool[TG_MAX_TASKS];
+	uint32_t toPoolCount = 0;
+
+	graph->start = getTimeInNanoseconds();
+	graph->finished = 0;
+	graph->mainQueueCount = 0;
+
+	c_mutex_lock(&graph->lock);
+	for (uint32_t i = 0; i < graph->count; ++i) {
+		graph->tasks[i].remaining = graph->tasks[i].dependencyCount;
+	}
+	for (uint32_t i = 0; i < graph->count; ++i) {
+		if (graph->tasks[i].dependencyCount == 0) {
+			dispatch(graph, i, toPool, &toPoolCount);
+		}
+	}
+	c_mutex_unlock(&graph->lock);
+
+	for (uint32_t i = 0; i < toPoolCount; ++i) {
+		tp_submit(runTask, graph->tasks + toPool[i]);
+	}
+
+	c_mutex_lock(&graph->lock);
+	while (graph->finished < graph->count) {
+		if (graph->mainQueueCount) {
+			uint32_t index = graph->mainQueue[--graph->mainQueueCount];
+			c_mutex_unlock(&graph->lock);
+			runTask(graph->tasks + index);
+			c_mutex_lock(&graph->lock);
+		} else {
+			c_cond_wait(&graph->changed, &graph->lock);
+		}
+	}
+	c_mutex_unlock(&graph->lock);
+
+	graph->end = getTimeInNanoseconds();
+}
+
+void tg_print_timings(const task_graph* graph) {
+	uint64_t serial = 0;
+	printf("%-28s %10s %10s\n", "task", "start ms", "took ms");
+	for (uint32_t i = 0; i < graph->count; ++i) {
+		const tg_task* task = graph->tasks + i;
+		serial += task->end - task->start;
+		printf("%-28s %10.3f %10.3f%s\n", task->name,
+			(double)(task->start - graph->start) / 1e6,
+			(double)(task->end - task->start) / 1e6,
+			task->mainThread ? " (main)" : "");
+	}
+	printf("total %.3f ms, %.3f ms if run serially\n",
+		(double)(graph->end - graph->start) / 1e6, (double)serial / 1e6);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "threading.h"
+
+#define TG_MAX_TASKS 64
+#define TG_MAX_DEPENDENTS 16
+
+typedef void (*tg_task_fn)();
+
+struct task_graph;
+
+typedef struct tg_task {
+	const char* name;
+	tg_task_fn fn;
+	bool mainThread;
+
+	uint32_t dependents[TG_MAX_DEPENDENTS];
+	uint32_t dependentCount;
+	uint32_t dependencyCount;
+	uint32_t remaining;
+
+	uint64_t start, end;
+	struct task_graph* graph;
+} tg_task;
+
+/* tasks run on the worker pool as soon as all of their dependencies finished,
+   mainThread tasks are picked up by the thread that called tg_run */
+typedef struct task_graph {
+	tg_task tasks[TG_MAX_TASKS];
+	uint32_t count;
+	uint32_t finished;
+
+	uint32_t mainQueue[TG_MAX_TASKS];
+	uint32_t mainQueueCount;
+
+	uint64_t start, end;
+
+	c_mutex lock;
+	c_cond changed;
+} task_graph;
+
+void tg_init(task_graph* graph);
+uint32_t tg_add(task_graph* graph, const char* name, tg_task_fn fn, bool mainThread);
+void tg_depend(task_graph* graph, uint32_t task, uint32_t dependency);
+void tg_run(task_graph* graph);
+void tg_print_timings(const task_graph* graph);
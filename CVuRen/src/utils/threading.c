@@ -0,0 +1,230 @@
+#include "threading.h"
+
+#include <stdlib.h>
+#include <windows.h>
+
+#include "trace.h"
+#include "utils.h"
+
+void c_mutex_lock(c_mutex* m) {
+	AcquireSRWLockExclusive((PSRWLOCK)&m->handle);
+}
+
+void c_mutex_unlock(c_mutex* m) {
+	ReleaseSRWLockExclusive((PSRWLOCK)&m->handle);
+}
+
+void c_cond_wait(c_cond* c, c_mutex* m) {
+	SleepConditionVariableSRW((PCONDITION_VARIABLE)&c->handle, (PSRWLOCK)&m->handle, INFINITE, 0);
+}
+
+void c_cond_signal(c_cond* c) {
+	WakeConditionVariable((PCONDITION_VARIABLE)&c->handle);
+}
+
+void c_cond_broadcast(c_cond* c) {
+	WakeAllConditionVariable((PCONDITION_VARIABLE)&c->handle);
+}
+
+typedef struct thread_start {
+	c_thread_fn fn;
+	void* arg;
+} thread_start;
+
+static DWORD WINAPI threadEntry(LPVOID param) {
+	thread_start start = *(thread_start*)param;
+	free(param);
+	start.fn(start.arg);
+	return 0;
+}
+
+c_thread c_thread_start(c_thread_fn fn, void* arg) {
+	thread_start* start = malloc(sizeof(thread_start));
+	start->fn = fn;
+	start->arg = arg;
+
+	c_thread thread = { CreateThread(NULL, 0, threadEntry, start, 0, NULL) };
+	if (thread.handle == NULL) {
+		c_throw("failed to start a thread");
+	}
+	return thread;
+}
+
+void c_thread_join(c_thread thread) {
+	WaitForSingleObject((HANDLE)thread.handle, INFINITE);
+	CloseHandle((HANDLE)thread.handle);
+}
+
+uint32_t c_cpu_count() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+void c_sleep_ns(uint64_t ns) {
+	HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!timer) {
+		/* before windows 10 1803 */
+		Sleep((DWORD)(ns / 1000000));
+		return;
+	}
+	/* negative is relative, in 100 ns units */
+	LARGE_INTEGER due;
+	due.QuadPart = -(LONGLONG)(ns / 100);
+	SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE);
+	WaitForSingleObject(timer, INFINITE);
+	CloseHandle(timer);
+}
+
+int32_t c_atomic_add(volatile int32_t* value, int32_t add) {
+	return (int32_t)InterlockedExchangeAdd((volatile LONG*)value, (LONG)add) + add;
+}
+
+int64_t c_atomic_add64(volatile int64_t* value, int64_t add) {
+	return (int64_t)InterlockedExchangeAdd64((volatile LONG64*)value, (LONG64)add) + add;
+}
+
+int32_t c_atomic_load(volatile int32_t* value) {
+	return (int32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void c_atomic_store(volatile int32_t* value, int32_t v) {
+	InterlockedExchange((volatile LONG*)value, (LONG)v);
+}
+
+int32_t c_atomic_cas(volatile int32_t* value, int32_t expected, int32_t desired) {
+	return (int32_t)InterlockedCompareExchange((volatile LONG*)value, (LONG)desired, (LONG)expected);
+}
+
+int32_t c_atomic_exchange(volatile int32_t* value, int32_t v) {
+	return (int32_t)InterlockedExchange((volatile LONG*)value, (LONG)v);
+}
+
+//  THREAD POOL
+
+typedef struct tp_job {
+	tp_job_fn fn;
+	void* arg;
+} tp_job;
+
+static struct THREADPOOL {
+	c_thread* threads;
+	uint32_t threadCount;
+
+	tp_job* jobs;
+	size_t capacity, head, count;
+	uint32_t running;
+
+	c_mutex lock;
+	c_cond jobReady;
+	c_cond idle;
+	bool quit;
+} POOL;
+
+static void workerLoop(void* arg) {
+	TRACE_THREAD_NAME("worker");
+	for (;;) {
+		c_mutex_lock(&POOL.lock);
+		while (!POOL.count && !POOL.quit) {
+			c_cond_wait(&POOL.jobReady, &POOL.lock);
+		}
+		if (!POOL.count && POOL.quit) {
+			c_mutex_unlock(&POOL.lock);
+			return;
+		}
+		tp_job job = POOL.jobs[POOL.head];
+		POOL.head = (POOL.head + 1) % POOL.capacity;
+		--POOL.count;
+		++POOL.running;
+		c_mutex_unlock(&POOL.lock);
+
+		job.fn(job.arg);
+
+		c_mutex_lock(&POOL.lock);
+		--POOL.running;
+		if (!POOL.count && !POOL.running) {
+			c_cond_broadcast(&POOL.idle);
+		}
+		c_mutex_unlock(&POOL.lock);
+	}
+}
+
+void tp_init(uint32_t threadCount) {
+	if (POOL.threads) return;
+
+	if (threadCount == 0) {
+		threadCount = c_cpu_count() > 1 ? c_cpu_count() - 1 : 1;
+	}
+
+	POOL.capacity = 64;
+	POOL.jobs = malloc(sizeof(tp_job) * POOL.capacity);
+	POOL.head = POOL.count = 0;
+	POOL.running = 0;
+	POOL.quit = false;
+
+	POOL.threadCount = threadCount;
+	POOL.threads = malloc(sizeof(c_thread) * threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		POOL.threads[i] = c_thread_start(workerLoop, NULL);
+	}
+}
+
+void tp_submit(tp_job_fn fn, void* arg) {
+	if (!POOL.threads) {
+		/* no pool - run inline, keeps callers simple */
+		fn(arg);
+		return;
+	}
+
+	c_mutex_lock(&POOL.lock);
+	if (POOL.count == POOL.capacity) {
+		tp_job* grown = malloc(sizeof(tp_job) * POOL.capacity * 2);
+		for (size_t i = 0; i < POOL.count; ++i) {
+			grown[i] = POOL.jobs[(POOL.head + i) % POOL.capacity];
+		}
+		free(POOL.jobs);
+		POOL.jobs = grown;
+		POOL.head = 0;
+		POOL.capacity *= 2;
+	}
+	POOL.jobs[(POOL.head + POOL.count) % POOL.capacity] = (tp_job){ fn, arg };
+	++POOL.count;
+	c_cond_signal(&POOL.jobReady);
+	c_mutex_unlock(&POOL.lock);
+}
+
+void tp_wait_idle() {
+	if (!POOL.threads) return;
+
+	c_mutex_lock(&POOL.lock);
+	while (POOL.count || POOL.running) {
+		c_cond_wait(&POOL.idle, &POOL.lock);
+	}
+	c_mutex_unlock(&POOL.lock);
+}
+
+void tp_shutdown() {
+	if (!POOL.threads) return;
+
+	c_mutex_lock(&POOL.lock);
+	POOL.quit = true;
+	c_cond_broadcast(&POOL.jobReady);
+	c_mutex_unlock(&POOL.lock);
+
+	for (uint32_t i = 0; i < POOL.threadCount; ++i) {
+		c_thread_join(POOL.threads[i]);
+	}
+	free(POOL.threads);
+	free(POOL.jobs);
+	POOL.threads = NULL;
+	POOL.jobs = NULL;
+	POOL.threadCount = 0;
+}
+
+uint32_t tp_thread_count() {
+	return POOL.threadCount;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* thin wrappers over win32 sync primitives, so windows.h stays out of headers */
+typedef struct c_mutex {
+	void* handle;
+} c_mutex;
+
+typedef struct c_cond {
+	void* handle;
+} c_cond;
+
+typedef struct c_thread {
+	void* handle;
+} c_thread;
+
+typedef void (*c_thread_fn)(void* arg);
+
+#define C_MUTEX_INIT {NULL}
+#define C_COND_INIT {NULL}
+
+void c_mutex_lock(c_mutex* m);
+void c_mutex_unlock(c_mutex* m);
+void c_cond_wait(c_cond* c, c_mutex* m);
+void c_cond_signal(c_cond* c);
+void c_cond_broadcast(c_cond* c);
+
+c_thread c_thread_start(c_thread_fn fn, void* arg);
+void c_thread_join(c_thread thread);
+uint32_t c_cpu_count();
+/* high resolution timer where the system has one, Sleep() rounds up to the scheduler tick */
+void c_sleep_ns(uint64_t ns);
+
+/* atomics over 32/64 bit values, all of them are full barriers */
+int32_t c_atomic_add(volatile int32_t* value, int32_t add);
+int64_t c_atomic_add64(volatile int64_t* value, int64_t add);
+int32_t c_atomic_load(volatile int32_t* value);
+void c_atomic_store(volatile int32_t* value, int32_t v);
+int32_t c_atomic_cas(volatile int32_t* value, int32_t expected, int32_t desired);
+/* returns the previous value */
+int32_t c_atomic_exchange(volatile int32_t* value, int32_t v);
+
+/* global worker pool, jobs are executed in submission order by any free worker */
+typedef void (*tp_job_fn)(void* arg);
+
+void tp_init(uint32_t threadCount);
+void tp_submit(tp_job_fn fn, void* arg);
+void tp_wait_idle();
+void tp_shutdown();
+uint32_t tp_thread_count();
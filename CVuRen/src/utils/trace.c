@@ -0,0 +1,281 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <windows.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+#include "threading.h"
+
+uint64_t trace_ticks() {
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return (uint64_t)count.QuadPart;
+}
+
+uint64_t trace_ticks_per_second() {
+	static uint64_t frequency = 0;
+	if (!frequency) {
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		frequency = (uint64_t)freq.QuadPart;
+	}
+	return frequency;
+}
+
+#if CVUREN_TRACE
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct trace_event {
+	/* NULL ends the innermost open zone */
+	const char* name;
+	uint64_t ticks;
+} trace_event;
+
+typedef struct trace_ring {
+	trace_event events[TRACE_RING_EVENTS];
+	/* events ever written, wraps, only the owning thread stores to it */
+	volatile uint32_t head;
+	const char* name;
+	uint32_t id;
+	/* the gpu track comes in QPC ticks already, so do cpu tracks without an invariant tsc */
+	bool qpc;
+} trace_ring;
+
+static struct TRACE {
+	volatile bool enabled;
+	trace_ring* rings[TRACE_MAX_THREADS];
+	volatile int32_t ringCount;
+	trace_ring* gpu;
+	/* decided when tracing is first enabled, zones fall back to QPC without it */
+	bool invariantTsc;
+	/* tsc and QPC read together when tracing starts, export pairs it with a second read */
+	uint64_t startTsc, startQpc;
+} TRACE;
+
+/* cpuid 0x80000007 edx bit 8: the tsc ticks at a constant rate through power states and is synced across cores */
+static bool cpuHasInvariantTsc() {
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0x80000000);
+	if ((uint32_t)regs[0] < 0x80000007) return false;
+	__cpuid(regs, 0x80000007);
+	return regs[3] & (1 << 8);
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+	return edx & (1 << 8);
+#endif
+}
+
+/* a few ns against tens for QueryPerformanceCounter */
+static inline uint64_t zoneTicks() {
+	return TRACE.invariantTsc ? __rdtsc() : trace_ticks();
+}
+
+/* the QPC read sits halfway between the two tsc reads around it */
+static void calibrate(uint64_t* tsc, uint64_t* qpc) {
+	uint64_t before = __rdtsc();
+	*qpc = trace_ticks();
+	uint64_t after = __rdtsc();
+	*tsc = before + (after - before) / 2;
+}
+
+static TRACE_THREAD_LOCAL trace_ring* threadRing;
+static TRACE_THREAD_LOCAL const char* threadName;
+/* set once the ring table is full, so a thread doesn't keep asking */
+static TRACE_THREAD_LOCAL bool threadUntraced;
+
+static trace_ring* newRing(const char* name) {
+	int32_t index = c_atomic_add(&TRACE.ringCount, 1) - 1;
+	if (index >= TRACE_MAX_THREADS) return NULL;
+
+	trace_ring* ring = calloc(1, sizeof(trace_ring));
+	if (!ring) return NULL;
+	ring->name = name;
+	ring->id = (uint32_t)index + 1;
+	ring->qpc = !TRACE.invariantTsc;
+	TRACE.rings[index] = ring;
+	return ring;
+}
+
+static trace_ring* currentRing() {
+	if (!threadRing && !threadUntraced) {
+		threadRing = newRing(threadName);
+		threadUntraced = threadRing == NULL;
+	}
+	return threadRing;
+}
+
+static void push(trace_ring* ring, const char* name, uint64_t ticks) {
+	uint32_t head = ring->head;
+	ring->events[head & (TRACE_RING_EVENTS - 1)] = (trace_event){ name, ticks };
+	/* volatile stores are releases with msvc on x86/x64, the event is visible before the head */
+	ring->head = head + 1;
+}
+
+void trace_begin(const char* name) {
+	if (!TRACE.enabled) return;
+	trace_ring* ring = currentRing();
+	if (ring) push(ring, name, zoneTicks());
+}
+
+void trace_end() {
+	if (!TRACE.enabled) return;
+	trace_ring* ring = currentRing();
+	if (ring) push(ring, NULL, zoneTicks());
+}
+
+void trace_thread_name(const char* name) {
+	threadName = name;
+	if (threadRing) threadRing->name = name;
+}
+
+void trace_gpu_event(const char* name, uint64_t ticks) {
+	if (!TRACE.enabled) return;
+	if (!TRACE.gpu) {
+		TRACE.gpu = newRing("gpu");
+		if (!TRACE.gpu) return;
+		TRACE.gpu->qpc = true;
+	}
+	push(TRACE.gpu, name, ticks);
+}
+
+void trace_set_enabled(bool enabled) {
+	if (enabled && !TRACE.startTsc) {
+		// rings only appear once tracing is on, so every cpu ring sees the final choice
+		TRACE.invariantTsc = cpuHasInvariantTsc();
+		calibrate(&TRACE.startTsc, &TRACE.startQpc);
+	}
+	TRACE.enabled = enabled;
+}
+
+bool trace_enabled() {
+	return TRACE.enabled;
+}
+
+static uint32_t firstEvent(const trace_ring* ring) {
+	uint32_t head = ring->head;
+	return head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+}
+
+static void writeName(FILE* file, const char* name) {
+	fputc('"', file);
+	for (const char* c = name; *c; ++c) {
+		if (*c == '"' || *c == '\\') fputc('\\', file);
+		fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+/* QPC ticks, signed since a zone can't start before tracing did but rounding can put it a tick earlier */
+static double qpcTicks(const trace_ring* ring, uint64_t ticks, double qpcPerTsc) {
+	if (ring->qpc) return (double)ticks;
+	return (double)TRACE.startQpc + (double)(int64_t)(ticks - TRACE.startTsc) * qpcPerTsc;
+}
+
+bool trace_export(const char* path) {
+	int32_t ringCount = c_atomic_load(&TRACE.ringCount);
+	if (ringCount > TRACE_MAX_THREADS) ringCount = TRACE_MAX_THREADS;
+
+	// one rate over the whole run maps the tsc rings, QPC rings (the gpu, cpus without an invariant tsc) pass through
+	uint64_t endTsc, endQpc;
+	calibrate(&endTsc, &endQpc);
+	double qpcPerTsc = endTsc > TRACE.startTsc ?
+		(double)(endQpc - TRACE.startQpc) / (double)(endTsc - TRACE.startTsc) : 0.0;
+
+	// the earliest event still in any ring is time zero
+	double origin = INFINITY;
+	uint32_t eventCount = 0;
+	for (int32_t r = 0; r < ringCount; ++r) {
+		trace_ring* ring = TRACE.rings[r];
+		if (!ring || ring->head == 0) continue;
+		uint32_t first = firstEvent(ring);
+		eventCount += ring->head - first;
+		for (uint32_t i = first; i != ring->head; ++i) {
+			double ticks = qpcTicks(ring, ring->events[i & (TRACE_RING_EVENTS - 1)].ticks, qpcPerTsc);
+			if (ticks < origin) origin = ticks;
+		}
+	}
+	if (eventCount == 0) {
+		fprintf(stderr, "trace: nothing recorded, %s not written\n", path);
+		return false;
+	}
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "trace: can't write %s\n", path);
+		return false;
+	}
+
+	double toMicroseconds = 1e6 / (double)trace_ticks_per_second();
+	const char* separator = "";
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (int32_t r = 0; r < ringCount; ++r) {
+		trace_ring* ring = TRACE.rings[r];
+		if (!ring || ring->head == 0) continue;
+
+		if (ring->name) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+				separator, ring->id);
+			writeName(file, ring->name);
+			fprintf(file, "}}");
+			separator = ",\n";
+		}
+
+		// the ring may start in the middle of a zone, ends without a begin are dropped
+		uint32_t depth = 0;
+		uint32_t head = ring->head;
+		for (uint32_t i = firstEvent(ring); i != head; ++i) {
+			trace_event event = ring->events[i & (TRACE_RING_EVENTS - 1)];
+			double ts = (qpcTicks(ring, event.ticks, qpcPerTsc) - origin) * toMicroseconds;
+			if (event.name) {
+				++depth;
+				fprintf(file, "%s{\"name\":", separator);
+				writeName(file, event.name);
+				fprintf(file, ",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, ring->id);
+			} else {
+				if (depth == 0) continue;
+				--depth;
+				fprintf(file, "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", separator, ts, ring->id);
+			}
+			separator = ",\n";
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("trace: %u events from %d tracks written to %s\n", eventCount, ringCount, path);
+	return true;
+}
+
+#else
+
+void trace_begin(const char* name) {}
+void trace_end() {}
+void trace_thread_name(const char* name) {}
+void trace_gpu_event(const char* name, uint64_t ticks) {}
+void trace_set_enabled(bool enabled) {}
+
+bool trace_enabled() {
+	return false;
+}
+
+bool trace_export(const char* path) {
+	fprintf(stderr, "trace: built with CVUREN_TRACE=0, %s not written\n", path);
+	return false;
+}
+
+#endif
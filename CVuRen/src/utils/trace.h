@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* build with CVUREN_TRACE=0 and every zone macro compiles to nothing */
+#ifndef CVUREN_TRACE
+#define CVUREN_TRACE 1
+#endif
+
+#define TRACE_MAX_THREADS 64
+/* per thread, a power of two, the oldest events get overwritten */
+#define TRACE_RING_EVENTS (1u << 16)
+
+/*
+ * Timeline of begin/end zones, written to per thread rings without locks:
+ * a thread only ever writes its own ring and publishes the head after the
+ * event, the exporter reads whatever the heads cover. Zones take raw tsc
+ * ticks, mapped at export onto QueryPerformanceCounter ticks through a
+ * (tsc, QPC) pair read when tracing starts and another at export; on a cpu
+ * without an invariant tsc they read QPC directly instead. QPC is
+ * also the time domain calibrated gpu timestamps come in, so the gpu track
+ * lines up with the cpu ones.
+ * Export once the threads are quiet (after deviceIdle / tp_wait_idle).
+ */
+#if CVUREN_TRACE
+#define TRACE_BEGIN(name) trace_begin(name)
+#define TRACE_END() trace_end()
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END() ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+/* zone names are not copied, pass string literals */
+void trace_begin(const char* name);
+void trace_end();
+void trace_thread_name(const char* name);
+
+/* the gpu gets a track of its own, fed from one thread in submission order; NULL name ends a zone */
+void trace_gpu_event(const char* name, uint64_t ticks);
+
+/* off by default, zones cost a branch until this is called */
+void trace_set_enabled(bool enabled);
+bool trace_enabled();
+
+uint64_t trace_ticks();
+uint64_t trace_ticks_per_second();
+
+/* chrome://tracing / Perfetto json, returns false when there was nothing to write or the file failed */
+bool trace_export(const char* path);
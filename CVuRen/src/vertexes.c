@@ -32,3 +32,29 @@ VertexAttribDescrStruct getAttributeDescriptions() {
 
 	return attributeDescriptions;
 }
+
+VkVertexInputBindingDescription getInstanceBindDescription() {
+	VkVertexInputBindingDescription bindingDescription = {
+		.binding = 1,
+		.stride = sizeof(InstanceData),
+		.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+	};
+
+	return bindingDescription;
+}
+
+VertexAttribDescrStruct getInstanceAttributeDescriptions() {
+	VertexAttribDescrStruct attributeDescriptions;
+	attributeDescriptions.count = 4;
+	attributeDescriptions.descrs = malloc(sizeof(VkVertexInputAttributeDescription) * attributeDescriptions.count);
+
+	// a mat4 attribute takes one location per column
+	for (uint32_t i = 0; i < attributeDescriptions.count; ++i) {
+		attributeDescriptions.descrs[i].location = 3 + i;
+		attributeDescriptions.descrs[i].binding = 1;
+		attributeDescriptions.descrs[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions.descrs[i].offset = (uint32_t)(offsetof(InstanceData, model) + sizeof(vec4) * i);
+	}
+
+	return attributeDescriptions;
+}
@@ -21,6 +21,24 @@ typedef struct VertexAttribDescrStruct {
 VkVertexInputBindingDescription getBindDescription();
 VertexAttribDescrStruct getAttributeDescriptions();
 
+/* per-instance data, streamed into binding 1 */
+typedef struct InstanceData {
+	mat4 model;
+} InstanceData;
+
+VkVertexInputBindingDescription getInstanceBindDescription();
+VertexAttribDescrStruct getInstanceAttributeDescriptions();
+
 typedef struct UniformBufferObject {
 	alignas(16) mat4 model, view, proj;
+	/* froxel tile size and depth slicing, see lightingClusterParams */
+	alignas(16) vec4 cluster;
+	/* view space to each cascade's light clip space, SHADOW_CASCADES of them */
+	alignas(16) mat4 shadowMatrices[4];
+	/* per cascade, the view depth it ends at and the world size of a texel */
+	alignas(16) vec4 cascadeSplits;
+	alignas(16) vec4 cascadeTexels;
+	/* towards the sun in view space, and its color */
+	alignas(16) vec4 sunDirection;
+	alignas(16) vec4 sunColor;
 } UniformBufferObject;
\ No newline at end of file
@@ -0,0 +1,760 @@
+#include "views.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vkcontext.h"
+#include "pipelines.h"
+#include "geometry.h"
+#include "lighting.h"
+#include "shadows.h"
+#include "resolution.h"
+#include "settings.h"
+
+#include "utils/utils.h"
+
+#define VIEW_PI 3.14159265f
+
+/* what each extra view keeps per frame in flight */
+typedef struct ViewFrame {
+    VkBuffer uniform, instances, draws;
+    VkDeviceMemory uniformMemory, instancesMemory, drawsMemory;
+    void* uniformMapped;
+    InstanceData* instancesMapped;
+    VkDrawIndexedIndirectCommand* drawsMapped;
+    VkDescriptorSet set;
+    VkSemaphore imageAvailable;
+} ViewFrame;
+
+typedef struct View {
+    /* index into the extra windows */
+    uint32_t window;
+    VkSurfaceKHR surface;
+    VkSwapchainKHR swapchain;
+    VkFormat format;
+    VkExtent2D extent;
+    VkImage* images;
+    uint32_t imageCount;
+    /* the image this frame presents, valid while acquired */
+    uint32_t imageIndex;
+    bool acquired;
+    /* out of date or suboptimal, rebuilt before the next acquire */
+    bool stale;
+
+    VkImage color, depth;
+    VkDeviceMemory colorMemory, depthMemory;
+    VkImageView colorView, depthView;
+    VkFramebuffer framebuffer;
+
+    Camera camera;
+    /* the lods this view picked last frame, so the main view's hysteresis isn't disturbed */
+    uint8_t* lods;
+    uint32_t lodCapacity;
+    /* the scene's instances before culling, cpu side so culling doesn't read mapped memory */
+    InstanceData* instances;
+    DrawBatch* batches;
+    uint32_t batchCount;
+    DrawStats drawStats;
+
+    ViewFrame* frames;
+} View;
+
+static struct VIEWS {
+    uint32_t count;
+    View views[WINDOW_MAX_EXTRA];
+
+    VkRenderPass renderPass;
+    VkDescriptorPool pool;
+    PipelineHandle pipeline;
+
+    ViewStats stats;
+} VIEWS;
+
+static void createRenderPass() {
+    // compatible with the scene pass, so the scene shaders can be specialized for it
+    VkAttachmentDescription attachments[2] = {
+        {
+            .flags = 0,
+            .format = RESOLUTION_COLOR_FORMAT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+        },
+        {
+            .flags = 0,
+            .format = findDepthFormat(),
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+        }
+    };
+    VkAttachmentReference colorRef = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+    VkAttachmentReference depthRef = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+    VkSubpassDescription subpass = {
+        .flags = 0,
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 0,
+        .pInputAttachments = NULL,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRef,
+        .pResolveAttachments = NULL,
+        .pDepthStencilAttachment = &depthRef,
+        .preserveAttachmentCount = 0,
+        .pPreserveAttachments = NULL
+    };
+    // the targets are shared by the frames in flight, the last frame's blit has to be done reading
+    VkSubpassDependency dependencies[2] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = 0
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .dependencyFlags = 0
+        }
+    };
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 2,
+        .pDependencies = dependencies
+    };
+    if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &VIEWS.renderPass) != VK_SUCCESS) {
+        c_throw("failed to create view render pass");
+    }
+}
+
+static void createFrames(View* view) {
+    VkDeviceSize instancesSize = sizeof(InstanceData) * MAX_INSTANCES;
+    VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAW_BATCHES;
+    VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0
+    };
+
+    view->frames = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(ViewFrame));
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        ViewFrame* frame = view->frames + i;
+        createBuffer(sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_UNIFORM,
+            &frame->uniform, &frame->uniformMemory);
+        vkMapMemory(VULKAN.device, frame->uniformMemory, 0, sizeof(UniformBufferObject), 0, &frame->uniformMapped);
+        createBuffer(instancesSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_VERTEX,
+            &frame->instances, &frame->instancesMemory);
+        vkMapMemory(VULKAN.device, frame->instancesMemory, 0, instancesSize, 0, (void**)&frame->instancesMapped);
+        createBuffer(drawsSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STORAGE,
+            &frame->draws, &frame->drawsMemory);
+        vkMapMemory(VULKAN.device, frame->drawsMemory, 0, drawsSize, 0, (void**)&frame->drawsMapped);
+
+        if (vkCreateSemaphore(VULKAN.device, &semaphoreInfo, NULL, &frame->imageAvailable) != VK_SUCCESS) {
+            c_throw("failed to create view semaphores");
+        }
+    }
+}
+
+static void createDescriptors() {
+    uint32_t sets = VIEWS.count * MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sets },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * sets },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * sets }
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = sets,
+        .poolSizeCount = 3,
+        .pPoolSizes = poolSizes
+    };
+    if (vkCreateDescriptorPool(VULKAN.device, &poolInfo, NULL, &VIEWS.pool) != VK_SUCCESS) {
+        c_throw("failed to create view descriptor pool");
+    }
+
+    // the scene's set layout, the light and shadow bindings are only there to satisfy it
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            ViewFrame* frame = VIEWS.views[v].frames + i;
+            VkDescriptorSetAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext = NULL,
+                .descriptorPool = VIEWS.pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &VULKAN.descriptorSetLayout
+            };
+            if (vkAllocateDescriptorSets(VULKAN.device, &allocInfo, &frame->set) != VK_SUCCESS) {
+                c_throw("failed to allocate view descriptor sets");
+            }
+
+            VkDescriptorBufferInfo buffers[4] = {
+                { frame->uniform, 0, sizeof(UniformBufferObject) },
+                { lightingLights(i), 0, VK_WHOLE_SIZE },
+                { lightingClusters(i), 0, VK_WHOLE_SIZE },
+                { lightingIndices(i), 0, VK_WHOLE_SIZE }
+            };
+            VkDescriptorImageInfo images[2] = {
+                {
+                    .sampler = VULKAN.textureSampler,
+                    .imageView = VULKAN.textureImageView,
+                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                },
+                {
+                    .sampler = shadowMapSampler(),
+                    .imageView = shadowMapView(),
+                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                }
+            };
+            VkWriteDescriptorSet writes[6];
+            for (uint32_t b = 0; b < 6; ++b) {
+                bool image = b == 1 || b == 5;
+                writes[b] = (VkWriteDescriptorSet){
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = NULL,
+                    .dstSet = frame->set,
+                    .dstBinding = b,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+                        image ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pImageInfo = image ? images + (b == 5) : NULL,
+                    .pBufferInfo = image ? NULL : buffers + (b == 0 ? 0 : b - 1),
+                    .pTexelBufferView = NULL
+                };
+            }
+            vkUpdateDescriptorSets(VULKAN.device, 6, writes, 0, NULL);
+        }
+    }
+}
+
+static void requestViewPipeline() {
+    PipelineDesc desc;
+    sceneVertexInput(&desc);
+    strncpy(desc.fragShader, "shaders/frag.spv", PIPELINE_SHADER_PATH - 1);
+    desc.renderPass = VIEWS.renderPass;
+    desc.layout = VULKAN.pipelineLayout;
+    VkBool32 simple = VK_TRUE;
+    desc.specEntries[0] = (VkSpecializationMapEntry){ 0, 0, sizeof(VkBool32) };
+    desc.specEntryCount = 1;
+    memcpy(desc.specData, &simple, sizeof(VkBool32));
+    desc.specDataSize = sizeof(VkBool32);
+    VIEWS.pipeline = requestPipeline(&desc, PIPELINE_HANDLE_NONE);
+}
+
+void createViewResources() {
+    memset(&VIEWS.stats, 0, sizeof(ViewStats));
+    VIEWS.count = WINDOW.extraCount;
+    if (VIEWS.count == 0) return;
+
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        memset(view, 0, sizeof(View));
+        view->window = v;
+        view->instances = malloc(sizeof(InstanceData) * MAX_INSTANCES);
+        view->batches = malloc(sizeof(DrawBatch) * VULKAN.meshCount * MESH_MAX_LODS);
+        cameraInit(&view->camera, VULKAN.camera.fovy, VULKAN.camera.znear, VULKAN.camera.zfar);
+        createFrames(view);
+    }
+    createRenderPass();
+    createDescriptors();
+    requestViewPipeline();
+}
+
+void destroyViewResources() {
+    if (VIEWS.count == 0) return;
+
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+            ViewFrame* frame = view->frames + i;
+            vkDestroyBuffer(VULKAN.device, frame->uniform, NULL);
+            freeDeviceMemory(frame->uniformMemory);
+            vkDestroyBuffer(VULKAN.device, frame->instances, NULL);
+            freeDeviceMemory(frame->instancesMemory);
+            vkDestroyBuffer(VULKAN.device, frame->draws, NULL);
+            freeDeviceMemory(frame->drawsMemory);
+            vkDestroySemaphore(VULKAN.device, frame->imageAvailable, NULL);
+        }
+        free(view->frames);
+        free(view->instances);
+        free(view->batches);
+        free(view->lods);
+    }
+    vkDestroyDescriptorPool(VULKAN.device, VIEWS.pool, NULL);
+    vkDestroyRenderPass(VULKAN.device, VIEWS.renderPass, NULL);
+}
+
+static void createSwapchain(View* view) {
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VULKAN.physicalDevice, view->surface, &capabilities);
+    uint32_t formatCount = 0, modeCount = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(VULKAN.physicalDevice, view->surface, &formatCount, NULL);
+    VkSurfaceFormatKHR* formats = malloc(sizeof(VkSurfaceFormatKHR) * formatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(VULKAN.physicalDevice, view->surface, &formatCount, formats);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(VULKAN.physicalDevice, view->surface, &modeCount, NULL);
+    VkPresentModeKHR* modes = malloc(sizeof(VkPresentModeKHR) * modeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(VULKAN.physicalDevice, view->surface, &modeCount, modes);
+
+    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(formats, formatCount);
+    VkPresentModeKHR presentMode = chooseSwapPresentMode(modes, modeCount);
+    free(formats);
+    free(modes);
+
+    // glfw only knows the size on the main thread, its last poll is what counts here
+    VkExtent2D extent = capabilities.currentExtent;
+    if (extent.width == UINT32_MAX) {
+        int width = 0, height = 0;
+        windowExtraFramebufferSize(view->window, &width, &height);
+        extent.width = u32_clamp((uint32_t)width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        extent.height = u32_clamp((uint32_t)height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+    }
+    uint32_t imageCount = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+        imageCount = capabilities.maxImageCount;
+    }
+    if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        c_throw("view swapchain images can't be transfer destinations");
+    }
+
+    uint32_t queueFamilyIndices[] = { VULKAN.queueFamilies.graphicsFamily, VULKAN.queueFamilies.presentFamily };
+    bool qGraphNEQPresent = queueFamilyIndices[0] != queueFamilyIndices[1];
+    VkSwapchainKHR oldSwapchain = view->swapchain;
+    VkSwapchainCreateInfoKHR createInfo = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .pNext = NULL,
+        .flags = 0,
+        .surface = view->surface,
+        .minImageCount = imageCount,
+        .imageFormat = surfaceFormat.format,
+        .imageColorSpace = surfaceFormat.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .imageSharingMode = qGraphNEQPresent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = qGraphNEQPresent ? 2 : 0,
+        .pQueueFamilyIndices = qGraphNEQPresent ? queueFamilyIndices : NULL,
+        .preTransform = capabilities.currentTransform,
+        .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+        .presentMode = presentMode,
+        .clipped = VK_TRUE,
+        .oldSwapchain = oldSwapchain
+    };
+    if (vkCreateSwapchainKHR(VULKAN.device, &createInfo, NULL, &view->swapchain) != VK_SUCCESS) {
+        c_throw("failed to create view swapchain");
+    }
+    if (oldSwapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(VULKAN.device, oldSwapchain, NULL);
+    }
+
+    free(view->images);
+    vkGetSwapchainImagesKHR(VULKAN.device, view->swapchain, &view->imageCount, NULL);
+    view->images = malloc(sizeof(VkImage) * view->imageCount);
+    vkGetSwapchainImagesKHR(VULKAN.device, view->swapchain, &view->imageCount, view->images);
+    view->format = surfaceFormat.format;
+    view->extent = extent;
+    view->stale = false;
+}
+
+static void createTargets(View* view) {
+    createImage(view->extent.width, view->extent.height, RESOLUTION_COLOR_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_ATTACHMENT, &view->color, &view->colorMemory);
+    view->colorView = createImageView(view->color, RESOLUTION_COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    VkFormat depthFormat = findDepthFormat();
+    createImage(view->extent.width, view->extent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_ATTACHMENT, &view->depth, &view->depthMemory);
+    view->depthView = createImageView(view->depth, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    VkImageView attachments[] = { view->colorView, view->depthView };
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = VIEWS.renderPass,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .width = view->extent.width,
+        .height = view->extent.height,
+        .layers = 1
+    };
+    if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, &view->framebuffer) != VK_SUCCESS) {
+        c_throw("failed to create view framebuffer");
+    }
+}
+
+static void destroyTargets(View* view) {
+    vkDestroyFramebuffer(VULKAN.device, view->framebuffer, NULL);
+    vkDestroyImageView(VULKAN.device, view->colorView, NULL);
+    vkDestroyImage(VULKAN.device, view->color, NULL);
+    freeDeviceMemory(view->colorMemory);
+    vkDestroyImageView(VULKAN.device, view->depthView, NULL);
+    vkDestroyImage(VULKAN.device, view->depth, NULL);
+    freeDeviceMemory(view->depthMemory);
+}
+
+void createViewTargets() {
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        if (glfwCreateWindowSurface(VULKAN.instance, WINDOW.extra[view->window], NULL, &view->surface) != VK_SUCCESS) {
+            c_throw("failed to create view surface");
+        }
+        // the present family was picked for the main window, every other one has to work with it too
+        VkBool32 presentSupport = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(VULKAN.physicalDevice, VULKAN.queueFamilies.presentFamily,
+            view->surface, &presentSupport);
+        if (!presentSupport) {
+            c_throw("the present queue can't present to an extra window");
+        }
+        createSwapchain(view);
+        createTargets(view);
+    }
+}
+
+void destroyViewTargets() {
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        destroyTargets(view);
+        vkDestroySwapchainKHR(VULKAN.device, view->swapchain, NULL);
+        vkDestroySurfaceKHR(VULKAN.instance, view->surface, NULL);
+        free(view->images);
+        view->swapchain = VK_NULL_HANDLE;
+        view->images = NULL;
+    }
+}
+
+uint32_t viewCount() {
+    return 1 + VIEWS.count;
+}
+
+static void recreateView(View* view) {
+    // frames still in flight draw into the targets
+    vkDeviceWaitIdle(VULKAN.device);
+    destroyTargets(view);
+    createSwapchain(view);
+    createTargets(view);
+    ++VIEWS.stats.recreates;
+}
+
+void acquireViews(uint32_t frame) {
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        view->acquired = false;
+
+        // minimized, nothing to present until it's back
+        int width = 0, height = 0;
+        windowExtraFramebufferSize(view->window, &width, &height);
+        if (width == 0 || height == 0) continue;
+        if (view->stale || (uint32_t)width != view->extent.width || (uint32_t)height != view->extent.height) {
+            recreateView(view);
+        }
+
+        VkResult result = vkAcquireNextImageKHR(VULKAN.device, view->swapchain, UINT64_MAX,
+            view->frames[frame].imageAvailable, VK_NULL_HANDLE, &view->imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            view->stale = true;
+            continue;
+        } else if (result == VK_SUBOPTIMAL_KHR) {
+            // the image is still good for this frame
+            view->stale = true;
+        } else if (result != VK_SUCCESS) {
+            c_throw("failed to acquire view swapchain image");
+        }
+        view->acquired = true;
+    }
+}
+
+// spread evenly around the main camera's center, at the main camera's distance and height
+static void orbitCamera(View* view, uint32_t index) {
+    const Camera* primary = &VULKAN.camera;
+    float angle = 2.0f * VIEW_PI * (float)(index + 1) / (float)viewCount();
+    float c = cosf(angle), s = sinf(angle);
+    vec3 offset;
+    glm_vec3_sub((float*)primary->eye, (float*)primary->center, offset);
+    vec3 eye = {
+        primary->center[0] + offset[0] * c - offset[1] * s,
+        primary->center[1] + offset[0] * s + offset[1] * c,
+        primary->center[2] + offset[2]
+    };
+    cameraLookAt(&view->camera, eye, primary->center, primary->up);
+    cameraSetAspect(&view->camera, (float)view->extent.width / (float)view->extent.height);
+    cameraUpdate(&view->camera);
+}
+
+// bounding spheres against the view's frustum, the survivors are packed into the frame's instance buffer
+static uint32_t cullView(View* view, ViewFrame* frame) {
+    mat4 viewProj;
+    vec4 planes[6];
+    glm_mat4_mul(view->camera.proj, view->camera.view, viewProj);
+    glm_frustum_planes(viewProj, planes);
+
+    uint32_t written = 0, batchCount = 0;
+    for (uint32_t b = 0; b < view->batchCount; ++b) {
+        DrawBatch batch = view->batches[b];
+        const Mesh* mesh = VULKAN.meshes + batch.mesh;
+        uint32_t first = written;
+        for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i) {
+            vec4* model = (vec4*)view->instances[i].model;
+            vec3 center;
+            glm_mat4_mulv3(model, (float*)mesh->center, 1.0f, center);
+            float scale = glm_vec3_norm(model[0]);
+            float sy = glm_vec3_norm(model[1]), sz = glm_vec3_norm(model[2]);
+            if (sy > scale) scale = sy;
+            if (sz > scale) scale = sz;
+            float radius = mesh->radius * scale;
+
+            bool inside = true;
+            for (uint32_t p = 0; p < 6 && inside; ++p) {
+                inside = glm_vec3_dot(planes[p], center) + planes[p][3] >= -radius;
+            }
+            if (inside) frame->instancesMapped[written++] = view->instances[i];
+        }
+        if (written == first) continue;
+
+        const MeshLod* lod = mesh->lods + batch.lod;
+        frame->drawsMapped[batchCount++] = (VkDrawIndexedIndirectCommand){
+            .indexCount = lod->indexCount,
+            .instanceCount = written - first,
+            .firstIndex = lod->firstIndex,
+            .vertexOffset = mesh->vertexOffset,
+            .firstInstance = first
+        };
+    }
+    view->batchCount = batchCount;
+    return written;
+}
+
+void updateViews(uint32_t frameIndex) {
+    ViewStats* stats = &VIEWS.stats;
+    stats->views = stats->instances = stats->culled = stats->batches = 0;
+    if (VIEWS.count == 0) return;
+
+    uint64_t start = getTimeInNanoseconds();
+    Scene* scene = &VULKAN.scene;
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        if (!view->acquired) continue;
+        ViewFrame* frame = view->frames + frameIndex;
+
+        orbitCamera(view, v);
+        // rewritten every frame, the sun moves and it's one small copy per view
+        UniformBufferObject ubo = {
+            GLM_MAT4_IDENTITY_INIT,GLM_MAT4_ZERO_INIT,GLM_MAT4_ZERO_INIT
+        };
+        glm_mat4_copy(view->camera.view, ubo.view);
+        glm_mat4_copy(view->camera.proj, ubo.proj);
+        writeShadowUniforms(&view->camera, &ubo);
+        memcpy(frame->uniformMapped, &ubo, sizeof(ubo));
+
+        // the scene keeps the main view's lods, the shadow casters follow them
+        if (view->lodCapacity != scene->capacity) {
+            free(view->lods);
+            view->lods = calloc(scene->capacity, sizeof(uint8_t));
+            view->lodCapacity = scene->capacity;
+        }
+        uint8_t* lods = scene->lod;
+        scene->lod = view->lods;
+        view->batchCount = sceneBuildDraws(scene, VULKAN.meshes, VULKAN.meshCount, &view->camera,
+            (float)view->extent.height, view->instances, NULL, view->batches, &view->drawStats);
+        scene->lod = lods;
+
+        uint32_t visible = cullView(view, frame);
+        ++stats->views;
+        stats->instances += visible;
+        stats->culled += view->drawStats.instances - visible;
+        stats->batches += view->batchCount;
+    }
+
+    uint64_t elapsed = getTimeInNanoseconds() - start;
+    stats->buildNs = elapsed;
+    if (elapsed > stats->buildNsMax) stats->buildNsMax = elapsed;
+    ++stats->frames;
+    stats->viewsTotal += stats->views;
+    stats->instancesTotal += stats->instances;
+    stats->culledTotal += stats->culled;
+    stats->buildNsTotal += elapsed;
+}
+
+void recordViews(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    VkPipeline pipeline = VIEWS.count ? getPipeline(VIEWS.pipeline) : VK_NULL_HANDLE;
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        if (!view->acquired) continue;
+        ViewFrame* frame = view->frames + frameIndex;
+
+        VkClearValue clear[] = {
+            {.color = {0.0f,0.0f,0.0f,1.0f}},
+            {.depthStencil = {1.0f, 0}}
+        };
+        VkRenderPassBeginInfo renderPassInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = NULL,
+            .renderPass = VIEWS.renderPass,
+            .framebuffer = view->framebuffer,
+            .renderArea = {
+                .offset = {0,0},
+                .extent = view->extent
+            },
+            .clearValueCount = 2,
+            .pClearValues = clear
+        };
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // still compiling, the view is only cleared
+        if (pipeline != VK_NULL_HANDLE && view->batchCount > 0) {
+            VkViewport viewport = {
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = (float)view->extent.width,
+                .height = (float)view->extent.height,
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f
+            };
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            VkRect2D scissor = {
+                .offset = {0,0},
+                .extent = view->extent
+            };
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bindGeometry(commandBuffer);
+            VkDeviceSize instanceOffset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1, &frame->instances, &instanceOffset);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, VULKAN.pipelineLayout,
+                0, 1, &frame->set, 0, NULL);
+            if (VULKAN.multiDrawIndirect) {
+                vkCmdDrawIndexedIndirect(commandBuffer, frame->draws, 0, view->batchCount,
+                    sizeof(VkDrawIndexedIndirectCommand));
+            } else {
+                for (uint32_t i = 0; i < view->batchCount; ++i) {
+                    const VkDrawIndexedIndirectCommand* draw = frame->drawsMapped + i;
+                    vkCmdDrawIndexed(commandBuffer, draw->indexCount, draw->instanceCount,
+                        draw->firstIndex, draw->vertexOffset, draw->firstInstance);
+                }
+            }
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void recordViewBlits(VkCommandBuffer commandBuffer) {
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        if (!view->acquired) continue;
+
+        // transfer is the stage the acquire semaphores are waited on, the same as the main view's blit
+        VkImageMemoryBarrier toDst = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = view->images[view->imageIndex],
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, NULL, 0, NULL, 1, &toDst);
+
+        VkImageBlit region = {
+            .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .srcOffsets = { { 0, 0, 0 }, { (int32_t)view->extent.width, (int32_t)view->extent.height, 1 } },
+            .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .dstOffsets = { { 0, 0, 0 }, { (int32_t)view->extent.width, (int32_t)view->extent.height, 1 } }
+        };
+        vkCmdBlitImage(commandBuffer, view->color, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            toDst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+
+        VkImageMemoryBarrier toPresent = toDst;
+        toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toPresent.dstAccessMask = 0;
+        toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, NULL, 0, NULL, 1, &toPresent);
+    }
+}
+
+uint32_t viewPresentTargets(uint32_t frame, VkSemaphore* waits, VkSwapchainKHR* swapchains, uint32_t* imageIndices) {
+    uint32_t count = 0;
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        if (!view->acquired) continue;
+        waits[count] = view->frames[frame].imageAvailable;
+        swapchains[count] = view->swapchain;
+        imageIndices[count] = view->imageIndex;
+        ++count;
+    }
+    return count;
+}
+
+void viewsPresented(const VkResult* results) {
+    uint32_t count = 0;
+    for (uint32_t v = 0; v < VIEWS.count; ++v) {
+        View* view = VIEWS.views + v;
+        if (!view->acquired) continue;
+        VkResult result = results[count++];
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            view->stale = true;
+        } else if (result != VK_SUCCESS) {
+            c_throw("failed to present view swapchain image");
+        }
+    }
+}
+
+ViewStats getViewStats() {
+    return VIEWS.stats;
+}
+
+void printViewStats() {
+    const ViewStats* stats = &VIEWS.stats;
+    if (VIEWS.count == 0) return;
+    double frames = stats->frames ? (double)stats->frames : 1.0;
+    printf("views: %u extra, %.2f presented a frame on average, %.0f instances drawn and %.0f frustum culled "
+        "a frame, %.2f ms to cull on average and %.2f ms at worst, %u swapchain recreates\n",
+        VIEWS.count, (double)stats->viewsTotal / frames, (double)stats->instancesTotal / frames,
+        (double)stats->culledTotal / frames, (double)stats->buildNsTotal / frames / 1e6,
+        (double)stats->buildNsMax / 1e6, stats->recreates);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "window.h"
+
+/* the main view and one per extra window */
+#define VIEW_MAX (1 + WINDOW_MAX_EXTRA)
+
+typedef struct ViewStats {
+    /* extra views with an image this frame, the rest were minimized or out of date */
+    uint32_t views;
+    uint32_t instances, culled, batches;
+    /* culling and writing every extra view's draws */
+    uint64_t buildNs, buildNsMax;
+
+    uint64_t frames, viewsTotal, instancesTotal, culledTotal, buildNsTotal;
+    uint32_t recreates;
+} ViewStats;
+
+/*
+ * Extra views of the scene, each in a window of its own with its own camera,
+ * surface, swapchain and targets. The main view stays what VULKAN holds; the
+ * extra ones share the device, the geometry arenas, the scene and its
+ * textures, the pipeline layout and the scene shaders. Every view picks its
+ * own lods and is frustum culled on the cpu into its own instance and
+ * indirect buffers, then drawn in the same command buffer as the main view.
+ * Their blits go in the main view's present commands, that submit waits on
+ * every acquired image, and one vkQueuePresentKHR hands all the swapchains
+ * back together.
+ *
+ * The extra cameras orbit the main camera's center, spread evenly around it.
+ * They're shaded with the sun and ambient light only and tonemapped straight
+ * in the scene shader: clusters, shadow cascades, occlusion culling, dynamic
+ * resolution and the post stack all follow the main camera.
+ */
+void createViewResources();
+void destroyViewResources();
+
+/* surfaces, swapchains and targets for the extra windows; main thread, after createViewResources */
+void createViewTargets();
+void destroyViewTargets();
+
+uint32_t viewCount();
+
+/* render thread, after the main view's acquire; a view that can't get an image sits the frame out */
+void acquireViews(uint32_t frame);
+/* cameras, lods, culling and draws of the views that got an image */
+void updateViews(uint32_t frame);
+
+/* every acquired view's scene pass, its target ends up ready to blit */
+void recordViews(VkCommandBuffer commandBuffer, uint32_t frame);
+/* into the acquired images, in the present commands after the main view's blit */
+void recordViewBlits(VkCommandBuffer commandBuffer);
+
+/* appends what the present submit waits on and what vkQueuePresentKHR takes, returns how many */
+uint32_t viewPresentTargets(uint32_t frame, VkSemaphore* waits, VkSwapchainKHR* swapchains, uint32_t* imageIndices);
+/* results in the order viewPresentTargets gave the swapchains */
+void viewsPresented(const VkResult* results);
+
+ViewStats getViewStats();
+void printViewStats();
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+
+#include "vkstructs.h"
+#include "pipelines.h"
+#include "scene.h"
+#include "renderqueue.h"
+#include "devices.h"
+#include "gpumemory.h"
+#include "lighting.h"
+
+#include "utils/threading.h"
+
+static const int MAX_FRAMES_IN_FLIGHT = 2;
+#define MAX_INSTANCES 16384
+#define MAX_DRAW_BATCHES 1024
+
+/* compute and transfer fall back to the graphics family when there's no dedicated one */
+typedef struct QueueFamilyIndices {
+    uint32_t graphicsFamily;
+    uint32_t presentFamily;
+    uint32_t computeFamily;
+    uint32_t transferFamily;
+    bool dedicatedCompute;
+    bool dedicatedTransfer;
+    bool itIs;
+} QueueFamilyIndices;
+
+// ======= VULKAN DATA STRUCT ======= //
+struct VULKAN {
+    VkInstance instance;
+    VkSurfaceKHR surface;
+    
+    VkPhysicalDevice physicalDevice;
+    /* decides the optional paths, see DeviceTier */
+    DeviceTier deviceTier;
+    VkDevice device;
+    bool pipelineStatisticsQuery;
+    bool multiDrawIndirect;
+    bool calibratedTimestamps;
+    
+    QueueFamilyIndices queueFamilies;
+    VkQueue graphicsQueue;
+    VkQueue presentQueue;
+    VkQueue computeQueue;
+    VkQueue transferQueue;
+    VkSwapchainKHR swapchain;
+    
+    VkFormat swapchainImageFormat;
+    bool swapchainTransferSrc;
+    VkExtent2D swapchainExtent;
+    vkimages swapchainImages;
+    /* the scaled part of the scene target the frame renders to, set by updateRenderScale */
+    VkExtent2D renderExtent;
+
+    VkRenderPass renderPass;
+    /* same attachments, loads instead of clearing, for drawing on top of the first pass */
+    VkRenderPass renderPassLoad;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkPipelineLayout pipelineLayout;
+    PipelineHandle pipeline;
+    
+    VkFramebuffer sceneFramebuffer;
+    VkCommandPool commandPool;
+    c_mutex commandPoolLock;
+    VkCommandBuffer* commandBuffer;
+    /* the blit into the acquired image, a submit of its own so nothing else waits for the acquire */
+    VkCommandBuffer* presentCommandBuffer;
+
+    VkSemaphore* imageAvailableSemaphore;
+    VkSemaphore* renderFinishedSemaphore;
+    VkFence* inFlightFence;
+
+    bool framebufferResized;
+
+    uint32_t currentFrame;
+
+
+    VkBuffer* uniformBuffers;
+    VkDeviceMemory* uniformBuffersMemory;
+    void** uniformBuffersMapped;
+
+    VkBuffer* instanceBuffers;
+    VkDeviceMemory* instanceBuffersMemory;
+    void** instanceBuffersMapped;
+    uint32_t* instanceNodes;
+
+    VkBuffer* indirectBuffers;
+    VkDeviceMemory* indirectBuffersMemory;
+    void** indirectBuffersMapped;
+
+    Mesh* meshes;
+    uint32_t meshCount;
+    /* per mesh and lod as the scene emits them, drawBatches is the same in render queue order */
+    DrawBatch* sceneBatches;
+    DrawBatch* drawBatches;
+    uint32_t drawBatchCount;
+    RenderQueue renderQueue;
+    DrawStats drawStats;
+
+    Scene scene;
+    uint32_t sceneRoot;
+    Camera camera;
+    uint32_t* uniformVersions;
+    Light* lights;
+    uint32_t lightCount;
+    /* where each light was scattered, the orbit is measured from there */
+    vec3* lightOrigins;
+
+    /* mesh and texture uploads at startup */
+    uint64_t uploadTimeNs;
+
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet* descriptorSets;
+
+    VkImage textureImage;
+    VkDeviceMemory textureImageMemory;
+    VkImageView textureImageView;
+    VkSampler textureSampler;
+
+    VkImage depthImage;
+    VkDeviceMemory depthImageMemory;
+    VkImageView depthImageView;
+
+    VkDebugUtilsMessengerEXT debugMessenger;
+};
+
+extern struct VULKAN VULKAN;
+
+//  HELPERS SHARED WITH THE SUBSYSTEMS
+uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    MemoryCategory category, VkBuffer* buffer, VkDeviceMemory* bufferMemory);
+/* one buffer per frame in flight, mapped when mapped isn't NULL */
+void createFrameBuffers(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    MemoryCategory category, VkBuffer** buffers, VkDeviceMemory** memory, void*** mapped);
+void destroyFrameBuffers(VkBuffer* buffers, VkDeviceMemory* memory, void** mapped);
+void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+    VkMemoryPropertyFlags properties, MemoryCategory category, VkImage* image, VkDeviceMemory* imageMemory);
+/* 2d array, one mip level */
+void createImageLayers(uint32_t width, uint32_t height, uint32_t layers, VkFormat format, VkImageTiling tiling,
+    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category,
+    VkImage* image, VkDeviceMemory* imageMemory);
+VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+VkImageView createImageViewLayers(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+    VkImageViewType viewType, uint32_t baseLayer, uint32_t layerCount);
+VkCommandBuffer beginSingleTimeCommands();
+void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+VkShaderModule createShaderModule(shaderfile file);
+/* default desc with the scene's vertex shader and vertex/instance input */
+void sceneVertexInput(PipelineDesc* desc);
+/* shared with the extra views' swapchains */
+VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR* formats, uint32_t count);
+VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* modes, uint32_t count);
+VkFormat findDepthFormat();
+/* depth only, sampled with linear compare filtering and copied between layers */
+VkFormat findShadowFormat();
+bool hasStancilComponent(VkFormat format);
+QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
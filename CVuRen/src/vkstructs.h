@@ -7,17 +7,7 @@ typedef struct vkimages {
 	uint32_t count;
 } vkimages;
 
-typedef struct vkimageviews {
-	VkImageView* swapChainImageViews;
-	uint32_t count;
-} vkimageviews;
-
 typedef struct shaderfile {
-	char* file;
+	const char* file;
 	size_t size;
 } shaderfile;
-
-typedef struct framebuffer {
-	VkFramebuffer* f;
-	size_t count;
-} framebuffer;
\ No newline at end of file
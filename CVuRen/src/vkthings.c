@@ -6,13 +6,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <stdbool.h>
 
 #include "window.h"
+#include "vkcontext.h"
 #include "vkstructs.h"
 #include "vertexes.h"
-
+#include "capture.h"
+#include "compute.h"
+#include "geometry.h"
+#include "gpumemory.h"
+#include "gpustats.h"
+#include "gputrace.h"
+#include "hud.h"
+#include "lighting.h"
+#include "meshopt.h"
+#include "occlusion.h"
+#include "overdraw.h"
+#include "overlay.h"
+#include "settings.h"
+#include "resolution.h"
+#include "post.h"
+#include "shadows.h"
+#include "simulation.h"
+#include "sprites.h"
+#include "views.h"
+
+#include "utils/assetio.h"
 #include "utils/dynamic_array.h"
+#include "utils/taskgraph.h"
+#include "utils/trace.h"
 #include "utils/utils.h"
 
 #ifdef NDEBUG
@@ -21,63 +45,7 @@
 #define VALIDATION_LAYERS 1
 #endif
 
-// ======= VULKAN DATA STRUCT ======= //
-static struct VULKAN {
-    VkInstance instance;
-    VkSurfaceKHR surface;
-    
-    VkPhysicalDevice physicalDevice;
-    VkDevice device;
-    
-    VkQueue graphicsQueue;
-    VkQueue presentQueue;
-    VkSwapchainKHR swapchain;
-    
-    VkFormat swapchainImageFormat;
-    VkExtent2D swapchainExtent;
-    vkimages swapchainImages;
-    vkimageviews swapchainImageViews;
-
-    VkRenderPass renderPass;
-    VkDescriptorSetLayout descriptorSetLayout;
-    VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
-    
-    framebuffer swapchainFramebuffers;
-    VkCommandPool commandPool;
-    VkCommandBuffer* commandBuffer;
-
-    VkSemaphore* imageAvailableSemaphore;
-    VkSemaphore* renderFinishedSemaphore;
-    VkFence* inFlightFence;
-
-    bool framebufferResized;
-
-    uint32_t currentFrame;
-
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
-
-    VkBuffer* uniformBuffers;
-    VkDeviceMemory* uniformBuffersMemory;
-    void** uniformBuffersMapped;
-
-    VkDescriptorPool descriptorPool;
-    VkDescriptorSet* descriptorSets;
-
-    VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
-    VkImageView textureImageView;
-    VkSampler textureSampler;
-
-    VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
-    VkImageView depthImageView;
-
-    VkDebugUtilsMessengerEXT debugMessenger;
-} VULKAN;
+struct VULKAN VULKAN;
 
 #ifdef NDEBUG
 const char** validationLayers = NULL;
@@ -88,8 +56,6 @@ const char* validationLayers[] = {"VK_LAYER_KHRONOS_validation\0"};
 const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 const uint32_t deviceExtensionsCount = 1;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
-
 #define VERTICES_COUNT 8
 Vertex vertices[VERTICES_COUNT] = {
     {{-0.5f, -0.5f, 0.5f},{1.0f, 0.0f, 0.0f,1.0f}, {1.0f, 0.0f, 0.0f}},
@@ -108,12 +74,6 @@ const uint32_t indices[INDICES_COUNT] = {
     4, 5, 6, 6, 7, 4
 };
 
-typedef struct QueueFamilyIndices {
-    uint32_t graphicsFamily;
-    uint32_t presentFamily;
-    bool itIs;
-} QueueFamilyIndices;
-
 typedef struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR* capabilities;
     VkSurfaceFormatKHR* formats;
@@ -128,51 +88,38 @@ void createSwapChain();
 
 void pickPhysicalDevice();
 bool isDeviceSuitable(VkPhysicalDevice device);
-QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 void createLogicalDevice();
 bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR* formats, uint32_t count);
 VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* modes, uint32_t count);
 VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR* capabilities);
-void createImageViews();
 void createRenderPass();
 void createGraphicsPipeline();
-shaderfile readFile(const char* filename);
-VkShaderModule createShaderModule(shaderfile file);
 void createFramebuffers();
 void createCommandPool();
 void createCommandBuffers();
-void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+void recordCommandBuffer(VkCommandBuffer commandBuffer);
+void recordPresentCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 void createSyncObjects();
 void recreateSwapchain();
 void clearupSwapchain();
-void createVertexBuffer();
-void createIndexBuffer();
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags properties, VkBuffer* buffer, VkDeviceMemory* bufferMemory);
-void copyBuffer(VkBuffer srcBuffer,VkBuffer dstBuffer, VkDeviceSize size);
+void buildMeshes();
+void uploadMeshes();
 void createDescriptorSetLayout();
 void createUniformBuffers();
+void createInstanceBuffers();
 void updateUniformBuffer(uint32_t currentImage);
 void createDescriptorPool();
 void createDescriptorSets();
+void decodeTextureImage();
 void createTextureImage();
-void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* image, VkDeviceMemory* imageMemory);
-VkCommandBuffer beginSingleTimeCommands();
-void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 void createTextureImageView();
-VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
 void createTextureSampler();
 void createDepthResources();
 VkFormat findSupportedFormat(const VkFormat* candidates, uint32_t candidatesCount,
     VkImageTiling tiling, VkFormatFeatureFlags features);
-VkFormat findDepthFormat();
-bool hasStancilComponent(VkFormat format);
 
 static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 
@@ -191,29 +138,144 @@ void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT* create
 //  FROM .H
 void initVk() {
     glfwSetFramebufferSizeCallback(WINDOW.window, framebufferResizeCallback);
-    createInstance();
-    setupDebugMessenger();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createDescriptorSetLayout();
-    createGraphicsPipeline();
-    createCommandPool();
-    createDepthResources();
-    createFramebuffers();
-    createTextureImage();
-    createTextureImageView();
-    createTextureSampler();
-    createVertexBuffer();
-    createIndexBuffer();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
-    createSyncObjects();
+
+    // every step runs as soon as what it touches exists, GLFW calls stay on this thread
+    task_graph graph;
+    tg_init(&graph);
+
+    uint32_t instance = tg_add(&graph, "createInstance", createInstance, false);
+    uint32_t debug = tg_add(&graph, "setupDebugMessenger", setupDebugMessenger, false);
+    uint32_t surface = tg_add(&graph, "createSurface", createSurface, false);
+    uint32_t physical = tg_add(&graph, "pickPhysicalDevice", pickPhysicalDevice, false);
+    uint32_t device = tg_add(&graph, "createLogicalDevice", createLogicalDevice, false);
+    uint32_t pipelineCache = tg_add(&graph, "initPipelineCache", initPipelineCache, false);
+    uint32_t swapchain = tg_add(&graph, "createSwapChain", createSwapChain, true);
+    uint32_t renderPass = tg_add(&graph, "createRenderPass", createRenderPass, false);
+    uint32_t setLayout = tg_add(&graph, "createDescriptorSetLayout", createDescriptorSetLayout, false);
+    uint32_t pipeline = tg_add(&graph, "createGraphicsPipeline", createGraphicsPipeline, false);
+    uint32_t commandPool = tg_add(&graph, "createCommandPool", createCommandPool, false);
+    uint32_t depth = tg_add(&graph, "createDepthResources", createDepthResources, false);
+    uint32_t framebuffers = tg_add(&graph, "createFramebuffers", createFramebuffers, false);
+    uint32_t textureDecode = tg_add(&graph, "decodeTextureImage", decodeTextureImage, false);
+    uint32_t texture = tg_add(&graph, "createTextureImage", createTextureImage, false);
+    uint32_t textureView = tg_add(&graph, "createTextureImageView", createTextureImageView, false);
+    uint32_t sampler = tg_add(&graph, "createTextureSampler", createTextureSampler, false);
+    uint32_t geometry = tg_add(&graph, "createGeometryBuffers", createGeometryBuffers, false);
+    uint32_t meshes = tg_add(&graph, "buildMeshes", buildMeshes, false);
+    uint32_t upload = tg_add(&graph, "uploadMeshes", uploadMeshes, false);
+    uint32_t uniformBuffers = tg_add(&graph, "createUniformBuffers", createUniformBuffers, false);
+    uint32_t instanceBuffers = tg_add(&graph, "createInstanceBuffers", createInstanceBuffers, false);
+    uint32_t descriptorPool = tg_add(&graph, "createDescriptorPool", createDescriptorPool, false);
+    uint32_t descriptorSets = tg_add(&graph, "createDescriptorSets", createDescriptorSets, false);
+    uint32_t commandBuffers = tg_add(&graph, "createCommandBuffers", createCommandBuffers, false);
+    uint32_t syncObjects = tg_add(&graph, "createSyncObjects", createSyncObjects, false);
+    uint32_t compute = tg_add(&graph, "createComputeResources", createComputeResources, false);
+    uint32_t statistics = tg_add(&graph, "createStatisticsQueries", createStatisticsQueries, false);
+    uint32_t occlusion = tg_add(&graph, "createOcclusionResources", createOcclusionResources, false);
+    uint32_t pyramid = tg_add(&graph, "createDepthPyramid", createDepthPyramid, false);
+    uint32_t capture = tg_add(&graph, "createCaptureResources", createCaptureResources, false);
+    uint32_t overdraw = tg_add(&graph, "createOverdrawResources", createOverdrawResources, false);
+    uint32_t overdrawTarget = tg_add(&graph, "createOverdrawTarget", createOverdrawTarget, false);
+    uint32_t gpuTrace = tg_add(&graph, "createGpuTrace", createGpuTrace, false);
+    uint32_t lighting = tg_add(&graph, "createLightingResources", createLightingResources, false);
+    uint32_t shadows = tg_add(&graph, "createShadowResources", createShadowResources, false);
+    uint32_t resolution = tg_add(&graph, "createResolutionResources", createResolutionResources, false);
+    uint32_t post = tg_add(&graph, "createPostResources", createPostResources, false);
+    uint32_t renderTargets = tg_add(&graph, "createRenderTargets", createRenderTargets, false);
+    uint32_t overlay = tg_add(&graph, "createOverlayResources", createOverlayResources, false);
+    uint32_t overlayTargets = tg_add(&graph, "createOverlayTargets", createOverlayTargets, false);
+    uint32_t sprites = tg_add(&graph, "createSpriteResources", createSpriteResources, false);
+    uint32_t spriteTargets = tg_add(&graph, "createSpriteTargets", createSpriteTargets, false);
+    uint32_t views = tg_add(&graph, "createViewResources", createViewResources, false);
+    uint32_t viewTargets = tg_add(&graph, "createViewTargets", createViewTargets, true);
+
+    tg_depend(&graph, debug, instance);
+    tg_depend(&graph, surface, instance);
+    tg_depend(&graph, physical, surface);
+    tg_depend(&graph, device, physical);
+    tg_depend(&graph, pipelineCache, device);
+    tg_depend(&graph, swapchain, device);
+    tg_depend(&graph, renderPass, device);
+    tg_depend(&graph, setLayout, device);
+    tg_depend(&graph, pipeline, renderPass);
+    tg_depend(&graph, pipeline, setLayout);
+    tg_depend(&graph, pipeline, pipelineCache);
+    tg_depend(&graph, commandPool, device);
+    tg_depend(&graph, depth, swapchain);
+    tg_depend(&graph, depth, commandPool);
+    tg_depend(&graph, framebuffers, renderTargets);
+    tg_depend(&graph, framebuffers, renderPass);
+    tg_depend(&graph, framebuffers, depth);
+    tg_depend(&graph, texture, textureDecode);
+    tg_depend(&graph, texture, commandPool);
+    tg_depend(&graph, textureView, texture);
+    tg_depend(&graph, sampler, device);
+    tg_depend(&graph, geometry, device);
+    tg_depend(&graph, upload, geometry);
+    tg_depend(&graph, upload, commandPool);
+    tg_depend(&graph, upload, meshes);
+    tg_depend(&graph, uniformBuffers, device);
+    tg_depend(&graph, instanceBuffers, device);
+    tg_depend(&graph, descriptorPool, device);
+    tg_depend(&graph, descriptorSets, descriptorPool);
+    tg_depend(&graph, descriptorSets, setLayout);
+    tg_depend(&graph, descriptorSets, uniformBuffers);
+    tg_depend(&graph, descriptorSets, textureView);
+    tg_depend(&graph, descriptorSets, sampler);
+    tg_depend(&graph, descriptorSets, lighting);
+    tg_depend(&graph, descriptorSets, shadows);
+    tg_depend(&graph, commandBuffers, commandPool);
+    tg_depend(&graph, syncObjects, device);
+    tg_depend(&graph, compute, device);
+    tg_depend(&graph, statistics, device);
+    tg_depend(&graph, occlusion, pipelineCache);
+    tg_depend(&graph, occlusion, commandPool);
+    tg_depend(&graph, occlusion, instanceBuffers);
+    tg_depend(&graph, pyramid, occlusion);
+    tg_depend(&graph, pyramid, depth);
+    tg_depend(&graph, capture, swapchain);
+    tg_depend(&graph, overdraw, pipeline);
+    tg_depend(&graph, overdrawTarget, overdraw);
+    tg_depend(&graph, gpuTrace, commandPool);
+    tg_depend(&graph, lighting, pipelineCache);
+    tg_depend(&graph, lighting, compute);
+    tg_depend(&graph, shadows, pipelineCache);
+    tg_depend(&graph, shadows, commandPool);
+    // loadScene resets the caster tracking, the two shouldn't overlap
+    tg_depend(&graph, shadows, instanceBuffers);
+    tg_depend(&graph, resolution, pipelineCache);
+    tg_depend(&graph, renderTargets, swapchain);
+    tg_depend(&graph, post, pipelineCache);
+    tg_depend(&graph, post, commandPool);
+    tg_depend(&graph, renderTargets, resolution);
+    tg_depend(&graph, renderTargets, post);
+    tg_depend(&graph, overlay, pipelineCache);
+    tg_depend(&graph, overlay, commandPool);
+    tg_depend(&graph, overlayTargets, overlay);
+    tg_depend(&graph, overlayTargets, renderTargets);
+    tg_depend(&graph, sprites, pipelineCache);
+    tg_depend(&graph, sprites, commandPool);
+    tg_depend(&graph, spriteTargets, sprites);
+    tg_depend(&graph, spriteTargets, renderTargets);
+    // the extra cameras start from the main one, which loadScene sets up with the instance buffers
+    tg_depend(&graph, views, pipeline);
+    tg_depend(&graph, views, meshes);
+    tg_depend(&graph, views, instanceBuffers);
+    tg_depend(&graph, views, textureView);
+    tg_depend(&graph, views, sampler);
+    tg_depend(&graph, views, lighting);
+    tg_depend(&graph, views, shadows);
+    tg_depend(&graph, viewTargets, views);
+
+    tg_run(&graph);
+    VULKAN.uploadTimeNs = (graph.tasks[upload].end - graph.tasks[upload].start) +
+        (graph.tasks[texture].end - graph.tasks[texture].start);
+
+    // the first frame should already have something to draw
+    waitPipeline(VULKAN.pipeline);
+
+    tg_print_timings(&graph);
+    asset_print_stats();
 }
 void cleanVk() {
     clearupSwapchain();
@@ -221,26 +283,60 @@ void cleanVk() {
     vkDestroySampler(VULKAN.device, VULKAN.textureSampler, NULL);
     vkDestroyImageView(VULKAN.device, VULKAN.textureImageView, NULL);
     vkDestroyImage(VULKAN.device, VULKAN.textureImage, NULL);
-    vkFreeMemory(VULKAN.device, VULKAN.textureImageMemory, NULL);
+    freeDeviceMemory(VULKAN.textureImageMemory);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroyBuffer(VULKAN.device, VULKAN.uniformBuffers[i], NULL);
-        vkFreeMemory(VULKAN.device, VULKAN.uniformBuffersMemory[i], NULL);
+        freeDeviceMemory(VULKAN.uniformBuffersMemory[i]);
+        vkDestroyBuffer(VULKAN.device, VULKAN.instanceBuffers[i], NULL);
+        freeDeviceMemory(VULKAN.instanceBuffersMemory[i]);
+        vkDestroyBuffer(VULKAN.device, VULKAN.indirectBuffers[i], NULL);
+        freeDeviceMemory(VULKAN.indirectBuffersMemory[i]);
     }
+    free(VULKAN.instanceNodes);
+    scenePrintStats(&VULKAN.scene);
+    printf("camera: %u recomputes\n", VULKAN.camera.recomputes);
+    printDrawStats(&VULKAN.drawStats);
+    printOcclusionStats();
+    destroyOcclusionResources();
+    printLightingStats();
+    destroyLightingResources();
+    free(VULKAN.lights);
+    free(VULKAN.lightOrigins);
+    printShadowStats();
+    destroyShadowResources();
+    printResolutionStats();
+    destroyResolutionResources();
+    printPostStats();
+    destroyPostResources();
+    printOverlayStats();
+    destroyOverlayResources();
+    printSpriteStats();
+    destroySpriteResources();
+    printViewStats();
+    destroyViewTargets();
+    destroyViewResources();
+    destroyOverdrawResources();
+    sceneFree(&VULKAN.scene);
+    free(VULKAN.meshes);
+    free(VULKAN.sceneBatches);
+    free(VULKAN.drawBatches);
+    printRenderQueueStats(&VULKAN.renderQueue);
+    renderQueueFree(&VULKAN.renderQueue);
+    free(VULKAN.uniformVersions);
 
     vkDestroyDescriptorPool(VULKAN.device, VULKAN.descriptorPool, NULL);
     vkDestroyDescriptorSetLayout(VULKAN.device, VULKAN.descriptorSetLayout, NULL);
 
-    vkDestroyBuffer(VULKAN.device, VULKAN.indexBuffer, NULL);
-    vkFreeMemory(VULKAN.device, VULKAN.indexBufferMemory, NULL);
+    printGeometryStats();
+    destroyGeometryBuffers();
 
-    vkDestroyBuffer(VULKAN.device, VULKAN.vertexBuffer, NULL);
-    vkFreeMemory(VULKAN.device, VULKAN.vertexBufferMemory, NULL);
-
-    vkDestroyPipeline(VULKAN.device, VULKAN.pipeline, NULL);
+    printPipelineCacheStats();
+    destroyPipelineCache();
     vkDestroyPipelineLayout(VULKAN.device, VULKAN.pipelineLayout, NULL);
 
     vkDestroyRenderPass(VULKAN.device, VULKAN.renderPass, NULL);
+    vkDestroyRenderPass(VULKAN.device, VULKAN.renderPassLoad, NULL);
 
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
         vkDestroySemaphore(VULKAN.device, VULKAN.imageAvailableSemaphore[i], NULL);
@@ -249,6 +345,14 @@ void cleanVk() {
     }
 
     vkDestroyCommandPool(VULKAN.device, VULKAN.commandPool, NULL);
+    destroyComputeResources();
+    printStatistics();
+    destroyStatisticsQueries();
+    destroyGpuTrace();
+    printCaptureStats();
+    destroyCaptureResources();
+    printMemoryReport();
+    destroyMemoryTracking();
     
     vkDestroyDevice(VULKAN.device, NULL);
 
@@ -261,59 +365,135 @@ void cleanVk() {
 }
 
 void drawFrame() {
+    TRACE_BEGIN("waitFence");
     vkWaitForFences(VULKAN.device, 1, VULKAN.inFlightFence+VULKAN.currentFrame, VK_TRUE, UINT64_MAX);
+    TRACE_END();
+    TRACE_BEGIN("collect");
+    collectStatistics(VULKAN.currentFrame);
+    collectOcclusionStats(VULKAN.currentFrame);
+    collectGpuTrace(VULKAN.currentFrame);
+    collectLightingStats(VULKAN.currentFrame);
+    collectShadowStats(VULKAN.currentFrame);
+    collectResolutionStats(VULKAN.currentFrame);
+    collectPostStats(VULKAN.currentFrame);
+    collectCaptures(VULKAN.currentFrame);
+    retireGeometry();
+    updateMemoryBudget();
+    TRACE_END();
 
     uint32_t imageIndex = 0;
     
+    TRACE_BEGIN("acquire");
     VkResult result = vkAcquireNextImageKHR(VULKAN.device, VULKAN.swapchain, UINT64_MAX,
         VULKAN.imageAvailableSemaphore[VULKAN.currentFrame], VK_NULL_HANDLE, &imageIndex);
+    TRACE_END();
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        TRACE_BEGIN("recreateSwapchain");
         recreateSwapchain();
+        TRACE_END();
         return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         c_throw("failed to acquire swapchain image");
     }
-
+    // only once the main view has its image, nothing returns early after this and leaves a semaphore signaled
+    TRACE_BEGIN("acquireViews");
+    acquireViews(VULKAN.currentFrame);
+    TRACE_END();
+
+    // the cluster tiles follow the render extent, which the camera version doesn't cover
+    if (updateRenderScale()) {
+        memset(VULKAN.uniformVersions, 0, sizeof(uint32_t) * MAX_FRAMES_IN_FLIGHT);
+    }
     updateUniformBuffer(VULKAN.currentFrame);
+    TRACE_BEGIN("views");
+    updateViews(VULKAN.currentFrame);
+    TRACE_END();
+    TRACE_BEGIN("sprites");
+    spritesBegin(VULKAN.currentFrame);
+    spritesEnd();
+    TRACE_END();
+    TRACE_BEGIN("hud");
+    drawHud(VULKAN.currentFrame);
+    TRACE_END();
 
     vkResetFences(VULKAN.device, 1, VULKAN.inFlightFence + VULKAN.currentFrame);
 
+    TRACE_BEGIN("record");
     vkResetCommandBuffer(VULKAN.commandBuffer[VULKAN.currentFrame], 0);
-    recordCommandBuffer(VULKAN.commandBuffer[VULKAN.currentFrame], imageIndex);
+    recordCommandBuffer(VULKAN.commandBuffer[VULKAN.currentFrame]);
+    vkResetCommandBuffer(VULKAN.presentCommandBuffer[VULKAN.currentFrame], 0);
+    recordPresentCommands(VULKAN.presentCommandBuffer[VULKAN.currentFrame], imageIndex);
+    TRACE_END();
+
+    VkSemaphore computeSemaphore;
+    VkPipelineStageFlags computeStage;
+    bool computeSubmitted = submitAsyncCompute(VULKAN.currentFrame, &computeSemaphore, &computeStage);
 
-    VkSemaphore waitSemaphores[] = { VULKAN.imageAvailableSemaphore[VULKAN.currentFrame] };
+    // rendering doesn't need the swapchain images, only the blits at the end wait for them
     VkSemaphore signalSemaphores[] = { VULKAN.renderFinishedSemaphore[VULKAN.currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = NULL,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = waitSemaphores,
-        .pWaitDstStageMask = waitStages,
-        .commandBufferCount = 1,
-        .pCommandBuffers = VULKAN.commandBuffer+VULKAN.currentFrame,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = signalSemaphores
+    VkSemaphore acquireSemaphores[VIEW_MAX] = { VULKAN.imageAvailableSemaphore[VULKAN.currentFrame] };
+    VkSwapchainKHR swapchains[VIEW_MAX] = { VULKAN.swapchain };
+    uint32_t imageIndices[VIEW_MAX] = { imageIndex };
+    uint32_t presentCount = 1 + viewPresentTargets(VULKAN.currentFrame, acquireSemaphores + 1, swapchains + 1,
+        imageIndices + 1);
+    VkPipelineStageFlags acquireStages[VIEW_MAX];
+    for (uint32_t i = 0; i < VIEW_MAX; ++i) {
+        acquireStages[i] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    VkSubmitInfo submitInfos[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = NULL,
+            .waitSemaphoreCount = computeSubmitted ? 1 : 0,
+            .pWaitSemaphores = &computeSemaphore,
+            .pWaitDstStageMask = &computeStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = VULKAN.commandBuffer + VULKAN.currentFrame,
+            .signalSemaphoreCount = 0,
+            .pSignalSemaphores = NULL
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = NULL,
+            .waitSemaphoreCount = presentCount,
+            .pWaitSemaphores = acquireSemaphores,
+            .pWaitDstStageMask = acquireStages,
+            .commandBufferCount = 1,
+            .pCommandBuffers = VULKAN.presentCommandBuffer + VULKAN.currentFrame,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = signalSemaphores
+        }
     };
 
-    if (vkQueueSubmit(VULKAN.graphicsQueue, 1, &submitInfo, VULKAN.inFlightFence[VULKAN.currentFrame]) != VK_SUCCESS) {
+    TRACE_BEGIN("submit");
+    if (vkQueueSubmit(VULKAN.graphicsQueue, 2, submitInfos, VULKAN.inFlightFence[VULKAN.currentFrame]) != VK_SUCCESS) {
         c_throw("failed to submit draw command buffer");
     }
+    TRACE_END();
 
+    // every view in one call, each swapchain reports on its own
+    VkResult presentResults[VIEW_MAX];
     VkPresentInfoKHR presentInfo = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .pNext = NULL,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = signalSemaphores,
-        .swapchainCount = 1,
-        .pSwapchains = &VULKAN.swapchain,
-        .pImageIndices = &imageIndex,
-        .pResults = NULL
+        .swapchainCount = presentCount,
+        .pSwapchains = swapchains,
+        .pImageIndices = imageIndices,
+        .pResults = presentResults
     };
 
+    TRACE_BEGIN("present");
     result = vkQueuePresentKHR(VULKAN.presentQueue, &presentInfo);
+    TRACE_END();
 
+    if (result != VK_SUCCESS && result != VK_ERROR_OUT_OF_DATE_KHR && result != VK_SUBOPTIMAL_KHR) {
+        c_throw("failed to present swapchain image");
+    }
+    viewsPresented(presentResults + 1);
+    result = presentResults[0];
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         VULKAN.framebufferResized = false;
         recreateSwapchain();
@@ -350,7 +530,7 @@ void createInstance() {
         .applicationVersion = 0,
         .pEngineName = "CVuRen",
         .engineVersion = 0,
-        .apiVersion = VK_API_VERSION_1_0,
+        .apiVersion = VK_API_VERSION_1_1,
     };
     VkInstanceCreateInfo inst_info = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -394,6 +574,14 @@ void createSwapChain() {
         imageCount = scsd.capabilities->maxImageCount;
     }
 
+    // only ever blitted to from the upscaled output, and copied out of for captures when the surface allows it
+    if (!(scsd.capabilities->supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        c_throw("swapchain images can't be transfer destinations");
+    }
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    VULKAN.swapchainTransferSrc = (scsd.capabilities->supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (VULKAN.swapchainTransferSrc) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
     QueueFamilyIndices indices = findQueueFamilies(VULKAN.physicalDevice);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
     bool qGraphNEQPresent = indices.graphicsFamily != indices.presentFamily;
@@ -408,7 +596,7 @@ void createSwapChain() {
         .imageColorSpace = surfaceFormat.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = usage,
         .imageSharingMode = qGraphNEQPresent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = qGraphNEQPresent ? 2 : 0,
         .pQueueFamilyIndices = qGraphNEQPresent ? queueFamilyIndices : NULL,
@@ -443,17 +631,49 @@ void pickPhysicalDevice() {
     VkPhysicalDevice* devices = (VkPhysicalDevice*)malloc(sizeof(VkPhysicalDevice) * deviceCount);
     vkEnumeratePhysicalDevices(VULKAN.instance, &deviceCount, devices);
 
+    // SETTINGS.device is an index when it's all digits, part of a name otherwise
+    char* end = NULL;
+    unsigned long requestedIndex = SETTINGS.device ? strtoul(SETTINGS.device, &end, 10) : 0;
+    bool byIndex = SETTINGS.device && end != SETTINGS.device && *end == '\0';
+
+    DeviceCaps* caps = malloc(sizeof(DeviceCaps) * deviceCount);
+    bool* suitable = malloc(sizeof(bool) * deviceCount);
+    uint32_t best = UINT32_MAX;
+    uint32_t bestScore = 0;
     for (uint32_t i = 0; i < deviceCount; ++i) {
-        if (isDeviceSuitable(devices[i])) {
-            VULKAN.physicalDevice = devices[i];
-            break;
+        QueueFamilyIndices qfi = findQueueFamilies(devices[i]);
+        queryDeviceCaps(devices[i], qfi.dedicatedCompute, qfi.dedicatedTransfer, caps + i);
+        suitable[i] = isDeviceSuitable(devices[i]);
+        if (!suitable[i]) continue;
+        if (SETTINGS.device && (byIndex ? i != requestedIndex : strstr(caps[i].name, SETTINGS.device) == NULL)) {
+            continue;
+        }
+
+        // a software device only wins when asked for, then it beats any score
+        uint32_t score = caps[i].score;
+        if (SETTINGS.cpuDevice && caps[i].type == VK_PHYSICAL_DEVICE_TYPE_CPU) score += 1u << 30;
+        if (best == UINT32_MAX || score > bestScore) {
+            best = i;
+            bestScore = score;
         }
     }
-    if (VULKAN.physicalDevice == VK_NULL_HANDLE) {
-        c_throw("failed to find suitable gpu\n");
+    if (best == UINT32_MAX) {
+        free(devices);
+        free(caps);
+        free(suitable);
+        c_throw(SETTINGS.device ? "no suitable device matches --device\n" : "failed to find suitable gpu\n");
         return;
     }
 
+    VULKAN.physicalDevice = devices[best];
+    if (SETTINGS.deviceTier < DEVICE_TIER_COUNT) caps[best].tier = (DeviceTier)SETTINGS.deviceTier;
+    VULKAN.deviceTier = caps[best].tier;
+    for (uint32_t i = 0; i < deviceCount; ++i) {
+        if (suitable[i]) printDeviceCaps(i, caps + i, i == best);
+    }
+    free(devices);
+    free(caps);
+    free(suitable);
 }
 
 bool isDeviceSuitable(VkPhysicalDevice device) {
@@ -466,13 +686,12 @@ bool isDeviceSuitable(VkPhysicalDevice device) {
     SwapChainSupportDetails scsd = querySwapChainSupport(device);
     bool swapchainOk = (scsd.formatsCount > 0) && (scsd.presentModesCount>0);
 
-    return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) &&
-        qfi.itIs && deviceExtSupported && swapchainOk && deviceFeatures.samplerAnisotropy;
+    return qfi.itIs && deviceExtSupported && swapchainOk && deviceFeatures.samplerAnisotropy;
 }
 
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
 {
-    QueueFamilyIndices qfi = {UINT32_MAX, UINT32_MAX, false};
+    QueueFamilyIndices qfi = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, false, false, false};
     
     uint32_t qCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &qCount, NULL);
@@ -481,37 +700,66 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
 
     VkBool32 presentSupport = VK_FALSE;
     for (uint32_t i = 0; i < qCount; ++i) {
-        if (qfi.graphicsFamily == UINT32_MAX && queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if (qfi.graphicsFamily == UINT32_MAX && (flags & VK_QUEUE_GRAPHICS_BIT)) {
             qfi.graphicsFamily = i;
-            continue;
         }
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, VULKAN.surface, &presentSupport);
-        if (presentSupport) {
+        // presenting from the graphics family saves a concurrent swapchain
+        if (presentSupport && (qfi.presentFamily == UINT32_MAX || i == qfi.graphicsFamily)) {
             qfi.presentFamily = i;
         }
-        if (qfi.graphicsFamily != UINT32_MAX && qfi.presentFamily != UINT32_MAX) {
-            qfi.itIs = true;
-            break;
+        if (!qfi.dedicatedCompute && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            qfi.computeFamily = i;
+            qfi.dedicatedCompute = true;
+        }
+        if (!qfi.dedicatedTransfer && (flags & VK_QUEUE_TRANSFER_BIT) &&
+            !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            qfi.transferFamily = i;
+            qfi.dedicatedTransfer = true;
         }
     }
+    free(queueFamilies);
+
+    // no async families - everything goes through the graphics queue
+    if (!qfi.dedicatedCompute) qfi.computeFamily = qfi.graphicsFamily;
+    if (!qfi.dedicatedTransfer) qfi.transferFamily = qfi.computeFamily;
+
+    qfi.itIs = qfi.graphicsFamily != UINT32_MAX && qfi.presentFamily != UINT32_MAX;
     return qfi;
 }
 
 void createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(VULKAN.physicalDevice);
+    // below the high tier compute work goes through the graphics queue, a copy queue still helps everywhere
+    if (VULKAN.deviceTier < DEVICE_TIER_HIGH && indices.dedicatedCompute) {
+        indices.computeFamily = indices.graphicsFamily;
+        indices.dedicatedCompute = false;
+        if (!indices.dedicatedTransfer) indices.transferFamily = indices.graphicsFamily;
+    }
+    VULKAN.queueFamilies = indices;
 
-#define QUEUES_COUNT 2
+#define QUEUES_COUNT 4
     VkDeviceQueueCreateInfo queueCreateInfos[QUEUES_COUNT];
-    uint32_t uniquiQueueFamilies[QUEUES_COUNT] = {indices.graphicsFamily, indices.presentFamily};
+    uint32_t families[QUEUES_COUNT] = {indices.graphicsFamily, indices.presentFamily,
+        indices.computeFamily, indices.transferFamily};
+    uint32_t uniqueCount = 0;
 
     const float qPriority = 1.0;
     for (int i = 0; i < QUEUES_COUNT; ++i) {
-        queueCreateInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfos[i].pNext = NULL;
-        queueCreateInfos[i].flags = 0;
-        queueCreateInfos[i].queueFamilyIndex = uniquiQueueFamilies[i];
-        queueCreateInfos[i].queueCount = 1;
-        queueCreateInfos[i].pQueuePriorities = &qPriority;
+        bool seen = false;
+        for (uint32_t j = 0; j < uniqueCount; ++j) {
+            seen |= queueCreateInfos[j].queueFamilyIndex == families[i];
+        }
+        if (seen) continue;
+
+        queueCreateInfos[uniqueCount].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfos[uniqueCount].pNext = NULL;
+        queueCreateInfos[uniqueCount].flags = 0;
+        queueCreateInfos[uniqueCount].queueFamilyIndex = families[i];
+        queueCreateInfos[uniqueCount].queueCount = 1;
+        queueCreateInfos[uniqueCount].pQueuePriorities = &qPriority;
+        ++uniqueCount;
     }
 
     VkPhysicalDeviceFeatures deviceFeatures;
@@ -519,16 +767,49 @@ void createLogicalDevice() {
     deviceFeatures.logicOp = VK_TRUE;
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(VULKAN.physicalDevice, &supportedFeatures);
+    // the low tier keeps to plain draws, which is also what leaves gpu culling off
+    bool lowTier = VULKAN.deviceTier == DEVICE_TIER_LOW;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery && !lowTier;
+    VULKAN.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery == VK_TRUE;
+    // per batch firstInstance is how instances find their matrices, so both are needed
+    if (supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance && !lowTier) {
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+        VULKAN.multiDrawIndirect = true;
+    }
+
+    // optional extensions go after the required ones
+    const char* extensions[8];
+    uint32_t extensionCount = 0;
+    for (uint32_t i = 0; i < deviceExtensionsCount; ++i) {
+        extensions[extensionCount++] = deviceExtensions[i];
+    }
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(VULKAN.physicalDevice, &properties);
+    // the budget is read through vkGetPhysicalDeviceMemoryProperties2, which is 1.1
+    bool memoryBudget = properties.apiVersion >= VK_API_VERSION_1_1 &&
+        hasDeviceExtension(VULKAN.physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudget) {
+        extensions[extensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+    // lines the trace's gpu track up with the cpu clock
+    if (hasDeviceExtension(VULKAN.physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+        extensions[extensionCount++] = VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+        VULKAN.calibratedTimestamps = true;
+    }
+
     VkDeviceCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .queueCreateInfoCount = QUEUES_COUNT,
+        .queueCreateInfoCount = uniqueCount,
         .pQueueCreateInfos = queueCreateInfos,
         .enabledLayerCount = 0,
         .ppEnabledLayerNames = NULL,
-        .enabledExtensionCount = deviceExtensionsCount,
-        .ppEnabledExtensionNames = deviceExtensions,
+        .enabledExtensionCount = extensionCount,
+        .ppEnabledExtensionNames = extensions,
         .pEnabledFeatures = &deviceFeatures
     };
 
@@ -543,6 +824,11 @@ void createLogicalDevice() {
 
     vkGetDeviceQueue(VULKAN.device, indices.graphicsFamily, 0, &VULKAN.graphicsQueue);
     vkGetDeviceQueue(VULKAN.device, indices.presentFamily, 0, &VULKAN.presentQueue);
+    vkGetDeviceQueue(VULKAN.device, indices.computeFamily, 0, &VULKAN.computeQueue);
+    vkGetDeviceQueue(VULKAN.device, indices.transferFamily, 0, &VULKAN.transferQueue);
+
+    // everything after this allocates through it
+    createMemoryTracking(memoryBudget);
 }
 
 bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -566,6 +852,20 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return true;
 }
 
+bool hasDeviceExtension(VkPhysicalDevice device, const char* name) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+    VkExtensionProperties* availableExtensions = malloc(sizeof(VkExtensionProperties) * extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, availableExtensions);
+
+    bool found = false;
+    for (uint32_t i = 0; i < extensionCount && !found; ++i) {
+        found = strcmp(name, availableExtensions[i].extensionName) == 0;
+    }
+    free(availableExtensions);
+    return found;
+}
+
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
     SwapChainSupportDetails details = {NULL,NULL,NULL,0,0};
 
@@ -598,6 +898,14 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR* formats, ui
 }
 
 VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* modes, uint32_t count) {
+    // frame times are measured, so vsync must not cap them
+    if (SETTINGS.regress) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (modes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+                return modes[i];
+            }
+        }
+    }
     for (uint32_t i = 0; i < count; ++i) {
         if (modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
             return modes[i];
@@ -611,7 +919,7 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR* capabilities) {
         return capabilities->currentExtent;
     } else {
         int width, height;
-        glfwGetFramebufferSize(WINDOW.window, &width, &height);
+        windowFramebufferSize(&width, &height);
 
         VkExtent2D actualExtent = {
             (uint32_t)width, (uint32_t)height
@@ -624,35 +932,26 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR* capabilities) {
     }
 }
 
-void createImageViews() {
-    VULKAN.swapchainImageViews.count = VULKAN.swapchainImages.count;
-    VULKAN.swapchainImageViews.swapChainImageViews = 
-        (VkImageView*)malloc(sizeof(VkImageView) * VULKAN.swapchainImageViews.count);
-
-    for (uint32_t i = 0; i < VULKAN.swapchainImages.count; ++i) {
-        VULKAN.swapchainImageViews.swapChainImageViews[i] =
-            createImageView(VULKAN.swapchainImages.swapchainImages[i], VULKAN.swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-    }
-}
-
 void createRenderPass() {
+    // the scene target, the upscale reads it afterwards
     VkAttachmentDescription colorAttachment = {
         .flags = 0,
-        .format = VULKAN.swapchainImageFormat,
+        .format = RESOLUTION_COLOR_FORMAT,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
     };
     VkAttachmentDescription depthAttachment = {
         .flags = 0,
         .format = findDepthFormat(),
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        // the depth pyramid and the late occlusion pass read it afterwards
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
@@ -682,14 +981,27 @@ void createRenderPass() {
         .pPreserveAttachments = NULL
     };
 
-    VkSubpassDependency dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-        .dependencyFlags = 0
+    // the target is shared by the frames in flight, the last frame's upscale has to be done reading it
+    VkSubpassDependency dependencies[2] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = 0
+        },
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .dependencyFlags = 0
+        }
     };
 
     VkRenderPassCreateInfo renderPassInfo = {
@@ -700,161 +1012,54 @@ void createRenderPass() {
         .pAttachments = attachments,
         .subpassCount = 1,
         .pSubpasses = &subpass,
-        .dependencyCount = 1,
-        .pDependencies = &dependency
+        .dependencyCount = 2,
+        .pDependencies = dependencies
     };
 
     VULKAN.renderPass = malloc(sizeof(VkRenderPass));
     if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &VULKAN.renderPass) != VK_SUCCESS) {
         c_throw("failed to create render pass");
     }
-}
-
-void createGraphicsPipeline() {
-    shaderfile vert = readFile("shaders/vert.spv");
-    shaderfile frag = readFile("shaders/frag.spv");
-
-    VkShaderModule vertShaderModule, fragShaderModule;
-    vertShaderModule = createShaderModule(vert);
-    fragShaderModule = createShaderModule(frag);
-
-    VkPipelineShaderStageCreateInfo vertCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = vertShaderModule,
-        .pName = "main",
-        .pSpecializationInfo = NULL
-    };
-    VkPipelineShaderStageCreateInfo fragCreateInfo = vertCreateInfo;
-    fragCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragCreateInfo.module = fragShaderModule;
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertCreateInfo, fragCreateInfo};
-
-    VkVertexInputBindingDescription bindingDescription = getBindDescription();
-    VertexAttribDescrStruct attributeDescriptions = getAttributeDescriptions();
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .vertexBindingDescriptionCount = 1,
-        .pVertexBindingDescriptions = &bindingDescription,
-        .vertexAttributeDescriptionCount = attributeDescriptions.count,
-        .pVertexAttributeDescriptions = attributeDescriptions.descrs
-    };
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE
-    };
-
-    VkViewport viewport = {
-        .x = 0.0f,
-        .y = 0.0f,
-        .width = (float)VULKAN.swapchainExtent.width,
-        .height = (float)VULKAN.swapchainExtent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
-    };
-
-    VkRect2D scissor = {
-        .offset = {0,0},
-        .extent = VULKAN.swapchainExtent
-    };
-
-    VkDynamicState dynamicStates[2] = {
-        VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
-    };
-    VkPipelineDynamicStateCreateInfo dynamicState = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .dynamicStateCount = 2,
-        .pDynamicStates = dynamicStates
-    };
-
-    VkPipelineViewportStateCreateInfo viewportState = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .viewportCount = 1,
-        .pViewports = &viewport,
-        .scissorCount = 1,
-        .pScissors = &scissor,
-    };
-
-    VkPipelineRasterizationStateCreateInfo rasterizer = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .depthClampEnable = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode = VK_POLYGON_MODE_FILL,
-        .cullMode = VK_CULL_MODE_BACK_BIT,
-        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
-        .depthBiasEnable = VK_FALSE,
-        .depthBiasConstantFactor = 0.0f,
-        .depthBiasClamp = 0.0f,
-        .depthBiasSlopeFactor = 0.0f,
-        .lineWidth = 1.0f
-    };
 
-    VkPipelineMultisampleStateCreateInfo multisampling = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 1.0f,
-        .pSampleMask = NULL,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE
-    };
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {
-        .blendEnable = VK_TRUE,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-        .colorBlendOp = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp = VK_BLEND_OP_ADD,
-        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-        VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-        VK_COLOR_COMPONENT_A_BIT
+    // follows the depth pyramid build, which leaves depth read only
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    dependencies[0] = (VkSubpassDependency){
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dependencyFlags = 0
     };
+    if (vkCreateRenderPass(VULKAN.device, &renderPassInfo, NULL, &VULKAN.renderPassLoad) != VK_SUCCESS) {
+        c_throw("failed to create render pass");
+    }
+}
 
-    VkPipelineColorBlendStateCreateInfo colorBlending = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .logicOpEnable = VK_TRUE,
-        .logicOp = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
-        .pAttachments = &colorBlendAttachment,
-        .blendConstants = {0.0f,0.0f,0.0f,0.0f}
-    };
+void sceneVertexInput(PipelineDesc* desc) {
+    pipelineDescDefault(desc);
+    strncpy(desc->vertShader, "shaders/vert.spv", PIPELINE_SHADER_PATH - 1);
 
-    VkPipelineDepthStencilStateCreateInfo depthStencil = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_TRUE,
-        .front = {0,0,0,0,0,0,0},
-        .back = {0,0,0,0,0,0,0},
-        .minDepthBounds = 0.0f,
-        .maxDepthBounds = 1.0f
-    };
+    VertexAttribDescrStruct attributeDescriptions = getAttributeDescriptions();
+    VertexAttribDescrStruct instanceDescriptions = getInstanceAttributeDescriptions();
+    desc->bindings[0] = getBindDescription();
+    desc->bindings[1] = getInstanceBindDescription();
+    desc->bindingCount = 2;
+    memcpy(desc->attributes, attributeDescriptions.descrs,
+        sizeof(VkVertexInputAttributeDescription) * attributeDescriptions.count);
+    memcpy(desc->attributes + attributeDescriptions.count, instanceDescriptions.descrs,
+        sizeof(VkVertexInputAttributeDescription) * instanceDescriptions.count);
+    desc->attributeCount = attributeDescriptions.count + instanceDescriptions.count;
+    free(attributeDescriptions.descrs);
+    free(instanceDescriptions.descrs);
+}
 
+void createGraphicsPipeline() {
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = NULL,
@@ -865,62 +1070,18 @@ void createGraphicsPipeline() {
         .pPushConstantRanges = NULL 
     };
 
-    VULKAN.pipelineLayout = malloc(sizeof(VkPipelineLayout));
     if (vkCreatePipelineLayout(VULKAN.device, &pipelineLayoutInfo, NULL, &VULKAN.pipelineLayout) != VK_SUCCESS) {
         c_throw("failed to create pipeline layout");
     }
 
-    VkGraphicsPipelineCreateInfo pipelineInfo = {
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .stageCount = 2,
-        .pStages = shaderStages,
-        .pVertexInputState = &vertexInputInfo,
-        .pInputAssemblyState = &inputAssembly,
-        .pTessellationState = NULL,
-        .pViewportState = &viewportState,
-        .pRasterizationState = &rasterizer,
-        .pMultisampleState = &multisampling,
-        .pDepthStencilState = &depthStencil,
-        .pColorBlendState = &colorBlending,
-        .pDynamicState = &dynamicState,
-        .layout = VULKAN.pipelineLayout,
-        .renderPass = VULKAN.renderPass,
-        .subpass = 0,
-        .basePipelineHandle = VK_NULL_HANDLE,
-        .basePipelineIndex = -1
-    };
-
-    VULKAN.pipeline = malloc(sizeof(VkPipeline));
-    if (vkCreateGraphicsPipelines(VULKAN.device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &VULKAN.pipeline) != VK_SUCCESS) {
-        c_throw("failed to create graphics pipeline");
-    }
+    PipelineDesc desc;
+    sceneVertexInput(&desc);
+    strncpy(desc.fragShader, "shaders/frag.spv", PIPELINE_SHADER_PATH - 1);
+    desc.renderPass = VULKAN.renderPass;
+    desc.layout = VULKAN.pipelineLayout;
 
-    vkDestroyShaderModule(VULKAN.device, vertShaderModule, NULL);
-    vkDestroyShaderModule(VULKAN.device, fragShaderModule, NULL);
-}
-
-shaderfile readFile(const char* filename) {
-    shaderfile result = {NULL, 0};
-    FILE* file;
-    file = fopen(filename, "rb");
-
-    if (file == NULL) {
-        c_throw("can't find file for readFile func");
-    }
-    
-    fseek(file, 0, SEEK_END);
-    result.size = ftell(file);
-    result.file = (char*)malloc( (result.size%4) == 0 ? result.size : result.size + (4-(result.size%4)) );
-    fseek(file,0, SEEK_SET);
-    for (uint32_t i = 0; i < result.size; ++i) {
-        result.file[i] =  feof(file) ? '\0' : (char) fgetc(file) ;
-    }
-
-    fclose(file);
-
-    return result;
+    // compiles in the background, frames skip the draw until it's ready
+    VULKAN.pipeline = requestPipeline(&desc, PIPELINE_HANDLE_NONE);
 }
 
 VkShaderModule createShaderModule(shaderfile file) {
@@ -928,7 +1089,7 @@ VkShaderModule createShaderModule(shaderfile file) {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .pCode = (uint32_t*) file.file,
+        .pCode = (const uint32_t*) file.file,
         .codeSize = file.size
     };
     
@@ -941,30 +1102,27 @@ VkShaderModule createShaderModule(shaderfile file) {
 
 void createFramebuffers() {
     VULKAN.framebufferResized = false;
-    VULKAN.swapchainFramebuffers.f = malloc(sizeof(VkFramebuffer) * VULKAN.swapchainImageViews.count);
-    VULKAN.swapchainFramebuffers.count = VULKAN.swapchainImageViews.count;
 
-    for (size_t i = 0; i < VULKAN.swapchainFramebuffers.count; ++i) {
-        VkImageView attachments[] = {
-            VULKAN.swapchainImageViews.swapChainImageViews[i],
-            VULKAN.depthImageView
-        };
+    // one for every frame, the swapchain images are only blitted to
+    VkImageView attachments[] = {
+        renderTargetView(),
+        VULKAN.depthImageView
+    };
 
-        VkFramebufferCreateInfo framebufferInfo = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .pNext = NULL,
-            .flags = 0,
-            .renderPass = VULKAN.renderPass,
-            .attachmentCount = 2,
-            .pAttachments = attachments,
-            .width = VULKAN.swapchainExtent.width,
-            .height = VULKAN.swapchainExtent.height,
-            .layers = 1
-        };
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .renderPass = VULKAN.renderPass,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .width = VULKAN.swapchainExtent.width,
+        .height = VULKAN.swapchainExtent.height,
+        .layers = 1
+    };
 
-        if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, VULKAN.swapchainFramebuffers.f+i) != VK_SUCCESS) {
-            c_throw("failed to create framebuffer");
-        }
+    if (vkCreateFramebuffer(VULKAN.device, &framebufferInfo, NULL, &VULKAN.sceneFramebuffer) != VK_SUCCESS) {
+        c_throw("failed to create framebuffer");
     }
 }
 
@@ -985,6 +1143,7 @@ void createCommandPool() {
 
 void createCommandBuffers() {
     VULKAN.commandBuffer = malloc(sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
+    VULKAN.presentCommandBuffer = malloc(sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
     VkCommandBufferAllocateInfo allocInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = NULL,
@@ -992,22 +1151,32 @@ void createCommandBuffers() {
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = (uint32_t) MAX_FRAMES_IN_FLIGHT
     };
-    if (vkAllocateCommandBuffers(VULKAN.device, &allocInfo, VULKAN.commandBuffer)) {
+    c_mutex_lock(&VULKAN.commandPoolLock);
+    if (vkAllocateCommandBuffers(VULKAN.device, &allocInfo, VULKAN.commandBuffer) ||
+        vkAllocateCommandBuffers(VULKAN.device, &allocInfo, VULKAN.presentCommandBuffer)) {
         c_throw("failed to allocate command buffers");
     };
+    c_mutex_unlock(&VULKAN.commandPoolLock);
 }
 
-void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-    VkCommandBufferBeginInfo beginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .pInheritanceInfo = NULL
-    };
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        c_throw("failed to begin a command buffer");
+static void recordDrawRun(VkCommandBuffer commandBuffer, VkBuffer draws, VkDeviceSize drawOffset,
+    uint32_t first, uint32_t count) {
+    if (count == 0) return;
+    ++VULKAN.renderQueue.stats.drawCalls;
+    if (VULKAN.multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(commandBuffer, draws, drawOffset + sizeof(VkDrawIndexedIndirectCommand) * first,
+            count, sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        const VkDrawIndexedIndirectCommand* commands = VULKAN.indirectBuffersMapped[VULKAN.currentFrame];
+        for (uint32_t i = first; i < first + count; ++i) {
+            vkCmdDrawIndexed(commandBuffer, commands[i].indexCount, commands[i].instanceCount,
+                commands[i].firstIndex, commands[i].vertexOffset, commands[i].firstInstance);
+        }
     }
+}
 
+static void recordScenePass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,
+    bool clearOnly, VkBuffer instances, VkBuffer draws, VkDeviceSize drawOffset) {
     VkClearValue clearColor[] = {
         {.color = {0.0f,0.0f,0.0f,1.0f},.depthStencil = {0.0f, 0}},
         {.color = {0.0f,0.0f,0.0f,0.0f},.depthStencil = {1.0f, 0}}
@@ -1015,25 +1184,28 @@ void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
     VkRenderPassBeginInfo renderPassInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .pNext = NULL,
-        .renderPass = VULKAN.renderPass,
-        .framebuffer = VULKAN.swapchainFramebuffers.f[imageIndex],
+        .renderPass = renderPass,
+        .framebuffer = VULKAN.sceneFramebuffer,
         .renderArea = {
             .offset = {0,0},
-            .extent = VULKAN.swapchainExtent
+            .extent = VULKAN.renderExtent
         },
         .clearValueCount = 2,
         .pClearValues = clearColor,
     };
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, VULKAN.pipeline);
+    if (clearOnly) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
 
     // = VIEWPORTING AND SCISSORING =
     VkViewport viewport = {
         .x = 0.0f,
         .y = 0.0f,
-        .width = (float) VULKAN.swapchainExtent.width,
-        .height = (float) VULKAN.swapchainExtent.height ,
+        .width = (float) VULKAN.renderExtent.width,
+        .height = (float) VULKAN.renderExtent.height,
         .minDepth = 0.0f,
         .maxDepth = 1.0f
     };
@@ -1041,22 +1213,166 @@ void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
 
     VkRect2D scissor = {
         .offset = {0,0},
-        .extent = VULKAN.swapchainExtent
+        .extent = VULKAN.renderExtent
     };
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     // =============================
 
-    VkBuffer vertexBuffers[] = { VULKAN.vertexBuffer };
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, VULKAN.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    // every mesh lives in the shared arenas, so geometry is bound once per pass
+    bindGeometry(commandBuffer);
+    VkDeviceSize instanceOffset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instances, &instanceOffset);
+
+    // batches are in key order, runs with the same state go out as one indirect call
+    RenderQueue* queue = &VULKAN.renderQueue;
+    RenderBindState bound;
+    renderBindReset(queue, &bound);
+    bool drawable = false;
+    uint32_t runStart = 0;
+    for (uint32_t i = 0; i < VULKAN.drawBatchCount; ++i) {
+        RenderKeyFields fields = renderKeyDecode(queue->keys[i]);
+        bool pipelineChanged = renderBindPipeline(queue, &bound, fields.pipeline);
+        bool materialChanged = renderBindMaterial(queue, &bound, fields.material);
+        if (!pipelineChanged && !materialChanged) continue;
+
+        if (drawable) recordDrawRun(commandBuffer, draws, drawOffset, runStart, i - runStart);
+        runStart = i;
+
+        if (pipelineChanged) {
+            VkPipeline pipeline = getPipeline(fields.pipeline);
+            // still compiling, its draws are dropped this frame
+            drawable = pipeline != VK_NULL_HANDLE;
+            if (drawable) vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        }
+        if (materialChanged) {
+            // every pipeline shares the layout, so sets stay bound across pipeline changes
+            // the only material so far is the default one
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, VULKAN.pipelineLayout,
+                0, 1, &VULKAN.descriptorSets[VULKAN.currentFrame], 0, NULL);
+        }
+    }
+    if (drawable) recordDrawRun(commandBuffer, draws, drawOffset, runStart, VULKAN.drawBatchCount - runStart);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
 
+static void recordOverdrawPass(VkCommandBuffer commandBuffer, uint32_t frame) {
+    beginOverdrawCount(commandBuffer);
+    bindGeometry(commandBuffer);
+    VkDeviceSize instanceOffset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, VULKAN.instanceBuffers + frame, &instanceOffset);
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, VULKAN.pipelineLayout,
-        0, 1, &VULKAN.descriptorSets[VULKAN.currentFrame], 0, NULL);
+        0, 1, &VULKAN.descriptorSets[frame], 0, NULL);
+    // one pipeline for everything, so the whole list goes out in one run
+    recordDrawRun(commandBuffer, VULKAN.indirectBuffers[frame], 0, 0, VULKAN.drawBatchCount);
+    endOverdrawCount(commandBuffer);
+}
 
-    vkCmdDrawIndexed(commandBuffer, INDICES_COUNT, 1, 0, 0, 0);
+void recordCommandBuffer(VkCommandBuffer commandBuffer) {
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .pInheritanceInfo = NULL
+    };
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        c_throw("failed to begin a command buffer");
+    }
 
-    vkCmdEndRenderPass(commandBuffer);
+    uint32_t frame = VULKAN.currentFrame;
+    resetStatistics(commandBuffer, frame);
+    gpuTraceReset(commandBuffer, frame);
+    beginResolutionFrame(commandBuffer, frame);
+    acquireLightingBuffers(commandBuffer, frame);
+    TRACE_GPU_BEGIN(commandBuffer, frame, "frame");
+
+    TRACE_GPU_BEGIN(commandBuffer, frame, "shadows");
+    recordShadows(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
+
+    if (getPipeline(VULKAN.pipeline) == VK_NULL_HANDLE) {
+        // still compiling - clear only
+        recordScenePass(commandBuffer, VULKAN.renderPass, true, VK_NULL_HANDLE, VK_NULL_HANDLE, 0);
+    } else if (overdrawReady()) {
+        // every draw with nothing culled, that's the waste being looked at
+        TRACE_GPU_BEGIN(commandBuffer, frame, "overdrawCount");
+        beginStatistics(commandBuffer, frame, STATISTICS_PASS_OVERDRAW);
+        recordOverdrawPass(commandBuffer, frame);
+        endStatistics(commandBuffer, frame, STATISTICS_PASS_OVERDRAW);
+        TRACE_GPU_END(commandBuffer, frame);
+        TRACE_GPU_BEGIN(commandBuffer, frame, "overdrawHeatmap");
+        recordOverdrawHeatmap(commandBuffer);
+        TRACE_GPU_END(commandBuffer, frame);
+    } else if (occlusionCullingActive()) {
+        // last frame's visible set, then whatever the pyramid of that shows to be newly visible
+        TRACE_GPU_BEGIN(commandBuffer, frame, "cullEarly");
+        recordOcclusionCull(commandBuffer, frame, OCCLUSION_PHASE_EARLY);
+        TRACE_GPU_END(commandBuffer, frame);
+        TRACE_GPU_BEGIN(commandBuffer, frame, "sceneEarly");
+        beginStatistics(commandBuffer, frame, STATISTICS_PASS_SCENE);
+        recordScenePass(commandBuffer, VULKAN.renderPass, false, occlusionVisibleInstances(frame),
+            occlusionDraws(frame), occlusionDrawOffset(OCCLUSION_PHASE_EARLY));
+        endStatistics(commandBuffer, frame, STATISTICS_PASS_SCENE);
+        TRACE_GPU_END(commandBuffer, frame);
+        TRACE_GPU_BEGIN(commandBuffer, frame, "depthPyramid");
+        recordDepthPyramid(commandBuffer);
+        TRACE_GPU_END(commandBuffer, frame);
+        TRACE_GPU_BEGIN(commandBuffer, frame, "cullLate");
+        recordOcclusionCull(commandBuffer, frame, OCCLUSION_PHASE_LATE);
+        TRACE_GPU_END(commandBuffer, frame);
+        TRACE_GPU_BEGIN(commandBuffer, frame, "sceneLate");
+        beginStatistics(commandBuffer, frame, STATISTICS_PASS_LATE);
+        recordScenePass(commandBuffer, VULKAN.renderPassLoad, false, occlusionVisibleInstances(frame),
+            occlusionDraws(frame), occlusionDrawOffset(OCCLUSION_PHASE_LATE));
+        endStatistics(commandBuffer, frame, STATISTICS_PASS_LATE);
+        TRACE_GPU_END(commandBuffer, frame);
+    } else {
+        TRACE_GPU_BEGIN(commandBuffer, frame, "scene");
+        beginStatistics(commandBuffer, frame, STATISTICS_PASS_SCENE);
+        recordScenePass(commandBuffer, VULKAN.renderPass, false, VULKAN.instanceBuffers[frame],
+            VULKAN.indirectBuffers[frame], 0);
+        endStatistics(commandBuffer, frame, STATISTICS_PASS_SCENE);
+        TRACE_GPU_END(commandBuffer, frame);
+    }
+    TRACE_GPU_BEGIN(commandBuffer, frame, "sprites");
+    recordSprites(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
+    TRACE_GPU_BEGIN(commandBuffer, frame, "upscale");
+    recordUpscale(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
+    TRACE_GPU_BEGIN(commandBuffer, frame, "overlay");
+    recordOverlay(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
+    finishOutput(commandBuffer, frame);
+    TRACE_GPU_BEGIN(commandBuffer, frame, "views");
+    recordViews(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        c_throw("fauled to record command buffer");
+    }
+}
+
+void recordPresentCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .pInheritanceInfo = NULL
+    };
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        c_throw("failed to begin a command buffer");
+    }
+
+    uint32_t frame = VULKAN.currentFrame;
+    TRACE_GPU_BEGIN(commandBuffer, frame, "present");
+    recordPresentBlit(commandBuffer, frame, imageIndex);
+    recordViewBlits(commandBuffer);
+    TRACE_GPU_BEGIN(commandBuffer, frame, "capture");
+    recordCapture(commandBuffer, frame, imageIndex);
+    TRACE_GPU_END(commandBuffer, frame);
+    TRACE_GPU_END(commandBuffer, frame);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         c_throw("fauled to record command buffer");
@@ -1090,83 +1406,115 @@ void createSyncObjects() {
 }
 
 void recreateSwapchain() {
+    // this can be the render thread, the size comes from the main thread's last poll
     int width = 0, height = 0;
-    glfwGetFramebufferSize(WINDOW.window, &width, &height);
-    while (width == 0 || height == 0) {
-        glfwGetFramebufferSize(WINDOW.window, &width, &height);
-        glfwWaitEvents();
-    }
+    windowWaitForSize(&width, &height);
+    if (width == 0 || height == 0) return;
 
     vkDeviceWaitIdle(VULKAN.device);
 
     clearupSwapchain();
 
     createSwapChain();
-    createImageViews();
+    createRenderTargets();
+    createOverlayTargets();
+    createSpriteTargets();
     createDepthResources();
+    createDepthPyramid();
     createFramebuffers();
+    createCaptureBuffers();
+    createOverdrawTarget();
+
+    // the cluster tiles follow the extent, which the camera version doesn't cover
+    memset(VULKAN.uniformVersions, 0, sizeof(uint32_t) * MAX_FRAMES_IN_FLIGHT);
 }
 
 void clearupSwapchain() {
+    destroyDepthPyramid();
+    destroyCaptureBuffers();
+    destroyOverdrawTarget();
+
     vkDestroyImageView(VULKAN.device, VULKAN.depthImageView, NULL);
     vkDestroyImage(VULKAN.device, VULKAN.depthImage, NULL);
-    vkFreeMemory(VULKAN.device, VULKAN.depthImageMemory, NULL);
+    freeDeviceMemory(VULKAN.depthImageMemory);
 
-    for (size_t i = 0; i < VULKAN.swapchainFramebuffers.count; ++i) {
-        vkDestroyFramebuffer(VULKAN.device, VULKAN.swapchainFramebuffers.f[i], NULL);
-    }
-
-    for (uint32_t i = 0; i < VULKAN.swapchainImageViews.count; ++i) {
-        vkDestroyImageView(VULKAN.device, VULKAN.swapchainImageViews.swapChainImageViews[i], NULL);
-    }
+    vkDestroyFramebuffer(VULKAN.device, VULKAN.sceneFramebuffer, NULL);
+    destroyOverlayTargets();
+    destroySpriteTargets();
+    destroyRenderTargets();
 
     vkDestroySwapchainKHR(VULKAN.device, VULKAN.swapchain, NULL);
 }
 
-void createVertexBuffer() {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * VERTICES_COUNT;
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &stagingBuffer, &stagingBufferMemory);
-
-    void* data;// = malloc(bufferSize);
-    vkMapMemory(VULKAN.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices, (size_t)bufferSize);
-    vkUnmapMemory(VULKAN.device, stagingBufferMemory);
-
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &VULKAN.vertexBuffer, &VULKAN.vertexBufferMemory);
-
-    copyBuffer(stagingBuffer, VULKAN.vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
-    vkFreeMemory(VULKAN.device, stagingBufferMemory, NULL);
+// geometry after lod generation and optimization, freed once uploaded
+static struct {
+    Vertex* vertices;
+    uint32_t vertexCount;
+    uint32_t* indices;
+    uint32_t indexCount;
+} meshData;
+
+static void printCacheStats(const char* label, const uint32_t* meshIndices, uint32_t indexCount, uint32_t vertexCount) {
+    MeshCacheStats stats = meshAnalyzeVertexCache(meshIndices, indexCount, vertexCount, MESHOPT_CACHE_SIZE);
+    printf("\t%s: ACMR %.3f, ATVR %.3f\n", label, stats.acmr, stats.atvr);
 }
 
-void createIndexBuffer() {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * INDICES_COUNT;
+void buildMeshes() {
+    VULKAN.meshCount = 1;
+    VULKAN.meshes = calloc(VULKAN.meshCount, sizeof(Mesh));
+    if (VULKAN.meshCount * MESH_MAX_LODS > MAX_DRAW_BATCHES) {
+        c_throw("too many meshes for the draw batch buffers");
+    }
+    VULKAN.sceneBatches = malloc(sizeof(DrawBatch) * VULKAN.meshCount * MESH_MAX_LODS);
+    VULKAN.drawBatches = malloc(sizeof(DrawBatch) * VULKAN.meshCount * MESH_MAX_LODS);
+    renderQueueInit(&VULKAN.renderQueue, VULKAN.meshCount * MESH_MAX_LODS);
+
+    uint32_t* source = malloc(sizeof(uint32_t) * INDICES_COUNT);
+    memcpy(source, indices, sizeof(uint32_t) * INDICES_COUNT);
+
+    printf("mesh 0:\n");
+    printCacheStats("authored", source, INDICES_COUNT, VERTICES_COUNT);
+    if (SETTINGS.meshOptimize) {
+        meshOptimizeVertexCache(source, source, INDICES_COUNT, VERTICES_COUNT);
+        meshOptimizeOverdraw(source, source, INDICES_COUNT, vertices, VERTICES_COUNT);
+    }
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &stagingBuffer, &stagingBufferMemory);
+    meshData.indices = malloc(sizeof(uint32_t) * MESH_LOD_INDEX_CAPACITY(INDICES_COUNT));
+    meshData.indexCount = meshBuildLods(VULKAN.meshes, meshData.indices, 0,
+        source, INDICES_COUNT, vertices, VERTICES_COUNT);
+    free(source);
+
+    meshData.vertices = malloc(sizeof(Vertex) * VERTICES_COUNT);
+    if (SETTINGS.meshOptimize) {
+        // simplification scrambles triangle order, so every coarser lod gets its own pass
+        for (uint32_t i = 1; i < VULKAN.meshes->lodCount; ++i) {
+            const MeshLod* lod = VULKAN.meshes->lods + i;
+            meshOptimizeVertexCache(meshData.indices + lod->firstIndex, meshData.indices + lod->firstIndex,
+                lod->indexCount, VERTICES_COUNT);
+        }
+        // lod 0 comes first in the index buffer, so fetch order follows it
+        meshData.vertexCount = meshOptimizeVertexFetch(meshData.vertices, meshData.indices, meshData.indexCount,
+            vertices, VERTICES_COUNT);
+    } else {
+        memcpy(meshData.vertices, vertices, sizeof(Vertex) * VERTICES_COUNT);
+        meshData.vertexCount = VERTICES_COUNT;
+    }
+    VULKAN.meshes->vertexCount = meshData.vertexCount;
 
-    void* data; // = malloc(bufferSize);
-    vkMapMemory(VULKAN.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices, bufferSize);
-    vkUnmapMemory(VULKAN.device, stagingBufferMemory);
+    printCacheStats(SETTINGS.meshOptimize ? "optimized" : "unoptimized", meshData.indices,
+        VULKAN.meshes->lods[0].indexCount, meshData.vertexCount);
+    meshPrintLods("mesh 0", VULKAN.meshes);
+}
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &VULKAN.indexBuffer, &VULKAN.indexBufferMemory);
-    copyBuffer(stagingBuffer, VULKAN.indexBuffer, bufferSize);
+void uploadMeshes() {
+    if (!uploadMesh(VULKAN.meshes, meshData.vertices, meshData.vertexCount, meshData.indices, meshData.indexCount)) {
+        c_throw("geometry arenas are out of space");
+    }
 
-    vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
-    vkFreeMemory(VULKAN.device, stagingBufferMemory, NULL);
+    free(meshData.vertices);
+    free(meshData.indices);
+    meshData.vertices = NULL;
+    meshData.indices = NULL;
 }
 
 uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -1186,8 +1534,8 @@ uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
 
 void createBuffer(
     VkDeviceSize size, VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags properties, VkBuffer* buffer,
-    VkDeviceMemory* bufferMemory) {
+    VkMemoryPropertyFlags properties, MemoryCategory category,
+    VkBuffer* buffer, VkDeviceMemory* bufferMemory) {
     
     VkBufferCreateInfo bufferInfo = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -1207,20 +1555,36 @@ void createBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(VULKAN.device, *buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = NULL,
-        .allocationSize = memRequirements.size,
-        .memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties)
-    };
-
-    if (vkAllocateMemory(VULKAN.device, &allocInfo, NULL, bufferMemory) != VK_SUCCESS) {
+    uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, properties);
+    if (!allocateDeviceMemory(memRequirements.size, memoryType, category, bufferMemory)) {
         c_throw("failed to allocate vertex buffer memory");
     }
 
     vkBindBufferMemory(VULKAN.device, *buffer, *bufferMemory, 0);
 }
 
+void createFrameBuffers(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    MemoryCategory category, VkBuffer** buffers, VkDeviceMemory** memory, void*** mapped) {
+    *buffers = malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
+    *memory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    if (mapped) *mapped = malloc(sizeof(void*) * MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(size, usage, properties, category, *buffers + i, *memory + i);
+        if (mapped) vkMapMemory(VULKAN.device, (*memory)[i], 0, size, 0, *mapped + i);
+    }
+}
+
+void destroyFrameBuffers(VkBuffer* buffers, VkDeviceMemory* memory, void** mapped) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroyBuffer(VULKAN.device, buffers[i], NULL);
+        freeDeviceMemory(memory[i]);
+    }
+    free(buffers);
+    free(memory);
+    free(mapped);
+}
+
 void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -1239,7 +1603,7 @@ void createDescriptorSetLayout() {
         .binding = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
         .descriptorCount = 1,
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         .pImmutableSamplers = NULL
     };
 
@@ -1251,16 +1615,28 @@ void createDescriptorSetLayout() {
         .pImmutableSamplers = NULL
     };
 
-    VkDescriptorSetLayoutBinding bindings[] = {
+    // lights, cluster ranges and light indices from the clustered lighting pass, then the shadow cascades
+    VkDescriptorSetLayoutBinding bindings[6] = {
         uboLayoutBinding,
         samplerLayoutBinding
     };
+    for (uint32_t i = 2; i < 5; ++i) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = NULL
+        };
+    }
+    bindings[5] = samplerLayoutBinding;
+    bindings[5].binding = 5;
 
     VkDescriptorSetLayoutCreateInfo layoutInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .bindingCount = 2,
+        .bindingCount = 6,
         .pBindings = bindings
     };
 
@@ -1275,40 +1651,226 @@ void createUniformBuffers() {
     VULKAN.uniformBuffers = malloc(sizeof(VkBuffer*) * MAX_FRAMES_IN_FLIGHT);
     VULKAN.uniformBuffersMemory = malloc(sizeof(VkDeviceMemory*) * MAX_FRAMES_IN_FLIGHT);
     VULKAN.uniformBuffersMapped = malloc(sizeof(void**) * MAX_FRAMES_IN_FLIGHT);
+    // 0 never matches a camera version, so every frame gets written once
+    VULKAN.uniformVersions = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(uint32_t));
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
         createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VULKAN.uniformBuffers+i, VULKAN.uniformBuffersMemory+i);
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_UNIFORM, VULKAN.uniformBuffers+i, VULKAN.uniformBuffersMemory+i);
         vkMapMemory(VULKAN.device, VULKAN.uniformBuffersMemory[i], 0, bufferSize, 0, VULKAN.uniformBuffersMapped + i);
     }
 
 }
 
-bool firstTime = true;
-void updateUniformBuffer(uint32_t currentImage) {
-    UniformBufferObject ubo = {
-        GLM_MAT4_IDENTITY_INIT,GLM_MAT4_ZERO_INIT,GLM_MAT4_ZERO_INIT
-    };
-    static mat4 s_model;
-    if (firstTime) { 
-        glm_mat4_copy(GLM_MAT4_IDENTITY, s_model);
-        firstTime = false;
+void createInstanceBuffers() {
+    VkDeviceSize bufferSize = sizeof(InstanceData) * MAX_INSTANCES;
+
+    VULKAN.instanceBuffers = malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
+    VULKAN.instanceBuffersMemory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    VULKAN.instanceBuffersMapped = malloc(sizeof(void*) * MAX_FRAMES_IN_FLIGHT);
+
+    VULKAN.instanceNodes = malloc(sizeof(uint32_t) * MAX_INSTANCES);
+
+    // matrices are composed straight into these, no staging copy, the occlusion cull reads them too
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_VERTEX, VULKAN.instanceBuffers + i, VULKAN.instanceBuffersMemory + i);
+        vkMapMemory(VULKAN.device, VULKAN.instanceBuffersMemory[i], 0, bufferSize, 0, VULKAN.instanceBuffersMapped + i);
+    }
+
+    // one indirect command per draw batch, also read on the cpu when multi draw isn't available
+    VkDeviceSize indirectSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAW_BATCHES;
+    VULKAN.indirectBuffers = malloc(sizeof(VkBuffer) * MAX_FRAMES_IN_FLIGHT);
+    VULKAN.indirectBuffersMemory = malloc(sizeof(VkDeviceMemory) * MAX_FRAMES_IN_FLIGHT);
+    VULKAN.indirectBuffersMapped = malloc(sizeof(void*) * MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(indirectSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STORAGE, VULKAN.indirectBuffers + i, VULKAN.indirectBuffersMemory + i);
+        vkMapMemory(VULKAN.device, VULKAN.indirectBuffersMemory[i], 0, indirectSize, 0, VULKAN.indirectBuffersMapped + i);
     }
 
+    loadScene(SETTINGS.scene);
+}
+
+const char* sceneKindName(SceneKind kind) {
+    static const char* names[SCENE_KIND_COUNT] = { "quads", "instances", "textures" };
+    return kind < SCENE_KIND_COUNT ? names[kind] : "unknown";
+}
+
+static float randomRange(float low, float high) {
+    return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+// a fixed seed, so regression runs see the same lights every time
+static void scatterLights(uint32_t count) {
+    if (count > LIGHTING_MAX_LIGHTS) count = LIGHTING_MAX_LIGHTS;
+    VULKAN.lights = realloc(VULKAN.lights, sizeof(Light) * (count ? count : 1));
+    VULKAN.lightOrigins = realloc(VULKAN.lightOrigins, sizeof(vec3) * (count ? count : 1));
+    VULKAN.lightCount = count;
+
+    srand(7);
+    for (uint32_t i = 0; i < count; ++i) {
+        Light* light = VULKAN.lights + i;
+        light->position[0] = randomRange(-2.0f, 2.0f);
+        light->position[1] = randomRange(-2.0f, 2.0f);
+        light->position[2] = randomRange(-0.6f, 0.6f);
+        light->range = randomRange(0.15f, 0.45f);
+        float intensity = randomRange(0.5f, 1.5f);
+        light->color[0] = randomRange(0.1f, 1.0f) * intensity;
+        light->color[1] = randomRange(0.1f, 1.0f) * intensity;
+        light->color[2] = randomRange(0.1f, 1.0f) * intensity;
+        // every eighth one is a spot pointing down
+        light->spotCos = i % 8 == 0 ? 0.8f : -2.0f;
+        light->direction[0] = 0.0f;
+        light->direction[1] = 0.0f;
+        light->direction[2] = -1.0f;
+        glm_vec3_copy(light->position, VULKAN.lightOrigins[i]);
+    }
+}
+
+// half the lights circle one way, half the other, angle is how far from where they were scattered
+static void orbitLights(float angle) {
+    float c = cosf(angle), s = sinf(angle);
+    for (uint32_t i = 0; i < VULKAN.lightCount; ++i) {
+        const float* o = VULKAN.lightOrigins[i];
+        float* p = VULKAN.lights[i].position;
+        float sign = (i & 1) ? -1.0f : 1.0f;
+        p[0] = o[0] * c - o[1] * s * sign;
+        p[1] = o[0] * s * sign + o[1] * c;
+    }
+}
+
+void loadScene(SceneKind kind) {
+    Scene* scene = &VULKAN.scene;
+    if (scene->capacity) sceneFree(scene);
+    sceneInit(scene, MAX_INSTANCES);
+
+    float position[3] = { 0.0f, 0.0f, 0.0f };
+    float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float scale[3] = { 1.0f, 1.0f, 1.0f };
+    VULKAN.sceneRoot = sceneAddNode(scene, SCENE_NO_PARENT, kind != SCENE_KIND_INSTANCES ? 0 : SCENE_NO_MESH,
+        position, rotation, scale);
+    // a wide floor below everything that never moves, what the shadow cache holds on to
+    float floorPosition[3] = { 0.0f, 0.0f, -1.0f };
+    float floorScale[3] = { 6.0f, 6.0f, 1.0f };
+    sceneAddNode(scene, SCENE_NO_PARENT, 0, floorPosition, rotation, floorScale);
+
+    // near used to be 0, which squashes every depth value to 1
+    uint32_t version = VULKAN.camera.version;
+    cameraInit(&VULKAN.camera, glm_rad(45.0f), 0.1f, 100.0f);
+    // versions keep increasing, so every frame in flight rewrites its ubo
+    VULKAN.camera.version = version;
     vec3 eye = { 2.0f, 2.0f, 2.0f };
     vec3 center = { 0.0f, 0.0f, 0.0f };
     vec3 up = { 0.0f, 0.0f, 1.0f };
-    
-    glm_rotate_z(s_model, glm_rad(3.0f), ubo.model);
-    glm_mat4_copy(ubo.model, s_model);
-    glm_lookat(eye, center, up, ubo.view);
-    glm_perspective(glm_rad(45.0f),
-        (float)VULKAN.swapchainExtent.width / (float)VULKAN.swapchainExtent.height,
-        0.0f, 1.0f, ubo.proj);
 
-    ubo.proj[1][1] *= -1;
+    if (kind == SCENE_KIND_INSTANCES) {
+        // a grid of small copies under the spinning root
+        const int side = 32;
+        float spacing = 0.12f;
+        float childScale[3] = { 0.1f, 0.1f, 0.1f };
+        for (int y = 0; y < side; ++y) {
+            for (int x = 0; x < side; ++x) {
+                float p[3] = { ((float)x - side * 0.5f) * spacing, ((float)y - side * 0.5f) * spacing, 0.0f };
+                sceneAddNode(scene, VULKAN.sceneRoot, 0, p, rotation, childScale);
+            }
+        }
+        eye[0] = eye[1] = 3.0f;
+        eye[2] = 4.0f;
+    }
+    cameraLookAt(&VULKAN.camera, eye, center, up);
+    scatterLights(SETTINGS.lightCount);
+
+    vec3 sunDirection = { -0.4f, -0.25f, -1.0f };
+    vec3 sunColor = { 0.9f, 0.85f, 0.75f };
+    setShadowLight(sunDirection, sunColor);
+    invalidateShadowCache();
+    simulationReset();
+    spritesSetField(kind == SCENE_KIND_TEXTURES && SETTINGS.spriteCount < SPRITE_SCENE_SPRITES ?
+        SPRITE_SCENE_SPRITES : SETTINGS.spriteCount);
+}
+
+// keys every batch by state and its nearest instance, drawBatches ends up in key order
+static void queueDraws(const InstanceData* instances) {
+    RenderQueue* queue = &VULKAN.renderQueue;
+    const Camera* camera = &VULKAN.camera;
+    renderQueueBeginFrame(queue);
+    renderQueueClear(queue);
+
+    vec3 forward;
+    glm_vec3_sub((float*)camera->center, (float*)camera->eye, forward);
+    glm_vec3_normalize(forward);
+    float range = camera->zfar - camera->znear;
+
+    for (uint32_t b = 0; b < VULKAN.drawBatchCount; ++b) {
+        const DrawBatch* batch = VULKAN.sceneBatches + b;
+        float nearest = camera->zfar;
+        for (uint32_t i = batch->firstInstance; i < batch->firstInstance + batch->instanceCount; ++i) {
+            vec3 offset;
+            glm_vec3_sub((float*)instances[i].model[3], (float*)camera->eye, offset);
+            float depth = glm_vec3_dot(offset, forward);
+            if (depth < nearest) nearest = depth;
+        }
+        renderQueuePush(queue, renderKeyEncode(RENDER_PASS_OPAQUE, VULKAN.pipeline, RENDER_MATERIAL_DEFAULT,
+            batch->mesh, (nearest - camera->znear) / range), b);
+    }
+    renderQueueSort(queue);
+
+    for (uint32_t i = 0; i < queue->count; ++i) {
+        VULKAN.drawBatches[i] = VULKAN.sceneBatches[queue->values[i]];
+    }
+}
+
+void updateUniformBuffer(uint32_t currentImage) {
+    SimState state;
+    simulationSample(getTimeInNanoseconds(), &state);
+    sceneSetRotation(&VULKAN.scene, VULKAN.sceneRoot, state.spin);
+    sceneUpdate(&VULKAN.scene);
+
+    cameraSetAspect(&VULKAN.camera,
+        (float)VULKAN.swapchainExtent.width / (float)VULKAN.swapchainExtent.height);
+    cameraUpdate(&VULKAN.camera);
+    // the cascades also follow the sun, which the camera version doesn't cover
+    if (updateShadowCascades(&VULKAN.camera)) {
+        memset(VULKAN.uniformVersions, 0, sizeof(uint32_t) * MAX_FRAMES_IN_FLIGHT);
+    }
+    writeShadowCasters(currentImage, &VULKAN.scene);
+
+    // each frame in flight has its own copy, so it's rewritten once per camera change per frame
+    if (VULKAN.uniformVersions[currentImage] != VULKAN.camera.version) {
+        UniformBufferObject ubo = {
+            GLM_MAT4_IDENTITY_INIT,GLM_MAT4_ZERO_INIT,GLM_MAT4_ZERO_INIT
+        };
+        glm_mat4_copy(VULKAN.camera.view, ubo.view);
+        glm_mat4_copy(VULKAN.camera.proj, ubo.proj);
+        lightingClusterParams(&VULKAN.camera, VULKAN.renderExtent, ubo.cluster);
+        writeShadowUniforms(&VULKAN.camera, &ubo);
+        memcpy(VULKAN.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        VULKAN.uniformVersions[currentImage] = VULKAN.camera.version;
+    }
 
-    memcpy(VULKAN.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    VULKAN.drawBatchCount = sceneBuildDraws(&VULKAN.scene, VULKAN.meshes, VULKAN.meshCount, &VULKAN.camera,
+        (float)VULKAN.renderExtent.height, VULKAN.instanceBuffersMapped[currentImage], VULKAN.instanceNodes,
+        VULKAN.sceneBatches, &VULKAN.drawStats);
+    queueDraws(VULKAN.instanceBuffersMapped[currentImage]);
+    orbitLights(state.lightOrbit);
+    writeLightingInputs(currentImage, VULKAN.lights, VULKAN.lightCount, &VULKAN.camera);
+    writeOcclusionInputs(currentImage, VULKAN.drawBatches, VULKAN.drawBatchCount, VULKAN.meshes,
+        VULKAN.instanceBuffersMapped[currentImage], VULKAN.instanceNodes, VULKAN.drawStats.instances, &VULKAN.camera);
+
+    VkDrawIndexedIndirectCommand* draws = VULKAN.indirectBuffersMapped[currentImage];
+    for (uint32_t i = 0; i < VULKAN.drawBatchCount; ++i) {
+        const DrawBatch* batch = VULKAN.drawBatches + i;
+        const Mesh* mesh = VULKAN.meshes + batch->mesh;
+        const MeshLod* lod = mesh->lods + batch->lod;
+        draws[i] = (VkDrawIndexedIndirectCommand){
+            .indexCount = lod->indexCount,
+            .instanceCount = batch->instanceCount,
+            .firstIndex = lod->firstIndex,
+            .vertexOffset = mesh->vertexOffset,
+            .firstInstance = batch->firstInstance
+        };
+    }
 }
 
 void createDescriptorPool() {
@@ -1319,7 +1881,11 @@ void createDescriptorPool() {
         },
         {
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = MAX_FRAMES_IN_FLIGHT
+            .descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT
         }
     };
 
@@ -1328,7 +1894,7 @@ void createDescriptorPool() {
         .pNext = NULL,
         .flags = 0,
         .maxSets = MAX_FRAMES_IN_FLIGHT,
-        .poolSizeCount = 2,
+        .poolSizeCount = 3,
         .pPoolSizes = poolSizes
     };
 
@@ -1391,33 +1957,93 @@ void createDescriptorSets() {
             }
         };
         vkUpdateDescriptorSets(VULKAN.device, 2, descriptorWrite, 0, NULL);
+
+        VkDescriptorBufferInfo lightingInfo[3] = {
+            { lightingLights(i), 0, VK_WHOLE_SIZE },
+            { lightingClusters(i), 0, VK_WHOLE_SIZE },
+            { lightingIndices(i), 0, VK_WHOLE_SIZE }
+        };
+        VkWriteDescriptorSet lightingWrites[3];
+        for (uint32_t b = 0; b < 3; ++b) {
+            lightingWrites[b] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = VULKAN.descriptorSets[i],
+                .dstBinding = 2 + b,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = NULL,
+                .pBufferInfo = lightingInfo + b,
+                .pTexelBufferView = NULL
+            };
+        }
+        vkUpdateDescriptorSets(VULKAN.device, 3, lightingWrites, 0, NULL);
+
+        VkDescriptorImageInfo shadowInfo = {
+            .sampler = shadowMapSampler(),
+            .imageView = shadowMapView(),
+            .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+        };
+        VkWriteDescriptorSet shadowWrite = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = NULL,
+            .dstSet = VULKAN.descriptorSets[i],
+            .dstBinding = 5,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &shadowInfo,
+            .pBufferInfo = NULL,
+            .pTexelBufferView = NULL
+        };
+        vkUpdateDescriptorSets(VULKAN.device, 1, &shadowWrite, 0, NULL);
     }
 }
 
-void createTextureImage() {
-    int tWidth, tHeight, tChannels;
-    stbi_uc* pixels = stbi_load("textures/texture.png", &tWidth, &tHeight, &tChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = tWidth * tHeight * tChannels;
+static struct {
+    assetfile asset;
+    stbi_uc* pixels;
+    int width, height, channels;
+} decodedTexture;
+
+void decodeTextureImage() {
+    if (!asset_open("textures/texture.png", &decodedTexture.asset)) {
+        c_throw("failed to open texture image");
+    }
 
-    if (!pixels) {
+    // decoded straight from the mapped file, no stdio copy in between
+    decodedTexture.pixels = stbi_load_from_memory(decodedTexture.asset.data, (int)decodedTexture.asset.size,
+        &decodedTexture.width, &decodedTexture.height, &decodedTexture.channels, STBI_rgb_alpha);
+
+    if (!decodedTexture.pixels) {
         c_throw("failed to load texture image");
     }
+}
+
+void createTextureImage() {
+    int tWidth = decodedTexture.width, tHeight = decodedTexture.height;
+    stbi_uc* pixels = decodedTexture.pixels;
+    // STBI_rgb_alpha always gives 4 channels, whatever the file has
+    VkDeviceSize imageSize = (VkDeviceSize)tWidth * tHeight * 4;
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, &stagingBuffer, &stagingBufferMemory);
 
     void* data;
     vkMapMemory(VULKAN.device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, (size_t)imageSize);
+    asset_copy(&decodedTexture.asset, data, pixels, (size_t)imageSize);
     vkUnmapMemory(VULKAN.device, stagingBufferMemory);
 
     stbi_image_free(pixels);
+    decodedTexture.pixels = NULL;
+    asset_close(&decodedTexture.asset);
 
     createImage((uint32_t)tWidth, (uint32_t)tHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &VULKAN.textureImage, &VULKAN.textureImageMemory);
+        MEMORY_CATEGORY_TEXTURE, &VULKAN.textureImage, &VULKAN.textureImageMemory);
 
     transitionImageLayout(VULKAN.textureImage, VK_FORMAT_R8G8B8A8_SRGB,
         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
@@ -1426,11 +2052,17 @@ void createTextureImage() {
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     vkDestroyBuffer(VULKAN.device, stagingBuffer, NULL);
-    vkFreeMemory(VULKAN.device, stagingBufferMemory, NULL);
+    freeDeviceMemory(stagingBufferMemory);
+}
+
+void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+    VkMemoryPropertyFlags properties, MemoryCategory category, VkImage* image, VkDeviceMemory* imageMemory) {
+    createImageLayers(width, height, 1, format, tiling, usage, properties, category, image, imageMemory);
 }
 
-void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* image, VkDeviceMemory* imageMemory) {
+void createImageLayers(uint32_t width, uint32_t height, uint32_t layers, VkFormat format, VkImageTiling tiling,
+    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category,
+    VkImage* image, VkDeviceMemory* imageMemory) {
     VkImageCreateInfo imageInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext = NULL,
@@ -1443,7 +2075,7 @@ void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling
             .depth = 1
             },
         .mipLevels = 1,
-        .arrayLayers = 1,
+        .arrayLayers = layers,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = tiling,
         .usage = usage,
@@ -1460,20 +2092,17 @@ void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling
     VkMemoryRequirements memReq;
     vkGetImageMemoryRequirements(VULKAN.device, *image, &memReq);
 
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = NULL,
-        .allocationSize = memReq.size,
-        .memoryTypeIndex = findMemoryType(memReq.memoryTypeBits, properties)
-    };
-
-    if (vkAllocateMemory(VULKAN.device, &allocInfo, NULL, imageMemory) != VK_SUCCESS) {
+    uint32_t memoryType = findMemoryType(memReq.memoryTypeBits, properties);
+    if (!allocateDeviceMemory(memReq.size, memoryType, category, imageMemory)) {
         c_throw("failed to alloc texture image memory");
     }
     vkBindImageMemory(VULKAN.device, *image, *imageMemory, 0);
 }
 
 VkCommandBuffer beginSingleTimeCommands() {
+    // the pool and the queue are shared by init tasks, held until endSingleTimeCommands
+    c_mutex_lock(&VULKAN.commandPoolLock);
+
     VkCommandBufferAllocateInfo allocInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = NULL,
@@ -1516,6 +2145,8 @@ void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkQueueWaitIdle(VULKAN.graphicsQueue);
 
     vkFreeCommandBuffers(VULKAN.device, VULKAN.commandPool, 1, &commandBuffer);
+
+    c_mutex_unlock(&VULKAN.commandPoolLock);
 }
 
 void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
@@ -1606,20 +2237,25 @@ void createTextureImageView() {
 }
 
 VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+    return createImageViewLayers(image, format, aspectFlags, VK_IMAGE_VIEW_TYPE_2D, 0, 1);
+}
+
+VkImageView createImageViewLayers(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+    VkImageViewType viewType, uint32_t baseLayer, uint32_t layerCount) {
     VkImageViewCreateInfo viewInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
         .image = image,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .viewType = viewType,
         .format = format,
         .components = {0,0,0,0},
         .subresourceRange = {
             .aspectMask = aspectFlags,
             .baseMipLevel = 0,
             .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1
+            .baseArrayLayer = baseLayer,
+            .layerCount = layerCount
             }
     };
 
@@ -1664,8 +2300,8 @@ void createTextureSampler() {
 void createDepthResources() {
     VkFormat depthFormat = findDepthFormat();
     createImage(VULKAN.swapchainExtent.width, VULKAN.swapchainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &VULKAN.depthImage, &VULKAN.depthImageMemory);
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        MEMORY_CATEGORY_ATTACHMENT, &VULKAN.depthImage, &VULKAN.depthImageMemory);
     VULKAN.depthImageView = createImageView(VULKAN.depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 
     transitionImageLayout(VULKAN.depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
@@ -1694,6 +2330,16 @@ VkFormat findDepthFormat() {
         VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
+VkFormat findShadowFormat() {
+    // light space depth is linear, 16 bits are enough and halve the bandwidth of every cascade
+    VkFormat cands[] = { VK_FORMAT_D16_UNORM, VK_FORMAT_D32_SFLOAT };
+    return findSupportedFormat(
+        cands, 2,
+        VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT |
+        VK_FORMAT_FEATURE_TRANSFER_DST_BIT);
+}
+
 bool hasStancilComponent(VkFormat format) {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
@@ -3,4 +3,16 @@
 void initVk();
 void cleanVk();
 void drawFrame();
-void deviceIdle();
\ No newline at end of file
+void deviceIdle();
+
+/* deterministic scenes, the regression runs switch between them */
+typedef enum SceneKind {
+    SCENE_KIND_QUADS,
+    SCENE_KIND_INSTANCES,
+    /* the quads under a field of sprites, every layer of the sprite texture array in use */
+    SCENE_KIND_TEXTURES,
+    SCENE_KIND_COUNT
+} SceneKind;
+
+void loadScene(SceneKind kind);
+const char* sceneKindName(SceneKind kind);
\ No newline at end of file
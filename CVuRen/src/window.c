@@ -1,14 +1,106 @@
 #include "window.h"
 
+#include "settings.h"
+
+#include <stdio.h>
+#include <string.h>
+
 void initWindow() {
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
 	WINDOW.window = glfwCreateWindow(WIDTH, HEIGHT, "C Vulkan Renderer", NULL, NULL);
+	// regression images come from the main window alone
+	uint32_t extra = SETTINGS.regress || SETTINGS.viewCount < 2 ? 0 : SETTINGS.viewCount - 1;
+	if (extra > WINDOW_MAX_EXTRA) extra = WINDOW_MAX_EXTRA;
+	for (uint32_t i = 0; i < extra; ++i) {
+		char title[64];
+		snprintf(title, sizeof(title), "C Vulkan Renderer - view %u", i + 2);
+		WINDOW.extra[i] = glfwCreateWindow(WIDTH / 2, HEIGHT / 2, title, NULL, NULL);
+	}
+	WINDOW.extraCount = extra;
+	WINDOW.closing = false;
+	windowPublishSize();
 }
 
 void cleanWindow() {
+	for (uint32_t i = 0; i < WINDOW.extraCount; ++i) {
+		glfwDestroyWindow(WINDOW.extra[i]);
+	}
 	glfwDestroyWindow(WINDOW.window);
 	glfwTerminate();
 }
+
+bool windowShouldClose() {
+	if (glfwWindowShouldClose(WINDOW.window)) return true;
+	for (uint32_t i = 0; i < WINDOW.extraCount; ++i) {
+		if (glfwWindowShouldClose(WINDOW.extra[i])) return true;
+	}
+	return false;
+}
+
+void windowPublishSize() {
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(WINDOW.window, &width, &height);
+	int extraWidth[WINDOW_MAX_EXTRA] = { 0 }, extraHeight[WINDOW_MAX_EXTRA] = { 0 };
+	for (uint32_t i = 0; i < WINDOW.extraCount; ++i) {
+		glfwGetFramebufferSize(WINDOW.extra[i], extraWidth + i, extraHeight + i);
+	}
+
+	c_mutex_lock(&WINDOW.lock);
+	// only the main window's size is waited on, extra views just skip frames while minimized
+	bool changed = width != WINDOW.width || height != WINDOW.height;
+	WINDOW.width = width;
+	WINDOW.height = height;
+	memcpy(WINDOW.extraWidth, extraWidth, sizeof(extraWidth));
+	memcpy(WINDOW.extraHeight, extraHeight, sizeof(extraHeight));
+	if (changed) c_cond_broadcast(&WINDOW.resized);
+	c_mutex_unlock(&WINDOW.lock);
+}
+
+void windowSetEventsElsewhere(bool elsewhere) {
+	c_mutex_lock(&WINDOW.lock);
+	WINDOW.eventsElsewhere = elsewhere;
+	c_mutex_unlock(&WINDOW.lock);
+}
+
+void windowReleaseWaiters() {
+	c_mutex_lock(&WINDOW.lock);
+	WINDOW.closing = true;
+	c_cond_broadcast(&WINDOW.resized);
+	c_mutex_unlock(&WINDOW.lock);
+}
+
+void windowFramebufferSize(int* width, int* height) {
+	c_mutex_lock(&WINDOW.lock);
+	*width = WINDOW.width;
+	*height = WINDOW.height;
+	c_mutex_unlock(&WINDOW.lock);
+}
+
+void windowExtraFramebufferSize(uint32_t index, int* width, int* height) {
+	c_mutex_lock(&WINDOW.lock);
+	*width = WINDOW.extraWidth[index];
+	*height = WINDOW.extraHeight[index];
+	c_mutex_unlock(&WINDOW.lock);
+}
+
+void windowWaitForSize(int* width, int* height) {
+	c_mutex_lock(&WINDOW.lock);
+	while ((WINDOW.width == 0 || WINDOW.height == 0) && !WINDOW.closing) {
+		if (WINDOW.eventsElsewhere) {
+			c_cond_wait(&WINDOW.resized, &WINDOW.lock);
+		} else {
+			// nobody else is polling, so this is the main thread and it waits for the restore itself
+			c_mutex_unlock(&WINDOW.lock);
+			glfwWaitEvents();
+			if (windowShouldClose()) windowReleaseWaiters();
+			windowPublishSize();
+			c_mutex_lock(&WINDOW.lock);
+		}
+	}
+	*width = WINDOW.closing ? 0 : WINDOW.width;
+	*height = WINDOW.closing ? 0 : WINDOW.height;
+	c_mutex_unlock(&WINDOW.lock);
+}
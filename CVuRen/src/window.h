@@ -3,12 +3,44 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <stdbool.h>
+
+#include "utils/threading.h"
+
 static const uint32_t WIDTH = 800;
 static const uint32_t HEIGHT = 600;
+/* windows opened next to the main one, one per extra view, see views.h */
+#define WINDOW_MAX_EXTRA 3
 
 struct {
 	GLFWwindow* window;
+	GLFWwindow* extra[WINDOW_MAX_EXTRA];
+	uint32_t extraCount;
+
+	/* framebuffer size as of the last poll, for threads that can't ask glfw */
+	int width, height;
+	int extraWidth[WINDOW_MAX_EXTRA], extraHeight[WINDOW_MAX_EXTRA];
+	/* events are polled by the main thread while another one renders */
+	bool eventsElsewhere;
+	bool closing;
+	c_mutex lock;
+	c_cond resized;
 } WINDOW;
 
+/* opens the extra windows SETTINGS.viewCount asks for as well */
 void initWindow();
-void cleanWindow();
\ No newline at end of file
+void cleanWindow();
+
+/* main thread, true once any of the windows is asked to close */
+bool windowShouldClose();
+
+/* main thread, after polling events */
+void windowPublishSize();
+void windowSetEventsElsewhere(bool elsewhere);
+/* wakes threads waiting for a size, they get zeros back */
+void windowReleaseWaiters();
+
+void windowFramebufferSize(int* width, int* height);
+void windowExtraFramebufferSize(uint32_t index, int* width, int* height);
+/* blocks while the window is minimized, zeros when it's closing instead */
+void windowWaitForSize(int* width, int* height);